@@ -0,0 +1,95 @@
+#pragma once
+
+#include <string>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <unordered_map>
+#include <nlohmann/json.hpp>
+#include "RouteExecutor.hpp"
+
+// 单个路由执行器的准入策略
+struct AdmissionPolicy
+{
+    double max_queue_wait_seconds = 0.0; // 预计排队等待超过该值时拒绝（0表示不检查）
+    size_t max_in_flight_tasks = 0;      // 执行器执行中 + TaskManager排队/执行中的任务上限（0表示不检查）
+    double client_rate = 0.0;            // 每个客户端每秒补充的令牌数（0表示不限流）
+    double client_burst = 0.0;           // 每个客户端的令牌桶容量
+};
+
+// 准入判断结果
+struct AdmissionDecision
+{
+    bool admitted = true;
+    int status_code = 200;   // 拒绝时为429（客户端限流）或503（服务过载）
+    int retry_after = 0;     // 建议客户端重试的间隔（秒）
+    std::string reason;      // rate_limited / queue_wait / in_flight / queue_full
+};
+
+// 自适应准入控制
+// 在请求进入执行器队列之前，根据实测的排队等待时间、在途任务量和客户端令牌桶决定是否接收，
+// 过载时尽早以429/503拒绝，并根据当前处理速率给出Retry-After
+class AdmissionController
+{
+public:
+    AdmissionController();
+
+    // 设置执行器（按名称）的准入策略，未设置策略的执行器只受队列上限约束
+    void set_policy(const std::string &executor_name, const AdmissionPolicy &policy);
+
+    // 判断请求能否进入执行器，client为客户端标识（IP）
+    AdmissionDecision admit(const RouteExecutor &executor, const std::string &client);
+
+    // 执行器队列已满导致提交失败时调用（client与admit相同），退还admit消耗的客户端令牌，返回带Retry-After的拒绝结果
+    AdmissionDecision reject_queue_full(const RouteExecutor &executor, const std::string &client);
+
+    // 准入统计信息
+    nlohmann::json get_stats();
+
+    // 被拒绝的请求总数
+    size_t get_rejected_count() const { return rejected_; }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct TokenBucket
+    {
+        double tokens = 0.0;
+        Clock::time_point last_refill;
+    };
+
+    // 消耗客户端令牌（调用方需持有mutex_），令牌不足时返回需要等待的秒数，否则返回0
+    double take_token(const std::string &key, const AdmissionPolicy &policy, Clock::time_point now);
+
+    // 退还一个客户端令牌（调用方需持有mutex_），用于已通过准入但未能入队的请求
+    void refund_token(const std::string &key, const AdmissionPolicy &policy);
+
+    // 更新TaskManager的任务处理速率（调用方需持有mutex_）
+    void sample_task_rate(Clock::time_point now);
+
+    // 清理长时间未使用的令牌桶（调用方需持有mutex_）
+    void evict_idle_buckets(Clock::time_point now);
+
+    // 记录一次拒绝（调用方需持有mutex_）
+    void record_rejection(const std::string &executor_name, const std::string &reason);
+
+    // 将等待秒数换算为Retry-After，限制在[1, max_retry_after_]之间
+    int to_retry_after(double seconds) const;
+
+    std::mutex mutex_;
+    std::unordered_map<std::string, AdmissionPolicy> policies_;
+    std::unordered_map<std::string, TokenBucket> buckets_;   // key: 执行器名|客户端
+    Clock::time_point last_eviction_;
+
+    // TaskManager处理速率（个/秒）
+    double task_rate_;
+    size_t last_task_completed_;
+    Clock::time_point last_task_sample_;
+
+    // 拒绝计数: 执行器名 -> 原因 -> 次数
+    std::unordered_map<std::string, std::unordered_map<std::string, size_t>> rejections_;
+    std::atomic<size_t> admitted_;
+    std::atomic<size_t> rejected_;
+
+    int max_retry_after_; // Retry-After上限（秒）
+};
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <memory>
 #include <thread>
@@ -8,12 +9,22 @@
 #include <atomic>
 #include <condition_variable>
 #include <queue>
+#include <unordered_map>
 #include <future>
 #include <functional>
 #include <nlohmann/json.hpp>
 #include "DoubaoMediaAnalyzer.hpp"
 #include "TaskManager.hpp"
 #include "ExcelProcessor.hpp"
+#include "EventLoop.hpp"
+#include "HttpConnection.hpp"
+#include "ChunkedResponseWriter.hpp"
+#include "ResponseCompressor.hpp"
+#include "RouteExecutor.hpp"
+#include "AdmissionController.hpp"
+#include "WorkerSupervisor.hpp"
+#include "Metrics.hpp"
+#include "ConfigManager.hpp"
 
 // API请求结构
 struct ApiRequest
@@ -52,6 +63,7 @@ struct ApiExcelRequest
     std::string prompt;      // 分析提示词
     int max_tokens;          // 最大令牌数
     bool save_to_db;         // 是否保存到数据库
+    bool async_job;          // 是否以异步作业方式执行
 };
 
 
@@ -64,10 +76,34 @@ struct ApiResponse
     nlohmann::json data;
     double response_time;
     std::string error;
+    std::string trace_id; // 被采样时的跟踪ID（通过X-Trace-Id响应头返回）
+
+    // 非JSON接口（例如Prometheus指标）：content_type不为空时直接以body作为响应体返回
+    const char *content_type = nullptr;
+    std::string body;
 
     ApiResponse() : success(false), response_time(0.0) {}
 };
 
+// 单次API调用的上下文（所有string_view在调用期间有效）
+struct ApiContext
+{
+    std::string_view body;                   // 请求体（JSON）
+    std::string_view path;                   // 请求路径
+    std::string_view auth_header;            // Authorization 头
+    std::string_view query;                  // 查询字符串（不含'?'）
+    ChunkedResponseWriter *stream = nullptr; // 流式响应输出（HTTP/1.1）
+    const HttpRequest *request = nullptr;    // 原始HTTP请求（读取其他请求头、上传写入的临时文件）
+};
+
+// 路由表项：处理函数及其所属的执行器
+struct ApiRoute
+{
+    std::function<ApiResponse(const ApiContext &)> handler;
+    RouteExecutor *executor = nullptr;
+    bool requires_auth = false; // 开启鉴权时需要携带有效的access token
+};
+
 class ApiServer
 {
 private:
@@ -76,40 +112,187 @@ private:
     int port_;
     std::string host_;
 
-    // 并发处理相关成员
-    std::vector<std::thread> worker_threads_;
-    std::queue<std::function<void()>> request_queue_;
-    std::mutex queue_mutex_;
-    std::condition_variable queue_condition_;
-    std::atomic<bool> server_running_;
-    size_t max_concurrent_requests_;
+    // 并发处理相关成员：按路由划分的执行器（舱壁隔离）
+    std::unique_ptr<RouteExecutor> control_executor_;  // 认证、状态、作业查询
+    std::unique_ptr<RouteExecutor> query_executor_;    // 数据库查询
+    std::unique_ptr<RouteExecutor> analysis_executor_; // 媒体分析
+    size_t max_concurrent_requests_;                   // 分析执行器的排队请求硬上限（正常情况下由准入控制提前拒绝）
+    AdmissionController admission_;                   // 按排队等待时间、在途任务量和客户端配额做准入控制
+
+    // 路由表
+    std::unordered_map<std::string, ApiRoute> routes_;
+    std::vector<std::pair<std::string, ApiRoute>> prefix_routes_;
+    size_t max_request_body_size_; // 单个请求体大小上限
+    std::shared_ptr<const UploadPolicy> upload_policy_; // 上传接口的请求体上限和临时文件策略
+
+    // epoll I/O事件循环相关成员
+    int listen_fd_;
+    size_t io_thread_count_;
+    std::vector<std::unique_ptr<EventLoop>> io_loops_;
+    std::vector<std::thread> io_threads_;
+    std::atomic<size_t> next_loop_index_;
+    std::atomic<size_t> open_connections_;
+    std::atomic<bool> stopped_;
+    // 每个I/O循环上的连接表（fd -> 连接），仅在对应循环线程中访问，用于超时扫描
+    std::vector<std::unordered_map<int, HttpConnectionPtr>> io_connections_;
+
+    // 长连接相关配置
+    int keep_alive_timeout_seconds_;    // 空闲长连接超时（需大于nginx upstream的keepalive_timeout）
+    int request_timeout_seconds_;       // 接收单个请求的超时（防止慢速请求占用连接）
+    int write_timeout_seconds_;         // 发送响应无进展的超时
+    size_t max_requests_per_connection_; // 单个连接最多处理的请求数
+    size_t max_pipeline_depth_;         // 单个连接同时处理的流水线请求数上限
+    size_t stream_buffer_limit_;        // 流式响应在单个连接上积压的数据上限，超过后写入方暂停
+    std::atomic<size_t> aborted_streams_; // 因连接关闭或长时间不可写而中止的流式响应数
+    std::atomic<size_t> reused_requests_; // 复用已有连接的请求数
+    std::atomic<size_t> total_requests_;  // 已接收的请求总数
+
+    // 响应压缩
+    size_t compression_min_size_;                // 小于该大小的响应体不压缩
+    std::atomic<size_t> compressed_responses_;   // 已压缩的完整响应数
+    std::atomic<size_t> compression_input_bytes_;
+    std::atomic<size_t> compression_output_bytes_;
+
+    // 鉴权：API_REQUIRE_AUTH=1时，标记为requires_auth的路由需要携带有效的access token
+    bool require_auth_;
+    AuthConfig auth_config_; // 管理员账号（构造时从配置文件读取一次）
+
+    // 多进程模式下所属的supervisor（单进程模式为nullptr）
+    WorkerSupervisor *supervisor_;
+
+    // 各执行器的请求处理耗时（构造时注册，之后只读）
+    std::unordered_map<const RouteExecutor *, Histogram *> request_histograms_;
+
+    // 注册路由表
+    void register_routes();
+
+    // 查找路径对应的路由，未找到返回nullptr
+    const ApiRoute *find_route(std::string_view path) const;
+
+    // 验证Authorization头中的access token，失败时设置response并返回false
+    bool authorize(std::string_view auth_header, ApiResponse &response);
+
+    // 各路由的处理函数
+    ApiResponse route_auth(const ApiContext &ctx);
+    ApiResponse route_auth_refresh(const ApiContext &ctx);
+    ApiResponse route_status();
+    ApiResponse route_metrics();
+    ApiResponse route_debug_traces(const ApiContext &ctx);
+    ApiResponse route_jobs(const ApiContext &ctx);
+    ApiResponse route_query(const ApiContext &ctx);
+    ApiResponse route_analyze(const ApiContext &ctx);
+    ApiResponse route_batch_analyze(const ApiContext &ctx);
+    ApiResponse route_excel_analyze(const ApiContext &ctx);
+    ApiResponse route_db_media_analyze(const ApiContext &ctx);
+    ApiResponse route_upload(const ApiContext &ctx);
+
+    // 接收新连接（在第0个I/O循环中执行）
+    void on_accept();
+
+    // 将新连接注册到指定的I/O循环
+    void register_connection(size_t loop_index, int client_fd, const std::string &peer);
+
+    // 连接上的epoll事件分发
+    void on_connection_event(const HttpConnectionPtr &conn, uint32_t events);
+
+    // 读取连接上的数据
+    void handle_readable(const HttpConnectionPtr &conn);
 
-    // 请求处理工作线程函数
-    void request_worker_thread();
+    // 解析读缓冲区中的完整请求（支持流水线），依次投递到工作线程处理
+    void dispatch_requests(const HttpConnectionPtr &conn);
 
-    // 处理HTTP连接
-    void handle_connection(int client_socket);
+    // 以429/503（带Retry-After）拒绝未通过准入控制的请求
+    void reject_request(const HttpConnectionPtr &conn, uint64_t sequence, bool keep_alive, const AdmissionDecision &decision);
+
+    // 在工作线程中处理一个完整的HTTP请求，sequence为该请求在连接上的序号
+    void handle_request(const HttpConnectionPtr &conn, const HttpRequestPtr &request, uint64_t sequence, bool keep_alive);
+
+    // 构建HTTP响应报文，status_code为0时根据response自动选择（200/401）
+    // 响应头和响应体是两个独立片段，响应体直接由response序列化生成
+    // encoding不为Identity且响应体不小于compression_min_size_时压缩响应体
+    OutputBuffer build_http_response(const ApiResponse &response, int status_code = 0, bool keep_alive = false, const std::string &extra_headers = "",
+                                     ContentEncoding encoding = ContentEncoding::Identity);
+
+    // 用已生成的响应体构建HTTP响应报文（按需压缩）
+    OutputBuffer build_http_body_response(std::string body, const char *content_type, int status_code, bool keep_alive,
+                                          const std::string &extra_headers, ContentEncoding encoding);
+
+    // 生成Prometheus文本格式的指标（GET /metrics）
+    std::string render_metrics();
+
+    // 向序号为sequence的响应槽位追加数据（finished表示响应已完整），并把队首的响应数据按顺序移入发送缓冲区
+    void append_response(const HttpConnectionPtr &conn, uint64_t sequence, OutputBuffer data, bool finished, bool close_after_write);
+
+    // 在I/O循环线程中接收工作线程产生的响应数据并发送
+    void deliver_response(const HttpConnectionPtr &conn, uint64_t sequence, OutputBuffer data, bool finished, bool close_after_write);
+
+    // 将响应加入连接的发送缓冲区（在I/O循环线程中执行）
+    void queue_response(const HttpConnectionPtr &conn, OutputBuffer response, bool close_after_write);
+
+    // 尽可能发送缓冲区中的数据
+    void flush_write_buffer(const HttpConnectionPtr &conn);
+
+    // 流式响应的背压：工作线程发送chunk前登记字节数，wait为true时先等待积压降到上限以下；
+    // 连接已关闭返回false，超过write_timeout_seconds_仍不可写时关闭连接并返回false
+    bool reserve_stream_buffer(const HttpConnectionPtr &conn, size_t bytes, bool wait);
+
+    // I/O线程：投递的数据已放入连接（released为其字节数）或发送了部分数据后，更新积压量并唤醒等待的写入方
+    void update_stream_buffer(const HttpConnectionPtr &conn, size_t released = 0);
+
+    // 根据连接状态更新epoll关注的事件
+    void update_interest(const HttpConnectionPtr &conn);
+
+    // 关闭连接
+    void close_connection(const HttpConnectionPtr &conn);
+
+    // 定时扫描I/O循环上的连接，关闭空闲、慢请求和发送停滞的连接
+    void sweep_connections(size_t loop_index);
+
+    // 多进程模式下把本worker的状态写入共享内存槽位（同时作为心跳）
+    void report_worker_status();
 
     // 解析API请求
     ApiResponse parse_request(const std::string &request_json, const std::string &path);
 
     // 处理图片分析请求
-    ApiResponse handle_image_analysis(const ApiRequest &request);
+    ApiResponse handle_image_analysis(const ApiRequest &request, ChunkedResponseWriter *stream);
 
     // 处理视频分析请求
-    ApiResponse handle_video_analysis(const ApiRequest &request);
+    ApiResponse handle_video_analysis(const ApiRequest &request, ChunkedResponseWriter *stream);
+
+    // 处理上传的媒体数据（图片在内存中分析，视频使用file_path或写入临时文件后分析）
+    ApiResponse handle_upload_analysis(const ApiRequest &request, std::string_view data, const std::string &file_path);
 
     // 处理查询请求
     ApiResponse handle_query_request(const ApiQueryRequest &request);
 
-    // 处理批量分析请求
-    ApiResponse handle_batch_analysis(const std::vector<ApiRequest> &requests);
+    // 处理批量分析请求，async_job为true时提交异步作业并立即返回作业ID
+    // stream不为空时每完成一个任务输出一行NDJSON，最后输出汇总行
+    ApiResponse handle_batch_analysis(const std::vector<ApiRequest> &requests, bool async_job = false, ChunkedResponseWriter *stream = nullptr);
 
     // 处理Excel文件分析请求
-    ApiResponse handle_excel_analysis(const ApiExcelRequest &request);
+    ApiResponse handle_excel_analysis(const ApiExcelRequest &request, ChunkedResponseWriter *stream = nullptr);
 
     // 处理数据库媒体分析请求
-    ApiResponse handle_db_media_analysis(const std::string &prompt, int max_tokens = 1500, int video_frames = 5, bool save_to_db = true, const std::string &model_name = "", int batch_size = 10);
+    ApiResponse handle_db_media_analysis(const std::string &prompt, int max_tokens = 1500, int video_frames = 5, bool save_to_db = true, const std::string &model_name = "", int batch_size = 10, bool async_job = false, ChunkedResponseWriter *stream = nullptr);
+
+    // 批量分析中单个任务结果的JSON表示
+    nlohmann::json batch_result_to_json(const TaskResult &result);
+
+    // Excel/数据库媒体分析中单个任务结果的JSON表示（含file_id、media_url）
+    nlohmann::json media_result_to_json(const TaskResult &result);
+
+    // 流式输出汇总行并记录到响应中
+    void finish_stream(ChunkedResponseWriter *stream, const ApiResponse &response);
+
+    // 根据单个分析请求创建TaskManager任务
+    AnalysisTask create_analysis_task(const ApiRequest &request, const std::string &task_id);
+
+    // 提交异步作业并构建包含作业ID的响应
+    ApiResponse submit_job(const std::string &type, const std::vector<AnalysisTask> &tasks, const nlohmann::json &metadata = nlohmann::json::object());
+
+    // 处理作业查询/取消请求（/api/jobs、/api/jobs/{id}、/api/jobs/{id}/cancel）
+    ApiResponse handle_job_request(std::string_view path, std::string_view query);
 
 
 
@@ -130,9 +313,16 @@ public:
     // 停止服务器
     void stop();
 
+    // 以多进程模式的worker身份运行（需在start之前调用）
+    void set_supervisor(WorkerSupervisor *supervisor) { supervisor_ = supervisor; }
+
     // 处理API请求
     // auth_header: 来自HTTP头部的 Authorization 字段值（例如 "Bearer <token>"）
-    ApiResponse process_request(const std::string &request_json, const std::string &path = "/", const std::string &auth_header = "");
+    // query: URL中的查询字符串（不含'?'）
+    // stream: 流式响应输出（HTTP/1.1连接），请求体中 "stream": true 时批量接口通过它逐条输出结果
+    // http_request: 原始HTTP请求（上传接口需要读取Content-Type和临时文件）
+    ApiResponse process_request(std::string_view request_json, std::string_view path = "/", std::string_view auth_header = "", std::string_view query = "", ChunkedResponseWriter *stream = nullptr,
+                                const HttpRequest *http_request = nullptr);
 
     // 获取服务器状态
     nlohmann::json get_status();
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <nlohmann/json.hpp>
+
+class Gauge;
+class Histogram;
+
+// 模型后端池
+// 同一模型的多个副本（BASE_URL中逗号分隔的地址）组成一个池，按在途请求数最少选择副本：
+// 被动健康检查在连续失败（连接错误、超时、5xx）后按指数退避摘除副本，到期后自动重新加入；
+// 主动健康检查定期探测每个副本，探测失败的副本在恢复前不参与路由。
+// 所有副本都不可用时退化为在全部副本中选择，避免健康检查误判时拒绝所有请求
+class BackendPool
+{
+public:
+    // 池中的一个副本（由池持有，地址不变）
+    struct Endpoint
+    {
+        std::string url;
+        std::string health_url;
+
+        int in_flight = 0;
+        int consecutive_failures = 0;
+        int ejections = 0; // 连续被摘除的次数，用于计算退避时长
+        std::chrono::steady_clock::time_point ejected_until;
+        bool probe_ok = true; // 最近一次主动探测是否成功
+        bool probing = false;
+
+        size_t requests = 0;
+        size_t failures = 0;
+        double latency_ewma = 0.0; // 成功请求的延迟（指数滑动平均，秒）
+
+        Histogram *latency_seconds = nullptr;
+        Gauge *healthy_gauge = nullptr;
+    };
+
+    // 按配置的BASE_URL取得后端池（同一配置的所有分析器共用一个，实例不析构）
+    static BackendPool &for_url(const std::string &base_url);
+
+    // 所有后端池的统计信息
+    static nlohmann::json get_all_stats();
+
+    // 拆分逗号分隔的地址列表
+    static std::vector<std::string> split_urls(const std::string &base_url);
+
+    // 地址的scheme://host:port部分
+    static std::string origin_of(const std::string &url);
+
+    BackendPool(const BackendPool &) = delete;
+    BackendPool &operator=(const BackendPool &) = delete;
+
+    // 选择在途请求最少的可用副本（在途数加一）
+    // 指定exclude时（如对冲请求）只在其他可用副本中选择，没有则返回nullptr
+    Endpoint *acquire(const Endpoint *exclude = nullptr);
+
+    // 请求结束：ok为false时计入连续失败，达到阈值后摘除副本
+    void release(Endpoint *endpoint, double latency_seconds, bool ok);
+
+    // 请求没有得到结果（未发出或被取消），只归还在途数
+    void cancel(Endpoint *endpoint);
+
+    // 并行预热到各副本的连接（DNS解析、TCP和TLS握手、HTTP/2协商），不等待结果，重复调用只预热一次
+    void warm_up();
+
+    size_t size() const { return endpoints_.size(); }
+    const std::string &first_url() const { return endpoints_.front()->url; }
+
+    nlohmann::json get_stats() const;
+
+private:
+    explicit BackendPool(const std::string &base_url);
+
+    // 调用方需持有mutex_
+    bool available(const Endpoint &endpoint, std::chrono::steady_clock::time_point now) const;
+    void eject(Endpoint &endpoint, std::chrono::steady_clock::time_point now);
+    void update_gauge(Endpoint &endpoint, std::chrono::steady_clock::time_point now);
+
+    // 主动健康检查（在HTTP客户端的事件线程中执行）
+    void check_health();
+    void on_probe_result(Endpoint *endpoint, bool ok, const std::string &error);
+
+    std::string base_url_;
+    std::vector<std::unique_ptr<Endpoint>> endpoints_;
+
+    mutable std::mutex mutex_;
+    size_t next_;  // 在途数相同时轮流选择的起始位置
+    size_t panic_; // 没有可用副本而在全部副本中选择的次数
+    bool warmed_up_;
+};
+
+// 后端租约（RAII）：构造时从池中选择副本，析构时归还并反馈结果；
+// 没有调用succeeded()或cancelled()就析构视为失败
+class BackendLease
+{
+public:
+    // 指定other时选择与其不同的可用副本，没有可选副本时acquired()为false
+    explicit BackendLease(BackendPool &pool, const BackendLease *other = nullptr);
+    ~BackendLease();
+
+    BackendLease(const BackendLease &) = delete;
+    BackendLease &operator=(const BackendLease &) = delete;
+
+    bool acquired() const { return endpoint_ != nullptr; }
+
+    // 选中副本的请求地址
+    const std::string &url() const { return endpoint_->url; }
+
+    // 标记请求成功（后端有响应且不是5xx），latency_seconds为上游请求耗时（不含本地排队）
+    void succeeded(double latency_seconds)
+    {
+        succeeded_ = true;
+        latency_seconds_ = latency_seconds;
+    }
+
+    // 标记请求没有得到结果（如本地排队超时未发出），归还时不计入成功或失败
+    void cancelled() { cancelled_ = true; }
+
+private:
+    BackendPool &pool_;
+    BackendPool::Endpoint *endpoint_;
+    bool succeeded_;
+    bool cancelled_;
+    double latency_seconds_;
+};
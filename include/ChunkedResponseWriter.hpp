@@ -0,0 +1,68 @@
+#pragma once
+
+#include <string>
+#include <functional>
+#include <memory>
+#include <nlohmann/json.hpp>
+#include "OutputBuffer.hpp"
+#include "ResponseCompressor.hpp"
+
+// 流式HTTP响应（Transfer-Encoding: chunked）
+// 在工作线程中使用：每次写入都编码成一个chunk交给sink，由sink投递到连接所属的I/O循环发送，
+// 适合逐条输出批量任务结果（NDJSON，每行一个JSON对象），服务器无需缓存完整结果。
+// 发送前经过flow_control：客户端读取慢、连接上积压的数据超过上限时写入方等待，连接关闭后停止输出
+class ChunkedResponseWriter
+{
+public:
+    // data: 已编码的HTTP数据；finished: 是否为该响应的最后一段
+    using Sink = std::function<void(OutputBuffer data, bool finished)>;
+
+    // bytes: 即将交给sink的字节数；wait为false时只登记不等待。返回false表示连接已关闭或长时间不可写，应停止输出
+    using FlowControl = std::function<bool(size_t bytes, bool wait)>;
+
+    // encoding不为Identity时对chunk内容做流式压缩（每次写入都会flush）
+    ChunkedResponseWriter(Sink sink, bool keep_alive, ContentEncoding encoding = ContentEncoding::Identity,
+                          FlowControl flow_control = nullptr);
+
+    // 禁用拷贝构造和赋值
+    ChunkedResponseWriter(const ChunkedResponseWriter &) = delete;
+    ChunkedResponseWriter &operator=(const ChunkedResponseWriter &) = delete;
+
+    // 发送响应头（只发送一次，write/write_line会自动调用）
+    void begin(const std::string &content_type = "application/x-ndjson");
+
+    // 发送一个chunk（数据作为独立片段发送，不与chunk头拼接）
+    // wait为false时不等待背压，用于不能阻塞的线程（例如HTTP客户端的事件线程），写入量需由调用方限定
+    void write(std::string data, bool wait = true);
+
+    // 发送一行NDJSON
+    void write_line(const nlohmann::json &line, bool wait = true);
+
+    // 发送结束chunk，之后不能再写入
+    void finish();
+
+    // 是否已发送响应头
+    bool started() const { return started_; }
+
+    // 是否已结束
+    bool finished() const { return finished_; }
+
+    // 连接已关闭或客户端长时间不读取，后续写入都被丢弃，调用方应停止产生结果
+    bool aborted() const { return aborted_; }
+
+private:
+    // 把已编码的数据作为一个chunk发送
+    void send_chunk(std::string data, bool wait);
+
+    // 经过背压检查后交给sink
+    void emit(OutputBuffer data, bool finished, bool wait);
+
+    Sink sink_;
+    FlowControl flow_control_;
+    bool keep_alive_;
+    bool started_;
+    bool finished_;
+    bool aborted_;
+    ContentEncoding encoding_;
+    std::unique_ptr<ResponseCompressor> compressor_;
+};
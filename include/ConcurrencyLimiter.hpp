@@ -0,0 +1,119 @@
+#pragma once
+
+#include <string>
+#include <mutex>
+#include <deque>
+#include <functional>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+class Gauge;
+class Counter;
+class Histogram;
+
+// 上游（模型后端）自适应并发限制
+// 按梯度算法（参考Netflix concurrency-limits的Gradient2）从观测到的延迟推算后端可持续的并发数：
+// 短期延迟接近长期基线时逐步提高上限，延迟明显升高时按比例降低，超时/连接失败时乘性减小。
+// 超过上限的请求在本地排队，而不是全部压到后端上等待超时；排队不占用调用线程，名额空出时回调发起请求
+class ConcurrencyLimiter
+{
+public:
+    // 排队结果回调：acquired为true时已获得名额（用ConcurrencyPermit接管），false表示排队已满或等待超时
+    using Waiter = std::function<void(bool acquired)>;
+
+    // 按后端地址取得限流器（同一后端的所有分析器共用一个，实例不析构）
+    static ConcurrencyLimiter &for_backend(const std::string &backend);
+
+    // 所有后端的统计信息
+    static nlohmann::json get_all_stats();
+
+    ConcurrencyLimiter(const ConcurrencyLimiter &) = delete;
+    ConcurrencyLimiter &operator=(const ConcurrencyLimiter &) = delete;
+
+    // 获取一个名额，不阻塞调用线程：有空闲名额或排队已满时立即在当前线程回调并返回0；
+    // 否则加入队列并返回排队编号，名额空出时在归还名额的线程中回调（调用方负责按超时调用cancel_wait）
+    uint64_t acquire_async(Waiter waiter);
+
+    // 放弃排队（等待超时），仍在队列中时回调false；已获得名额或编号为0时无操作
+    void cancel_wait(uint64_t ticket);
+
+    // 不排队获取名额（用于对冲等可选请求），已满时直接返回false，不计入拒绝数
+    bool try_acquire();
+
+    // 归还名额并反馈本次请求：rtt_seconds为请求耗时，dropped表示超时、连接失败等过载信号
+    void release(double rtt_seconds, bool dropped);
+
+    int get_limit() const;
+    nlohmann::json get_stats() const;
+
+private:
+    explicit ConcurrencyLimiter(const std::string &backend);
+
+    struct Waiting
+    {
+        uint64_t ticket;
+        std::chrono::steady_clock::time_point start;
+        Waiter waiter;
+    };
+
+    // 调用方需持有mutex_
+    void update_gauges();
+
+    // 把空出的名额分给排队的请求，返回需要在释放mutex_后回调的waiter（调用方需持有mutex_）
+    std::vector<Waiter> grant_waiting();
+
+    std::string backend_;
+
+    mutable std::mutex mutex_;
+    std::deque<Waiting> waiting_; // 等待名额的请求（先到先得）
+    uint64_t next_ticket_;
+
+    double limit_;     // 当前并发上限（取整后使用）
+    double long_rtt_;  // 长期延迟基线（指数滑动平均，秒）
+    double short_rtt_; // 短期延迟（指数滑动平均，秒）
+    std::chrono::steady_clock::time_point last_update_; // 上次记录延迟样本的时间
+    std::chrono::steady_clock::time_point last_adjust_; // 上次调整上限的时间
+    int in_flight_;
+    size_t rejected_;
+    size_t dropped_;
+
+    Gauge *limit_gauge_;
+    Gauge *in_flight_gauge_;
+    Gauge *queued_gauge_;
+    Counter *rejected_counter_;
+    Histogram *queue_wait_seconds_;
+};
+
+// 限流名额（RAII）：析构时归还并反馈耗时；
+// 没有调用succeeded()就析构视为失败（超时、连接错误等）
+class ConcurrencyPermit
+{
+public:
+    // 不排队获取名额（见ConcurrencyLimiter::try_acquire）
+    explicit ConcurrencyPermit(ConcurrencyLimiter &limiter);
+
+    // 接管acquire_async已获得的名额
+    ConcurrencyPermit(ConcurrencyLimiter &limiter, std::adopt_lock_t);
+    ~ConcurrencyPermit();
+
+    ConcurrencyPermit(const ConcurrencyPermit &) = delete;
+    ConcurrencyPermit &operator=(const ConcurrencyPermit &) = delete;
+
+    // 是否获取到名额
+    bool acquired() const { return acquired_; }
+
+    // 标记请求成功（耗时计入延迟基线）
+    void succeeded() { succeeded_ = true; }
+
+    // 标记请求被主动取消（如对冲请求中落后的一方），归还名额但不计入延迟或丢弃
+    void cancelled() { cancelled_ = true; }
+
+private:
+    ConcurrencyLimiter &limiter_;
+    bool acquired_;
+    bool succeeded_;
+    bool cancelled_;
+    std::chrono::steady_clock::time_point start_;
+};
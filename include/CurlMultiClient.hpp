@@ -0,0 +1,127 @@
+#pragma once
+
+#include <curl/curl.h>
+#include <string>
+#include <vector>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <unordered_map>
+#include <nlohmann/json.hpp>
+#include "EventLoop.hpp"
+
+// 发往上游的HTTP请求
+struct UpstreamRequest
+{
+    std::string url;
+    std::string method = "POST";
+    std::shared_ptr<const std::string> body; // 请求体只读共享：对冲请求与原请求引用同一份数据（为空表示无请求体）
+    std::vector<std::string> headers;
+    int timeout = 60;         // 整个请求的超时（秒）
+    bool enable_http2 = true; // HTTPS后端通过ALPN协商HTTP/2，同一后端的请求复用一个连接上的多个流
+
+    // 流式响应：设置后收到的数据在事件线程中逐段交给on_data（不再累积到响应的body中）
+    std::function<void(const char *data, size_t size)> on_data;
+};
+
+// 上游HTTP响应
+struct UpstreamResponse
+{
+    CURLcode code = CURLE_OK; // CURL结果，非CURLE_OK时error为错误描述
+    long status = 0;          // HTTP状态码
+    std::string body;
+    std::string error;
+
+    // 各阶段从请求开始的累计耗时（秒）
+    double namelookup_time = 0.0;
+    double connect_time = 0.0;
+    double appconnect_time = 0.0;
+    double pretransfer_time = 0.0;
+    double starttransfer_time = 0.0;
+    double total_time = 0.0;
+};
+
+// 基于curl_multi的异步HTTP客户端
+// 一个事件线程通过socket回调（CURLMOPT_SOCKETFUNCTION/TIMERFUNCTION + epoll）驱动所有传输，
+// 等待模型响应的请求不再各自占用一个线程；同一后端的HTTP/2请求复用连接上的多个流
+class CurlMultiClient
+{
+public:
+    using Callback = std::function<void(UpstreamResponse &&)>;
+
+    // 单例模式（首次使用时启动事件线程）
+    static CurlMultiClient &getInstance();
+
+    CurlMultiClient(const CurlMultiClient &) = delete;
+    CurlMultiClient &operator=(const CurlMultiClient &) = delete;
+
+    // 提交请求，完成后在事件线程中调用callback（callback应尽快返回，耗时的处理交给其他线程），返回传输ID
+    uint64_t submit(UpstreamRequest request, Callback callback);
+
+    // 取消进行中的传输：callback仍会被调用，code为CURLE_ABORTED_BY_CALLBACK；已完成的传输忽略
+    void cancel(uint64_t transfer_id);
+
+    // 提交请求，返回响应的future
+    std::future<UpstreamResponse> submit(UpstreamRequest request);
+
+    // 在事件线程中定期执行task（如后端健康检查），task应尽快返回
+    void run_every(int interval_ms, std::function<void()> task);
+
+    // 在事件线程中延迟执行一次task（如请求对冲），task应尽快返回
+    void run_after(int delay_ms, std::function<void()> task);
+
+    // 登记新的目标主机（如后端池中的各副本），连接缓存按主机数扩大，空闲连接不会因缓存过小被关闭
+    void add_target_hosts(size_t count);
+
+    // 获取统计信息
+    nlohmann::json get_stats() const;
+
+private:
+    // 一次传输的状态（事件线程之外只在提交前访问）
+    struct Transfer
+    {
+        UpstreamRequest request;
+        UpstreamResponse response;
+        Callback callback;
+        uint64_t id = 0;
+        CURL *easy = nullptr;
+        curl_slist *headers = nullptr;
+    };
+
+    CurlMultiClient();
+
+    // 以下函数只在事件线程中执行
+    void start_transfer(Transfer *transfer);
+    void finish_transfers();
+    void abort_transfer(uint64_t transfer_id);
+    void on_socket_event(curl_socket_t socket, uint32_t events);
+    void on_timer();
+    CURL *acquire_easy();
+    void recycle_easy(CURL *easy);
+
+    static int socket_callback(CURL *easy, curl_socket_t socket, int what, void *userp, void *socketp);
+    static int timer_callback(CURLM *multi, long timeout_ms, void *userp);
+    static size_t write_callback(void *contents, size_t size, size_t nmemb, void *userp);
+
+    CURLM *multi_;
+    EventLoop loop_;
+    std::thread thread_;
+    int timer_fd_;
+
+    // 空闲的easy句柄（事件线程中访问），连接由multi句柄的连接缓存持有，句柄可以直接复用
+    std::vector<CURL *> idle_easy_;
+
+    // 进行中的传输（事件线程中访问），用于按ID取消
+    std::unordered_map<uint64_t, Transfer *> transfers_;
+
+    std::atomic<size_t> in_flight_;
+    std::atomic<size_t> submitted_;
+    std::atomic<size_t> failed_;
+    std::atomic<size_t> cancelled_;
+    std::atomic<size_t> timers_; // run_every/run_after注册的定时器数（统计socket数时排除）
+    std::atomic<uint64_t> next_id_;
+    size_t target_hosts_; // 登记的目标主机数（事件线程中访问）
+};
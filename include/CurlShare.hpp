@@ -0,0 +1,35 @@
+#pragma once
+
+#include <curl/curl.h>
+#include <string>
+#include <mutex>
+#include <nlohmann/json.hpp>
+
+// 按目标主机共享的CURL缓存（CURLSH）
+// 工作线程中的阻塞下载（utils::download_file）同一主机共用一个share句柄，只共享DNS缓存和TLS会话：同一CDN的后续下载
+// 不再重新解析DNS，新连接可以恢复TLS会话；不同主机使用各自的share句柄，互不争用锁。
+// libcurl不支持在同时使用的多个线程间共享连接缓存（CURL_LOCK_DATA_CONNECT），keep-alive连接由各工作线程复用的easy句柄各自保留。
+// 发往模型后端的请求由CurlMultiClient的multi句柄统一收发，multi句柄本身已共享这些缓存，不使用share句柄
+class CurlShare
+{
+public:
+    // 取得url所在主机（scheme://host:port）的share句柄（首次使用时创建，实例不析构）
+    static CURLSH *for_url(const std::string &url);
+
+    // 各主机share句柄的使用统计
+    static nlohmann::json get_stats();
+
+    CurlShare(const CurlShare &) = delete;
+    CurlShare &operator=(const CurlShare &) = delete;
+
+private:
+    explicit CurlShare(const std::string &origin);
+
+    static void lock_callback(CURL *handle, curl_lock_data data, curl_lock_access access, void *userptr);
+    static void unlock_callback(CURL *handle, curl_lock_data data, void *userptr);
+
+    std::string origin_;
+    CURLSH *share_;
+    std::mutex locks_[CURL_LOCK_DATA_LAST]; // 每类共享数据一把锁
+    size_t uses_;                           // 取得句柄的次数（持有registry锁时修改）
+};
@@ -102,8 +102,8 @@ public:
     // 创建 refresh token 记录（token_hash 为 SHA256 hex）
     bool create_refresh_token_record(const std::string &token_hash, const std::string &user_id, long created_at, long expires_at);
 
-    // 验证 refresh token，返回 true 并填充 out_user_id
-    bool verify_refresh_token_record(const std::string &token_hash, std::string &out_user_id);
+    // 验证 refresh token，返回 true 并填充 out_user_id（out_expires_at不为空时同时返回过期时间）
+    bool verify_refresh_token_record(const std::string &token_hash, std::string &out_user_id, long *out_expires_at = nullptr);
 
     // 撤销 refresh token（删除记录）
     bool revoke_refresh_token_record(const std::string &token_hash);
@@ -1,14 +1,17 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <memory>
+#include <functional>
 #include <nlohmann/json.hpp>
 #include "DatabaseManager.hpp"
 #include "ConfigManager.hpp"
 #include "VideoKeyframeAnalyzer.hpp"
 #include "utils.hpp"
 #include "config.hpp"
+#include "PayloadWriter.hpp"
 
 struct AnalysisResult
 {
@@ -18,10 +21,17 @@ struct AnalysisResult
     nlohmann::json usage;
     nlohmann::json raw_response;
     std::string error;
+    bool cached; // 结果来自结果缓存（没有调用模型）
 
-    AnalysisResult() : success(false), response_time(0.0) {}
+    AnalysisResult() : success(false), response_time(0.0), cached(false) {}
 };
 
+struct UpstreamRequest;
+struct UpstreamResponse;
+class StreamingResponseParser;
+class BackendLease;
+class ConcurrencyPermit;
+
 class DoubaoMediaAnalyzer
 {
 private:
@@ -40,6 +50,13 @@ private:
     bool is_vllm_api(const std::string &url) const;
 
 public:
+    // 异步分析的完成回调（在HTTP客户端的事件线程中调用，应尽快返回）
+    using AnalysisCallback = std::function<void(AnalysisResult &&)>;
+
+    // 流式输出的内容片段回调（在HTTP客户端的事件线程中调用，应尽快返回）
+    // 传入时以流式方式请求模型，返回的AnalysisResult仍包含完整内容
+    using TokenCallback = std::function<void(const std::string &delta)>;
+
     // 使用默认配置构造函数
     explicit DoubaoMediaAnalyzer(const std::string &api_key);
 
@@ -52,11 +69,29 @@ public:
     // 连接测试
     bool test_connection();
 
+    // 预热到模型后端各副本的连接（非阻塞，多个分析器实例共用同一后端池时只预热一次）
+    void warm_up_backends();
+
     // 单张图片分析
     AnalysisResult analyze_single_image(const std::string &image_path,
                                         const std::string &prompt,
                                         int max_tokens = 1500,
-                                        const std::string &model_name = "");
+                                        const std::string &model_name = "",
+                                        TokenCallback on_token = nullptr);
+
+    // 单张图片分析（异步）：编码在当前线程完成，等待模型响应不占用线程
+    void analyze_single_image_async(const std::string &image_path,
+                                    const std::string &prompt,
+                                    int max_tokens,
+                                    const std::string &model_name,
+                                    AnalysisCallback callback,
+                                    TokenCallback on_token = nullptr);
+
+    // 单张图片分析（内存中的图片数据，如上传的请求体）
+    AnalysisResult analyze_image_data(std::string_view image_data,
+                                      const std::string &prompt,
+                                      int max_tokens = 1500,
+                                      const std::string &model_name = "");
 
     // 单个视频分析
     AnalysisResult analyze_single_video(const std::string &video_path,
@@ -71,7 +106,8 @@ public:
                                              int max_tokens = 2000,
                                              const std::string &method = "keyframes",
                                              int num_frames = 5,
-                                             const std::string &model_name = "");
+                                             const std::string &model_name = "",
+                                             TokenCallback on_token = nullptr);
 
     // 批量分析
     std::vector<AnalysisResult> batch_analyze(const std::string &media_folder,
@@ -86,7 +122,8 @@ public:
     AnalysisResult analyze_text(const std::string &text,
                                 const std::string &prompt,
                                 int max_tokens = 1500,
-                                const std::string &model_name = "");
+                                const std::string &model_name = "",
+                                TokenCallback on_token = nullptr);
 
     // 文件分析
     AnalysisResult analyze_file(const std::string &file_path,
@@ -106,13 +143,42 @@ public:
     std::vector<MediaAnalysisRecord> get_recent_results(int limit = 10);
     nlohmann::json get_database_statistics();
 
+    // 数据库管理器（供其他模块共用同一个连接池）
+    DatabaseManager *get_database_manager() { return db_manager_.get(); }
+
     virtual ~DoubaoMediaAnalyzer(); // 添加这行
 
 private:
     // 内部方法
-    std::vector<std::string> extract_video_frames(const std::string &video_path, int num_frames);
-    AnalysisResult send_analysis_request(const nlohmann::json &payload, int timeout);
+    std::vector<std::vector<unsigned char>> extract_video_frames(const std::string &video_path, int num_frames);
+    void analyze_image_bytes_async(std::vector<unsigned char> image_data, const std::string &prompt, int max_tokens, const std::string &model_name, AnalysisCallback callback, TokenCallback on_token = nullptr);
+    UpstreamRequest build_video_request(std::vector<std::vector<unsigned char>> &frames, const std::string &prompt, int max_tokens, const std::string &model_name, bool stream = false);
+    AnalysisResult send_analysis_request(const nlohmann::json &payload, int timeout, TokenCallback on_token = nullptr);
+    AnalysisResult send_upstream_request(UpstreamRequest request, int timeout, TokenCallback on_token = nullptr);
+    void send_upstream_request_async(UpstreamRequest request, int timeout, AnalysisCallback callback, TokenCallback on_token = nullptr);
+    void start_upstream_request(UpstreamRequest request, int timeout, AnalysisCallback callback, TokenCallback on_token,
+                                std::shared_ptr<BackendLease> lease, std::shared_ptr<ConcurrencyPermit> permit);
+
+    // 一次上游调用（可能包含一个对冲请求）的共享状态，只在HTTP客户端的事件线程中访问
+    struct UpstreamCall;
+    void on_upstream_attempt_done(const std::shared_ptr<UpstreamCall> &call, int attempt,
+                                  std::shared_ptr<BackendLease> &lease, std::shared_ptr<ConcurrencyPermit> &permit,
+                                  UpstreamResponse &response);
+    AnalysisResult complete_upstream_request(UpstreamResponse &response, std::shared_ptr<BackendLease> &lease,
+                                             std::shared_ptr<ConcurrencyPermit> &permit,
+                                             StreamingResponseParser *stream_parser, int timeout);
+
+    // 请求构建：JSON载荷（文本/文件分析）或一次写出的载荷（图片/视频分析）
+    UpstreamRequest make_upstream_request(int timeout) const;
+    UpstreamRequest build_analysis_request(const nlohmann::json &payload, int timeout, bool stream = false);
+    UpstreamRequest build_analysis_request(const PayloadWriter &writer, int timeout);
+    PayloadWriter make_payload_writer(const std::string &model_name, int max_tokens) const;
+    void prepare_image_for_backend(std::vector<unsigned char> &image_data) const;
+    std::string api_type_name() const;
+    std::string describe_request_failure(const std::string &reason, int timeout) const;
+    AnalysisResult request_error_result(const std::string &error) const;
     AnalysisResult process_response(const std::string &response_text, double response_time);
+    AnalysisResult process_stream_response(const StreamingResponseParser &parser);
 
     // HTTP请求
     std::string make_http_request(const std::string &url,
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// 基于epoll的事件循环（Reactor）
+// 每个EventLoop由一个I/O线程驱动，负责监听的fd的读写事件；
+// 其他线程通过post()把任务投递到循环线程中执行（使用eventfd唤醒）
+class EventLoop
+{
+public:
+    using EventCallback = std::function<void(uint32_t events)>;
+    using Task = std::function<void()>;
+
+    EventLoop();
+    ~EventLoop();
+
+    // 禁用拷贝构造和赋值
+    EventLoop(const EventLoop &) = delete;
+    EventLoop &operator=(const EventLoop &) = delete;
+
+    // 检查epoll/eventfd是否创建成功
+    bool is_valid() const { return epoll_fd_ >= 0 && wakeup_fd_ >= 0; }
+
+    // 注册fd及其事件回调（只能在循环线程中调用，其他线程请通过post()）
+    bool add(int fd, uint32_t events, EventCallback callback);
+
+    // 修改fd关注的事件
+    bool modify(int fd, uint32_t events);
+
+    // 移除fd（不负责close）
+    void remove(int fd);
+
+    // 线程安全：投递任务到循环线程执行
+    void post(Task task);
+
+    // 注册周期性定时任务（基于timerfd，在循环线程中执行），成功返回true
+    bool run_every(int interval_ms, Task task);
+
+    // 注册一次性定时任务（只能在循环线程中调用），执行后自动注销，成功返回true
+    bool run_after(int delay_ms, Task task);
+
+    // 运行事件循环，阻塞直到stop()
+    void run();
+
+    // 停止事件循环（可在任意线程调用）
+    void stop();
+
+    // 事件循环是否正在运行
+    bool is_running() const { return running_; }
+
+    // 当前线程是否为循环线程
+    bool is_in_loop_thread() const { return loop_thread_id_ == std::this_thread::get_id(); }
+
+    // 当前已注册的fd数量
+    size_t get_handler_count() const { return handler_count_; }
+
+private:
+    // 唤醒epoll_wait
+    void wakeup();
+
+    // 执行投递过来的任务
+    void run_pending_tasks();
+
+    int epoll_fd_;
+    int wakeup_fd_;
+    std::atomic<bool> running_;
+    std::atomic<bool> quit_;
+    std::thread::id loop_thread_id_;
+
+    // fd -> 回调，仅在循环线程中访问
+    std::unordered_map<int, EventCallback> handlers_;
+    std::atomic<size_t> handler_count_;
+
+    // 定时器fd，析构时关闭
+    std::vector<int> timer_fds_;
+
+    // 跨线程投递的任务队列
+    std::mutex pending_mutex_;
+    std::vector<Task> pending_tasks_;
+};
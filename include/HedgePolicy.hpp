@@ -0,0 +1,60 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <nlohmann/json.hpp>
+
+class Counter;
+
+// 请求对冲策略
+// 模型延迟有长尾（如某个副本卡在长prefill上）：请求超过近期延迟的分位数（默认p95）仍未返回时，
+// 把同一请求发往另一个副本，先返回的结果生效，另一个请求被取消。
+// 对冲请求受预算限制：每个请求存入UPSTREAM_HEDGE_BUDGET个令牌，每次对冲消耗一个，
+// 对冲请求数不会超过总请求数的该比例，后端整体变慢时不会因对冲而成倍放大负载
+class HedgePolicy
+{
+public:
+    // 按后端池和请求超时取得策略（图片、视频等不同类型请求的延迟分布不同，分开统计；实例不析构）
+    static HedgePolicy &for_requests(const std::string &base_url, int timeout);
+
+    // 所有策略的统计信息
+    static nlohmann::json get_all_stats();
+
+    HedgePolicy(const HedgePolicy &) = delete;
+    HedgePolicy &operator=(const HedgePolicy &) = delete;
+
+    // 新请求：存入对冲预算，返回发出对冲请求前等待的毫秒数（关闭或延迟样本不足时返回0，表示不对冲）
+    int on_request();
+
+    // 到达对冲时间仍未返回：预算足够时扣除一次并返回true
+    bool try_hedge();
+
+    // 记录一次成功请求从发出到得到结果的耗时（秒）
+    void record(double latency_seconds);
+
+    // 对冲请求先于原请求返回
+    void hedge_won();
+
+    nlohmann::json get_stats() const;
+
+private:
+    explicit HedgePolicy(const std::string &name);
+
+    std::string name_;
+
+    mutable std::mutex mutex_;
+    std::vector<double> samples_; // 最近的延迟样本（环形缓冲）
+    size_t next_sample_;
+    size_t new_samples_; // 上次计算分位数以来的样本数
+    int delay_ms_;       // 当前的对冲等待时间，0表示样本不足
+    double tokens_;
+
+    size_t requests_;
+    size_t hedges_;
+    size_t wins_;
+    size_t over_budget_; // 到达对冲时间但预算不足的次数
+
+    Counter *sent_counter_;
+    Counter *won_counter_;
+};
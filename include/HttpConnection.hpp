@@ -0,0 +1,60 @@
+#pragma once
+
+#include <string>
+#include <memory>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include "HttpRequestParser.hpp"
+#include "OutputBuffer.hpp"
+
+class EventLoop;
+
+// 流水线中一个请求对应的响应槽位，响应必须按请求到达的顺序发送
+struct PendingResponse
+{
+    bool ready = false;  // 工作线程是否已生成响应
+    bool close = false;  // 发送该响应后关闭连接
+    OutputBuffer data;   // 已生成、尚未移入发送缓冲区的响应数据
+};
+
+// 流式响应的背压状态：工作线程写入chunk前等待积压降到上限以下，I/O线程发送数据后更新（字段受mutex保护）
+struct StreamBackpressure
+{
+    std::mutex mutex;
+    std::condition_variable writable;
+    size_t posted = 0;   // 已投递给I/O循环、尚未放入连接缓冲区的字节数
+    size_t buffered = 0; // 连接上等待发送的字节数（发送缓冲区和流水线槽位，由I/O线程更新）
+    bool closed = false; // 连接已关闭，写入方应停止输出
+};
+
+// 单个客户端连接的状态（除backpressure外由所属EventLoop线程独占访问）
+struct HttpConnection
+{
+    int fd = -1;                     // 客户端socket
+    EventLoop *loop = nullptr;       // 所属的I/O事件循环
+    size_t loop_index = 0;           // 所属I/O事件循环的下标
+    std::string peer;                // 客户端地址（ip:port）
+
+    std::string read_buffer;         // 已读取但尚未处理的数据
+    HttpRequestParser parser;        // 增量式请求解析器
+    OutputBuffer write_buffer;       // 待发送的响应数据（按片段scatter-gather发送）
+
+    std::deque<PendingResponse> pending; // 已派发、响应尚未发送的请求（按到达顺序）
+    uint64_t pending_base = 0;       // pending.front()对应的请求序号
+    size_t requests_received = 0;    // 该连接上已接收的完整请求数
+
+    bool draining = false;           // 不再接收新请求，已派发的请求响应完后关闭
+    bool close_after_write = false;  // 响应发送完毕后关闭连接
+    bool read_shutdown = false;      // 对端已关闭写方向（收到FIN）
+    bool closed = false;             // 连接是否已关闭
+
+    StreamBackpressure backpressure; // 流式响应的背压（工作线程与I/O线程共享）
+
+    std::chrono::steady_clock::time_point last_active = std::chrono::steady_clock::now();   // 最近一次读写时间（空闲超时）
+    std::chrono::steady_clock::time_point request_start = std::chrono::steady_clock::now(); // 当前请求开始接收的时间（慢请求超时）
+};
+
+using HttpConnectionPtr = std::shared_ptr<HttpConnection>;
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <utility>
+#include <memory>
+#include <functional>
+#include "UploadSpooler.hpp"
+
+// 已解析的HTTP请求
+// 所有string_view都指向本对象内部的raw/decoded_body，请求对象创建后不可移动，统一通过shared_ptr传递
+struct HttpRequest
+{
+    std::string raw;          // 请求原始字节（请求行 + 头部 + 请求体）
+    std::string decoded_body; // chunked编码时解码后的请求体
+
+    std::string_view method;  // GET / POST ...
+    std::string_view target;  // 原始请求目标（含查询字符串）
+    std::string_view path;    // 路径部分（不含查询字符串）
+    std::string_view query;   // 查询字符串（不含'?'）
+    std::string_view version; // HTTP/1.1
+    std::vector<std::pair<std::string_view, std::string_view>> headers;
+    std::string_view body;
+    std::string body_file; // 上传的请求体较大时写入的临时文件（此时body为空），请求对象析构时删除
+
+    bool keep_alive = false; // 根据协议版本和Connection头计算
+
+    HttpRequest() = default;
+    ~HttpRequest();
+    HttpRequest(const HttpRequest &) = delete;
+    HttpRequest &operator=(const HttpRequest &) = delete;
+
+    // 按名称查找请求头（不区分大小写），不存在时返回空
+    std::string_view header(std::string_view name) const;
+};
+
+using HttpRequestPtr = std::shared_ptr<HttpRequest>;
+
+// 上传接口的请求体策略：允许更大的请求体，超过spool_threshold的请求体边接收边由后台线程写入临时文件
+struct UploadPolicy
+{
+    std::string path;       // 上传接口路径
+    size_t max_body_size;   // 上传请求体大小上限
+    size_t spool_threshold; // 超过该大小（按Content-Length）的请求体写入临时文件
+    std::string spool_dir;  // 临时文件目录
+    size_t spool_window;    // 每个上传尚未写入文件的数据上限，超过时暂停读取
+};
+
+// 增量式HTTP/1.1请求解析器
+// 每次收到数据后对连接的读缓冲区调用parse()，已扫描过的字节不会被重复扫描；
+// 请求完整时将其字节从缓冲区中取出（整段缓冲区恰好是一个请求时直接move，无拷贝）
+class HttpRequestParser
+{
+public:
+    enum class Status
+    {
+        Incomplete, // 需要更多数据
+        Complete,   // 已解析出一个完整请求
+        Error       // 请求格式错误或超出限制，见error_status()
+    };
+
+    explicit HttpRequestParser(size_t max_header_size = 64 * 1024,
+                               size_t max_body_size = 16 * 1024 * 1024);
+    ~HttpRequestParser();
+
+    HttpRequestParser(const HttpRequestParser &) = delete;
+    HttpRequestParser &operator=(const HttpRequestParser &) = delete;
+
+    // 解析缓冲区，Complete时out为解析出的请求，剩余字节（流水线请求）保留在buffer中
+    Status parse(std::string &buffer, HttpRequestPtr &out);
+
+    // 重置解析状态，准备解析下一个请求
+    void reset();
+
+    // 设置请求体大小上限
+    void set_max_body_size(size_t max_body_size) { max_body_size_ = max_body_size; }
+
+    // 设置上传接口的请求体策略（为空时所有路径都使用max_body_size）
+    void set_upload_policy(std::shared_ptr<const UploadPolicy> policy) { upload_policy_ = std::move(policy); }
+
+    // 是否正在把请求体写入临时文件（此时已读取的请求体会及时从缓冲区中移出）
+    bool spooling() const { return state_ == State::Spool; }
+
+    // 临时文件的写入积压超过上限，连接应暂停读取，写入追上后通过spool通知恢复
+    bool spool_backlogged() const;
+
+    // 设置后台写入的通知回调（在写入线程中调用：积压回落、写入完成或失败时，需重新调用parse()）
+    void set_spool_notify(std::function<void()> notify) { spool_notify_ = std::move(notify); }
+
+    // 请求头包含 "Expect: 100-continue" 且尚未回复时返回true（只返回一次）
+    bool take_expect_continue();
+
+    // 是否已开始接收某个请求（用于区分空闲连接和慢速请求）
+    bool in_progress() const { return state_ != State::RequestLine || scan_offset_ > 0; }
+
+    // 出错时对应的HTTP状态码和错误描述
+    int error_status() const { return error_status_; }
+    const std::string &error_message() const { return error_message_; }
+
+private:
+    enum class State
+    {
+        RequestLine, // 等待完整的请求头
+        Body,        // 按Content-Length等待请求体
+        Spool,       // 按Content-Length把请求体写入临时文件
+        ChunkSize,   // chunked: 等待块大小行
+        ChunkData,   // chunked: 等待块数据
+        Trailers     // chunked: 等待尾部头
+    };
+
+    struct HeaderSpan
+    {
+        size_t name_offset;
+        size_t name_length;
+        size_t value_offset;
+        size_t value_length;
+    };
+
+    // 解析请求行和请求头（偏移量形式），成功返回true
+    bool parse_head(const std::string &buffer);
+
+    // 解析chunked请求体，返回false表示数据不足或出错（出错时设置error_status_）
+    bool parse_chunked(const std::string &buffer);
+
+    // 把缓冲区中已收到的请求体交给后台写入并移出缓冲区，返回false表示尚未全部写入或出错
+    bool spool_body(std::string &buffer);
+
+    // 放弃尚未交给请求对象的临时文件
+    void discard_spool();
+
+    // 从缓冲区中取出完整请求并构建HttpRequest
+    HttpRequestPtr take_request(std::string &buffer);
+
+    Status fail(int status, const std::string &message);
+
+    size_t max_header_size_;
+    size_t max_body_size_;
+    std::shared_ptr<const UploadPolicy> upload_policy_;
+
+    State state_;
+    size_t scan_offset_;    // 下次查找的起始位置
+    size_t headers_end_;    // 请求头结束位置（含空行）
+    size_t content_length_; // Content-Length
+    size_t request_end_;    // 完整请求的结束位置
+    size_t chunk_remaining_;
+    size_t body_limit_;    // 当前请求的请求体上限
+    UploadSpooler::FilePtr spool_file_;  // 后台写入的临时文件（Spool状态）
+    std::function<void()> spool_notify_;
+    std::string spool_path_;
+    size_t spooled_bytes_; // 已交给后台写入的字节数
+    bool upload_;          // 当前请求是否为上传接口
+    bool chunked_;
+    bool keep_alive_;
+    bool expect_continue_;
+
+    // 请求行/请求头的偏移量
+    size_t method_length_;
+    size_t target_offset_;
+    size_t target_length_;
+    size_t version_offset_;
+    size_t version_length_;
+    std::vector<HeaderSpan> header_spans_;
+    std::string decoded_body_;
+
+    int error_status_;
+    std::string error_message_;
+};
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <unordered_map>
+#include <nlohmann/json.hpp>
+#include "TaskManager.hpp"
+
+// 作业中单行（单个媒体）的处理状态
+enum class JobItemState
+{
+    Pending,   // 等待提交或在任务队列中排队
+    Running,   // 正在分析
+    Succeeded, // 分析成功
+    Failed,    // 分析失败
+    Cancelled  // 作业取消时尚未开始执行
+};
+
+// 作业整体状态
+enum class JobState
+{
+    Queued,    // 已创建，尚无任务开始执行
+    Running,   // 有任务正在执行
+    Completed, // 所有行都已处理完成
+    Cancelled  // 已取消（已开始执行的行会执行完毕）
+};
+
+// 作业中的一行
+struct JobItem
+{
+    AnalysisTask task;                        // 分析参数
+    JobItemState state = JobItemState::Pending;
+    nlohmann::json result;                    // 处理完成后的结果
+};
+
+// 异步分析作业
+struct Job
+{
+    std::string id;
+    std::string type;           // batch_analyze / excel_analyze / db_media_analyze / analyze
+    JobState state = JobState::Queued;
+    nlohmann::json metadata;    // 提交时的附加信息（如excel_path）
+    std::string created_at;     // 创建时间（格式化时间戳）
+    double submit_time = 0.0;   // 提交时间（单调时钟，秒）
+    double start_time = 0.0;    // 第一行开始执行的时间
+    double finish_time = 0.0;   // 全部完成的时间
+
+    std::vector<JobItem> items;
+    size_t next_index = 0;      // 下一个待提交到TaskManager的行
+    size_t in_flight = 0;       // 已提交但尚未完成的行数
+    size_t running = 0;
+    size_t succeeded = 0;
+    size_t failed = 0;
+    size_t cancelled = 0;
+
+    std::shared_ptr<std::atomic<bool>> cancel_flag = std::make_shared<std::atomic<bool>>(false);
+};
+
+// 异步作业管理器
+// 作业提交后立即返回作业ID，行任务按窗口分批提交给TaskManager执行，
+// 客户端通过作业ID查询进度和已完成的部分结果，处理过程不再依赖HTTP连接的生命周期
+class JobManager
+{
+public:
+    // 单例模式
+    static JobManager &getInstance();
+
+    // 提交作业，返回作业ID
+    std::string submit(const std::string &type, const std::vector<AnalysisTask> &tasks, const nlohmann::json &metadata = nlohmann::json::object());
+
+    // 查询作业状态和结果（results从offset开始，最多limit条），作业不存在时返回false
+    bool get_job(const std::string &job_id, nlohmann::json &out, size_t offset = 0, size_t limit = 100);
+
+    // 取消作业：未开始的行不再执行，正在执行的行会执行完毕，作业不存在时返回false
+    bool cancel(const std::string &job_id, nlohmann::json &out);
+
+    // 所有作业的摘要列表
+    nlohmann::json list_jobs();
+
+    // 作业统计信息
+    nlohmann::json get_stats();
+
+private:
+    JobManager();
+    ~JobManager() = default;
+
+    // 禁用拷贝构造和赋值
+    JobManager(const JobManager &) = delete;
+    JobManager &operator=(const JobManager &) = delete;
+
+    // 从作业中取出待提交的行（调用方需持有mutex_），返回需要提交给TaskManager的任务
+    std::vector<AnalysisTask> take_next_tasks(const std::shared_ptr<Job> &job);
+
+    // 行开始执行
+    void on_item_start(const std::shared_ptr<Job> &job, size_t index);
+
+    // 行执行完成
+    void on_item_complete(const std::shared_ptr<Job> &job, size_t index, const AnalysisResult &result);
+
+    // 作业摘要（调用方需持有mutex_）
+    nlohmann::json summarize(const Job &job) const;
+
+    // 清理过期的已结束作业（调用方需持有mutex_）
+    void evict_finished_jobs();
+
+    std::mutex mutex_;
+    std::unordered_map<std::string, std::shared_ptr<Job>> jobs_;
+
+    size_t max_in_flight_per_job_; // 单个作业同时提交到TaskManager的行数上限（图片任务等待模型响应时不占用工作线程）
+    size_t max_finished_jobs_;     // 最多保留的已结束作业数
+    double finished_job_ttl_;      // 已结束作业的保留时间（秒）
+
+    std::atomic<size_t> total_submitted_;
+};
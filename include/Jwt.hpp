@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <nlohmann/json.hpp>
 
 namespace jwt
@@ -9,5 +10,12 @@ namespace jwt
     std::string GenerateToken(const std::string &sub, int expiry_seconds);
 
     // 验证 token 的签名和过期时间，验证通过后将 payload 填充到 out_claims，并返回 true
+    // 验证通过的token会缓存到过期为止，再次验证时只需一次哈希查找
     bool VerifyToken(const std::string &token, nlohmann::json &out_claims);
+
+    // 只判断 token 是否有效（不拷贝payload），用于请求鉴权
+    bool IsTokenValid(std::string_view token);
+
+    // 已验证token缓存的统计信息
+    nlohmann::json GetCacheStats();
 }
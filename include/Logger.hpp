@@ -0,0 +1,188 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <initializer_list>
+#include <type_traits>
+#include <nlohmann/json.hpp>
+
+// 日志级别
+enum class LogLevel
+{
+    Trace = 0, // 载荷内容（截断后）等最详细的信息
+    Debug,     // 各阶段耗时等性能诊断信息
+    Info,      // 请求、任务的开始和完成
+    Warn,
+    Error,
+    Off
+};
+
+// 结构化字段（key=value）
+struct LogField
+{
+    const char *key;
+    std::string value;
+
+    LogField(const char *k, const std::string &v) : key(k), value(v) {}
+    LogField(const char *k, std::string &&v) : key(k), value(std::move(v)) {}
+    LogField(const char *k, std::string_view v) : key(k), value(v) {}
+    LogField(const char *k, const char *v) : key(k), value(v ? v : "") {}
+    LogField(const char *k, bool v) : key(k), value(v ? "true" : "false") {}
+
+    template <typename T, typename std::enable_if<std::is_integral<T>::value, int>::type = 0>
+    LogField(const char *k, T v) : key(k), value(std::to_string(v))
+    {
+    }
+
+    template <typename T, typename std::enable_if<std::is_floating_point<T>::value, int>::type = 0>
+    LogField(const char *k, T v) : key(k), value(format_double(static_cast<double>(v)))
+    {
+    }
+
+    static std::string format_double(double v);
+};
+
+// 异步日志
+// 业务线程只把格式化好的消息写入无锁环形缓冲区，由后台线程批量写出；
+// 缓冲区满时丢弃新日志并计数，不阻塞请求处理
+class Logger
+{
+public:
+    // 单例模式
+    static Logger &getInstance();
+
+    // 禁用拷贝构造和赋值
+    Logger(const Logger &) = delete;
+    Logger &operator=(const Logger &) = delete;
+
+    void set_level(LogLevel level) { level_.store(level, std::memory_order_relaxed); }
+    LogLevel get_level() const { return level_.load(std::memory_order_relaxed); }
+
+    bool should_log(LogLevel level) const { return level >= level_.load(std::memory_order_relaxed); }
+
+    // 解析级别名称（trace/debug/info/warn/error/off），失败时返回false
+    static bool parse_level(const std::string &name, LogLevel &level);
+    static const char *level_name(LogLevel level);
+
+    // 写入一条日志（不检查级别，调用方应先用should_log判断，通常通过LOG_*宏调用）
+    void log(LogLevel level, std::string_view message, std::initializer_list<LogField> fields = {});
+
+    // 等待缓冲区中的日志全部写出
+    void flush();
+
+    // 停止后台线程（写出剩余日志），之后的日志改为同步写出
+    void shutdown();
+
+    // 截断载荷用于日志输出，超出部分以"...(N bytes)"表示
+    static std::string truncate(std::string_view payload, size_t max_length = 256);
+
+    // 获取统计信息
+    nlohmann::json get_stats() const;
+
+private:
+    Logger();
+    ~Logger() = default;
+
+    struct Record
+    {
+        LogLevel level;
+        int64_t timestamp_us; // 微秒级时间戳
+        int thread_id;
+        std::string text; // 消息和字段
+    };
+
+    struct Slot
+    {
+        std::atomic<size_t> sequence;
+        Record record;
+    };
+
+    bool try_push(Record &&record);
+    bool try_pop(Record &record);
+    void ensure_writer();
+    void writer_loop();
+    void write_batch();
+    static void write_lines(const std::string &out, const std::string &err);
+    static void format_record(const Record &record, std::string &out);
+    static void after_fork_child();
+
+    static constexpr size_t capacity_ = 8192; // 必须是2的幂
+
+    std::unique_ptr<Slot[]> slots_;
+    alignas(64) std::atomic<size_t> enqueue_pos_;
+    alignas(64) std::atomic<size_t> dequeue_pos_;
+
+    std::atomic<LogLevel> level_;
+    std::atomic<bool> running_;
+    std::atomic<bool> writer_started_;
+    std::atomic<bool> stopped_;
+    std::mutex writer_mutex_;
+    std::condition_variable writer_cv_;
+    std::thread writer_;
+
+    std::atomic<size_t> written_;
+    std::atomic<size_t> dropped_;
+    size_t reported_dropped_; // 只由后台线程访问
+};
+
+// 限速：每秒最多输出per_second条，超出的被计数，在下一个允许输出的日志中报告
+class LogRateLimiter
+{
+public:
+    explicit LogRateLimiter(size_t per_second) : per_second_(per_second), window_(0), count_(0), suppressed_(0) {}
+
+    // 允许输出时返回true，suppressed为上一窗口被抑制的条数
+    bool allow(size_t &suppressed);
+
+private:
+    size_t per_second_;
+    std::atomic<int64_t> window_;
+    std::atomic<size_t> count_;
+    std::atomic<size_t> suppressed_;
+};
+
+// 先检查级别再构造消息，级别关闭时参数不会被求值
+#define LOG_AT(level, ...)                                    \
+    do                                                        \
+    {                                                         \
+        Logger &log_instance_ = Logger::getInstance();        \
+        if (log_instance_.should_log(level))                  \
+            log_instance_.log(level, __VA_ARGS__);            \
+    } while (0)
+
+#define LOG_TRACE(...) LOG_AT(LogLevel::Trace, __VA_ARGS__)
+#define LOG_DEBUG(...) LOG_AT(LogLevel::Debug, __VA_ARGS__)
+#define LOG_INFO(...) LOG_AT(LogLevel::Info, __VA_ARGS__)
+#define LOG_WARN(...) LOG_AT(LogLevel::Warn, __VA_ARGS__)
+#define LOG_ERROR(...) LOG_AT(LogLevel::Error, __VA_ARGS__)
+
+// 采样：同一调用点每n条输出一条
+#define LOG_EVERY_N(level, n, ...)                                                              \
+    do                                                                                          \
+    {                                                                                           \
+        static std::atomic<size_t> log_counter_{0};                                             \
+        Logger &log_instance_ = Logger::getInstance();                                          \
+        if (log_instance_.should_log(level) &&                                                  \
+            log_counter_.fetch_add(1, std::memory_order_relaxed) % static_cast<size_t>(n) == 0) \
+            log_instance_.log(level, __VA_ARGS__);                                              \
+    } while (0)
+
+// 限速：同一调用点每秒最多输出per_second条
+#define LOG_RATE_LIMITED(level, per_second, message, ...)                                        \
+    do                                                                                           \
+    {                                                                                            \
+        static LogRateLimiter log_limiter_(per_second);                                          \
+        Logger &log_instance_ = Logger::getInstance();                                           \
+        size_t log_suppressed_ = 0;                                                              \
+        if (log_instance_.should_log(level) && log_limiter_.allow(log_suppressed_))              \
+        {                                                                                        \
+            if (log_suppressed_ > 0)                                                             \
+                log_instance_.log(level, "⏭️ 限速省略日志", {{"suppressed", log_suppressed_}});  \
+            log_instance_.log(level, message, ##__VA_ARGS__);                                    \
+        }                                                                                        \
+    } while (0)
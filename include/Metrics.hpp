@@ -0,0 +1,142 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <nlohmann/json.hpp>
+
+// 指标标签（按注册顺序输出）
+typedef std::vector<std::pair<std::string, std::string>> MetricLabels;
+
+// 单调递增计数器
+class Counter
+{
+public:
+    void inc(uint64_t n = 1) { value_.fetch_add(n, std::memory_order_relaxed); }
+    uint64_t get() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> value_{0};
+};
+
+// 可增可减的瞬时值
+class Gauge
+{
+public:
+    void set(int64_t v) { value_.store(v, std::memory_order_relaxed); }
+    void add(int64_t n = 1) { value_.fetch_add(n, std::memory_order_relaxed); }
+    void sub(int64_t n = 1) { value_.fetch_sub(n, std::memory_order_relaxed); }
+    int64_t get() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<int64_t> value_{0};
+};
+
+// 耗时直方图（HDR风格的对数线性桶）
+// 以微秒记录，每个2的幂区间再均分为8个子桶，相对误差不超过12.5%，
+// 记录只有几次原子加，不加锁
+class Histogram
+{
+public:
+    // 记录一次耗时（秒）
+    void observe(double seconds);
+
+    uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+    double sum() const { return sum_us_.load(std::memory_order_relaxed) / 1e6; }
+
+    // 估算分位数（秒），q取0~1
+    double quantile(double q) const;
+
+    // 耗时小于等于upper_us（必须是2的幂）的累计次数
+    uint64_t cumulative_count(uint64_t upper_us) const;
+
+private:
+    static const int sub_bits_ = 3;
+    static const int sub_count_ = 1 << sub_bits_;
+    static const int max_octave_ = 40; // 2^40微秒约12天，更大的值计入最后一个桶
+    static const int bucket_count_ = (max_octave_ - sub_bits_ + 2) * sub_count_;
+
+    static int bucket_index(uint64_t us);
+    static uint64_t bucket_upper(int index);
+
+    std::atomic<uint64_t> buckets_[bucket_count_] = {};
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> sum_us_{0};
+};
+
+// 作用域计时：析构时把耗时记入直方图
+class ScopedTimer
+{
+public:
+    explicit ScopedTimer(Histogram &histogram)
+        : histogram_(&histogram), start_(std::chrono::steady_clock::now()) {}
+    ~ScopedTimer() { stop(); }
+
+    ScopedTimer(const ScopedTimer &) = delete;
+    ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+    // 提前结束计时，返回耗时（秒），重复调用只记录一次
+    double stop();
+
+private:
+    Histogram *histogram_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+// 指标注册表
+// 指标对象注册后地址不变，调用方在函数内用static引用缓存，之后的更新不经过注册表的锁；
+// render()按Prometheus文本格式输出全部指标
+class Metrics
+{
+public:
+    // 单例模式
+    static Metrics &getInstance();
+
+    Counter &counter(const std::string &name, const std::string &help, const MetricLabels &labels = {});
+    Gauge &gauge(const std::string &name, const std::string &help, const MetricLabels &labels = {});
+    Histogram &histogram(const std::string &name, const std::string &help, const MetricLabels &labels = {});
+
+    // 处理阶段耗时（doubao_stage_duration_seconds{stage="..."}）
+    Histogram &stage(const std::string &stage);
+
+    // 按Prometheus文本格式追加全部已注册指标
+    void render(std::string &out) const;
+
+    // 追加一组只在抓取时读取的样本（如队列深度），type为"gauge"或"counter"
+    static void render_samples(std::string &out, const std::string &name, const std::string &help, const char *type,
+                               const std::vector<std::pair<MetricLabels, double>> &samples);
+
+    // 各处理阶段耗时汇总（次数、平均值、分位数）
+    nlohmann::json get_stage_stats() const;
+
+private:
+    Metrics() = default;
+
+    enum class Type
+    {
+        Counter,
+        Gauge,
+        Histogram
+    };
+
+    struct Family
+    {
+        std::string help;
+        Type type;
+        std::map<std::string, std::unique_ptr<Counter>> counters;
+        std::map<std::string, std::unique_ptr<Gauge>> gauges;
+        std::map<std::string, std::unique_ptr<Histogram>> histograms;
+    };
+
+    Family &family(const std::string &name, const std::string &help, Type type);
+    static std::string format_labels(const MetricLabels &labels);
+    static void render_histogram(std::string &out, const std::string &name, const std::string &labels, const Histogram &histogram);
+
+    mutable std::mutex mutex_;
+    std::map<std::string, Family> families_;
+};
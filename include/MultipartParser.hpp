@@ -0,0 +1,30 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+// multipart/form-data中的一个部分（string_view指向原始请求体）
+struct MultipartPart
+{
+    std::string_view name;         // 字段名
+    std::string_view filename;     // 文件名（普通字段为空）
+    std::string_view content_type; // 该部分的Content-Type（未指定时为空）
+    std::string_view data;         // 内容
+};
+
+// multipart/form-data解析
+// 只记录各部分在请求体中的位置，不拷贝内容，请求体可以在内存中，也可以是映射到内存的临时文件
+class MultipartParser
+{
+public:
+    // 从Content-Type中取出boundary，不是multipart/form-data时返回空
+    static std::string_view boundary(std::string_view content_type);
+
+    // 解析请求体，格式错误时返回false并设置error
+    static bool parse(std::string_view body, std::string_view boundary, std::vector<MultipartPart> &parts, std::string &error);
+
+private:
+    // 取出Content-Disposition中的参数值（如name、filename）
+    static std::string_view disposition_param(std::string_view disposition, std::string_view name);
+};
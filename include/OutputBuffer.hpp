@@ -0,0 +1,50 @@
+#pragma once
+
+#include <string>
+#include <deque>
+#include <cstddef>
+#include <sys/uio.h>
+#include <nlohmann/json.hpp>
+
+// 待发送的响应数据
+// 由多个独立分配的片段（响应头、JSON响应体、chunk头等）组成，追加时只移动字符串不拷贝内容，
+// 发送时把多个片段填入iovec，用一次scatter-gather系统调用提交
+class OutputBuffer
+{
+public:
+    OutputBuffer() = default;
+    OutputBuffer(std::string data) { append(std::move(data)); }
+
+    // 追加一个片段（空字符串忽略）
+    void append(std::string data);
+
+    // 追加另一个缓冲区的全部片段
+    void append(OutputBuffer &&other);
+
+    // 待发送的字节数
+    size_t size() const { return size_; }
+
+    bool empty() const { return size_ == 0; }
+
+    // 片段数
+    size_t segment_count() const { return segments_.size(); }
+
+    // 用待发送的数据填充iovec，返回填充的个数
+    int fill_iovec(struct iovec *iov, int max_count) const;
+
+    // 标记前n个字节已发送，释放已发送完的片段
+    void consume(size_t n);
+
+    void clear();
+
+    // 合并为一个连续的字符串（只用于需要完整报文的场景，如日志和测试）
+    std::string to_string() const;
+
+    // 把JSON直接序列化追加到out末尾（不经过临时字符串）
+    static void append_json(std::string &out, const nlohmann::json &value);
+
+private:
+    std::deque<std::string> segments_;
+    size_t offset_ = 0; // 第一个片段中已发送的字节数
+    size_t size_ = 0;
+};
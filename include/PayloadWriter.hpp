@@ -0,0 +1,62 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+// 模型请求体的写入器
+// 按后端格式一次性写出最终的请求JSON：文本片段在添加时完成JSON转义，
+// 图片只记录原始字节（最终要发送的JPEG/PNG数据），在finish()中按计算好的总长度一次分配，
+// 并把Base64直接写进请求体，不再经过Base64字符串、data URL拼接、JSON DOM和dump()等中间副本
+class PayloadWriter
+{
+public:
+    enum class Format
+    {
+        Doubao,         // OpenAI兼容的chat格式，content为文本和image_url数组
+        VLLM,           // 同上，但不带stream字段
+        OllamaChat,     // Ollama /api/chat：文本拼接为content，图片放在images数组
+        OllamaGenerate, // Ollama /api/generate：文本拼接为prompt，图片放在images数组
+    };
+
+    PayloadWriter(Format format, const std::string &model, int max_tokens, double temperature);
+
+    // 添加文本片段
+    void add_text(std::string_view text);
+
+    // 添加图片（data为最终要发送的图片字节，调用方需保证在finish()之前有效）
+    // detail仅用于OpenAI兼容格式（如"low"），mime_type用于data URL
+    void add_image(const unsigned char *data, size_t size, const char *detail = nullptr, const char *mime_type = "image/jpeg");
+    void add_image(const std::vector<unsigned char> &data, const char *detail = nullptr, const char *mime_type = "image/jpeg")
+    {
+        add_image(data.data(), data.size(), detail, mime_type);
+    }
+
+    // 请求流式响应（默认为非流式）
+    void set_stream(bool stream) { stream_ = stream; }
+
+    // 写出完整的请求体
+    std::string finish() const;
+
+private:
+    struct Part
+    {
+        bool is_image;
+        std::string text; // 已转义的文本（不含引号）
+        const unsigned char *data;
+        size_t size;
+        const char *detail;
+        const char *mime_type;
+    };
+
+    // 按格式依次输出各部分（先统计长度，再写入分配好的缓冲区）
+    template <typename Output>
+    void write(Output &out) const;
+
+    Format format_;
+    std::string model_;       // 已转义（含引号）
+    std::string max_tokens_;  // 已格式化的数值
+    std::string temperature_; // 已格式化的数值
+    bool stream_;
+    std::vector<Part> parts_;
+};
@@ -1,13 +1,32 @@
 #pragma once
 
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <ctime>
 #include <nlohmann/json.hpp>
 
+class DatabaseManager;
+
+// refresh token存储（进程内单例）
+// 使用服务器已初始化的数据库连接池（未接入数据库时退回本地文件），
+// 验证通过的token哈希在内存中缓存一段时间，撤销操作由后台线程异步写入存储
 class RefreshTokenStore
 {
 public:
-    RefreshTokenStore();
-    ~RefreshTokenStore();
+    // 单例模式
+    static RefreshTokenStore &getInstance();
+
+    // 禁用拷贝构造和赋值
+    RefreshTokenStore(const RefreshTokenStore &) = delete;
+    RefreshTokenStore &operator=(const RefreshTokenStore &) = delete;
+
+    // 接入数据库（不持有所有权，db须在shutdown之前一直有效），为nullptr时使用本地文件
+    void attach_database(DatabaseManager *db);
 
     // 创建并持久化 refresh token，返回明文 token 字符串（会在 DB 中保存其 hash）
     std::string CreateRefreshToken(const std::string &sub, int expiry_seconds);
@@ -15,10 +34,51 @@ public:
     // 验证 token，有效则返回 true 并填充 out_sub
     bool VerifyRefreshToken(const std::string &token, std::string &out_sub);
 
-    // 撤销 token
+    // 撤销 token（立即生效，存储中的记录异步删除）
     void RevokeToken(const std::string &token);
 
+    // 写出尚未完成的撤销并停止后台线程
+    void shutdown();
+
+    // 获取统计信息
+    nlohmann::json get_stats();
+
 private:
-    // no file-backed storage in DB-backed implementation
+    RefreshTokenStore();
+
+    struct CachedToken
+    {
+        std::string sub;
+        std::time_t expires_at;   // token本身的过期时间
+        std::time_t cached_until; // 缓存的有效期
+    };
+
+    // 缓存有效期：多进程模式下其他worker撤销的token最多在这段时间内仍被本进程接受
+    static constexpr std::time_t cache_ttl_seconds_ = 60;
+    static constexpr size_t cache_capacity_ = 65536;
+
     std::string random_hex(size_t len);
+
+    // 调用方需持有mutex_
+    void cache_token(const std::string &token_hash, const std::string &sub, std::time_t expires_at);
+
+    // 后台线程：依次删除已撤销token的存储记录
+    void writer_loop();
+
+    DatabaseManager *db_;
+
+    std::mutex mutex_;
+    std::condition_variable writer_cv_;
+    std::thread writer_;
+    bool writer_started_;
+    bool stopped_;
+
+    std::unordered_map<std::string, CachedToken> cache_; // token哈希 -> 缓存记录
+    // 已撤销但存储记录尚未删除的token哈希，期间即使存储中查到也视为无效
+    std::unordered_set<std::string> pending_revocations_;
+    std::deque<std::string> revocation_queue_;
+
+    size_t cache_hits_;
+    size_t cache_misses_;
+    size_t revocations_written_;
 };
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <zlib.h>
+
+struct ZSTD_CCtx_s;
+
+// 响应体的内容编码
+enum class ContentEncoding
+{
+    Identity,
+    Gzip,
+    Zstd // 编译时需要libzstd（HAVE_ZSTD）
+};
+
+// 响应压缩
+// 根据Accept-Encoding选择编码；完整响应一次性压缩，chunked流式响应逐段压缩并flush，
+// 保证每条NDJSON结果都能立即被客户端解压
+class ResponseCompressor
+{
+public:
+    // 根据Accept-Encoding头选择编码（优先zstd，其次gzip，q=0表示不接受）
+    static ContentEncoding negotiate(std::string_view accept_encoding);
+
+    // Content-Encoding头的取值
+    static const char *encoding_name(ContentEncoding encoding);
+
+    // 一次性压缩，失败时返回false
+    static bool compress(ContentEncoding encoding, std::string_view input, std::string &output);
+
+    // 创建流式压缩器
+    explicit ResponseCompressor(ContentEncoding encoding);
+    ~ResponseCompressor();
+
+    // 禁用拷贝构造和赋值
+    ResponseCompressor(const ResponseCompressor &) = delete;
+    ResponseCompressor &operator=(const ResponseCompressor &) = delete;
+
+    // 压缩一段数据并flush，返回可以立即发送的压缩数据
+    std::string write(std::string_view data);
+
+    // 结束压缩流，返回剩余的压缩数据
+    std::string finish();
+
+    ContentEncoding get_encoding() const { return encoding_; }
+
+private:
+    static const int gzip_level_ = 6;
+    static const int zstd_level_ = 3;
+
+    ContentEncoding encoding_;
+    z_stream gzip_stream_;
+    bool gzip_initialized_;
+    ZSTD_CCtx_s *zstd_ctx_;
+    bool finished_;
+};
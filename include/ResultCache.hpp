@@ -0,0 +1,113 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <list>
+#include <deque>
+#include <unordered_map>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <ctime>
+#include <nlohmann/json.hpp>
+
+class Counter;
+
+// 分析结果缓存（进程内单例）
+// 按内容寻址：键由媒体标识、提示词、模型名、max_tokens和帧数组成。图片的媒体标识是规范化后
+// 送给模型的JPEG/PNG数据的SHA-256，同一张图片换了URL或文件名也能命中；视频在抽帧之前查找缓存，
+// 本地文件按文件内容的SHA-256、远程视频按URL标识，命中时不再下载和抽帧。
+// 内存层按LRU淘汰；磁盘层每个结果一个JSON文件，进程重启后仍然有效，写入由后台线程异步完成
+class ResultCache
+{
+public:
+    // 缓存的分析结果（只缓存成功的结果）
+    struct Entry
+    {
+        std::string content;
+        nlohmann::json usage;
+        nlohmann::json raw_response;
+        std::time_t created_at = 0;
+    };
+
+    // 命中的缓存层
+    enum class Tier
+    {
+        Miss,
+        Memory,
+        Disk,
+    };
+
+    // 单例模式
+    static ResultCache &getInstance();
+
+    // 禁用拷贝构造和赋值
+    ResultCache(const ResultCache &) = delete;
+    ResultCache &operator=(const ResultCache &) = delete;
+
+    // 媒体内容的哈希
+    static std::string media_hash(const std::vector<unsigned char> &data);
+
+    // 文件内容的哈希（流式读取），读取失败时返回空字符串
+    static std::string file_hash(const std::string &path);
+
+    // 缓存键：frame_count对图片为0
+    static std::string make_key(const std::string &media_hash, const std::string &prompt,
+                                const std::string &model, int max_tokens, int frame_count);
+
+    // 查询缓存：先查内存，再查磁盘（磁盘命中后放入内存），未命中返回Tier::Miss
+    Tier get(const std::string &key, Entry &entry);
+
+    // 写入缓存：内存立即生效，磁盘异步写出
+    void put(const std::string &key, Entry entry);
+
+    // 写出尚未完成的磁盘写入并停止后台线程
+    void shutdown();
+
+    nlohmann::json get_stats();
+
+    static const char *tier_name(Tier tier);
+
+private:
+    ResultCache();
+
+    struct MemoryItem
+    {
+        std::string key;
+        Entry entry;
+    };
+
+    std::string disk_path(const std::string &key) const;
+    bool expired(const Entry &entry, std::time_t now) const;
+
+    // 调用方需持有mutex_
+    void put_memory(const std::string &key, Entry entry);
+
+    // 后台线程：写出磁盘文件，超过条数上限时删除最旧的文件
+    void writer_loop();
+    void scan_disk();
+    void prune_disk();
+
+    mutable std::mutex mutex_;
+    std::condition_variable writer_cv_;
+    std::thread writer_;
+    bool writer_started_;
+    bool stopped_;
+
+    // LRU：链表头部为最近使用
+    std::list<MemoryItem> lru_;
+    std::unordered_map<std::string, std::list<MemoryItem>::iterator> index_;
+
+    std::deque<std::pair<std::string, Entry>> write_queue_;
+    size_t disk_entries_; // 磁盘上的缓存文件数（后台线程启动时扫描，之后按写入和删除计数）
+
+    size_t memory_hits_;
+    size_t disk_hits_;
+    size_t misses_;
+    size_t disk_writes_;
+    size_t disk_errors_;
+
+    Counter *memory_hit_counter_;
+    Counter *disk_hit_counter_;
+    Counter *miss_counter_;
+};
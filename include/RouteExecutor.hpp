@@ -0,0 +1,85 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <chrono>
+#include <nlohmann/json.hpp>
+
+// 路由执行器（舱壁隔离）
+// 每类路由使用独立的线程池和有界队列，耗时的媒体分析请求占满自己的执行器时，
+// 状态查询、数据库查询等轻量请求仍由各自的执行器及时处理
+class RouteExecutor
+{
+public:
+    using Job = std::function<void()>;
+
+    RouteExecutor(const std::string &name, size_t thread_count, size_t max_queue_size);
+    ~RouteExecutor();
+
+    // 禁用拷贝构造和赋值
+    RouteExecutor(const RouteExecutor &) = delete;
+    RouteExecutor &operator=(const RouteExecutor &) = delete;
+
+    // 提交任务，队列已满或已关闭时返回false（由调用方回复503）
+    bool submit(Job job);
+
+    // 停止接收任务并等待工作线程退出（队列中未执行的任务被丢弃）
+    void shutdown();
+
+    const std::string &get_name() const { return name_; }
+
+    // 当前排队的任务数
+    size_t get_queue_size() const;
+
+    // 正在执行的任务数
+    size_t get_active_count() const { return active_; }
+
+    // 线程数
+    size_t get_thread_count() const { return thread_count_; }
+
+    // 估算新任务的排队等待时间（秒）：取队首任务已等待时间与 排队数×平均执行时间/线程数 中的较大值
+    double estimate_queue_wait() const;
+
+    // 所有线程都忙碌时的处理速率（个/秒，线程数/平均执行时间），尚无统计时为0
+    double get_drain_rate() const;
+
+    // 执行器统计信息
+    nlohmann::json get_stats() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct QueuedJob
+    {
+        Job job;
+        Clock::time_point enqueue_time;
+    };
+
+    // 工作线程函数
+    void worker_thread();
+
+    std::string name_;
+    size_t thread_count_;
+    size_t max_queue_size_;
+
+    std::vector<std::thread> workers_;
+    std::queue<QueuedJob> queue_;
+    mutable std::mutex mutex_;
+    std::condition_variable condition_;
+
+    // 排队等待时间和执行时间统计（受mutex_保护）
+    // 用执行时间而不是单位时间内的完成数估算处理速率，空闲期间不会拉低速率
+    double queue_wait_ewma_;           // 排队等待时间的指数加权平均（秒）
+    double service_time_ewma_;         // 任务执行时间的指数加权平均（秒）
+
+    std::atomic<bool> stop_;
+    std::atomic<size_t> active_;
+    std::atomic<size_t> completed_;
+    std::atomic<size_t> rejected_;
+};
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <nlohmann/json.hpp>
+
+// 模型流式响应的增量解析器
+// 在HTTP客户端的写回调中逐段喂入数据：OpenAI兼容的SSE（data: {...}）和Ollama的NDJSON（每行一个JSON）
+// 按行切分后立即解析，累积完整内容和usage，新增的内容片段可以随时取出转发给客户端
+class StreamingResponseParser
+{
+public:
+    enum class Format
+    {
+        SSE,    // 豆包、vLLM：data: {"choices":[{"delta":{"content":"..."}}]}，以data: [DONE]结束
+        NDJSON, // Ollama：{"message":{"content":"..."}}或{"response":"..."}，最后一行done为true
+    };
+
+    explicit StreamingResponseParser(Format format);
+
+    // 喂入收到的数据（可以在任意位置截断）
+    void feed(const char *data, size_t size);
+
+    // 数据结束，处理最后一行没有换行符的内容
+    void finish();
+
+    // 取出上次调用以来新增的内容片段
+    std::string take_delta();
+
+    // 是否解析到了任何事件
+    bool received_events() const { return events_ > 0; }
+
+    const std::string &content() const { return content_; }
+    const nlohmann::json &usage() const { return usage_; }
+
+    // 最后一个事件（作为原始响应保存）
+    const nlohmann::json &last_event() const { return last_event_; }
+
+    // 流中返回的错误信息（为空表示没有错误）
+    const std::string &error() const { return error_; }
+
+    // 无法解析的内容（如后端直接返回的非流式错误响应），最多保留前4KB
+    const std::string &unparsed() const { return unparsed_; }
+
+private:
+    void handle_line(std::string_view line);
+    void handle_event(const nlohmann::json &event);
+    void keep_unparsed(std::string_view line);
+
+    Format format_;
+    std::string buffer_; // 尚未遇到换行符的部分
+    std::string content_;
+    size_t delta_start_; // content_中尚未取出的起始位置
+    nlohmann::json usage_;
+    nlohmann::json last_event_;
+    std::string error_;
+    std::string unparsed_;
+    size_t events_;
+};
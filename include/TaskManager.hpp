@@ -11,7 +11,10 @@
 #include <future>
 #include <atomic>
 #include <memory>
+#include <unordered_map>
+#include <deque>
 #include "DoubaoMediaAnalyzer.hpp"
+#include "Tracer.hpp"
 
 // 分析任务结构
 struct AnalysisTask
@@ -26,6 +29,9 @@ struct AnalysisTask
     std::string model_name;                               // 大模型名称
     std::string file_id;                                  // Excel文件中的唯一标识符
     std::function<void(const AnalysisResult &)> callback; // 完成回调
+    std::function<void()> on_start;                       // 开始执行时的回调（可选）
+    std::shared_ptr<std::atomic<bool>> cancelled;         // 取消标志（可选），执行前被置位的任务直接跳过
+    TraceContext trace;                                   // 所属请求的跟踪上下文，未设置时继承提交线程的上下文
 };
 
 // 任务结果结构
@@ -53,6 +59,12 @@ public:
     // 批量添加分析任务
     std::vector<std::future<TaskResult>> addTasks(const std::vector<AnalysisTask> &tasks);
 
+    // 以滑动窗口执行一组任务：同时在途的任务不超过window个，每完成一个就补交下一个；
+    // 结果按完成顺序在调用线程中交给on_result（index为任务在tasks中的下标），
+    // on_result返回false时停止提交，尚未开始的在途任务被取消。返回已处理的结果数
+    size_t runTasks(const std::vector<AnalysisTask> &tasks, size_t window,
+                    const std::function<bool(size_t index, TaskResult &&result)> &on_result);
+
     // 关闭线程池
     void shutdown();
 
@@ -62,6 +74,15 @@ public:
     // 获取活跃线程数
     size_t getActiveThreadCount() const;
 
+    // 获取已发出模型请求、等待响应的任务数（不占用工作线程）
+    size_t getAwaitingTaskCount() const;
+
+    // 获取已执行完成的任务总数（用于估算处理速率）
+    size_t getCompletedTaskCount() const;
+
+    // 获取合并到相同的进行中任务、没有单独执行的任务总数
+    size_t getCoalescedTaskCount() const;
+
 private:
     TaskManager() = default;
     ~TaskManager();
@@ -73,15 +94,47 @@ private:
     // 工作线程函数
     void workerThread();
 
-    // 执行单个任务
-    TaskResult executeTask(const AnalysisTask &task);
+    // 执行单个任务：同步完成的任务直接调用completeTask，
+    // 异步等待模型响应的任务在响应到达后由工作线程调用completeTask
+    void executeTask(const AnalysisTask &task);
+
+    // 任务完成：保存结果、记录日志并调用回调
+    void completeTask(const AnalysisTask &task, TaskResult result, double start_time);
+
+    // 合并相同的进行中任务（single-flight）：相同媒体、提示词、模型和参数的任务只执行一次，
+    // 执行期间到达的重复任务挂在执行中的任务上，完成时得到同一个分析结果
+    struct CoalescedTask
+    {
+        AnalysisTask task;
+        double start_time;
+    };
+    static std::string coalescingKey(const AnalysisTask &task);
+
+    // 登记为执行者返回true；已有相同任务在执行时挂到其上并返回false
+    bool joinInFlight(const std::string &key, const AnalysisTask &task, double start_time);
+
+    // 执行者完成：完成自身以及挂在其上的所有重复任务
+    void finishInFlight(const std::string &key, const AnalysisTask &task, TaskResult result, double start_time);
+
+    // 把异步任务的后续处理交给工作线程（可在任意线程调用）
+    void postContinuation(std::function<void()> continuation);
+
+    // 异步任务提交失败（回调不会再被调用）时撤销等待计数
+    void abandonAwaiting();
 
     // 线程池
     std::vector<std::thread> workers_;
 
+    // 进行中的任务（合并键 -> 等待同一结果的重复任务）
+    std::mutex in_flight_mutex_;
+    std::unordered_map<std::string, std::vector<CoalescedTask>> in_flight_;
+
     // 任务队列
     std::queue<AnalysisTask> tasks_;
 
+    // 异步任务的后续处理，优先于新任务执行
+    std::queue<std::function<void()>> continuations_;
+
     // 同步原语
     std::mutex queue_mutex_;
     std::condition_variable condition_;
@@ -89,6 +142,9 @@ private:
     // 状态标志
     std::atomic<bool> stop_;
     std::atomic<size_t> active_threads_;
+    std::atomic<size_t> completed_tasks_{0};
+    std::atomic<size_t> coalesced_tasks_{0};
+    std::atomic<size_t> awaiting_tasks_{0}; // 等待模型响应的任务数，修改需持有queue_mutex_
 
     // 分析器实例
     std::shared_ptr<DoubaoMediaAnalyzer> analyzer_;
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include <nlohmann/json.hpp>
+
+// 跟踪上下文：随请求在线程间传递（如放入AnalysisTask），trace_id为0表示没有跟踪
+struct TraceContext
+{
+    uint64_t trace_id = 0;
+    uint64_t span_id = 0; // 当前所在的span，新span以它为父节点
+    bool sampled = false;
+
+    bool active() const { return trace_id != 0 && sampled; }
+};
+
+// 请求级跟踪
+// 每个请求可以按采样率或请求参数开启跟踪，开启后各处理阶段记录为嵌套的span，
+// 写入内存中的环形缓冲区，可导出为Chrome trace-event JSON（chrome://tracing、Perfetto）
+class Tracer
+{
+public:
+    // 单例模式
+    static Tracer &getInstance();
+
+    // 禁用拷贝构造和赋值
+    Tracer(const Tracer &) = delete;
+    Tracer &operator=(const Tracer &) = delete;
+
+    // 开始一个新的跟踪。force_sample: 1强制采样，0强制不采样，-1按采样率
+    TraceContext start_trace(int force_sample = -1);
+
+    // 当前线程的跟踪上下文
+    static TraceContext current();
+
+    // 采样率（0~1），默认取TRACE_SAMPLE_RATE环境变量，未设置时为0（只跟踪显式要求的请求）
+    void set_sample_rate(double rate) { sample_rate_.store(rate, std::memory_order_relaxed); }
+    double get_sample_rate() const { return sample_rate_.load(std::memory_order_relaxed); }
+
+    // 导出Chrome trace-event JSON，trace_id为空时导出缓冲区中全部span（最多limit个，取最近的）
+    std::string export_chrome_trace(const std::string &trace_id, size_t limit) const;
+
+    // 获取统计信息
+    nlohmann::json get_stats() const;
+
+    static std::string format_id(uint64_t id);
+    static uint64_t parse_id(const std::string &text);
+
+    // span使用的时间戳（微秒）
+    static int64_t now_us();
+
+private:
+    friend class TraceScope;
+    friend class Span;
+
+    struct SpanRecord
+    {
+        uint64_t trace_id;
+        uint64_t span_id;
+        uint64_t parent_id;
+        std::string name;
+        int64_t start_us; // 微秒级时间戳
+        int64_t duration_us;
+        int thread_id;
+        std::vector<std::pair<std::string, std::string>> args;
+    };
+
+    Tracer();
+
+    uint64_t next_id();
+    void record(SpanRecord &&span);
+
+    static constexpr size_t capacity_ = 8192;
+
+    std::atomic<double> sample_rate_;
+    mutable std::mutex mutex_;
+    std::vector<SpanRecord> spans_; // 环形缓冲区
+    size_t next_slot_;
+    std::atomic<size_t> traces_started_;
+    std::atomic<size_t> spans_recorded_;
+};
+
+// 在作用域内把当前线程的跟踪上下文切换为ctx（用于工作线程接续请求的跟踪）
+class TraceScope
+{
+public:
+    explicit TraceScope(const TraceContext &ctx);
+    ~TraceScope();
+
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+
+private:
+    TraceContext previous_;
+};
+
+// span：当前线程处于采样的跟踪中时记录作用域的耗时，并成为其中新span的父节点；
+// 未采样时构造和析构只检查一次线程局部变量
+class Span
+{
+public:
+    explicit Span(const char *name);
+
+    // 从start_us（Tracer::now_us()）开始计时，用于在完成回调中记录异步操作（如上游请求）的耗时
+    Span(const char *name, int64_t start_us);
+    ~Span();
+
+    Span(const Span &) = delete;
+    Span &operator=(const Span &) = delete;
+
+    bool active() const { return record_.span_id != 0; }
+
+    // 附加参数（只在采样时保存）
+    void set_arg(const char *key, std::string_view value);
+    void set_arg(const char *key, int64_t value) { set_arg(key, std::to_string(value)); }
+
+private:
+    Tracer::SpanRecord record_;
+};
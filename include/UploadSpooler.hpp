@@ -0,0 +1,91 @@
+#pragma once
+
+#include <string>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <functional>
+#include <memory>
+#include <atomic>
+#include <nlohmann/json.hpp>
+
+// 上传请求体的后台落盘（进程内单例，一个写入线程）
+// I/O线程只把收到的请求体片段交给写入线程，不做阻塞的磁盘写入；每个上传在内存中积压的数据有上限（window），
+// 超过时I/O线程暂停读取该连接，写入追上（积压降到一半）、全部写完或出错时通过notify通知I/O线程继续
+class UploadSpooler
+{
+public:
+    // 单个上传的临时文件（I/O线程与写入线程共享，除fd外的字段受mutex保护）
+    struct File
+    {
+        std::mutex mutex;
+        std::string dir;              // 临时文件目录
+        size_t window = 0;            // 允许积压的字节数
+        std::function<void()> notify; // 在写入线程中调用，需自行投递到I/O线程
+        std::string path;             // 临时文件路径（写入线程创建文件后设置）
+        int fd = -1;                  // 只由写入线程访问
+        size_t queued = 0;            // 已交付、尚未写入的字节数
+        bool throttled = false;       // I/O线程因积压暂停了读取，积压降到一半时通知
+        bool finished = false;        // 已全部写入并关闭
+        bool discarded = false;       // 已放弃，写入线程删除文件
+        std::string error;            // 创建或写入失败的原因
+    };
+    using FilePtr = std::shared_ptr<File>;
+
+    // 单例模式
+    static UploadSpooler &getInstance();
+
+    // 禁用拷贝构造和赋值
+    UploadSpooler(const UploadSpooler &) = delete;
+    UploadSpooler &operator=(const UploadSpooler &) = delete;
+
+    // 开始一个上传：文件由写入线程在dir中创建
+    FilePtr open(const std::string &dir, size_t window, std::function<void()> notify);
+
+    // 交付一段请求体
+    void write(const FilePtr &file, std::string data);
+
+    // 积压超过window时返回true（I/O线程应暂停读取），积压降到一半后通过notify通知
+    bool backlogged(const FilePtr &file);
+
+    // 请求体已全部交付，写完后关闭文件并通知
+    void finish(const FilePtr &file);
+
+    // 放弃上传（连接关闭或请求出错），写入线程关闭并删除文件
+    void discard(const FilePtr &file);
+
+    nlohmann::json get_stats();
+
+private:
+    UploadSpooler();
+
+    enum class Op
+    {
+        Write,
+        Finish,
+        Discard,
+    };
+
+    struct Item
+    {
+        FilePtr file;
+        Op op;
+        std::string data;
+    };
+
+    void enqueue(Item item);
+    void writer_loop();
+    void process(Item &item);
+
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    std::deque<Item> queue_;
+    std::thread writer_;
+
+    std::atomic<size_t> queued_bytes_;  // 所有上传积压的字节数
+    std::atomic<size_t> written_bytes_; // 已写入临时文件的字节数
+    std::atomic<size_t> files_;         // 已完成的上传数
+    std::atomic<size_t> throttled_;     // 因积压暂停读取的次数
+    std::atomic<size_t> errors_;        // 创建或写入失败的上传数
+};
@@ -152,12 +152,12 @@ private:
     void worker_thread();
 
     // 并发处理帧
-    std::vector<std::string> process_frames_concurrently(
+    std::vector<std::vector<unsigned char>> process_frames_concurrently(
         const std::vector<std::string>& frame_paths,
         int max_concurrency = std::thread::hardware_concurrency());
 
     // 单个帧的处理函数
-    std::string process_single_frame(const std::string& frame_path);
+    std::vector<unsigned char> process_single_frame(const std::string& frame_path);
     
     // CUDA资源管理方法
     bool acquire_cuda_resource();
@@ -170,13 +170,13 @@ public:
     // 获取视频元数据，无需完整下载
     VideoMetadata get_video_metadata(const std::string &video_url);
 
-    // 提取关键帧，返回base64编码的图像列表
-    std::vector<std::string> extract_keyframes(const std::string &video_url,
+    // 提取关键帧，返回JPEG编码的图像列表
+    std::vector<std::vector<unsigned char>> extract_keyframes(const std::string &video_url,
                                                int max_frames = 5,
                                                const std::string &output_format = "jpg");
 
-    // 提取采样帧，返回base64编码的图像列表
-    std::vector<std::string> extract_sample_frames(const std::string &video_url,
+    // 提取采样帧，返回JPEG编码的图像列表
+    std::vector<std::vector<unsigned char>> extract_sample_frames(const std::string &video_url,
                                                    int num_samples = 5);
 
     // 分析视频内容
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <cstdint>
+#include <sys/types.h>
+#include <nlohmann/json.hpp>
+
+// 共享内存中单个worker进程的状态槽位（supervisor与所有worker共享，字段均为无锁原子量）
+struct WorkerSlot
+{
+    std::atomic<int32_t> pid{0};             // worker进程ID，0表示未运行
+    std::atomic<uint32_t> restarts{0};       // 被重启的次数
+    std::atomic<int64_t> started_at{0};      // 启动时间（Unix时间戳，秒）
+    std::atomic<int64_t> heartbeat{0};       // 最近一次上报状态的时间（Unix时间戳，秒）
+    std::atomic<uint64_t> requests{0};       // 已接收的请求总数
+    std::atomic<uint64_t> open_connections{0};
+    std::atomic<uint64_t> queued{0};         // 各执行器中排队的请求数
+    std::atomic<uint64_t> active{0};         // 各执行器中正在处理的请求数
+    std::atomic<uint64_t> rejected{0};       // 准入控制拒绝的请求数
+};
+
+// 多进程模式的supervisor
+// 在创建任何线程之前fork出N个worker，每个worker都以SO_REUSEPORT绑定同一端口，由内核在worker间分配连接；
+// supervisor负责重启异常退出或失去心跳的worker，并通过共享内存汇总各worker的状态
+class WorkerSupervisor
+{
+public:
+    // worker进程的入口，返回值作为worker的退出码
+    using WorkerMain = std::function<int(size_t index)>;
+
+    explicit WorkerSupervisor(size_t worker_count);
+    ~WorkerSupervisor();
+
+    // 禁用拷贝构造和赋值
+    WorkerSupervisor(const WorkerSupervisor &) = delete;
+    WorkerSupervisor &operator=(const WorkerSupervisor &) = delete;
+
+    // 启动并监控worker，直到收到SIGINT/SIGTERM后停止所有worker；只在supervisor进程中返回
+    int run(WorkerMain worker_main);
+
+    // 当前worker进程的槽位（在supervisor进程中返回nullptr）
+    WorkerSlot *current_slot() const;
+
+    // 当前worker进程的序号
+    size_t current_index() const { return current_index_; }
+
+    size_t get_worker_count() const { return worker_count_; }
+
+    // 汇总所有worker的状态
+    nlohmann::json get_status() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    // fork一个worker进程
+    bool spawn(size_t index);
+
+    // 回收已退出的worker并安排重启
+    void reap_workers();
+
+    // 杀掉长时间没有心跳的worker（随后按退出处理并重启）
+    void check_heartbeats();
+
+    // 向所有worker发送SIGTERM，超时后SIGKILL
+    void stop_workers();
+
+    size_t worker_count_;
+    WorkerSlot *slots_;                              // 共享内存（MAP_SHARED）
+    pid_t supervisor_pid_;
+    size_t current_index_;                           // worker进程中为自身序号
+    bool is_worker_;
+
+    WorkerMain worker_main_;
+    std::vector<Clock::time_point> restart_at_;      // 计划重启的时间
+    std::vector<int> backoff_seconds_;               // 连续快速崩溃时的重启间隔（指数退避）
+
+    int heartbeat_timeout_seconds_;                  // 心跳超时时间
+    int min_uptime_seconds_;                         // 运行时间低于该值的退出视为启动失败，重启间隔加倍
+    int max_backoff_seconds_;
+    int shutdown_timeout_seconds_;                   // 停止时等待worker退出的时间
+};
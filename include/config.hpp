@@ -40,6 +40,33 @@ namespace config
     extern const int TEXT_ANALYSIS_TIMEOUT;
     extern const int FILE_ANALYSIS_TIMEOUT;
 
+    // 上游并发（每个模型后端的自适应并发上限）
+    extern const int UPSTREAM_INITIAL_CONCURRENCY;
+    extern const int UPSTREAM_MIN_CONCURRENCY;
+    extern const int UPSTREAM_MAX_CONCURRENCY;
+    extern const int UPSTREAM_MAX_QUEUE;
+    extern const int UPSTREAM_MAX_HOST_CONNECTIONS;
+    extern const int UPSTREAM_IDLE_CONNECTIONS_PER_HOST;
+
+    // 模型后端池（BASE_URL可以是逗号分隔的多个副本地址）
+    extern const int BACKEND_HEALTH_CHECK_INTERVAL_MS;
+    extern const int BACKEND_HEALTH_CHECK_TIMEOUT;
+    extern const int BACKEND_EJECT_AFTER_FAILURES;
+    extern const int BACKEND_BASE_EJECTION_SECONDS;
+    extern const int BACKEND_MAX_EJECTION_SECONDS;
+    extern const int BACKEND_WARMUP_CONNECTIONS;
+
+    // 请求对冲（有多个副本时，慢请求在另一个副本上重发，先返回的结果生效）
+    extern const double UPSTREAM_HEDGE_PERCENTILE;
+    extern const double UPSTREAM_HEDGE_BUDGET;
+    extern const int UPSTREAM_HEDGE_MIN_DELAY_MS;
+
+    // 分析结果缓存（按媒体内容、提示词、模型和参数寻址）
+    extern const size_t RESULT_CACHE_MEMORY_ENTRIES;
+    extern const std::string RESULT_CACHE_DIR;
+    extern const size_t RESULT_CACHE_DISK_MAX_ENTRIES;
+    extern const int RESULT_CACHE_TTL_SECONDS;
+
     // 文件扩展名
     extern const std::vector<std::string> IMAGE_EXTENSIONS;
     extern const std::vector<std::string> VIDEO_EXTENSIONS;
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <filesystem>
 #include <fstream>
@@ -52,14 +53,21 @@ namespace utils {
                                              int max_files = 5);
     
     // Base64编码
+    size_t base64_encoded_size(size_t size);
+    char* base64_encode_to(const unsigned char* data, size_t size, char* out); // out需有base64_encoded_size(size)字节，返回写入的末尾
     std::string base64_encode(const std::vector<unsigned char>& data);
     std::string base64_encode_chunked(const std::vector<unsigned char>& data);
+    std::string base64_encode_chunked(const unsigned char* data, size_t size);
     std::string base64_encode_file(const std::string& file_path);
+    std::string base64_encode_image_data(std::string_view data); // 内存中的图片数据，较大时先压缩
     std::vector<unsigned char> base64_decode(const std::string& encoded_string);
     
     // 图像处理
     std::vector<unsigned char> encode_image_to_jpeg(const cv::Mat& image, int quality = 85);
     cv::Mat resize_image(const cv::Mat& image, int max_size = 800);
+    std::vector<unsigned char> load_image_for_request(const std::string& file_path); // 发送给模型的图片数据，较大时缩小并重新编码为JPEG
+    std::vector<unsigned char> prepare_image_for_request(std::string_view data);     // 同上，内存中的图片数据
+    bool optimize_image_for_ollama(std::vector<unsigned char>& image_data, bool keep_png); // 按Ollama的要求缩小并重新编码，失败时保留原数据
     std::string optimize_image_for_ollama(const std::string& base64_data, const std::string& image_url);
     
     // JSON工具
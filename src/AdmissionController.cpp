@@ -0,0 +1,230 @@
+#include "AdmissionController.hpp"
+#include "TaskManager.hpp"
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+
+AdmissionController::AdmissionController()
+    : last_eviction_(Clock::now()), task_rate_(0.0), last_task_completed_(0), last_task_sample_(Clock::now()),
+      admitted_(0), rejected_(0), max_retry_after_(120)
+{
+}
+
+void AdmissionController::set_policy(const std::string &executor_name, const AdmissionPolicy &policy)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    policies_[executor_name] = policy;
+}
+
+int AdmissionController::to_retry_after(double seconds) const
+{
+    if (!(seconds > 1.0))
+        return 1;
+    return static_cast<int>(std::min<double>(std::ceil(seconds), max_retry_after_));
+}
+
+AdmissionDecision AdmissionController::admit(const RouteExecutor &executor, const std::string &client)
+{
+    AdmissionDecision decision;
+    Clock::time_point now = Clock::now();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto policy_it = policies_.find(executor.get_name());
+    if (policy_it == policies_.end())
+    {
+        admitted_++;
+        return decision;
+    }
+    const AdmissionPolicy &policy = policy_it->second;
+
+    // 1. 服务过载检查放在令牌消耗之前，被拒绝的请求不占用客户端配额
+    if (policy.max_queue_wait_seconds > 0.0)
+    {
+        double wait = executor.estimate_queue_wait();
+        if (wait > policy.max_queue_wait_seconds)
+        {
+            // 预计等待时间回落到阈值以内所需的时间
+            decision.admitted = false;
+            decision.status_code = 503;
+            decision.reason = "queue_wait";
+            decision.retry_after = to_retry_after(wait - policy.max_queue_wait_seconds);
+        }
+    }
+
+    if (decision.admitted && policy.max_in_flight_tasks > 0)
+    {
+        TaskManager &task_manager = TaskManager::getInstance();
+        sample_task_rate(now);
+
+        size_t in_flight = executor.get_active_count() + task_manager.getPendingTaskCount() + task_manager.getActiveThreadCount() +
+                           task_manager.getAwaitingTaskCount();
+        if (in_flight >= policy.max_in_flight_tasks)
+        {
+            // 按当前处理速率估算积压降到上限以下所需的时间，速率未知时按执行器速率估算
+            double rate = task_rate_ > 0.0 ? task_rate_ : executor.get_drain_rate();
+            double excess = static_cast<double>(in_flight - policy.max_in_flight_tasks + 1);
+
+            decision.admitted = false;
+            decision.status_code = 503;
+            decision.reason = "in_flight";
+            decision.retry_after = rate > 0.0 ? to_retry_after(excess / rate) : 5;
+        }
+    }
+
+    // 2. 客户端令牌桶
+    if (decision.admitted && policy.client_rate > 0.0 && !client.empty())
+    {
+        double wait = take_token(executor.get_name() + "|" + client, policy, now);
+        if (wait > 0.0)
+        {
+            decision.admitted = false;
+            decision.status_code = 429;
+            decision.reason = "rate_limited";
+            decision.retry_after = to_retry_after(wait);
+        }
+    }
+
+    evict_idle_buckets(now);
+
+    if (decision.admitted)
+    {
+        admitted_++;
+    }
+    else
+    {
+        record_rejection(executor.get_name(), decision.reason);
+    }
+    return decision;
+}
+
+AdmissionDecision AdmissionController::reject_queue_full(const RouteExecutor &executor, const std::string &client)
+{
+    AdmissionDecision decision;
+    decision.admitted = false;
+    decision.status_code = 503;
+    decision.reason = "queue_full";
+
+    // 队列满时按处理速率估算腾出空间所需的时间
+    double rate = executor.get_drain_rate();
+    decision.retry_after = rate > 0.0 ? to_retry_after(executor.get_queue_size() / rate) : 5;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    admitted_--;
+    record_rejection(executor.get_name(), decision.reason);
+
+    // 请求没有进入队列，不计入客户端的请求速率，否则客户端重试时会被误判为超限
+    auto policy_it = policies_.find(executor.get_name());
+    if (policy_it != policies_.end() && policy_it->second.client_rate > 0.0 && !client.empty())
+    {
+        refund_token(executor.get_name() + "|" + client, policy_it->second);
+    }
+    return decision;
+}
+
+double AdmissionController::take_token(const std::string &key, const AdmissionPolicy &policy, Clock::time_point now)
+{
+    double burst = std::max(1.0, policy.client_burst);
+
+    auto it = buckets_.find(key);
+    if (it == buckets_.end())
+    {
+        TokenBucket bucket;
+        bucket.tokens = burst;
+        bucket.last_refill = now;
+        it = buckets_.emplace(key, bucket).first;
+    }
+
+    TokenBucket &bucket = it->second;
+    double elapsed = std::chrono::duration<double>(now - bucket.last_refill).count();
+    bucket.tokens = std::min(burst, bucket.tokens + elapsed * policy.client_rate);
+    bucket.last_refill = now;
+
+    if (bucket.tokens >= 1.0)
+    {
+        bucket.tokens -= 1.0;
+        return 0.0;
+    }
+    return (1.0 - bucket.tokens) / policy.client_rate;
+}
+
+void AdmissionController::refund_token(const std::string &key, const AdmissionPolicy &policy)
+{
+    auto it = buckets_.find(key);
+    if (it != buckets_.end())
+    {
+        it->second.tokens = std::min(std::max(1.0, policy.client_burst), it->second.tokens + 1.0);
+    }
+}
+
+void AdmissionController::sample_task_rate(Clock::time_point now)
+{
+    double elapsed = std::chrono::duration<double>(now - last_task_sample_).count();
+    if (elapsed < 1.0)
+        return;
+
+    // 距上次采样过久（期间可能空闲）时只重置采样点，避免空闲时间拉低速率
+    size_t completed = TaskManager::getInstance().getCompletedTaskCount();
+    if (elapsed < 10.0)
+    {
+        double rate = (completed - last_task_completed_) / elapsed;
+        task_rate_ = task_rate_ > 0.0 ? task_rate_ * 0.7 + rate * 0.3 : rate;
+    }
+
+    last_task_completed_ = completed;
+    last_task_sample_ = now;
+}
+
+void AdmissionController::evict_idle_buckets(Clock::time_point now)
+{
+    if (now - last_eviction_ < std::chrono::seconds(60))
+        return;
+    last_eviction_ = now;
+
+    // 闲置超过10分钟的令牌桶早已回满，删除后再次访问时重建即可
+    for (auto it = buckets_.begin(); it != buckets_.end();)
+    {
+        if (now - it->second.last_refill > std::chrono::minutes(10))
+            it = buckets_.erase(it);
+        else
+            ++it;
+    }
+}
+
+void AdmissionController::record_rejection(const std::string &executor_name, const std::string &reason)
+{
+    rejections_[executor_name][reason]++;
+    rejected_++;
+}
+
+nlohmann::json AdmissionController::get_stats()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    nlohmann::json rejections = nlohmann::json::object();
+    for (const auto &executor : rejections_)
+    {
+        for (const auto &reason : executor.second)
+        {
+            rejections[executor.first][reason.first] = reason.second;
+        }
+    }
+
+    nlohmann::json policies = nlohmann::json::object();
+    for (const auto &item : policies_)
+    {
+        policies[item.first] = {
+            {"max_queue_wait_seconds", item.second.max_queue_wait_seconds},
+            {"max_in_flight_tasks", item.second.max_in_flight_tasks},
+            {"client_rate", item.second.client_rate},
+            {"client_burst", item.second.client_burst}};
+    }
+
+    return {
+        {"admitted", admitted_.load()},
+        {"rejected", rejected_.load()},
+        {"rejections", rejections},
+        {"task_rate", task_rate_},
+        {"tracked_clients", buckets_.size()},
+        {"policies", policies}};
+}
@@ -3,7 +3,18 @@
 #include "utils.hpp"
 #include "ConfigManager.hpp"
 #include "RefreshTokenStore.hpp"
+#include "ConcurrencyLimiter.hpp"
+#include "BackendPool.hpp"
+#include "HedgePolicy.hpp"
+#include "ResultCache.hpp"
+#include "CurlShare.hpp"
 #include "ExcelProcessor.hpp"
+#include "JobManager.hpp"
+#include "Logger.hpp"
+#include "CurlMultiClient.hpp"
+#include "Tracer.hpp"
+#include "MultipartParser.hpp"
+#include "UploadSpooler.hpp"
 #include <cstdlib>
 #include <iostream>
 #include <fstream>
@@ -14,9 +25,17 @@
 
 // HTTP服务器简单实现（基于socket）
 #include <sys/socket.h>
+#include <sys/epoll.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <unistd.h>
 #include <arpa/inet.h>
+#include <cerrno>
+#include <cctype>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 // 从main.cpp中提取的提示词函数
 // https://www.json.cn/jsonzip/ 压缩并转义 的在线工具
@@ -330,7 +349,12 @@ std::string get_video_prompt()
 }
 
 ApiServer::ApiServer(const std::string &api_key, int port, const std::string &host)
-    : api_key_(api_key), port_(port), host_(host), server_running_(false), max_concurrent_requests_(30)
+    : api_key_(api_key), port_(port), host_(host), max_concurrent_requests_(256),
+      max_request_body_size_(16 * 1024 * 1024), listen_fd_(-1), io_thread_count_(1), next_loop_index_(0), open_connections_(0), stopped_(false),
+      keep_alive_timeout_seconds_(75), request_timeout_seconds_(30), write_timeout_seconds_(60),
+      max_requests_per_connection_(1000), max_pipeline_depth_(16), stream_buffer_limit_(1024 * 1024), aborted_streams_(0),
+      reused_requests_(0), total_requests_(0),
+      compression_min_size_(1024), compressed_responses_(0), compression_input_bytes_(0), compression_output_bytes_(0), require_auth_(false), supervisor_(nullptr)
 {
     // 初始化分析器
     analyzer_ = std::make_unique<DoubaoMediaAnalyzer>(api_key);
@@ -338,38 +362,82 @@ ApiServer::ApiServer(const std::string &api_key, int port, const std::string &ho
     // 初始化任务管理器（使用16个工作线程）调用大模型需要传递 api_key
     TaskManager::getInstance().initialize(16, api_key);
 
-    // 初始化并发请求处理
-    server_running_ = true;
-
     // 创建请求处理工作线程
     size_t num_threads = std::thread::hardware_concurrency();
     if (num_threads == 0)
         num_threads = 8; // 默认使用8个线程
 
-    std::cout << "🚀 初始化API服务器并发处理，使用 " << num_threads << " 个工作线程" << std::endl;
-
-    for (size_t i = 0; i < num_threads; ++i)
+    std::cout << "🚀 初始化API服务器并发处理，分析请求使用 " << num_threads << " 个工作线程" << std::endl;
+
+    // I/O线程只做非阻塞读写，少量线程即可承载大量连接
+    io_thread_count_ = std::max<size_t>(1, std::min<size_t>(4, num_threads / 4));
+
+    // 按路由划分执行器：分析请求可能持续数分钟，不能让状态和查询请求排在它们后面
+    control_executor_ = std::make_unique<RouteExecutor>("control", 2, 256);
+    query_executor_ = std::make_unique<RouteExecutor>("query", 4, 128);
+    analysis_executor_ = std::make_unique<RouteExecutor>("analysis", num_threads, max_concurrent_requests_);
+
+    // 准入策略：按预计排队时间和在途任务量拒绝，而不是固定的排队数；
+    // 分析请求的排队时间上限留出处理时间，避免请求在nginx超时（60秒）后才开始执行
+    AdmissionPolicy control_policy;
+    control_policy.max_queue_wait_seconds = 1.0;
+    control_policy.client_rate = 50.0;
+    control_policy.client_burst = 100.0;
+    admission_.set_policy(control_executor_->get_name(), control_policy);
+
+    AdmissionPolicy query_policy;
+    query_policy.max_queue_wait_seconds = 3.0;
+    query_policy.client_rate = 20.0;
+    query_policy.client_burst = 40.0;
+    admission_.set_policy(query_executor_->get_name(), query_policy);
+
+    AdmissionPolicy analysis_policy;
+    analysis_policy.max_queue_wait_seconds = 20.0;
+    analysis_policy.max_in_flight_tasks = num_threads + 16 * 8;
+    analysis_policy.client_rate = 2.0;
+    analysis_policy.client_burst = 20.0;
+    admission_.set_policy(analysis_executor_->get_name(), analysis_policy);
+
+    // 上传接口：请求体最大512MB，超过8MB的边接收边写入临时文件，不在内存中累积
+    auto upload_policy = std::make_shared<UploadPolicy>();
+    upload_policy->path = "/api/upload";
+    upload_policy->max_body_size = 512 * 1024 * 1024;
+    upload_policy->spool_threshold = 8 * 1024 * 1024;
+    upload_policy->spool_dir = "/tmp";
+    upload_policy->spool_window = 8 * 1024 * 1024;
+    upload_policy_ = upload_policy;
+
+    const char *auth_env = std::getenv("API_REQUIRE_AUTH");
+    require_auth_ = auth_env && std::string(auth_env) == "1";
+
+    // 管理员账号（优先使用 config/db_config.json 中的 auth），登录时不再重复读取配置文件
+    ConfigManager cfg;
+    cfg.load_config();
+    auth_config_ = cfg.get_auth_config();
+
+    for (RouteExecutor *executor : {control_executor_.get(), query_executor_.get(), analysis_executor_.get()})
     {
-        worker_threads_.emplace_back(&ApiServer::request_worker_thread, this);
+        request_histograms_[executor] = &Metrics::getInstance().histogram(
+            "doubao_http_request_duration_seconds", "HTTP请求处理耗时（秒，不含排队）", {{"executor", executor->get_name()}});
     }
+
+    register_routes();
 }
 
 ApiServer::~ApiServer()
 {
     stop();
 
-    // 停止并发请求处理
-    server_running_ = false;
-    queue_condition_.notify_all();
+    // 停止并发请求处理，等待所有工作线程结束
+    control_executor_->shutdown();
+    query_executor_->shutdown();
+    analysis_executor_->shutdown();
 
-    // 等待所有工作线程结束
-    for (auto &thread : worker_threads_)
-    {
-        if (thread.joinable())
-        {
-            thread.join();
-        }
-    }
+    // 写出尚未完成的refresh token撤销（使用analyzer_的数据库连接池，需在其析构之前）
+    RefreshTokenStore::getInstance().shutdown();
+
+    // 写出尚未完成的结果缓存文件
+    ResultCache::getInstance().shutdown();
 
     std::cout << "🛑 所有API服务器工作线程已停止" << std::endl;
 }
@@ -384,6 +452,9 @@ bool ApiServer::initialize()
         return true;
     }
 
+    // 预热到模型后端的连接（后台完成，不阻塞启动）
+    analyzer_->warm_up_backends();
+
     // 测试API连接
     // if (!analyzer_->test_connection())
     // {
@@ -398,26 +469,28 @@ bool ApiServer::initialize()
         return false;
     }
 
+    // refresh token与分析结果共用同一个连接池
+    RefreshTokenStore::getInstance().attach_database(analyzer_->get_database_manager());
+
     std::cout << "✅ API服务器初始化成功" << std::endl;
     return true;
 }
 
 void ApiServer::start()
 {
-    int server_fd;
     struct sockaddr_in address;
     int opt = 1;
-    int addrlen = sizeof(address);
 
-    // 创建socket
-    if ((server_fd = socket(AF_INET, SOCK_STREAM, 0)) == 0)
+    // 创建非阻塞监听socket
+    if ((listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) < 0)
     {
         std::cerr << "❌ socket创建失败: " << strerror(errno) << std::endl;
         return;
     }
 
     // 设置socket选项
-    if (setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR | SO_REUSEPORT, &opt, sizeof(opt)))
+    if (setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) ||
+        setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)))
     {
         std::cerr << "❌ setsockopt失败: " << strerror(errno) << std::endl;
         return;
@@ -428,19 +501,53 @@ void ApiServer::start()
     address.sin_port = htons(port_);
 
     // 绑定socket
-    if (bind(server_fd, (struct sockaddr *)&address, sizeof(address)) < 0)
+    if (bind(listen_fd_, (struct sockaddr *)&address, sizeof(address)) < 0)
     {
         std::cerr << "❌ 绑定失败: " << strerror(errno) << std::endl;
         return;
     }
 
     // 监听连接
-    if (listen(server_fd, 128) < 0) // 增加监听队列大小
+    if (listen(listen_fd_, SOMAXCONN) < 0) // 增加监听队列大小
     {
         std::cerr << "❌ 监听失败: " << strerror(errno) << std::endl;
         return;
     }
 
+    // 创建I/O事件循环，第0个循环同时负责接收新连接
+    for (size_t i = 0; i < io_thread_count_; ++i)
+    {
+        auto loop = std::make_unique<EventLoop>();
+        if (!loop->is_valid())
+        {
+            std::cerr << "❌ 创建I/O事件循环失败" << std::endl;
+            return;
+        }
+        io_loops_.push_back(std::move(loop));
+    }
+    io_connections_.resize(io_loops_.size());
+
+    // 每个I/O循环每秒扫描一次自己的连接，处理空闲/慢请求超时
+    for (size_t i = 0; i < io_loops_.size(); ++i)
+    {
+        io_loops_[i]->run_every(1000, [this, i]()
+                                { sweep_connections(i); });
+    }
+
+    // 多进程模式下每秒上报一次状态，supervisor据此判断worker是否存活
+    if (supervisor_)
+    {
+        report_worker_status();
+        io_loops_[0]->run_every(1000, [this]()
+                                { report_worker_status(); });
+    }
+
+    if (!io_loops_[0]->add(listen_fd_, EPOLLIN, [this](uint32_t)
+                           { on_accept(); }))
+    {
+        return;
+    }
+
     std::cout << "🚀 API服务器已启动，监听地址: " << host_ << ":" << port_ << std::endl;
     std::cout << "📋 可用的API路由:" << std::endl;
     std::cout << "   - POST /api/auth : 获取JWT令牌" << std::endl;
@@ -449,745 +556,1727 @@ void ApiServer::start()
     std::cout << "   - POST /api/analyze : 分析图片、视频、文本、文件或音频" << std::endl;
     std::cout << "   - POST /api/batch_analyze : 批量分析图片或视频" << std::endl;
     std::cout << "   - POST /api/excel_analyze : 分析Excel文件中的媒体URL" << std::endl;
+    std::cout << "   - POST /api/upload : 直接上传图片或视频分析（multipart/form-data 或原始字节）" << std::endl;
 
     std::cout << "   - POST /api/query : 查询已分析的结果" << std::endl;
     std::cout << "   - GET /api/status : 获取服务器状态" << std::endl;
-    std::cout << "🔄 服务器已启用并发处理，最大并发连接数: " << max_concurrent_requests_ << std::endl;
+    std::cout << "   - GET /metrics : Prometheus格式的指标（各阶段耗时直方图、队列深度）" << std::endl;
+    std::cout << "   - GET /api/debug/traces : 导出请求跟踪（Chrome trace-event JSON，请求加 ?trace=1 开启跟踪）" << std::endl;
+    std::cout << "   - GET /api/jobs/{id} : 查询异步作业进度和结果（分析接口传入 \"async\": true 时返回作业ID）" << std::endl;
+    std::cout << "   - POST /api/jobs/{id}/cancel : 取消异步作业" << std::endl;
+    std::cout << "🔄 服务器已启用epoll事件驱动，I/O线程数: " << io_loops_.size()
+              << "，分析请求排队上限: " << max_concurrent_requests_ << "（按排队时间自适应准入）" << std::endl;
+
+    // 其余I/O循环运行在独立线程中
+    for (size_t i = 1; i < io_loops_.size(); ++i)
+    {
+        EventLoop *loop = io_loops_[i].get();
+        io_threads_.emplace_back([loop]()
+                                 { loop->run(); });
+    }
 
-    // 主循环，接受连接
-    while (true)
+    // 主线程运行第0个事件循环（接收连接 + 部分连接的I/O）
+    io_loops_[0]->run();
+}
+
+void ApiServer::stop()
+{
+    if (stopped_.exchange(true))
+        return;
+
+    // 停止所有I/O事件循环
+    for (auto &loop : io_loops_)
     {
-        int new_socket;
-        if ((new_socket = accept(server_fd, (struct sockaddr *)&address, (socklen_t *)&addrlen)) < 0)
+        loop->stop();
+    }
+
+    for (auto &thread : io_threads_)
+    {
+        if (thread.joinable() && thread.get_id() != std::this_thread::get_id())
         {
-            std::cerr << "❌ 接受连接失败: " << strerror(errno) << std::endl;
-            continue;
+            thread.join();
         }
+    }
 
-        std::cout << "✅ 接受新连接，socket: " << new_socket << std::endl;
-
-        // 检查当前并发请求数是否超过限制
-        {
-            std::unique_lock<std::mutex> lock(queue_mutex_);
-            if (request_queue_.size() >= max_concurrent_requests_)
-            {
-                std::cerr << "⚠️ 服务器繁忙，并发请求数已达上限: " << max_concurrent_requests_ << std::endl;
+    if (listen_fd_ >= 0)
+    {
+        close(listen_fd_);
+        listen_fd_ = -1;
+    }
 
-                // 发送服务器繁忙响应
-                std::string busy_response = "HTTP/1.1 503 Service Unavailable\r\n";
-                busy_response += "Content-Type: application/json\r\n";
-                busy_response += "Content-Length: 85\r\n";
-                busy_response += "\r\n";
-                busy_response += "{\"success\":false,\"message\":\"服务器繁忙，请稍后再试\",\"error\":\"Service Unavailable\"}";
+    std::cout << "🛑 API服务器已停止" << std::endl;
+}
 
-                send(new_socket, busy_response.c_str(), busy_response.length(), 0);
-                close(new_socket);
+// 接收新连接（运行在第0个I/O循环中），并按轮询方式分配给各I/O循环
+void ApiServer::on_accept()
+{
+    while (true)
+    {
+        struct sockaddr_in client_addr;
+        socklen_t addrlen = sizeof(client_addr);
+        int client_fd = accept4(listen_fd_, (struct sockaddr *)&client_addr, &addrlen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (client_fd < 0)
+        {
+            if (errno == EINTR)
                 continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+            {
+                std::cerr << "❌ 接受连接失败: " << strerror(errno) << std::endl;
             }
+            break;
         }
 
-        // 将连接处理任务添加到队列
-        {
-            std::unique_lock<std::mutex> lock(queue_mutex_);
-            request_queue_.push([this, new_socket]()
-                                { handle_connection(new_socket); });
-        }
+        int opt = 1;
+        setsockopt(client_fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
 
-        // 通知工作线程有新请求
-        queue_condition_.notify_one();
+        char ip[INET_ADDRSTRLEN] = {0};
+        inet_ntop(AF_INET, &client_addr.sin_addr, ip, sizeof(ip));
+        std::string peer = std::string(ip) + ":" + std::to_string(ntohs(client_addr.sin_port));
 
-        // 请求处理已移至handle_connection函数，由工作线程并发处理
+        size_t loop_index = next_loop_index_++ % io_loops_.size();
+        io_loops_[loop_index]->post([this, loop_index, client_fd, peer]()
+                                    { register_connection(loop_index, client_fd, peer); });
     }
 }
 
-void ApiServer::stop()
+void ApiServer::register_connection(size_t loop_index, int client_fd, const std::string &peer)
 {
-    std::cout << "🛑 API服务器已停止" << std::endl;
+    EventLoop *loop = io_loops_[loop_index].get();
+
+    auto conn = std::make_shared<HttpConnection>();
+    conn->fd = client_fd;
+    conn->loop = loop;
+    conn->loop_index = loop_index;
+    conn->peer = peer;
+    conn->parser.set_max_body_size(max_request_body_size_);
+    conn->parser.set_upload_policy(upload_policy_);
+
+    // 上传请求体的后台写入追上、完成或失败时回到I/O线程继续解析（弱引用，避免连接与解析器互相持有）
+    std::weak_ptr<HttpConnection> weak_conn = conn;
+    conn->parser.set_spool_notify([this, loop, weak_conn]()
+                                  { loop->post([this, weak_conn]()
+                                               {
+                                                   HttpConnectionPtr conn = weak_conn.lock();
+                                                   if (!conn || conn->closed)
+                                                       return;
+                                                   conn->last_active = std::chrono::steady_clock::now();
+                                                   dispatch_requests(conn);
+                                                   if (!conn->closed)
+                                                       flush_write_buffer(conn);
+                                               }); });
+
+    // 回调持有连接对象，连接关闭时随回调一起释放
+    if (!loop->add(client_fd, EPOLLIN | EPOLLRDHUP, [this, conn](uint32_t events)
+                   { on_connection_event(conn, events); }))
+    {
+        close(client_fd);
+        return;
+    }
+
+    io_connections_[loop_index][client_fd] = conn;
+    open_connections_++;
 }
 
-void ApiServer::request_worker_thread()
+void ApiServer::on_connection_event(const HttpConnectionPtr &conn, uint32_t events)
 {
-    while (server_running_)
-    {
-        std::function<void()> request_handler;
+    if (conn->closed)
+        return;
 
-        {
-            std::unique_lock<std::mutex> lock(queue_mutex_);
-            queue_condition_.wait(lock, [this]
-                                  { return !server_running_ || !request_queue_.empty(); });
+    if (events & (EPOLLERR | EPOLLHUP))
+    {
+        close_connection(conn);
+        return;
+    }
 
-            if (!server_running_)
-                break;
+    if (events & (EPOLLIN | EPOLLRDHUP))
+    {
+        handle_readable(conn);
+        if (conn->closed)
+            return;
+    }
 
-            if (request_queue_.empty())
-                continue;
+    if (events & EPOLLOUT)
+    {
+        flush_write_buffer(conn);
+    }
+}
 
-            request_handler = std::move(request_queue_.front());
-            request_queue_.pop();
-        }
+void ApiServer::handle_readable(const HttpConnectionPtr &conn)
+{
+    // 空闲连接上收到的第一个字节开始计算请求接收超时
+    bool idle = conn->read_buffer.empty() && !conn->parser.in_progress();
 
-        // 执行请求处理
-        try
+    char buffer[16384];
+    while (true)
+    {
+        ssize_t n = recv(conn->fd, buffer, sizeof(buffer), 0);
+        if (n > 0)
         {
-            request_handler();
+            conn->read_buffer.append(buffer, n);
+            // 超过单个请求的上限后不再继续读取，交给解析器报告413/431；
+            // 上传的请求体正在写入临时文件时，每读取1MB交给后台写入一次，读缓冲区不随上传大小增长
+            if (conn->read_buffer.size() > (conn->parser.spooling() ? 1024 * 1024 : max_request_body_size_ + 64 * 1024))
+                break;
+            continue;
         }
-        catch (const std::exception &e)
+        if (n == 0)
         {
-            std::cerr << "❌ 请求处理异常: " << e.what() << std::endl;
+            // 对端关闭了写方向，已收到的请求仍然需要响应
+            conn->read_shutdown = true;
+            break;
         }
+        if (errno == EINTR)
+            continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+            break;
+
+        close_connection(conn);
+        return;
     }
+
+    conn->last_active = std::chrono::steady_clock::now();
+    if (idle && !conn->read_buffer.empty())
+        conn->request_start = conn->last_active;
+
+    dispatch_requests(conn);
+
+    if (conn->closed)
+        return;
+
+    // 发送已就绪的响应，并在对端已关闭且没有待处理请求时关闭连接
+    flush_write_buffer(conn);
 }
 
-void ApiServer::handle_connection(int client_socket)
+// 从查询字符串中读取参数值（不做URL解码，仅用于数字等简单参数）
+static std::string get_query_param(std::string_view query, std::string_view name)
 {
-    try
+    while (!query.empty())
     {
-        // 读取请求
-        char buffer[4096] = {0};
-        int valread = read(client_socket, buffer, 4096);
-        if (valread <= 0)
+        size_t amp = query.find('&');
+        std::string_view pair = query.substr(0, amp);
+        size_t eq = pair.find('=');
+        if (pair.substr(0, eq) == name)
         {
-            close(client_socket);
-            return;
+            return eq == std::string_view::npos ? std::string() : std::string(pair.substr(eq + 1));
         }
+        if (amp == std::string_view::npos)
+            break;
+        query.remove_prefix(amp + 1);
+    }
+    return std::string();
+}
 
-        std::string request(buffer);
-        std::cout << "📥 收到请求: " << request << std::endl;
+// 客户端标识：经nginx转发（对端为本机）时使用X-Real-IP，否则使用对端IP
+static std::string get_client_address(const HttpConnectionPtr &conn, const HttpRequest &request)
+{
+    std::string ip = conn->peer.substr(0, conn->peer.rfind(':'));
+    if (ip == "127.0.0.1" || ip == "::1")
+    {
+        std::string_view real_ip = request.header("X-Real-IP");
+        if (!real_ip.empty())
+            return std::string(real_ip);
+    }
+    return ip;
+}
 
-        // 提取请求体
-        std::string request_body;
-        std::string request_path = "/"; // 默认路径
+void ApiServer::dispatch_requests(const HttpConnectionPtr &conn)
+{
+    // 流水线请求并发处理，但同一连接上同时处理的请求数有上限，超出的请求留在读缓冲区中
+    while (!conn->closed && !conn->draining && conn->pending.size() < max_pipeline_depth_)
+    {
+        HttpRequestPtr request;
+        HttpRequestParser::Status status = conn->parser.parse(conn->read_buffer, request);
+
+        if (status == HttpRequestParser::Status::Error)
+        {
+            LOG_RATE_LIMITED(LogLevel::Warn, 10, "⚠️ 请求解析失败", {{"peer", conn->peer}, {"error", conn->parser.error_message()}});
+
+            // 格式错误后无法确定下一个请求的边界，排在已派发请求之后回复错误并关闭连接
+            ApiResponse error_response;
+            error_response.message = conn->parser.error_message();
+            error_response.error = "Bad request";
+            conn->read_buffer.clear();
+            conn->draining = true;
+
+            uint64_t sequence = conn->pending_base + conn->pending.size();
+            conn->pending.emplace_back();
+            append_response(conn, sequence, build_http_response(error_response, conn->parser.error_status()), true, true);
+            // 放弃写了一半的上传临时文件
+            conn->parser.reset();
+            return;
+        }
 
-        // 提取请求路径
-        size_t path_start = request.find(" ");
-        if (path_start != std::string::npos)
+        if (status == HttpRequestParser::Status::Incomplete)
         {
-            size_t path_end = request.find(" ", path_start + 1);
-            if (path_end != std::string::npos)
+            // 客户端在发送请求体前等待 100 Continue（curl 对超过1KB的请求体默认如此）
+            // 100 Continue同样要按顺序发送，前面的请求都已响应后才能回复
+            if (conn->pending.empty() && conn->parser.take_expect_continue())
             {
-                request_path = request.substr(path_start + 1, path_end - path_start - 1);
+                queue_response(conn, std::string("HTTP/1.1 100 Continue\r\n\r\n"), false);
             }
+            return;
         }
-        size_t body_start = request.find("\r\n\r\n"); // 而不是被截断的版本
-        if (body_start != std::string::npos)
+
+        conn->requests_received++;
+        total_requests_++;
+        if (conn->requests_received > 1)
+            reused_requests_++;
+
+        // 缓冲区中剩余的数据属于下一个流水线请求
+        conn->request_start = std::chrono::steady_clock::now();
+
+        // 客户端要求关闭或达到单连接请求数上限时，这是该连接上的最后一个请求
+        bool keep_alive = request->keep_alive && conn->requests_received < max_requests_per_connection_;
+        if (!keep_alive)
         {
-            request_body = request.substr(body_start + 4);
+            conn->draining = true;
+            conn->read_buffer.clear();
         }
-        else
+
+        uint64_t sequence = conn->pending_base + conn->pending.size();
+        conn->pending.emplace_back();
+
+        // 按路由选择执行器（未知路径由轻量执行器直接返回错误），I/O线程不做任何阻塞操作
+        const ApiRoute *route = find_route(request->path);
+        RouteExecutor *executor = route ? route->executor : control_executor_.get();
+
+        // 准入控制在入队前完成，被拒绝的请求不占用执行器，连接保持可用
+        std::string client = get_client_address(conn, *request);
+        AdmissionDecision decision = admission_.admit(*executor, client);
+        if (decision.admitted &&
+            !executor->submit([this, conn, request, sequence, keep_alive]()
+                              { handle_request(conn, request, sequence, keep_alive); }))
         {
-            // 如果没有找到请求体分隔符，尝试查找Content-Length
-            size_t content_length_pos = request.find("Content-Length:");
-            if (content_length_pos != std::string::npos)
-            {
-                size_t colon_pos = request.find(":", content_length_pos);
-                size_t length_start = request.find_first_not_of(" ", colon_pos + 1);
-                size_t length_end = request.find("\r\n", length_start);
-                if (length_end != std::string::npos)
-                {
-                    std::string length_str = request.substr(length_start, length_end - length_start);
-                    int content_length = std::stoi(length_str);
-                    size_t body_pos = request.find("\r\n\r\n", length_end);
-                    if (body_pos != std::string::npos)
-                    {
-                        request_body = request.substr(body_pos + 4, content_length);
-                    }
-                }
-            }
+            decision = admission_.reject_queue_full(*executor, client);
         }
 
-        // 解析请求头并提取 Authorization（如果有）
-        std::string auth_header;
-        size_t headers_end = request.find("\r\n\r\n");
-        if (headers_end != std::string::npos)
+        if (!decision.admitted)
         {
-            std::string headers = request.substr(0, headers_end);
-            size_t auth_pos = headers.find("Authorization:");
-            if (auth_pos != std::string::npos)
-            {
-                // 修复Authorization头查找
-                size_t line_end = headers.find("\r\n", auth_pos);
-                if (line_end == std::string::npos)
-                    line_end = headers.length();
-                std::string line = headers.substr(auth_pos, line_end - auth_pos);
-                size_t colon = line.find(":");
-                if (colon != std::string::npos)
-                {
-                    auth_header = line.substr(colon + 1);
-                    // trim
-                    while (!auth_header.empty() && (auth_header.front() == ' ' || auth_header.front() == '	'))
-                        auth_header.erase(0, 1);
-                    while (!auth_header.empty() && (auth_header.back() == ' ' || auth_header.back() == ' ' || auth_header.back() == ' '))
-                        auth_header.pop_back();
-                }
-            }
+            reject_request(conn, sequence, keep_alive, decision);
         }
+    }
+}
+
+void ApiServer::reject_request(const HttpConnectionPtr &conn, uint64_t sequence, bool keep_alive, const AdmissionDecision &decision)
+{
+    // 过载时拒绝日志本身也会很多，限速输出
+    LOG_RATE_LIMITED(LogLevel::Warn, 10, "⚠️ 拒绝请求",
+                     {{"peer", conn->peer}, {"status", decision.status_code}, {"reason", decision.reason}, {"retry_after", decision.retry_after}});
+
+    ApiResponse busy_response;
+    busy_response.success = false;
+    if (decision.status_code == 429)
+    {
+        busy_response.message = "请求过于频繁，请稍后再试";
+        busy_response.error = "Too Many Requests";
+    }
+    else
+    {
+        busy_response.message = "服务器繁忙，请稍后再试";
+        busy_response.error = "Service Unavailable";
+    }
+    busy_response.data = {{"reason", decision.reason}, {"retry_after", decision.retry_after}};
+
+    std::string retry_header = "Retry-After: " + std::to_string(decision.retry_after) + "\r\n";
+    append_response(conn, sequence, build_http_response(busy_response, decision.status_code, keep_alive, retry_header), true, !keep_alive);
+}
+
+// 在工作线程中处理请求，处理完成后把响应交回连接所属的I/O循环发送
+void ApiServer::handle_request(const HttpConnectionPtr &conn, const HttpRequestPtr &request, uint64_t sequence, bool keep_alive)
+{
+    // 响应数据（完整响应或流式响应的各个chunk）都交回连接所属的I/O循环按顺序发送
+    auto sink = [this, conn, sequence, keep_alive](OutputBuffer data, bool finished)
+    {
+        conn->loop->post([this, conn, sequence, keep_alive, finished, data = std::move(data)]() mutable
+                         { deliver_response(conn, sequence, std::move(data), finished, finished && !keep_alive); });
+    };
+
+    // 按Accept-Encoding协商压缩方式，完整响应和流式响应都适用
+    ContentEncoding encoding = ResponseCompressor::negotiate(request->header("Accept-Encoding"));
+
+    // 流式响应的chunk登记在连接的背压状态中，放入连接缓冲区后释放；
+    // 客户端读取慢时写入方在flow_control中等待，不会在服务器内存中无限积压
+    auto stream_sink = [this, conn, sequence, keep_alive](OutputBuffer data, bool finished)
+    {
+        size_t size = data.size();
+        conn->loop->post([this, conn, sequence, keep_alive, finished, size, data = std::move(data)]() mutable
+                         {
+                             deliver_response(conn, sequence, std::move(data), finished, finished && !keep_alive);
+                             update_stream_buffer(conn, size); });
+    };
+    auto flow_control = [this, conn](size_t bytes, bool wait)
+    {
+        return reserve_stream_buffer(conn, bytes, wait);
+    };
+
+    // HTTP/1.0 不支持chunked编码，只能返回完整响应
+    ChunkedResponseWriter stream(stream_sink, keep_alive, encoding, flow_control);
+    ChunkedResponseWriter *stream_ptr = request->version == "HTTP/1.1" ? &stream : nullptr;
+
+    OutputBuffer http_response;
+
+    const ApiRoute *route = find_route(request->path);
+    ScopedTimer request_timer(*request_histograms_[route ? route->executor : control_executor_.get()]);
+
+    try
+    {
+        LOG_INFO("📥 收到请求",
+                 {{"method", request->method}, {"path", request->path}, {"peer", conn->peer}, {"bytes", request->body.size()}});
+        LOG_TRACE("📥 请求体", {{"body", Logger::truncate(request->body)}});
 
         // 解析请求并处理
-        ApiResponse response = process_request(request_body, request_path, auth_header);
+        ApiResponse response = process_request(request->body, request->path, request->header("Authorization"), request->query, stream_ptr, request.get());
 
-        // 构建完整响应JSON
-        nlohmann::json response_json_obj;
-        response_json_obj["success"] = response.success;
-        response_json_obj["message"] = response.message;
-        response_json_obj["data"] = response.data;
-        response_json_obj["response_time"] = response.response_time;
-        if (!response.error.empty())
+        // 已经以流式方式输出，只需结束chunked响应
+        if (stream.started())
         {
-            response_json_obj["error"] = response.error;
+            stream.finish();
+            return;
         }
 
-        // 发送响应
-        std::string response_json = response_json_obj.dump();
-
-        // 构建HTTP响应（若未经授权则返回401）
-        std::string http_response;
-        if (response.error == "Unauthorized")
-            http_response = "HTTP/1.1 401 Unauthorized\r\n"; // 确保有完整的\r\n
+        // 非JSON接口直接返回路由生成的响应体
+        if (response.content_type)
+            http_response = build_http_body_response(std::move(response.body), response.content_type, 200, keep_alive, "", encoding);
         else
-            http_response = "HTTP/1.1 200 OK\r\n";
-        http_response += "Content-Type: application/json\r\n";
-        http_response += "Content-Length: " + std::to_string(response_json.length()) + "\r\n";
-        http_response += "\r\n";
-        http_response += response_json;
+            http_response = build_http_response(response, 0, keep_alive, "", encoding);
+    }
+    catch (const std::exception &e)
+    {
+        LOG_ERROR("❌ 处理连接异常", {{"peer", conn->peer}, {"path", request->path}, {"error", e.what()}});
+
+        ApiResponse response;
+        response.message = "处理请求时发生异常: " + std::string(e.what());
+        response.error = "Request processing error";
 
-        send(client_socket, http_response.c_str(), http_response.length(), 0);
-        std::cout << "📤 发送响应: " << response_json << std::endl;
+        // 响应头已发出时只能在流中输出错误行
+        if (stream.started())
+        {
+            stream.write_line({{"type", "error"}, {"success", false}, {"message", response.message}, {"error", response.error}});
+            stream.finish();
+            return;
+        }
 
-        close(client_socket);
+        http_response = build_http_response(response, 500, keep_alive);
     }
-    catch (const std::exception &e)
+
+    sink(std::move(http_response), true);
+}
+
+// HTTP状态码对应的描述
+static const char *http_status_text(int status_code)
+{
+    switch (status_code)
     {
-        std::cerr << "❌ 处理连接异常: " << e.what() << std::endl;
-        close(client_socket);
+    case 200:
+        return "OK";
+    case 400:
+        return "Bad Request";
+    case 401:
+        return "Unauthorized";
+    case 408:
+        return "Request Timeout";
+    case 413:
+        return "Payload Too Large";
+    case 429:
+        return "Too Many Requests";
+    case 431:
+        return "Request Header Fields Too Large";
+    case 500:
+        return "Internal Server Error";
+    case 501:
+        return "Not Implemented";
+    case 503:
+        return "Service Unavailable";
+    case 505:
+        return "HTTP Version Not Supported";
+    default:
+        return "Unknown";
     }
 }
 
-ApiResponse ApiServer::process_request(const std::string &request_json, const std::string &path, const std::string &auth_header)
+OutputBuffer ApiServer::build_http_response(const ApiResponse &response, int status_code, bool keep_alive, const std::string &extra_headers,
+                                            ContentEncoding encoding)
 {
-    ApiResponse response;
+    // 直接把各字段序列化到响应体缓冲区（字段顺序与nlohmann::json对象一致），
+    // 不再先拷贝response.data构建完整的响应JSON对象再dump
+    // 按本线程上一次响应体的大小预留空间，避免大结果在序列化过程中反复扩容拷贝
+    thread_local size_t body_size_hint = 256;
+
+    std::string body;
+    body.reserve(body_size_hint);
+    body += "{\"data\":";
+    OutputBuffer::append_json(body, response.data);
+    if (!response.error.empty())
+    {
+        body += ",\"error\":";
+        OutputBuffer::append_json(body, response.error);
+    }
+    body += ",\"message\":";
+    OutputBuffer::append_json(body, response.message);
+    body += ",\"response_time\":";
+    OutputBuffer::append_json(body, response.response_time);
+    body += response.success ? ",\"success\":true}" : ",\"success\":false}";
+    body_size_hint = std::max<size_t>(256, body.size());
+
+    // 构建HTTP响应（若未经授权则返回401）
+    if (status_code == 0)
+        status_code = response.error == "Unauthorized" ? 401 : 200;
+
+    // 被采样的请求返回跟踪ID，可用于在 /api/debug/traces 中查找
+    if (!response.trace_id.empty())
+        return build_http_body_response(std::move(body), "application/json", status_code, keep_alive,
+                                        extra_headers + "X-Trace-Id: " + response.trace_id + "\r\n", encoding);
+
+    return build_http_body_response(std::move(body), "application/json", status_code, keep_alive, extra_headers, encoding);
+}
 
-    try
+OutputBuffer ApiServer::build_http_body_response(std::string body, const char *content_type, int status_code, bool keep_alive,
+                                                 const std::string &extra_headers, ContentEncoding encoding)
+{
+    // 小响应压缩收益很小，不值得消耗CPU
+    bool compressible = body.size() >= compression_min_size_;
+    bool compressed = false;
+    if (encoding != ContentEncoding::Identity && compressible)
     {
-        // 登录接口（公开）
-        if (path == "/api/auth")
+        std::string compressed_body;
+        if (ResponseCompressor::compress(encoding, body, compressed_body) && compressed_body.size() < body.size())
         {
-            nlohmann::json request_data = nlohmann::json::parse(request_json);
-            std::string username = request_data.value("username", "");
-            std::string password = request_data.value("password", "");
-            // 从配置获取管理员账号（优先使用 config/db_config.json 中的 auth）
-            ConfigManager cfg;
-            cfg.load_config();
-            auto auth = cfg.get_auth_config();
+            compressed_responses_++;
+            compression_input_bytes_ += body.size();
+            compression_output_bytes_ += compressed_body.size();
+            body = std::move(compressed_body);
+            compressed = true;
+        }
+    }
 
-            if (username == auth.admin_user && password == auth.admin_pass)
-            {
-                // 颁发短期 access token 和长期 refresh token
-                int access_exp = 60 * 60;           // 60 分钟
-                int refresh_exp = 7 * 24 * 60 * 60; // 7 天
-                std::string access_token = jwt::GenerateToken(username, access_exp);
+    std::string header;
+    header.reserve(192 + extra_headers.size());
+    header += "HTTP/1.1 " + std::to_string(status_code) + " " + http_status_text(status_code) + "\r\n";
+    header += std::string("Content-Type: ") + content_type + "\r\n";
+    header += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+    if (compressed)
+        header += std::string("Content-Encoding: ") + ResponseCompressor::encoding_name(encoding) + "\r\n";
+    if (compressible)
+        header += "Vary: Accept-Encoding\r\n";
+    header += extra_headers;
+    if (keep_alive)
+    {
+        header += "Connection: keep-alive\r\n";
+        header += "Keep-Alive: timeout=" + std::to_string(keep_alive_timeout_seconds_) + "\r\n";
+    }
+    else
+    {
+        header += "Connection: close\r\n";
+    }
+    header += "\r\n";
 
-                RefreshTokenStore store;
-                std::string refresh_token = store.CreateRefreshToken(username, refresh_exp);
+    // 响应头和响应体作为两个片段发送，不再拼接
+    OutputBuffer http_response;
+    http_response.append(std::move(header));
+    http_response.append(std::move(body));
+    return http_response;
+}
 
-                response.success = true;
-                response.message = "登录成功";
-                response.data["access_token"] = access_token;
-                response.data["expires_in"] = access_exp;
-                response.data["refresh_token"] = refresh_token;
-                response.data["refresh_expires_in"] = refresh_exp;
-            }
-            else
-            {
-                response.success = false;
-                response.message = "用户名或密码错误";
-                response.error = "Unauthorized";
-            }
+// 流水线请求可能乱序完成，只有队首的响应数据才能发送；
+// 流式响应在到达队首之前先缓存在槽位中，到达队首后新数据直接进入发送缓冲区
+void ApiServer::append_response(const HttpConnectionPtr &conn, uint64_t sequence, OutputBuffer data, bool finished, bool close_after_write)
+{
+    if (conn->closed || sequence < conn->pending_base || sequence - conn->pending_base >= conn->pending.size())
+        return;
 
-            return response;
-        }
+    PendingResponse &slot = conn->pending[sequence - conn->pending_base];
+    slot.data.append(std::move(data));
+    if (finished)
+    {
+        slot.close = close_after_write;
+        slot.ready = true;
+    }
+
+    while (!conn->pending.empty())
+    {
+        PendingResponse &front = conn->pending.front();
+        conn->write_buffer.append(std::move(front.data));
 
-        // 刷新 access token，使用 refresh token 获取新的 access token
-        if (path == "/api/auth/refresh")
+        if (!front.ready)
+            break;
+
+        bool close = front.close;
+        conn->pending.pop_front();
+        conn->pending_base++;
+
+        if (close)
         {
-            nlohmann::json request_data = nlohmann::json::parse(request_json);
-            std::string refresh_token = request_data.value("refresh_token", "");
-            if (refresh_token.empty())
-            {
-                response.success = false;
-                response.message = "缺少 refresh_token";
-                response.error = "Unauthorized";
-                return response;
-            }
+            // 之后不会再有响应，丢弃剩余的槽位
+            conn->close_after_write = true;
+            conn->draining = true;
+            conn->pending_base += conn->pending.size();
+            conn->pending.clear();
+            break;
+        }
+    }
+}
 
-            RefreshTokenStore store;
-            std::string sub;
-            if (!store.VerifyRefreshToken(refresh_token, sub))
-            {
-                response.success = false;
-                response.message = "无效或已过期的 refresh_token";
-                response.error = "Unauthorized";
-                return response;
-            }
+void ApiServer::deliver_response(const HttpConnectionPtr &conn, uint64_t sequence, OutputBuffer data, bool finished, bool close_after_write)
+{
+    if (conn->closed)
+        return;
 
-            // 轮换 refresh token：撤销旧 token，签发新 token
-            store.RevokeToken(refresh_token);
-            int new_refresh_exp = 7 * 24 * 60 * 60;
-            std::string new_refresh_token = store.CreateRefreshToken(sub, new_refresh_exp);
+    append_response(conn, sequence, std::move(data), finished, close_after_write);
 
-            int access_exp = 15 * 60; // 新的短期 access token
-            std::string access_token = jwt::GenerateToken(sub, access_exp);
+    // 空出流水线位置后继续处理读缓冲区中等待的请求
+    if (finished)
+        dispatch_requests(conn);
+    if (!conn->closed)
+        flush_write_buffer(conn);
+}
 
-            response.success = true;
-            response.message = "刷新成功";
-            response.data["access_token"] = access_token;
-            response.data["expires_in"] = access_exp;
-            response.data["refresh_token"] = new_refresh_token;
-            response.data["refresh_expires_in"] = new_refresh_exp;
+void ApiServer::queue_response(const HttpConnectionPtr &conn, OutputBuffer response, bool close_after_write)
+{
+    if (conn->closed)
+        return;
 
-            return response;
-        }
+    conn->write_buffer.append(std::move(response));
+    if (close_after_write)
+        conn->close_after_write = true;
 
-        // 对需要认证的接口进行 token 验证（/api/analyze /api/query /api/batch_analyze /api/excel_analyze）
-        // if (path == "/api/status" || path == "/api/query" || path == "/api/analyze" || path == "/api/batch_analyze" || path == "/api/excel_analyze")
-        // {
-        //     if (auth_header.empty())
-        //     {
-        //         response.success = false;
-        //         response.message = "未提供 Authorization 头";
-        //         response.error = "Unauthorized";
-        //         return response;
-        //     }
+    flush_write_buffer(conn);
+}
 
-        //     std::string token = auth_header;
-        //     // 支持直接传入 "Bearer <token>" 或者仅传 token
-        //     if (token.rfind("Bearer ", 0) == 0)
-        //     {
-        //         token = token.substr(7);
-        //     }
+// 非阻塞发送：多个片段（流水线中的多个响应、响应头和响应体）用sendmsg一次提交，
+// 部分发送时记录片段内的偏移，未发送完的数据等待EPOLLOUT后继续
+void ApiServer::flush_write_buffer(const HttpConnectionPtr &conn)
+{
+    bool had_data = !conn->write_buffer.empty();
+    struct iovec iov[64];
 
-        //     nlohmann::json claims;
-        //     if (!jwt::VerifyToken(token, claims))
-        //     {
-        //         response.success = false;
-        //         response.message = "无效或已过期的 token";
-        //         response.error = "Unauthorized";
-        //         return response;
-        //     }
-        // }
-        // 处理状态查询请求
-        if (path == "/api/status")
+    while (!conn->write_buffer.empty())
+    {
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = conn->write_buffer.fill_iovec(iov, 64);
+
+        ssize_t n = sendmsg(conn->fd, &msg, MSG_NOSIGNAL);
+        if (n > 0)
         {
-            response.success = true;
-            response.message = "服务器状态查询成功";
-            response.data = get_status();
-            response.response_time = 0.0;
-            return response;
+            conn->write_buffer.consume(static_cast<size_t>(n));
+            continue;
         }
-
-        // 处理查询请求
-        if (path == "/api/query")
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
         {
-            // 解析JSON请求
-            nlohmann::json request_data = nlohmann::json::parse(request_json);
-
-            ApiQueryRequest query_request;
-            query_request.query_type = request_data.value("query_type", "all");
-            query_request.tag = request_data.value("tag", "");
-            query_request.file_type = request_data.value("file_type", "");
-            query_request.start_date = request_data.value("start_date", "");
-            query_request.end_date = request_data.value("end_date", "");
-            query_request.limit = request_data.value("limit", 10);
-            query_request.condition = request_data.value("condition", "");
-            query_request.media_url = request_data.value("media_url", "");
-
-            // 处理查询请求
-            double start_time = utils::get_current_time();
-            response = handle_query_request(query_request);
-            response.response_time = utils::get_current_time() - start_time;
-            return response;
+            conn->last_active = std::chrono::steady_clock::now();
+            update_stream_buffer(conn);
+            update_interest(conn);
+            return;
         }
 
-        // 处理分析请求
-        if (path == "/api/analyze")
-        {
-            // 解析JSON请求
-            nlohmann::json request_data = nlohmann::json::parse(request_json);
+        close_connection(conn);
+        return;
+    }
 
-            // 检查必要字段
-            if (!request_data.contains("media_type"))
-            {
-                response.success = false;
-                response.message = "请求缺少必要字段: media_type";
-                response.error = "Invalid request format";
-                return response;
-            }
+    if (had_data)
+    {
+        conn->last_active = std::chrono::steady_clock::now();
+        update_stream_buffer(conn);
+    }
 
-            std::string media_type = request_data["media_type"].get<std::string>();
+    // 对端已关闭写方向且没有待响应的请求时，不会再有新请求到来（上传请求体仍在后台写入时等待其完成）
+    if (conn->close_after_write || (conn->read_shutdown && conn->pending.empty() && !conn->parser.spooling()))
+    {
+        close_connection(conn);
+        return;
+    }
 
-            ApiRequest request;
-            request.media_type = request_data["media_type"].get<std::string>();
+    update_interest(conn);
+}
 
-            // 根据媒体类型设置请求参数
-            if (media_type == "image" || media_type == "video")
-            {
-                // 处理多个URL的情况，只取第一个
-                if (!request_data.contains("media_url"))
-                {
-                    response.success = false;
-                    response.message = "媒体类型为image或video时，必须提供media_url";
-                    response.error = "Invalid request format";
-                    return response;
-                }
+// 根据连接状态更新epoll关注的事件
+void ApiServer::update_interest(const HttpConnectionPtr &conn)
+{
+    if (conn->closed)
+        return;
 
-                std::string media_url = request_data["media_url"].get<std::string>();
-                size_t comma_pos = media_url.find(",");
-                if (comma_pos != std::string::npos)
-                {
-                    media_url = media_url.substr(0, comma_pos);
-                    std::cout << "🔍 [信息] 检测到多个URL，只使用第一个: " << media_url << std::endl;
-                }
-                request.media_url = media_url;
+    uint32_t events = 0;
+    if (!conn->read_shutdown)
+    {
+        events |= EPOLLRDHUP;
+        // 流水线已满、不再接收新请求或上传请求体的后台写入积压时暂停读取，形成背压
+        if (!conn->draining && conn->pending.size() < max_pipeline_depth_ && !conn->parser.spool_backlogged())
+            events |= EPOLLIN;
+    }
+    if (!conn->write_buffer.empty())
+    {
+        events |= EPOLLOUT;
+    }
+
+    conn->loop->modify(conn->fd, events);
+}
+
+bool ApiServer::reserve_stream_buffer(const HttpConnectionPtr &conn, size_t bytes, bool wait)
+{
+    StreamBackpressure &backpressure = conn->backpressure;
+    std::unique_lock<std::mutex> lock(backpressure.mutex);
+
+    // 单个chunk超过上限时，等积压清空后仍然允许发送
+    bool writable = !wait || backpressure.writable.wait_for(lock, std::chrono::seconds(write_timeout_seconds_), [this, &backpressure]
+                                                             { return backpressure.closed || backpressure.posted + backpressure.buffered < stream_buffer_limit_; });
+    if (backpressure.closed)
+    {
+        aborted_streams_++;
+        return false;
+    }
+
+    if (!writable)
+    {
+        lock.unlock();
+        aborted_streams_++;
+        LOG_RATE_LIMITED(LogLevel::Warn, 10, "⚠️ 客户端长时间不读取流式响应，关闭连接", {{"peer", conn->peer}});
+        conn->loop->post([this, conn]()
+                         { close_connection(conn); });
+        return false;
+    }
+
+    backpressure.posted += bytes;
+    return true;
+}
+
+void ApiServer::update_stream_buffer(const HttpConnectionPtr &conn, size_t released)
+{
+    // 连接上等待发送的数据：发送缓冲区，以及尚未轮到发送的流水线槽位
+    size_t buffered = conn->write_buffer.size();
+    for (const auto &slot : conn->pending)
+    {
+        buffered += slot.data.size();
+    }
+
+    // buffered只由I/O线程修改，没有流式响应的连接不需要加锁
+    StreamBackpressure &backpressure = conn->backpressure;
+    if (released == 0 && buffered == backpressure.buffered)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(backpressure.mutex);
+        backpressure.posted -= std::min(released, backpressure.posted);
+        backpressure.buffered = buffered;
+    }
+    backpressure.writable.notify_all();
+}
+
+void ApiServer::close_connection(const HttpConnectionPtr &conn)
+{
+    if (conn->closed)
+        return;
+
+    conn->closed = true;
+    conn->loop->remove(conn->fd);
+    io_connections_[conn->loop_index].erase(conn->fd);
+    close(conn->fd);
+    open_connections_--;
+
+    // 唤醒等待背压的流式响应，使其停止输出
+    {
+        std::lock_guard<std::mutex> lock(conn->backpressure.mutex);
+        conn->backpressure.closed = true;
+    }
+    conn->backpressure.writable.notify_all();
+}
+
+// 每秒在I/O循环线程中执行一次
+void ApiServer::sweep_connections(size_t loop_index)
+{
+    auto now = std::chrono::steady_clock::now();
+    std::vector<HttpConnectionPtr> idle_connections;
+    std::vector<HttpConnectionPtr> slow_connections;
+
+    for (const auto &item : io_connections_[loop_index])
+    {
+        const HttpConnectionPtr &conn = item.second;
+
+        if (!conn->write_buffer.empty())
+        {
+            // 客户端长时间不读取响应
+            if (now - conn->last_active > std::chrono::seconds(write_timeout_seconds_))
+                idle_connections.push_back(conn);
+        }
+        else if (!conn->pending.empty())
+        {
+            // 请求仍在工作线程中处理（视频分析可能耗时数分钟），不计入超时
+            continue;
+        }
+        else if (conn->parser.spooling())
+        {
+            // 大文件上传只要持续有数据到达就不算超时；后台写入积压而暂停读取时不计入
+            if (!conn->parser.spool_backlogged() &&
+                now - conn->last_active > std::chrono::seconds(request_timeout_seconds_))
+                slow_connections.push_back(conn);
+        }
+        else if (conn->parser.in_progress() || !conn->read_buffer.empty())
+        {
+            if (now - conn->request_start > std::chrono::seconds(request_timeout_seconds_))
+                slow_connections.push_back(conn);
+        }
+        else if (now - conn->last_active > std::chrono::seconds(keep_alive_timeout_seconds_))
+        {
+            idle_connections.push_back(conn);
+        }
+    }
+
+    for (const auto &conn : idle_connections)
+    {
+        close_connection(conn);
+    }
+
+    for (const auto &conn : slow_connections)
+    {
+        LOG_RATE_LIMITED(LogLevel::Warn, 10, "⚠️ 接收请求超时，关闭连接", {{"peer", conn->peer}});
+
+        ApiResponse timeout_response;
+        timeout_response.message = "接收请求超时";
+        timeout_response.error = "Request timeout";
+        conn->read_buffer.clear();
+        conn->draining = true;
+        queue_response(conn, build_http_response(timeout_response, 408), true);
+    }
+}
+
+void ApiServer::report_worker_status()
+{
+    WorkerSlot *slot = supervisor_->current_slot();
+    if (!slot)
+        return;
+
+    slot->requests = total_requests_.load();
+    slot->open_connections = open_connections_.load();
+    slot->queued = control_executor_->get_queue_size() + query_executor_->get_queue_size() + analysis_executor_->get_queue_size();
+    slot->active = control_executor_->get_active_count() + query_executor_->get_active_count() + analysis_executor_->get_active_count();
+    slot->rejected = admission_.get_rejected_count();
+    slot->heartbeat = static_cast<int64_t>(time(nullptr));
+}
+
+ApiResponse ApiServer::process_request(std::string_view request_json, std::string_view path, std::string_view auth_header, std::string_view query, ChunkedResponseWriter *stream,
+                                       const HttpRequest *http_request)
+{
+    ApiResponse response;
+
+    // 请求级跟踪：trace=1强制采样，trace=0不采样，未指定时按采样率；
+    // 之后同一线程和提交的分析任务中的span都属于这次请求
+    std::string trace_param = get_query_param(query, "trace");
+    TraceScope trace_scope(Tracer::getInstance().start_trace(trace_param == "1" ? 1 : trace_param == "0" ? 0
+                                                                                                      : -1));
+    Span span("request");
+    span.set_arg("path", path);
+
+    try
+    {
+        // 按路由表分发，开启鉴权时受保护的路由先验证token（失败时authorize设置response）
+        const ApiRoute *route = find_route(path);
+        if (!route)
+        {
+            // 未知路径
+            response.success = false;
+            response.message = "未知的API路径: " + std::string(path);
+            response.error = "Unknown API path";
+            response.response_time = 0.0;
+        }
+        else if (!require_auth_ || !route->requires_auth || authorize(auth_header, response))
+        {
+            ApiContext ctx;
+            ctx.body = request_json;
+            ctx.path = path;
+            ctx.auth_header = auth_header;
+            ctx.query = query;
+            ctx.stream = stream;
+            ctx.request = http_request;
+            response = route->handler(ctx);
+        }
+    }
+    catch (const std::exception &e)
+    {
+        response.success = false;
+        response.message = "处理请求时发生异常: " + std::string(e.what());
+        response.error = "Request processing error";
+        response.response_time = 0.0;
+    }
+
+    if (span.active())
+    {
+        span.set_arg("success", response.success ? "true" : "false");
+        response.trace_id = Tracer::format_id(Tracer::current().trace_id);
+    }
+
+    return response;
+}
+
+// 验证Authorization头中的access token，失败时设置response并返回false
+// 验证通过的token由jwt模块缓存到过期为止，之后的请求只需一次哈希查找
+bool ApiServer::authorize(std::string_view auth_header, ApiResponse &response)
+{
+    // 支持直接传入 "Bearer <token>" 或者仅传 token
+    std::string_view token = auth_header;
+    if (token.rfind("Bearer ", 0) == 0)
+    {
+        token.remove_prefix(7);
+    }
+
+    if (token.empty())
+    {
+        response.success = false;
+        response.message = "未提供 Authorization 头";
+        response.error = "Unauthorized";
+        return false;
+    }
+
+    if (!jwt::IsTokenValid(token))
+    {
+        response.success = false;
+        response.message = "无效或已过期的 token";
+        response.error = "Unauthorized";
+        return false;
+    }
+
+    return true;
+}
+
+// 注册路由表：路径 -> 处理函数 + 执行器
+// 轻量接口（认证、状态、作业查询）、数据库查询和媒体分析分别使用独立的执行器，互不排队
+void ApiServer::register_routes()
+{
+    RouteExecutor *control = control_executor_.get();
+    RouteExecutor *query = query_executor_.get();
+    RouteExecutor *analysis = analysis_executor_.get();
+
+    routes_["/api/auth"] = {[this](const ApiContext &ctx)
+                            { return route_auth(ctx); },
+                            control};
+    routes_["/api/auth/refresh"] = {[this](const ApiContext &ctx)
+                                    { return route_auth_refresh(ctx); },
+                                    control};
+    routes_["/api/status"] = {[this](const ApiContext &)
+                              { return route_status(); },
+                              control, true};
+    routes_["/metrics"] = {[this](const ApiContext &)
+                           { return route_metrics(); },
+                           control, true};
+    routes_["/api/debug/traces"] = {[this](const ApiContext &ctx)
+                                    { return route_debug_traces(ctx); },
+                                    control, true};
+    routes_["/api/jobs"] = {[this](const ApiContext &ctx)
+                            { return route_jobs(ctx); },
+                            control, true};
+    routes_["/api/query"] = {[this](const ApiContext &ctx)
+                             { return route_query(ctx); },
+                             query, true};
+    routes_["/api/analyze"] = {[this](const ApiContext &ctx)
+                               { return route_analyze(ctx); },
+                               analysis, true};
+    routes_["/api/batch_analyze"] = {[this](const ApiContext &ctx)
+                                     { return route_batch_analyze(ctx); },
+                                     analysis, true};
+    routes_["/api/excel_analyze"] = {[this](const ApiContext &ctx)
+                                     { return route_excel_analyze(ctx); },
+                                     analysis, true};
+    routes_["/api/db_media_analyze"] = {[this](const ApiContext &ctx)
+                                        { return route_db_media_analyze(ctx); },
+                                        analysis, true};
+    routes_["/api/upload"] = {[this](const ApiContext &ctx)
+                              { return route_upload(ctx); },
+                              analysis, true};
+
+    // 前缀路由：/api/jobs/{id}、/api/jobs/{id}/cancel
+    prefix_routes_.emplace_back("/api/jobs/", routes_["/api/jobs"]);
+}
+
+const ApiRoute *ApiServer::find_route(std::string_view path) const
+{
+    auto it = routes_.find(std::string(path));
+    if (it != routes_.end())
+    {
+        return &it->second;
+    }
+
+    for (const auto &item : prefix_routes_)
+    {
+        if (path.rfind(item.first, 0) == 0)
+        {
+            return &item.second;
+        }
+    }
+
+    return nullptr;
+}
+
+// 登录接口（公开）
+ApiResponse ApiServer::route_auth(const ApiContext &ctx)
+{
+    ApiResponse response;
+
+    nlohmann::json request_data = nlohmann::json::parse(ctx.body);
+    std::string username = request_data.value("username", "");
+    std::string password = request_data.value("password", "");
+    if (username == auth_config_.admin_user && password == auth_config_.admin_pass)
+    {
+        // 颁发短期 access token 和长期 refresh token
+        int access_exp = 60 * 60;           // 60 分钟
+        int refresh_exp = 7 * 24 * 60 * 60; // 7 天
+        std::string access_token = jwt::GenerateToken(username, access_exp);
+
+        std::string refresh_token = RefreshTokenStore::getInstance().CreateRefreshToken(username, refresh_exp);
+
+        response.success = true;
+        response.message = "登录成功";
+        response.data["access_token"] = access_token;
+        response.data["expires_in"] = access_exp;
+        response.data["refresh_token"] = refresh_token;
+        response.data["refresh_expires_in"] = refresh_exp;
+    }
+    else
+    {
+        response.success = false;
+        response.message = "用户名或密码错误";
+        response.error = "Unauthorized";
+    }
+
+    return response;
+}
+
+// 刷新 access token，使用 refresh token 获取新的 access token
+ApiResponse ApiServer::route_auth_refresh(const ApiContext &ctx)
+{
+    ApiResponse response;
+
+    nlohmann::json request_data = nlohmann::json::parse(ctx.body);
+    std::string refresh_token = request_data.value("refresh_token", "");
+    if (refresh_token.empty())
+    {
+        response.success = false;
+        response.message = "缺少 refresh_token";
+        response.error = "Unauthorized";
+        return response;
+    }
+
+    RefreshTokenStore &store = RefreshTokenStore::getInstance();
+    std::string sub;
+    if (!store.VerifyRefreshToken(refresh_token, sub))
+    {
+        response.success = false;
+        response.message = "无效或已过期的 refresh_token";
+        response.error = "Unauthorized";
+        return response;
+    }
+
+    // 轮换 refresh token：撤销旧 token，签发新 token
+    store.RevokeToken(refresh_token);
+    int new_refresh_exp = 7 * 24 * 60 * 60;
+    std::string new_refresh_token = store.CreateRefreshToken(sub, new_refresh_exp);
+
+    int access_exp = 15 * 60; // 新的短期 access token
+    std::string access_token = jwt::GenerateToken(sub, access_exp);
+
+    response.success = true;
+    response.message = "刷新成功";
+    response.data["access_token"] = access_token;
+    response.data["expires_in"] = access_exp;
+    response.data["refresh_token"] = new_refresh_token;
+    response.data["refresh_expires_in"] = new_refresh_exp;
+
+    return response;
+}
+
+// 处理状态查询请求
+ApiResponse ApiServer::route_status()
+{
+    ApiResponse response;
+
+    response.success = true;
+    response.message = "服务器状态查询成功";
+    response.data = get_status();
+    response.response_time = 0.0;
+    return response;
+}
+
+// Prometheus指标（纯文本），包含各路由的耗时直方图和队列深度，开启鉴权时同样需要令牌
+ApiResponse ApiServer::route_metrics()
+{
+    ApiResponse response;
+    response.success = true;
+    response.content_type = "text/plain; version=0.0.4; charset=utf-8";
+    response.body = render_metrics();
+    return response;
+}
+
+// 导出请求跟踪：直接返回Chrome trace-event JSON，可以在chrome://tracing或Perfetto中打开
+// 其中包含请求路径和各阶段耗时，开启鉴权时需要令牌
+ApiResponse ApiServer::route_debug_traces(const ApiContext &ctx)
+{
+    std::string limit_param = get_query_param(ctx.query, "limit");
+    size_t limit = limit_param.empty() ? 2000 : static_cast<size_t>(std::max(1L, std::atol(limit_param.c_str())));
+
+    ApiResponse response;
+    response.success = true;
+    response.content_type = "application/json";
+    response.body = Tracer::getInstance().export_chrome_trace(get_query_param(ctx.query, "trace_id"), limit);
+    return response;
+}
+
+// 处理异步作业查询/取消请求
+ApiResponse ApiServer::route_jobs(const ApiContext &ctx)
+{
+    return handle_job_request(ctx.path, ctx.query);
+}
+
+// 处理查询请求
+ApiResponse ApiServer::route_query(const ApiContext &ctx)
+{
+    ApiResponse response;
+
+    // 解析JSON请求
+    nlohmann::json request_data = nlohmann::json::parse(ctx.body);
+
+    ApiQueryRequest query_request;
+    query_request.query_type = request_data.value("query_type", "all");
+    query_request.tag = request_data.value("tag", "");
+    query_request.file_type = request_data.value("file_type", "");
+    query_request.start_date = request_data.value("start_date", "");
+    query_request.end_date = request_data.value("end_date", "");
+    query_request.limit = request_data.value("limit", 10);
+    query_request.condition = request_data.value("condition", "");
+    query_request.media_url = request_data.value("media_url", "");
+
+    // 处理查询请求
+    double start_time = utils::get_current_time();
+    response = handle_query_request(query_request);
+    response.response_time = utils::get_current_time() - start_time;
+    return response;
+}
+
+// 处理分析请求
+// 流式模式下把模型输出的内容片段逐行写给客户端（在HTTP客户端的事件线程中调用，此时处理线程正在等待结果）
+static DoubaoMediaAnalyzer::TokenCallback stream_tokens_to(ChunkedResponseWriter *stream)
+{
+    if (!stream)
+    {
+        return nullptr;
+    }
+    // 事件线程不能等待背压，增量内容的总量受max_tokens限制
+    return [stream](const std::string &delta)
+    {
+        stream->write_line({{"type", "delta"}, {"content", delta}}, false);
+    };
+}
+
+ApiResponse ApiServer::route_analyze(const ApiContext &ctx)
+{
+    ApiResponse response;
+
+    // 解析JSON请求
+    nlohmann::json request_data = nlohmann::json::parse(ctx.body);
+
+    // 检查必要字段
+    if (!request_data.contains("media_type"))
+    {
+        response.success = false;
+        response.message = "请求缺少必要字段: media_type";
+        response.error = "Invalid request format";
+        return response;
+    }
+
+    std::string media_type = request_data["media_type"].get<std::string>();
+
+    ApiRequest request;
+    request.media_type = request_data["media_type"].get<std::string>();
+
+    // 根据媒体类型设置请求参数
+    if (media_type == "image" || media_type == "video")
+    {
+        // 处理多个URL的情况，只取第一个
+        if (!request_data.contains("media_url"))
+        {
+            response.success = false;
+            response.message = "媒体类型为image或video时，必须提供media_url";
+            response.error = "Invalid request format";
+            return response;
+        }
+
+        std::string media_url = request_data["media_url"].get<std::string>();
+        size_t comma_pos = media_url.find(",");
+        if (comma_pos != std::string::npos)
+        {
+            media_url = media_url.substr(0, comma_pos);
+            LOG_DEBUG("🔍 [信息] 检测到多个URL，只使用第一个", {{"url", media_url}});
+        }
+        request.media_url = media_url;
+    }
+    else if (media_type == "text")
+    {
+        // 文本类型
+        if (!request_data.contains("text"))
+        {
+            response.success = false;
+            response.message = "媒体类型为text时，必须提供text";
+            response.error = "Invalid request format";
+            return response;
+        }
+        request.text = request_data["text"].get<std::string>();
+    }
+    else if (media_type == "file")
+    {
+        // 文件类型
+        if (!request_data.contains("file_path"))
+        {
+            response.success = false;
+            response.message = "媒体类型为file时，必须提供file_path";
+            response.error = "Invalid request format";
+            return response;
+        }
+        request.file_path = request_data["file_path"].get<std::string>();
+    }
+    else if (media_type == "audio")
+    {
+        // 音频类型
+        if (!request_data.contains("media_url") && !request_data.contains("file_path"))
+        {
+            response.success = false;
+            response.message = "媒体类型为audio时，必须提供media_url或file_path";
+            response.error = "Invalid request format";
+            return response;
+        }
+
+        if (request_data.contains("media_url"))
+        {
+            std::string media_url = request_data["media_url"].get<std::string>();
+            request.media_url = media_url;
+        }
+
+        if (request_data.contains("file_path"))
+        {
+            request.file_path = request_data["file_path"].get<std::string>();
+        }
+    }
+    else
+    {
+        response.success = false;
+        response.message = "不支持的媒体类型: " + media_type + " (支持的类型: image, video, text, file, audio)";
+        response.error = "Invalid media type";
+        return response;
+    }
+
+    request.prompt = request_data.value("prompt", "");
+    request.max_tokens = request_data.value("max_tokens", 1500);
+    request.video_frames = request_data.value("video_frames", 5);
+    request.save_to_db = request_data.value("save_to_db", true);
+
+    // 添加大模型配置参数 （可选）
+    request.model_name = request_data.value("model_name", "");
+
+    // 异步模式：提交单任务作业后立即返回作业ID
+    if (request_data.value("async", false))
+    {
+        if (request.media_type != "image" && request.media_type != "video")
+        {
+            response.success = false;
+            response.message = "异步模式仅支持 image 和 video 类型";
+            response.error = "Invalid request format";
+            return response;
+        }
+        return submit_job("analyze", {create_analysis_task(request, "analyze")}, {{"media_url", request.media_url}});
+    }
+
+    // 流式模式：先发出响应头，模型输出的内容片段逐段返回，最后输出汇总行
+    ChunkedResponseWriter *result_stream = request_data.value("stream", false) ? ctx.stream : nullptr;
+    if (result_stream)
+    {
+        result_stream->begin();
+    }
+
+    // 处理请求
+    double start_time = utils::get_current_time();
+
+    if (request.media_type == "image")
+    {
+        response = handle_image_analysis(request, result_stream);
+    }
+    else if (request.media_type == "video")
+    {
+        response = handle_video_analysis(request, result_stream);
+    }
+    else if (request.media_type == "text")
+    {
+        // 调用文本分析方法
+        try
+        {
+            AnalysisResult result = analyzer_->analyze_text(
+                request.text,
+                request.prompt.empty() ? "请分析这段文本" : request.prompt,
+                request.max_tokens,
+                request.model_name,
+                stream_tokens_to(result_stream));
+
+            if (result.success)
+            {
+                response.success = true;
+                response.message = "文本分析成功";
+                response.data = {
+                    {"content", result.content},
+                    {"response_time", result.response_time},
+                    {"usage", result.usage}};
             }
-            else if (media_type == "text")
+            else
             {
-                // 文本类型
-                if (!request_data.contains("text"))
-                {
-                    response.success = false;
-                    response.message = "媒体类型为text时，必须提供text";
-                    response.error = "Invalid request format";
-                    return response;
-                }
-                request.text = request_data["text"].get<std::string>();
+                response.success = false;
+                response.message = "文本分析失败";
+                response.error = result.error;
             }
-            else if (media_type == "file")
+        }
+        catch (const std::exception &e)
+        {
+            response.success = false;
+            response.message = "文本分析异常: " + std::string(e.what());
+            response.error = "Text analysis error";
+        }
+    }
+    else if (request.media_type == "file")
+    {
+        // 调用文件分析方法
+        try
+        {
+            AnalysisResult result = analyzer_->analyze_file(
+                request.file_path,
+                request.prompt.empty() ? "请分析这个文件" : request.prompt,
+                request.max_tokens,
+                request.model_name);
+
+            if (result.success)
             {
-                // 文件类型
-                if (!request_data.contains("file_path"))
-                {
-                    response.success = false;
-                    response.message = "媒体类型为file时，必须提供file_path";
-                    response.error = "Invalid request format";
-                    return response;
-                }
-                request.file_path = request_data["file_path"].get<std::string>();
+                response.success = true;
+                response.message = "文件分析成功";
+                response.data = {
+                    {"content", result.content},
+                    {"response_time", result.response_time},
+                    {"usage", result.usage}};
+            }
+            else
+            {
+                response.success = false;
+                response.message = "文件分析失败";
+                response.error = result.error;
             }
-            else if (media_type == "audio")
+        }
+        catch (const std::exception &e)
+        {
+            response.success = false;
+            response.message = "文件分析异常: " + std::string(e.what());
+            response.error = "File analysis error";
+        }
+    }
+    else if (request.media_type == "audio")
+    {
+        // 音频分析 - 可以使用文件分析方法处理音频文件
+        try
+        {
+            std::string audio_path = request.file_path.empty() ? "" : request.file_path;
+            std::string audio_url = request.media_url.empty() ? "" : request.media_url;
+
+            // 如果是URL，先下载
+            if (!audio_url.empty())
             {
-                // 音频类型
-                if (!request_data.contains("media_url") && !request_data.contains("file_path"))
+                audio_path = "/tmp/api_audio_" + utils::get_current_timestamp() + ".mp3";
+                if (!utils::download_file(audio_url, audio_path))
                 {
                     response.success = false;
-                    response.message = "媒体类型为audio时，必须提供media_url或file_path";
-                    response.error = "Invalid request format";
+                    response.message = "音频下载失败: " + audio_url;
+                    response.error = "Audio download failed";
                     return response;
                 }
+            }
 
-                if (request_data.contains("media_url"))
-                {
-                    std::string media_url = request_data["media_url"].get<std::string>();
-                    request.media_url = media_url;
-                }
+            // 调用文件分析方法
+            AnalysisResult result = analyzer_->analyze_file(
+                audio_path,
+                request.prompt.empty() ? "请分析这段音频" : request.prompt,
+                request.max_tokens,
+                request.model_name);
 
-                if (request_data.contains("file_path"))
-                {
-                    request.file_path = request_data["file_path"].get<std::string>();
-                }
+            // 如果是下载的临时文件，清理
+            if (!audio_url.empty() && utils::file_exists(audio_path))
+            {
+                std::filesystem::remove(audio_path);
+            }
+
+            if (result.success)
+            {
+                response.success = true;
+                response.message = "音频分析成功";
+                response.data = {
+                    {"content", result.content},
+                    {"response_time", result.response_time},
+                    {"usage", result.usage}};
             }
             else
             {
                 response.success = false;
-                response.message = "不支持的媒体类型: " + media_type + " (支持的类型: image, video, text, file, audio)";
-                response.error = "Invalid media type";
-                return response;
+                response.message = "音频分析失败";
+                response.error = result.error;
             }
+        }
+        catch (const std::exception &e)
+        {
+            response.success = false;
+            response.message = "音频分析异常: " + std::string(e.what());
+            response.error = "Audio analysis error";
+        }
+    }
+
+    response.response_time = utils::get_current_time() - start_time;
+    if (result_stream)
+    {
+        finish_stream(result_stream, response);
+    }
+    return response;
+}
 
-            request.prompt = request_data.value("prompt", "");
-            request.max_tokens = request_data.value("max_tokens", 1500);
-            request.video_frames = request_data.value("video_frames", 5);
-            request.save_to_db = request_data.value("save_to_db", true);
+// 处理Excel分析请求
+ApiResponse ApiServer::route_excel_analyze(const ApiContext &ctx)
+{
+    ApiResponse response;
 
-            // 添加大模型配置参数 （可选）
-            request.model_name = request_data.value("model_name", "");
+    // 解析JSON请求
+    nlohmann::json request_data = nlohmann::json::parse(ctx.body);
 
-            // 处理请求
-            double start_time = utils::get_current_time();
+    // 检查必要字段
+    if (!request_data.contains("excel_path"))
+    {
+        response.success = false;
+        response.message = "请求缺少必要字段: excel_path";
+        response.error = "Invalid request format";
+        return response;
+    }
 
-            if (request.media_type == "image")
-            {
-                response = handle_image_analysis(request);
-            }
-            else if (request.media_type == "video")
-            {
-                response = handle_video_analysis(request);
-            }
-            else if (request.media_type == "text")
-            {
-                // 调用文本分析方法
-                try
-                {
-                    AnalysisResult result = analyzer_->analyze_text(
-                        request.text,
-                        request.prompt.empty() ? "请分析这段文本" : request.prompt,
-                        request.max_tokens,
-                        request.model_name);
+    ApiExcelRequest excel_request;
+    excel_request.excel_path = request_data["excel_path"].get<std::string>();
+    excel_request.output_path = request_data.value("output_path", "");
+    excel_request.prompt = request_data.value("prompt", "");
+    excel_request.max_tokens = request_data.value("max_tokens", 1500);
+    excel_request.save_to_db = request_data.value("save_to_db", true);
+    excel_request.async_job = request_data.value("async", false);
 
-                    if (result.success)
-                    {
-                        response.success = true;
-                        response.message = "文本分析成功";
-                        response.data = {
-                            {"content", result.content},
-                            {"response_time", result.response_time},
-                            {"usage", result.usage}};
-                    }
-                    else
-                    {
-                        response.success = false;
-                        response.message = "文本分析失败";
-                        response.error = result.error;
-                    }
-                }
-                catch (const std::exception &e)
-                {
-                    response.success = false;
-                    response.message = "文本分析异常: " + std::string(e.what());
-                    response.error = "Text analysis error";
-                }
-            }
-            else if (request.media_type == "file")
-            {
-                // 调用文件分析方法
-                try
-                {
-                    AnalysisResult result = analyzer_->analyze_file(
-                        request.file_path,
-                        request.prompt.empty() ? "请分析这个文件" : request.prompt,
-                        request.max_tokens,
-                        request.model_name);
+    // 处理请求
+    double start_time = utils::get_current_time();
+    response = handle_excel_analysis(excel_request, request_data.value("stream", false) ? ctx.stream : nullptr);
+    response.response_time = utils::get_current_time() - start_time;
+    return response;
+}
 
-                    if (result.success)
-                    {
-                        response.success = true;
-                        response.message = "文件分析成功";
-                        response.data = {
-                            {"content", result.content},
-                            {"response_time", result.response_time},
-                            {"usage", result.usage}};
-                    }
-                    else
-                    {
-                        response.success = false;
-                        response.message = "文件分析失败";
-                        response.error = result.error;
-                    }
-                }
-                catch (const std::exception &e)
-                {
-                    response.success = false;
-                    response.message = "文件分析异常: " + std::string(e.what());
-                    response.error = "File analysis error";
-                }
-            }
-            else if (request.media_type == "audio")
-            {
-                // 音频分析 - 可以使用文件分析方法处理音频文件
-                try
-                {
-                    std::string audio_path = request.file_path.empty() ? "" : request.file_path;
-                    std::string audio_url = request.media_url.empty() ? "" : request.media_url;
+// 处理数据库媒体分析请求
+ApiResponse ApiServer::route_db_media_analyze(const ApiContext &ctx)
+{
+    ApiResponse response;
 
-                    // 如果是URL，先下载
-                    if (!audio_url.empty())
-                    {
-                        audio_path = "/tmp/api_audio_" + utils::get_current_timestamp() + ".mp3";
-                        if (!utils::download_file(audio_url, audio_path))
-                        {
-                            response.success = false;
-                            response.message = "音频下载失败: " + audio_url;
-                            response.error = "Audio download failed";
-                            return response;
-                        }
-                    }
+    // 解析JSON请求
+    nlohmann::json request_data = nlohmann::json::parse(ctx.body);
+
+    // 获取请求参数
+    std::string prompt = request_data.value("prompt", "");
+    int max_tokens = request_data.value("max_tokens", 2000);
+    int video_frames = request_data.value("video_frames", 5);
+    bool save_to_db = request_data.value("save_to_db", true);
+    // 添加大模型配置参数 （可选）
+    std::string model_name = request_data.value("model_name", "");
+    // 添加分批请求数参数
+    int batch_size = request_data.value("batch_size", 10);
+    bool async_job = request_data.value("async", false);
+
+    // 处理请求
+    double start_time = utils::get_current_time();
+    ChunkedResponseWriter *result_stream = request_data.value("stream", false) ? ctx.stream : nullptr;
+    response = handle_db_media_analysis(prompt, max_tokens, video_frames, save_to_db, model_name, batch_size, async_job, result_stream);
+    response.response_time = utils::get_current_time() - start_time;
+    return response;
+}
 
-                    // 调用文件分析方法
-                    AnalysisResult result = analyzer_->analyze_file(
-                        audio_path,
-                        request.prompt.empty() ? "请分析这段音频" : request.prompt,
-                        request.max_tokens,
-                        request.model_name);
+// 只读映射上传时写入的临时文件，避免把大文件读入内存
+class MappedFile
+{
+public:
+    MappedFile() : data_(nullptr), size_(0) {}
+    ~MappedFile()
+    {
+        if (data_)
+            munmap(data_, size_);
+    }
 
-                    // 如果是下载的临时文件，清理
-                    if (!audio_url.empty() && utils::file_exists(audio_path))
-                    {
-                        std::filesystem::remove(audio_path);
-                    }
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
 
-                    if (result.success)
-                    {
-                        response.success = true;
-                        response.message = "音频分析成功";
-                        response.data = {
-                            {"content", result.content},
-                            {"response_time", result.response_time},
-                            {"usage", result.usage}};
-                    }
-                    else
-                    {
-                        response.success = false;
-                        response.message = "音频分析失败";
-                        response.error = result.error;
-                    }
-                }
-                catch (const std::exception &e)
-                {
-                    response.success = false;
-                    response.message = "音频分析异常: " + std::string(e.what());
-                    response.error = "Audio analysis error";
-                }
-            }
+    bool open(const std::string &path)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
 
-            response.response_time = utils::get_current_time() - start_time;
-            return response;
+        struct stat st;
+        if (fstat(fd, &st) != 0)
+        {
+            close(fd);
+            return false;
         }
 
-        // 处理Excel分析请求
-        if (path == "/api/excel_analyze")
+        size_ = static_cast<size_t>(st.st_size);
+        if (size_ > 0)
         {
-            // 解析JSON请求
-            nlohmann::json request_data = nlohmann::json::parse(request_json);
-
-            // 检查必要字段
-            if (!request_data.contains("excel_path"))
+            void *data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data == MAP_FAILED)
             {
-                response.success = false;
-                response.message = "请求缺少必要字段: excel_path";
-                response.error = "Invalid request format";
-                return response;
+                close(fd);
+                size_ = 0;
+                return false;
             }
+            madvise(data, size_, MADV_SEQUENTIAL);
+            data_ = data;
+        }
+        close(fd);
+        return true;
+    }
 
-            ApiExcelRequest excel_request;
-            excel_request.excel_path = request_data["excel_path"].get<std::string>();
-            excel_request.output_path = request_data.value("output_path", "");
-            excel_request.prompt = request_data.value("prompt", "");
-            excel_request.max_tokens = request_data.value("max_tokens", 1500);
-            excel_request.save_to_db = request_data.value("save_to_db", true);
+    std::string_view view() const { return std::string_view(static_cast<const char *>(data_), size_); }
 
-            // 处理请求
-            double start_time = utils::get_current_time();
-            response = handle_excel_analysis(excel_request);
-            response.response_time = utils::get_current_time() - start_time;
-            return response;
+private:
+    void *data_;
+    size_t size_;
+};
+
+// URL解码（查询字符串中的'+'表示空格）
+static std::string url_decode(std::string_view value)
+{
+    std::string result;
+    result.reserve(value.size());
+    for (size_t i = 0; i < value.size(); ++i)
+    {
+        char c = value[i];
+        if (c == '+')
+        {
+            result += ' ';
         }
+        else if (c == '%' && i + 2 < value.size() && std::isxdigit(static_cast<unsigned char>(value[i + 1])) &&
+                 std::isxdigit(static_cast<unsigned char>(value[i + 2])))
+        {
+            result += static_cast<char>(std::stoi(std::string(value.substr(i + 1, 2)), nullptr, 16));
+            i += 2;
+        }
+        else
+        {
+            result += c;
+        }
+    }
+    return result;
+}
+
+// 处理上传分析请求
+// 请求体为multipart/form-data（文件字段 + 其他参数字段），或者直接是图片/视频的原始字节（参数放在查询字符串中）
+ApiResponse ApiServer::route_upload(const ApiContext &ctx)
+{
+    ApiResponse response;
+    double start_time = utils::get_current_time();
+
+    // 参数：先取查询字符串，multipart中的同名字段覆盖查询字符串
+    std::unordered_map<std::string, std::string> fields;
+    std::string_view query = ctx.query;
+    while (!query.empty())
+    {
+        size_t amp = query.find('&');
+        std::string_view pair = query.substr(0, amp);
+        size_t eq = pair.find('=');
+        if (eq != std::string_view::npos)
+            fields[url_decode(pair.substr(0, eq))] = url_decode(pair.substr(eq + 1));
+        if (amp == std::string_view::npos)
+            break;
+        query.remove_prefix(amp + 1);
+    }
 
-        // 处理数据库媒体分析请求
-        if (path == "/api/db_media_analyze")
+    // 较大的请求体已在接收时写入临时文件，映射到内存后与内存中的请求体同样处理
+    MappedFile mapped;
+    std::string_view body = ctx.body;
+    std::string body_file = ctx.request ? ctx.request->body_file : std::string();
+    if (!body_file.empty())
+    {
+        if (!mapped.open(body_file))
         {
-            // 解析JSON请求
-            nlohmann::json request_data = nlohmann::json::parse(request_json);
+            response.success = false;
+            response.message = "读取上传临时文件失败";
+            response.error = "Upload error";
+            return response;
+        }
+        body = mapped.view();
+    }
 
-            // 获取请求参数
-            std::string prompt = request_data.value("prompt", "");
-            int max_tokens = request_data.value("max_tokens", 2000);
-            int video_frames = request_data.value("video_frames", 5);
-            bool save_to_db = request_data.value("save_to_db", true);
-            // 添加大模型配置参数 （可选）
-            std::string model_name = request_data.value("model_name", "");
-            // 添加分批请求数参数
-            int batch_size = request_data.value("batch_size", 10);
+    std::string_view content_type = ctx.request ? ctx.request->header("Content-Type") : std::string_view();
+    std::string_view media = body;
+    std::string_view media_content_type = content_type;
+    std::string filename;
 
-            // 处理请求
-            double start_time = utils::get_current_time();
-            response = handle_db_media_analysis(prompt, max_tokens, video_frames, save_to_db, model_name, batch_size);
-            response.response_time = utils::get_current_time() - start_time;
+    std::string_view boundary = MultipartParser::boundary(content_type);
+    if (!boundary.empty())
+    {
+        std::vector<MultipartPart> parts;
+        std::string error;
+        if (!MultipartParser::parse(body, boundary, parts, error))
+        {
+            response.success = false;
+            response.message = "multipart请求体解析失败: " + error;
+            response.error = "Invalid request format";
             return response;
         }
 
-        // 处理批量分析请求
-        if (path == "/api/batch_analyze")
+        const MultipartPart *file_part = nullptr;
+        for (const auto &part : parts)
         {
-            // 解析JSON请求
-            nlohmann::json request_data = nlohmann::json::parse(request_json);
+            if (!file_part && (!part.filename.empty() || part.name == "file"))
+                file_part = &part;
+            else
+                fields[std::string(part.name)] = std::string(part.data);
+        }
 
-            // 检查必要字段
-            if (!request_data.contains("requests") || !request_data["requests"].is_array())
-            {
-                response.success = false;
-                response.message = "请求缺少必要字段: requests (必须是数组)";
-                response.error = "Invalid request format";
-                return response;
-            }
+        if (!file_part)
+        {
+            response.success = false;
+            response.message = "multipart请求体中没有文件字段（file）";
+            response.error = "Invalid request format";
+            return response;
+        }
 
-            std::vector<ApiRequest> requests;
-            const auto &requests_array = request_data["requests"];
+        media = file_part->data;
+        media_content_type = file_part->content_type;
+        filename = std::string(file_part->filename);
 
-            for (const auto &req_json : requests_array)
-            {
-                if (!req_json.contains("media_type") || !req_json.contains("media_url"))
-                {
-                    response.success = false;
-                    response.message = "批量请求中的某个项目缺少必要字段: media_type 和 media_url";
-                    response.error = "Invalid request format";
-                    return response;
-                }
+        // 文件只是请求体的一部分，视频需要单独写出
+        body_file.clear();
+    }
 
-                ApiRequest req;
-                req.media_type = req_json["media_type"].get<std::string>();
+    if (media.empty())
+    {
+        response.success = false;
+        response.message = "上传的文件为空";
+        response.error = "Invalid request format";
+        return response;
+    }
 
-                // 处理多个URL的情况，只取第一个
-                // req.media_url = req_json["media_url"].get<std::string>();
-                std::string media_url = req_json["media_url"].get<std::string>();
-                size_t comma_pos = media_url.find(",");
-                if (comma_pos != std::string::npos)
-                {
-                    media_url = media_url.substr(0, comma_pos);
-                    std::cout << "🔍 [信息] 检测到多个URL，只使用第一个: " << media_url << std::endl;
-                }
-                req.media_url = media_url;
-
-                req.prompt = req_json.value("prompt", "");
-                req.max_tokens = req_json.value("max_tokens", 1500);
-                req.video_frames = req_json.value("video_frames", 5);
-                req.save_to_db = req_json.value("save_to_db", true);
-                // 添加大模型配置参数 （可选）
-                req.model_name = req_json.value("model_name", "");
-                // 验证媒体类型
-                if (req.media_type != "image" && req.media_type != "video")
-                {
-                    response.success = false;
-                    response.message = "不支持的媒体类型: " + req.media_type + " (必须是 image 或 video)";
-                    response.error = "Invalid media type";
-                    return response;
-                }
+    ApiRequest request;
+    request.media_type = fields["media_type"];
+    if (request.media_type.empty())
+    {
+        // 未指定类型时按Content-Type或文件扩展名判断
+        if (media_content_type.rfind("image/", 0) == 0 || (!filename.empty() && utils::is_image_file(filename)))
+            request.media_type = "image";
+        else if (media_content_type.rfind("video/", 0) == 0 || (!filename.empty() && utils::is_video_file(filename)))
+            request.media_type = "video";
+    }
+    if (request.media_type != "image" && request.media_type != "video")
+    {
+        response.success = false;
+        response.message = "无法确定上传文件的媒体类型，请通过media_type参数指定image或video";
+        response.error = "Invalid media type";
+        return response;
+    }
 
-                requests.push_back(req);
-            }
+    try
+    {
+        request.media_url = "upload://" + (filename.empty() ? std::string("body") : filename);
+        request.prompt = fields["prompt"];
+        request.max_tokens = fields["max_tokens"].empty() ? 1500 : std::stoi(fields["max_tokens"]);
+        request.video_frames = fields["video_frames"].empty() ? 5 : std::stoi(fields["video_frames"]);
+        request.save_to_db = fields["save_to_db"].empty() || fields["save_to_db"] == "true" || fields["save_to_db"] == "1";
+        request.model_name = fields["model_name"];
+    }
+    catch (const std::exception &e)
+    {
+        response.success = false;
+        response.message = "参数格式错误: " + std::string(e.what());
+        response.error = "Invalid request format";
+        return response;
+    }
 
-            // 处理批量分析请求
-            double start_time = utils::get_current_time();
-            response = handle_batch_analysis(requests);
-            response.response_time = utils::get_current_time() - start_time;
-            return response;
-        }
+    LOG_INFO("📤 收到上传分析请求",
+             {{"type", request.media_type}, {"file", request.media_url}, {"bytes", media.size()}, {"spooled", !mapped.view().empty()}});
 
-        // 未知路径
+    response = handle_upload_analysis(request, media, body_file);
+    if (response.success)
+        response.data["size"] = media.size();
+    response.response_time = utils::get_current_time() - start_time;
+    return response;
+}
+
+// 处理批量分析请求
+ApiResponse ApiServer::route_batch_analyze(const ApiContext &ctx)
+{
+    ApiResponse response;
+
+    // 解析JSON请求
+    nlohmann::json request_data = nlohmann::json::parse(ctx.body);
+
+    // 检查必要字段
+    if (!request_data.contains("requests") || !request_data["requests"].is_array())
+    {
         response.success = false;
-        response.message = "未知的API路径: " + path;
-        response.error = "Unknown API path";
-        response.response_time = 0.0;
+        response.message = "请求缺少必要字段: requests (必须是数组)";
+        response.error = "Invalid request format";
+        return response;
     }
-    catch (const std::exception &e)
+
+    std::vector<ApiRequest> requests;
+    const auto &requests_array = request_data["requests"];
+
+    for (const auto &req_json : requests_array)
     {
-        response.success = false;
-        response.message = "处理请求时发生异常: " + std::string(e.what());
-        response.error = "Request processing error";
-        response.response_time = 0.0;
+        if (!req_json.contains("media_type") || !req_json.contains("media_url"))
+        {
+            response.success = false;
+            response.message = "批量请求中的某个项目缺少必要字段: media_type 和 media_url";
+            response.error = "Invalid request format";
+            return response;
+        }
+
+        ApiRequest req;
+        req.media_type = req_json["media_type"].get<std::string>();
+
+        // 处理多个URL的情况，只取第一个
+        // req.media_url = req_json["media_url"].get<std::string>();
+        std::string media_url = req_json["media_url"].get<std::string>();
+        size_t comma_pos = media_url.find(",");
+        if (comma_pos != std::string::npos)
+        {
+            media_url = media_url.substr(0, comma_pos);
+            LOG_DEBUG("🔍 [信息] 检测到多个URL，只使用第一个", {{"url", media_url}});
+        }
+        req.media_url = media_url;
+
+        req.prompt = req_json.value("prompt", "");
+        req.max_tokens = req_json.value("max_tokens", 1500);
+        req.video_frames = req_json.value("video_frames", 5);
+        req.save_to_db = req_json.value("save_to_db", true);
+        // 添加大模型配置参数 （可选）
+        req.model_name = req_json.value("model_name", "");
+        // 验证媒体类型
+        if (req.media_type != "image" && req.media_type != "video")
+        {
+            response.success = false;
+            response.message = "不支持的媒体类型: " + req.media_type + " (必须是 image 或 video)";
+            response.error = "Invalid media type";
+            return response;
+        }
+
+        requests.push_back(req);
     }
 
+    // 处理批量分析请求
+    double start_time = utils::get_current_time();
+    ChunkedResponseWriter *result_stream = request_data.value("stream", false) ? ctx.stream : nullptr;
+    response = handle_batch_analysis(requests, request_data.value("async", false), result_stream);
+    response.response_time = utils::get_current_time() - start_time;
     return response;
 }
 
-ApiResponse ApiServer::handle_image_analysis(const ApiRequest &request)
+ApiResponse ApiServer::handle_image_analysis(const ApiRequest &request, ChunkedResponseWriter *stream)
 {
     ApiResponse response;
 
@@ -1211,7 +2300,8 @@ ApiResponse ApiServer::handle_image_analysis(const ApiRequest &request)
             temp_file,
             prompt,
             request.max_tokens,
-            request.model_name);
+            request.model_name,
+            stream_tokens_to(stream));
 
         // 清理临时文件
         std::filesystem::remove(temp_file);
@@ -1224,7 +2314,8 @@ ApiResponse ApiServer::handle_image_analysis(const ApiRequest &request)
                 {"content", result.content},
                 {"tags", analyzer_->extract_tags(result.content)},
                 {"response_time", result.response_time},
-                {"usage", result.usage}};
+                {"usage", result.usage},
+                {"cached", result.cached}};
 
             // 保存到数据库
             if (request.save_to_db)
@@ -1257,32 +2348,26 @@ ApiResponse ApiServer::handle_image_analysis(const ApiRequest &request)
     return response;
 }
 
-ApiResponse ApiServer::handle_video_analysis(const ApiRequest &request)
+ApiResponse ApiServer::handle_video_analysis(const ApiRequest &request, ChunkedResponseWriter *stream)
 {
     ApiResponse response;
     nlohmann::json timing_info = nlohmann::json::object();
     double total_start_time = utils::get_current_time();
 
-    std::cout << "🎬 [视频分析] 开始处理视频分析请求: " << request.media_url << std::endl;
-    std::cout << "⏰ [时间戳] 请求接收时间: " << utils::get_formatted_timestamp() << std::endl;
+    LOG_DEBUG("🎬 [视频分析] 开始处理视频分析请求", {{"url", request.media_url}});
 
     try
     {
         // 使用高效视频分析方法，无需下载整个视频
         double extraction_start_time = utils::get_current_time();
-        std::cout << "🎬 [视频分析] 开始高效分析视频，无需完整下载" << std::endl;
-        std::cout << "⏰ [时间戳] 分析开始时间: " << utils::get_formatted_timestamp() << std::endl;
 
         // 使用默认提示词或自定义提示词
         std::string prompt = request.prompt.empty() ? get_video_prompt() : request.prompt;
 
         // 分析视频
         double analysis_start_time = utils::get_current_time();
-        std::cout << "🔍 [视频分析] 开始分析视频..." << std::endl;
-        std::cout << "⏰ [时间戳] 分析开始时间: " << utils::get_formatted_timestamp() << std::endl;
-        std::cout << "📊 [参数] 提示词长度: " << prompt.length() << " 字符" << std::endl;
-        std::cout << "📊 [参数] 最大令牌数: " << request.max_tokens << std::endl;
-        std::cout << "📊 [参数] 提取帧数: " << request.video_frames << std::endl;
+        LOG_TRACE("🔍 [视频分析] 开始分析视频",
+                  {{"prompt_length", prompt.length()}, {"max_tokens", request.max_tokens}, {"frames", request.video_frames}});
 
         AnalysisResult result = analyzer_->analyze_video_efficiently(
             request.media_url,
@@ -1290,72 +2375,165 @@ ApiResponse ApiServer::handle_video_analysis(const ApiRequest &request)
             request.max_tokens,
             "keyframes",          // 使用关键帧提取方法
             request.video_frames, // 传递请求的帧数
-            request.model_name);
+            request.model_name,
+            stream_tokens_to(stream));
 
         double analysis_time = utils::get_current_time() - analysis_start_time;
         timing_info["analysis_seconds"] = analysis_time;
-        std::cout << "✅ [视频分析] 分析完成，耗时: " << analysis_time << " 秒" << std::endl;
-        std::cout << "⏰ [时间戳] 分析完成时间: " << utils::get_formatted_timestamp() << std::endl;
+        LOG_DEBUG("✅ [视频分析] 分析完成", {{"seconds", analysis_time}, {"success", result.success}});
 
         // 高效分析方法无需清理临时文件（已自动处理）
 
-        if (result.success)
-        {
-            // 保存到数据库
-            double db_start_time = utils::get_current_time();
+        if (result.success)
+        {
+            // 保存到数据库
+            double db_start_time = utils::get_current_time();
+            if (request.save_to_db)
+            {
+                if (save_to_database(result, request.media_url, "video"))
+                {
+                    double db_time = utils::get_current_time() - db_start_time;
+                    timing_info["database_seconds"] = db_time;
+                    LOG_DEBUG("✅ [数据库] 保存完成", {{"seconds", db_time}});
+
+                    response.data["saved_to_db"] = true;
+                }
+                else
+                {
+                    LOG_WARN("❌ [数据库] 保存失败", {{"url", request.media_url}});
+                    response.data["saved_to_db"] = false;
+                    response.message += "，但结果未保存到数据库";
+                }
+            }
+            else
+            {
+                LOG_TRACE("⏭️ [数据库] 跳过保存（save_to_db=false）");
+            }
+
+            response.success = true;
+            response.message = "视频分析成功";
+            response.data = {
+                {"content", result.content},
+                {"tags", analyzer_->extract_tags(result.content)},
+                {"response_time", result.response_time},
+                {"usage", result.usage},
+                {"cached", result.cached},
+                {"timing", timing_info}};
+
+            double total_time = utils::get_current_time() - total_start_time;
+            LOG_INFO("🎉 [完成] 视频分析请求处理完成", {{"url", request.media_url}, {"seconds", total_time}});
+        }
+        else
+        {
+            LOG_WARN("❌ [错误] 视频分析失败", {{"url", request.media_url}, {"error", result.error}});
+            response.success = false;
+            response.message = "视频分析失败: " + result.error;
+            response.error = result.error;
+        }
+    }
+    catch (const std::exception &e)
+    {
+        LOG_ERROR("❌ [异常] 视频分析异常", {{"url", request.media_url}, {"error", e.what()}});
+        response.success = false;
+        response.message = "视频分析异常: " + std::string(e.what());
+        response.error = "Video analysis error";
+    }
+
+    return response;
+}
+
+ApiResponse ApiServer::handle_upload_analysis(const ApiRequest &request, std::string_view data, const std::string &file_path)
+{
+    ApiResponse response;
+
+    try
+    {
+        AnalysisResult result;
+        if (request.media_type == "image")
+        {
+            // 图片直接在内存中编码，不经过临时文件
+            std::string prompt = request.prompt.empty() ? get_image_prompt() : request.prompt;
+            result = analyzer_->analyze_image_data(data, prompt, request.max_tokens, request.model_name);
+        }
+        else
+        {
+            // ffmpeg需要从文件读取视频：请求体已写入临时文件时直接使用，否则写出一份
+            std::string video_path = file_path;
+            std::shared_ptr<void> cleanup;
+            if (video_path.empty())
+            {
+                std::string path = upload_policy_->spool_dir + "/upload_video_XXXXXX";
+                int fd = mkstemp(&path[0]);
+                if (fd < 0)
+                    throw std::runtime_error("无法创建临时文件: " + std::string(strerror(errno)));
+                cleanup = std::shared_ptr<void>(nullptr, [path](void *)
+                                                { unlink(path.c_str()); });
+
+                size_t written = 0;
+                while (written < data.size())
+                {
+                    ssize_t n = write(fd, data.data() + written, data.size() - written);
+                    if (n < 0 && errno == EINTR)
+                        continue;
+                    if (n < 0)
+                    {
+                        close(fd);
+                        throw std::runtime_error("写入临时文件失败: " + std::string(strerror(errno)));
+                    }
+                    written += static_cast<size_t>(n);
+                }
+                close(fd);
+                video_path = path;
+            }
+
+            std::string prompt = request.prompt.empty() ? get_video_prompt() : request.prompt;
+            result = analyzer_->analyze_video_efficiently(
+                video_path,
+                prompt,
+                request.max_tokens,
+                "keyframes",
+                request.video_frames,
+                request.model_name);
+        }
+
+        if (result.success)
+        {
+            response.success = true;
+            response.message = request.media_type == "image" ? "图片分析成功" : "视频分析成功";
+            response.data = {
+                {"content", result.content},
+                {"tags", analyzer_->extract_tags(result.content)},
+                {"response_time", result.response_time},
+                {"usage", result.usage},
+                {"cached", result.cached}};
+
+            // 保存到数据库（路径记录为upload://文件名）
             if (request.save_to_db)
             {
-                std::cout << "💾 [数据库] 开始保存分析结果到数据库..." << std::endl;
-                std::cout << "⏰ [时间戳] 数据库保存开始时间: " << utils::get_formatted_timestamp() << std::endl;
-
-                if (save_to_database(result, request.media_url, "video"))
+                if (save_to_database(result, request.media_url, request.media_type))
                 {
-                    double db_time = utils::get_current_time() - db_start_time;
-                    timing_info["database_seconds"] = db_time;
-                    std::cout << "✅ [数据库] 保存完成，耗时: " << db_time << " 秒" << std::endl;
-                    std::cout << "⏰ [时间戳] 数据库保存完成时间: " << utils::get_formatted_timestamp() << std::endl;
-
                     response.data["saved_to_db"] = true;
                 }
                 else
                 {
-                    std::cout << "❌ [数据库] 保存失败" << std::endl;
                     response.data["saved_to_db"] = false;
                     response.message += "，但结果未保存到数据库";
                 }
             }
-            else
-            {
-                std::cout << "⏭️ [数据库] 跳过保存（save_to_db=false）" << std::endl;
-            }
-
-            response.success = true;
-            response.message = "视频分析成功";
-            response.data = {
-                {"content", result.content},
-                {"tags", analyzer_->extract_tags(result.content)},
-                {"response_time", result.response_time},
-                {"usage", result.usage},
-                {"timing", timing_info}};
-
-            double total_time = utils::get_current_time() - total_start_time;
-            std::cout << "🎉 [完成] 视频分析请求处理完成，总耗时: " << total_time << " 秒" << std::endl;
-            std::cout << "⏰ [时间戳] 请求处理完成时间: " << utils::get_formatted_timestamp() << std::endl;
         }
         else
         {
-            std::cout << "❌ [错误] 视频分析失败: " << result.error << std::endl;
             response.success = false;
-            response.message = "视频分析失败: " + result.error;
+            response.message = (request.media_type == "image" ? "图片分析失败: " : "视频分析失败: ") + result.error;
             response.error = result.error;
         }
     }
     catch (const std::exception &e)
     {
-        std::cout << "❌ [异常] 视频分析异常: " << e.what() << std::endl;
+        LOG_ERROR("❌ 上传分析异常", {{"file", request.media_url}, {"error", e.what()}});
         response.success = false;
-        response.message = "视频分析异常: " + std::string(e.what());
-        response.error = "Video analysis error";
+        response.message = "上传分析异常: " + std::string(e.what());
+        response.error = "Upload analysis error";
     }
 
     return response;
@@ -1375,7 +2553,7 @@ bool ApiServer::save_to_database(const AnalysisResult &result, const std::string
     }
     catch (const std::exception &e)
     {
-        std::cerr << "❌ 保存到数据库失败: " << e.what() << std::endl;
+        LOG_ERROR("❌ 保存到数据库失败", {{"url", media_url}, {"error", e.what()}});
         return false;
     }
 }
@@ -1387,6 +2565,45 @@ nlohmann::json ApiServer::get_status()
     status["api_key_set"] = !api_key_.empty();
     status["port"] = port_;
     status["host"] = host_;
+    status["connections"] = {
+        {"open", open_connections_.load()},
+        {"io_threads", io_loops_.size()},
+        {"reused_requests", reused_requests_.load()},
+        {"keep_alive_timeout", keep_alive_timeout_seconds_},
+        {"max_requests_per_connection", max_requests_per_connection_},
+        {"max_pipeline_depth", max_pipeline_depth_},
+        {"stream_buffer_limit", stream_buffer_limit_},
+        {"aborted_streams", aborted_streams_.load()}};
+    status["jobs"] = JobManager::getInstance().get_stats();
+    status["executors"] = {
+        {control_executor_->get_name(), control_executor_->get_stats()},
+        {query_executor_->get_name(), query_executor_->get_stats()},
+        {analysis_executor_->get_name(), analysis_executor_->get_stats()}};
+    status["admission"] = admission_.get_stats();
+    status["compression"] = {
+        {"min_size", compression_min_size_},
+        {"compressed_responses", compressed_responses_.load()},
+        {"input_bytes", compression_input_bytes_.load()},
+        {"output_bytes", compression_output_bytes_.load()}};
+    status["logging"] = Logger::getInstance().get_stats();
+    status["tracing"] = Tracer::getInstance().get_stats();
+    status["upstream"] = ConcurrencyLimiter::get_all_stats();
+    status["upstream_http"] = CurlMultiClient::getInstance().get_stats();
+    status["backends"] = BackendPool::get_all_stats();
+    status["hedging"] = HedgePolicy::get_all_stats();
+    status["result_cache"] = ResultCache::getInstance().get_stats();
+    status["upload_spool"] = UploadSpooler::getInstance().get_stats();
+    status["download_hosts"] = CurlShare::get_stats();
+    status["auth"] = {
+        {"required", require_auth_},
+        {"token_cache", jwt::GetCacheStats()},
+        {"refresh_tokens", RefreshTokenStore::getInstance().get_stats()}};
+    status["stages"] = Metrics::getInstance().get_stage_stats();
+    if (supervisor_)
+    {
+        status["worker_index"] = supervisor_->current_index();
+        status["workers"] = supervisor_->get_status();
+    }
 
     // 获取数据库统计信息
     try
@@ -1401,6 +2618,59 @@ nlohmann::json ApiServer::get_status()
     return status;
 }
 
+std::string ApiServer::render_metrics()
+{
+    std::string out;
+    out.reserve(32 * 1024);
+
+    // 已注册的计数器、直方图（各处理阶段耗时、上游请求、数据库连接池等）
+    Metrics::getInstance().render(out);
+
+    // 以下为抓取时读取的队列深度和连接数
+    std::vector<std::pair<MetricLabels, double>> queued;
+    std::vector<std::pair<MetricLabels, double>> active;
+    for (RouteExecutor *executor : {control_executor_.get(), query_executor_.get(), analysis_executor_.get()})
+    {
+        queued.push_back({{{"executor", executor->get_name()}}, static_cast<double>(executor->get_queue_size())});
+        active.push_back({{{"executor", executor->get_name()}}, static_cast<double>(executor->get_active_count())});
+    }
+    Metrics::render_samples(out, "doubao_executor_queued", "执行器中排队的请求数", "gauge", queued);
+    Metrics::render_samples(out, "doubao_executor_active", "执行器中正在处理的请求数", "gauge", active);
+
+    TaskManager &task_manager = TaskManager::getInstance();
+    Metrics::render_samples(out, "doubao_task_queue_pending", "任务管理器中排队的分析任务数", "gauge",
+                            {{{}, static_cast<double>(task_manager.getPendingTaskCount())}});
+    Metrics::render_samples(out, "doubao_task_active", "任务管理器中正在执行的分析任务数", "gauge",
+                            {{{}, static_cast<double>(task_manager.getActiveThreadCount())}});
+    Metrics::render_samples(out, "doubao_tasks_completed_total", "任务管理器已完成的分析任务数", "counter",
+                            {{{}, static_cast<double>(task_manager.getCompletedTaskCount())}});
+    Metrics::render_samples(out, "doubao_tasks_coalesced_total", "合并到相同的进行中任务、没有单独执行的分析任务数", "counter",
+                            {{{}, static_cast<double>(task_manager.getCoalescedTaskCount())}});
+
+    Metrics::render_samples(out, "doubao_task_awaiting_upstream", "已发出模型请求、等待响应的分析任务数", "gauge",
+                            {{{}, static_cast<double>(task_manager.getAwaitingTaskCount())}});
+
+    nlohmann::json upstream_http = CurlMultiClient::getInstance().get_stats();
+    Metrics::render_samples(out, "doubao_upstream_transfers_in_flight", "异步HTTP客户端中进行中的上游请求数", "gauge",
+                            {{{}, upstream_http["in_flight"].get<double>()}});
+    Metrics::render_samples(out, "doubao_upstream_sockets", "异步HTTP客户端正在监听的上游socket数", "gauge",
+                            {{{}, upstream_http["sockets"].get<double>()}});
+
+    Metrics::render_samples(out, "doubao_http_open_connections", "当前打开的HTTP连接数", "gauge",
+                            {{{}, static_cast<double>(open_connections_.load())}});
+    Metrics::render_samples(out, "doubao_http_requests_received_total", "已接收的HTTP请求数", "counter",
+                            {{{}, static_cast<double>(total_requests_.load())}});
+    Metrics::render_samples(out, "doubao_admission_rejected_total", "准入控制拒绝的请求数", "counter",
+                            {{{}, static_cast<double>(admission_.get_rejected_count())}});
+    if (supervisor_)
+    {
+        Metrics::render_samples(out, "doubao_worker_index", "处理本次抓取的worker序号", "gauge",
+                                {{{}, static_cast<double>(supervisor_->current_index())}});
+    }
+
+    return out;
+}
+
 ApiResponse ApiServer::handle_query_request(const ApiQueryRequest &request)
 {
     ApiResponse response;
@@ -1502,13 +2772,12 @@ ApiResponse ApiServer::handle_query_request(const ApiQueryRequest &request)
 }
 
 // 处理Excel文件分析请求
-ApiResponse ApiServer::handle_excel_analysis(const ApiExcelRequest &request)
+ApiResponse ApiServer::handle_excel_analysis(const ApiExcelRequest &request, ChunkedResponseWriter *stream)
 {
     ApiResponse response;
     double start_time = utils::get_current_time();
 
-    std::cout << "🔄 [Excel分析] 开始处理Excel文件: " << request.excel_path << std::endl;
-    std::cout << "⏰ [时间戳] 请求接收时间: " << utils::get_formatted_timestamp() << std::endl;
+    LOG_INFO("🔄 [Excel分析] 开始处理Excel文件", {{"path", request.excel_path}});
 
     try
     {
@@ -1547,6 +2816,65 @@ ApiResponse ApiServer::handle_excel_analysis(const ApiExcelRequest &request)
             return response;
         }
 
+        // 异步模式：提交作业后立即返回，各行由作业管理器调度执行
+        if (request.async_job)
+        {
+            return submit_job("excel_analyze", tasks, {{"excel_path", request.excel_path}, {"output_path", request.output_path}});
+        }
+
+        // 流式模式：每个任务完成后立即输出一行结果，结果不在内存中累积，分段保存到数据库；
+        // 同时在途的任务数有上限，客户端读取慢时不再继续提交新的行
+        if (stream)
+        {
+            stream->begin();
+
+            const size_t window_size = 64;
+            const size_t db_flush_size = 50;
+            std::vector<AnalysisResult> pending_db;
+            size_t successful = 0;
+
+            size_t handled = TaskManager::getInstance().runTasks(tasks, window_size, [&](size_t, TaskResult &&result)
+                                                                 {
+                nlohmann::json line = media_result_to_json(result);
+                line["type"] = "result";
+                stream->write_line(line);
+
+                if (result.success)
+                {
+                    successful++;
+                    pending_db.push_back(std::move(result.result));
+                    if (pending_db.size() >= db_flush_size)
+                    {
+                        save_batch_to_database(pending_db);
+                        pending_db.clear();
+                    }
+                }
+
+                if (stream->aborted())
+                {
+                    LOG_WARN("⚠️ [Excel分析] 客户端已断开，停止提交任务", {{"path", request.excel_path}});
+                    return false;
+                }
+                return true; });
+
+            if (!pending_db.empty())
+            {
+                save_batch_to_database(pending_db);
+            }
+
+            response.success = true;
+            response.message = "Excel文件处理完成，共分析 " + std::to_string(handled) + " 个媒体文件";
+            response.data["total_tasks"] = tasks.size();
+            response.data["successful_tasks"] = successful;
+            response.data["failed_tasks"] = handled - successful;
+            response.data["output_path"] = request.output_path;
+            response.response_time = utils::get_current_time() - start_time;
+
+            finish_stream(stream, response);
+            LOG_INFO("✅ [Excel分析] 流式处理完成", {{"path", request.excel_path}, {"tasks", handled}, {"seconds", response.response_time}});
+            return response;
+        }
+
         // 添加任务到队列并获取future列表
         auto futures = TaskManager::getInstance().addTasks(tasks);
 
@@ -1639,35 +2967,7 @@ ApiResponse ApiServer::handle_excel_analysis(const ApiExcelRequest &request)
         nlohmann::json results_json = nlohmann::json::array();
         for (const auto &result : results)
         {
-            nlohmann::json result_json;
-            result_json["task_id"] = result.task_id;
-            result_json["success"] = result.success;
-            result_json["file_id"] = result.result.raw_response.contains("file_id") ? result.result.raw_response["file_id"] : "";
-            result_json["media_url"] = result.result.raw_response.contains("path") ? result.result.raw_response["path"] : "";
-            result_json["media_type"] = result.result.raw_response.contains("type") ? result.result.raw_response["type"] : "";
-
-            if (!result.success)
-            {
-                result_json["error"] = result.error;
-            }
-            else
-            {
-                result_json["content"] = result.result.content;
-                result_json["response_time"] = result.result.response_time;
-
-                // 添加标签
-                if (result.result.raw_response.contains("tags"))
-                {
-                    result_json["tags"] = result.result.raw_response["tags"];
-                }
-                else
-                {
-                    auto extracted_tags = analyzer_->extract_tags(result.result.content);
-                    result_json["tags"] = extracted_tags;
-                }
-            }
-
-            results_json.push_back(result_json);
+            results_json.push_back(media_result_to_json(result));
         }
 
         response.data["results"] = results_json;
@@ -1677,135 +2977,120 @@ ApiResponse ApiServer::handle_excel_analysis(const ApiExcelRequest &request)
         response.success = false;
         response.message = "Excel处理失败: " + std::string(e.what());
         response.error = "Excel processing error";
+
+        if (stream && stream->started())
+        {
+            finish_stream(stream, response);
+        }
     }
 
     response.response_time = utils::get_current_time() - start_time;
-    std::cout << "✅ [Excel分析] 处理完成，耗时: " << response.response_time << " 秒" << std::endl;
+    LOG_INFO("✅ [Excel分析] 处理完成", {{"path", request.excel_path}, {"seconds", response.response_time}});
 
     return response;
 }
 
 // 处理批量分析请求
-ApiResponse ApiServer::handle_batch_analysis(const std::vector<ApiRequest> &requests)
+ApiResponse ApiServer::handle_batch_analysis(const std::vector<ApiRequest> &requests, bool async_job, ChunkedResponseWriter *stream)
 {
+    // 异步模式：一次性创建所有任务并提交作业，立即返回作业ID
+    if (async_job)
+    {
+        std::vector<AnalysisTask> tasks;
+        tasks.reserve(requests.size());
+        for (size_t i = 0; i < requests.size(); ++i)
+        {
+            tasks.push_back(create_analysis_task(requests[i], "batch_" + std::to_string(i)));
+        }
+        return submit_job("batch_analyze", tasks);
+    }
+
     ApiResponse response;
     nlohmann::json timing_info = nlohmann::json::object();
     double total_start_time = utils::get_current_time();
 
-    std::cout << "🔄 [批量分析] 开始处理 " << requests.size() << " 个媒体文件" << std::endl;
-    std::cout << "⏰ [时间戳] 请求接收时间: " << utils::get_formatted_timestamp() << std::endl;
+    LOG_INFO("🔄 [批量分析] 开始处理", {{"count", requests.size()}});
 
     try
     {
-        // 分批次处理请求，每批5个（减小批次大小以降低内存压力）
-        const size_t batch_size = 5;
-        size_t total_batches = (requests.size() + batch_size - 1) / batch_size;
+        // 滑动窗口：同时最多5个任务在途（降低内存压力），每完成一个就补交下一个，
+        // 结果按完成顺序输出，慢任务不会挡住已完成的结果
+        const size_t window_size = 5;
+        const size_t db_flush_size = 50;
+
+        std::vector<AnalysisTask> tasks;
+        tasks.reserve(requests.size());
+        for (size_t i = 0; i < requests.size(); ++i)
+        {
+            tasks.push_back(create_analysis_task(requests[i], "batch_" + std::to_string(i) + "_" + utils::get_current_timestamp()));
+        }
 
-        std::cout << "🔄 [批次处理] 准备分 " << total_batches << " 批次处理 " << requests.size() << " 个请求，每批次最多 " << batch_size << " 个" << std::endl;
+        LOG_DEBUG("🔄 [批量分析] 开始执行任务", {{"count", tasks.size()}, {"window", window_size}});
 
-        // 用于存储所有任务结果
-        std::vector<TaskResult> all_results;
+        // 非流式模式按请求顺序返回所有结果（流式模式下结果直接输出，不在内存中累积）
+        std::vector<TaskResult> all_results(stream ? 0 : tasks.size());
+        std::vector<AnalysisResult> pending_db;
+        int success_count = 0;
 
-        // 分批次处理
-        for (size_t i = 0; i < total_batches; ++i)
+        // 流式模式：先发出响应头，客户端可立即开始接收结果
+        if (stream)
         {
-            size_t start_idx = i * batch_size;
-            size_t end_idx = std::min(start_idx + batch_size, requests.size());
-
-            std::cout << "🔍 [批次处理] 正在处理第 " << (i + 1) << "/" << total_batches << " 批次，包含 " << (end_idx - start_idx) << " 个请求" << std::endl;
-
-            // 创建当前批次的任务列表
-            std::vector<AnalysisTask> batch_tasks;
-            batch_tasks.reserve(end_idx - start_idx);
+            stream->begin();
+        }
 
-            for (size_t j = start_idx; j < end_idx; ++j)
+        TaskManager::getInstance().runTasks(tasks, window_size, [&](size_t index, TaskResult &&taskResult)
+                                            {
+            if (taskResult.success)
             {
-                const auto &req = requests[j];
-
-                AnalysisTask task;
-                task.id = "batch_" + std::to_string(j) + "_" + utils::get_current_timestamp();
-                task.media_url = req.media_url;
-                task.media_type = req.media_type;
-                // 大模型
-                task.model_name = req.model_name;
-                //
-                task.prompt = req.prompt.empty() ? (req.media_type == "video" ? get_video_prompt() : get_image_prompt()) : req.prompt;
-                task.max_tokens = req.max_tokens > 0 ? req.max_tokens : config::DEFAULT_MAX_TOKENS;
-                task.video_frames = req.video_frames > 0 ? req.video_frames : config::DEFAULT_VIDEO_FRAMES;
-                task.save_to_db = req.save_to_db;
-
-                batch_tasks.push_back(task);
+                success_count++;
+                pending_db.push_back(taskResult.result);
             }
 
-            // 添加当前批次任务到队列并获取future列表
-            auto futures = TaskManager::getInstance().addTasks(batch_tasks);
-
-            // 用于存储当前批次的结果
-            std::vector<AnalysisResult> batch_results;
-
-            // 等待当前批次的所有任务完成
-            for (auto &future : futures)
+            if (stream)
             {
-                TaskResult taskResult = future.get();
-                all_results.push_back(taskResult);
-
-                // 将成功的分析结果添加到当前批次结果
-                if (taskResult.success)
-                {
-                    batch_results.push_back(taskResult.result);
-                }
+                nlohmann::json line = batch_result_to_json(taskResult);
+                line["type"] = "result";
+                stream->write_line(line);
             }
-
-            // 直接保存当前批次的结果到数据库
-            if (!batch_results.empty())
+            else
             {
-                std::cout << "💾 [数据库保存] 正在保存第 " << (i + 1) << "/" << total_batches << " 批次结果，包含 " << batch_results.size() << " 条记录" << std::endl;
+                all_results[index] = std::move(taskResult);
+            }
 
-                if (!save_batch_to_database(batch_results))
-                {
-                    std::cerr << "❌ [数据库保存] 第 " << (i + 1) << " 批次保存失败" << std::endl;
-                }
-                else
+            // 成功的结果分段保存到数据库
+            if (pending_db.size() >= db_flush_size)
+            {
+                if (!save_batch_to_database(pending_db))
                 {
-                    std::cout << "✅ [数据库保存] 第 " << (i + 1) << " 批次保存成功" << std::endl;
+                    LOG_ERROR("❌ [数据库保存] 批量保存失败", {{"count", pending_db.size()}});
                 }
+                pending_db.clear();
             }
 
-            std::cout << "✅ [批次处理] 第 " << (i + 1) << " 批次处理完成" << std::endl;
-        }
+            // 客户端断开后不再提交剩余任务
+            return !(stream && stream->aborted()); });
 
-        std::cout << "🎉 [批次处理] 所有批次处理完成，共处理 " << all_results.size() << " 个任务" << std::endl;
+        if (!pending_db.empty() && !save_batch_to_database(pending_db))
+        {
+            LOG_ERROR("❌ [数据库保存] 批量保存失败", {{"count", pending_db.size()}});
+        }
 
-        // 构建响应数据
-        nlohmann::json results_array = nlohmann::json::array();
-        int success_count = 0;
+        LOG_DEBUG("🎉 [批量分析] 所有任务处理完成", {{"count", requests.size()}});
 
-        for (const auto &result : all_results)
+        // 构建响应数据（流式模式下结果已逐条输出）
+        if (!stream)
         {
-            nlohmann::json result_obj;
-            result_obj["task_id"] = result.task_id;
-            result_obj["success"] = result.success;
-
-            if (result.success)
-            {
-                result_obj["content"] = result.result.content;
-                result_obj["tags"] = utils::extract_tags(result.result.content);
-                result_obj["response_time"] = result.result.response_time;
-                result_obj["usage"] = result.result.usage;
-                success_count++;
-            }
-            else
+            nlohmann::json results_array = nlohmann::json::array();
+            for (const auto &result : all_results)
             {
-                result_obj["error"] = result.error;
+                results_array.push_back(batch_result_to_json(result));
             }
-
-            results_array.push_back(result_obj);
+            response.data["results"] = results_array;
         }
 
         // 设置响应
         response.success = true;
         response.message = "批量分析完成，成功: " + std::to_string(success_count) + "/" + std::to_string(requests.size());
-        response.data["results"] = results_array;
         response.data["summary"] = {
             {"total", requests.size()},
             {"successful", success_count},
@@ -1816,9 +3101,7 @@ ApiResponse ApiServer::handle_batch_analysis(const std::vector<ApiRequest> &requ
         timing_info["pending_tasks"] = TaskManager::getInstance().getPendingTaskCount();
         timing_info["active_threads"] = TaskManager::getInstance().getActiveThreadCount();
 
-        std::cout << "✅ [批量分析] 处理完成，成功: " << success_count << "/" << requests.size() << std::endl;
-        std::cout << "⏰ [时间戳] 请求处理完成时间: " << utils::get_formatted_timestamp() << std::endl;
-        std::cout << "🎉 [完成] 批量分析请求处理完成，总耗时: " << total_time << " 秒" << std::endl;
+        LOG_INFO("🎉 [完成] 批量分析请求处理完成", {{"succeeded", success_count}, {"count", requests.size()}, {"seconds", total_time}});
     }
     catch (const std::exception &e)
     {
@@ -1826,14 +3109,93 @@ ApiResponse ApiServer::handle_batch_analysis(const std::vector<ApiRequest> &requ
         response.message = "批量分析失败: " + std::string(e.what());
         response.error = "Batch analysis error";
 
-        std::cerr << "❌ [批量分析] 异常: " << e.what() << std::endl;
+        LOG_ERROR("❌ [批量分析] 异常", {{"error", e.what()}});
     }
 
     response.data["timing"] = timing_info;
     response.response_time = utils::get_current_time() - total_start_time;
 
+    if (stream)
+    {
+        finish_stream(stream, response);
+    }
+
     return response;
 }
+
+nlohmann::json ApiServer::batch_result_to_json(const TaskResult &result)
+{
+    nlohmann::json result_obj;
+    result_obj["task_id"] = result.task_id;
+    result_obj["success"] = result.success;
+
+    if (result.success)
+    {
+        result_obj["content"] = result.result.content;
+        result_obj["tags"] = utils::extract_tags(result.result.content);
+        result_obj["response_time"] = result.result.response_time;
+        result_obj["usage"] = result.result.usage;
+        result_obj["cached"] = result.result.cached;
+    }
+    else
+    {
+        result_obj["error"] = result.error;
+    }
+
+    return result_obj;
+}
+
+nlohmann::json ApiServer::media_result_to_json(const TaskResult &result)
+{
+    nlohmann::json result_json;
+    result_json["task_id"] = result.task_id;
+    result_json["success"] = result.success;
+    result_json["file_id"] = result.result.raw_response.contains("file_id") ? result.result.raw_response["file_id"] : "";
+    result_json["media_url"] = result.result.raw_response.contains("path") ? result.result.raw_response["path"] : "";
+    result_json["media_type"] = result.result.raw_response.contains("type") ? result.result.raw_response["type"] : "";
+
+    if (!result.success)
+    {
+        result_json["error"] = result.error;
+    }
+    else
+    {
+        result_json["content"] = result.result.content;
+        result_json["response_time"] = result.result.response_time;
+        result_json["cached"] = result.result.cached;
+
+        // 添加标签
+        if (result.result.raw_response.contains("tags"))
+        {
+            result_json["tags"] = result.result.raw_response["tags"];
+        }
+        else
+        {
+            auto extracted_tags = analyzer_->extract_tags(result.result.content);
+            result_json["tags"] = extracted_tags;
+        }
+    }
+
+    return result_json;
+}
+
+// 流式响应的最后一行：与非流式响应相同的字段（不含results），type为summary
+void ApiServer::finish_stream(ChunkedResponseWriter *stream, const ApiResponse &response)
+{
+    nlohmann::json summary;
+    summary["type"] = "summary";
+    summary["success"] = response.success;
+    summary["message"] = response.message;
+    summary["data"] = response.data;
+    summary["response_time"] = response.response_time;
+    if (!response.error.empty())
+    {
+        summary["error"] = response.error;
+    }
+
+    stream->write_line(summary);
+    stream->finish();
+}
 // 批量保存分析结果到数据库（异步处理）
 bool ApiServer::save_batch_to_database(const std::vector<AnalysisResult> &results)
 {
@@ -1845,12 +3207,12 @@ bool ApiServer::save_batch_to_database(const std::vector<AnalysisResult> &result
             try {
                 bool success = analyzer_->save_batch_results_to_database(results);
                 if (!success) {
-                    std::cerr << "❌ 异步保存到数据库失败" << std::endl;
+                    LOG_ERROR("❌ 异步保存到数据库失败", {{"count", results.size()}});
                 } else {
-                    std::cout << "✅ 异步保存到数据库成功，共 " << results.size() << " 条记录" << std::endl;
+                    LOG_DEBUG("✅ 异步保存到数据库成功", {{"count", results.size()}});
                 }
             } catch (const std::exception &e) {
-                std::cerr << "❌ 异步保存到数据库异常: " << e.what() << std::endl;
+                LOG_ERROR("❌ 异步保存到数据库异常", {{"error", e.what()}});
             } });
 
         // 分离线程，使其在后台运行
@@ -1861,19 +3223,18 @@ bool ApiServer::save_batch_to_database(const std::vector<AnalysisResult> &result
     }
     catch (const std::exception &e)
     {
-        std::cerr << "❌ 启动异步数据库保存任务失败: " << e.what() << std::endl;
+        LOG_ERROR("❌ 启动异步数据库保存任务失败", {{"error", e.what()}});
         return false;
     }
 }
 
 // 处理数据库媒体分析请求
-ApiResponse ApiServer::handle_db_media_analysis(const std::string &prompt, int max_tokens, int video_frames, bool save_to_db, const std::string &model_name, int batch_size)
+ApiResponse ApiServer::handle_db_media_analysis(const std::string &prompt, int max_tokens, int video_frames, bool save_to_db, const std::string &model_name, int batch_size, bool async_job, ChunkedResponseWriter *stream)
 {
     ApiResponse response;
     double start_time = utils::get_current_time();
 
-    std::cout << "🔄 [数据库媒体分析] 开始处理数据库中的媒体" << std::endl;
-    std::cout << "⏰ [时间戳] 请求接收时间: " << utils::get_formatted_timestamp() << std::endl;
+    LOG_INFO("🔄 [数据库媒体分析] 开始处理数据库中的媒体");
 
     try
     {
@@ -1890,125 +3251,104 @@ ApiResponse ApiServer::handle_db_media_analysis(const std::string &prompt, int m
             return response;
         }
 
-        std::cout << "📊 [数据库媒体分析] 从数据库读取到 " << media_data.size() << " 条媒体数据" << std::endl;
+        LOG_DEBUG("📊 [数据库媒体分析] 从数据库读取媒体数据", {{"count", media_data.size()}});
 
         // 创建分析任务
         std::string analysis_prompt = prompt.empty() ? get_image_prompt() : prompt;
         int tokens = max_tokens > 0 ? max_tokens : config::DEFAULT_MAX_TOKENS;
 
-        // 分批次处理数据，使用传入的batch_size参数，默认为5（减小批次大小以降低内存压力）
-        const size_t actual_batch_size = batch_size > 0 ? std::min((size_t)batch_size, (size_t)5) : 5;
-        size_t total_batches = (media_data.size() + actual_batch_size - 1) / actual_batch_size;
-
-        std::cout << "🔄 [批次处理] 准备分 " << total_batches << " 批次处理数据，每批次最多 " << actual_batch_size << " 条" << std::endl;
-
-        // 用于存储所有任务结果
-        std::vector<TaskResult> all_results;
-
-        // 分批次处理
-        for (size_t i = 0; i < total_batches; ++i)
+        // 异步模式：所有媒体作为一个作业提交，由作业管理器控制并发，无需按批次等待
+        if (async_job)
         {
-            size_t start_idx = i * actual_batch_size;
-            size_t end_idx = std::min(start_idx + actual_batch_size, media_data.size());
-
-            std::vector<ExcelRowData> batch_data(media_data.begin() + start_idx, media_data.begin() + end_idx);
-
-            std::cout << "🔍 [批次处理] 正在处理第 " << (i + 1) << "/" << total_batches << " 批次，包含 " << batch_data.size() << " 条数据" << std::endl;
-
-            // 为当前批次创建分析任务
-            auto tasks = processor.create_analysis_tasks(batch_data, analysis_prompt, tokens, video_frames, save_to_db, model_name);
+            auto tasks = processor.create_analysis_tasks(media_data, analysis_prompt, tokens, video_frames, save_to_db, model_name);
             if (tasks.empty())
             {
-                std::cout << "⚠️ [批次处理] 第 " << (i + 1) << " 批次没有有效的分析任务，跳过" << std::endl;
-                continue;
+                response.success = false;
+                response.message = "没有有效的分析任务";
+                response.error = "No valid analysis tasks";
+                return response;
             }
+            return submit_job("db_media_analyze", tasks, {{"media_count", media_data.size()}});
+        }
 
-            // 添加任务到队列并获取future列表
-            auto futures = TaskManager::getInstance().addTasks(tasks);
+        // 为所有媒体创建分析任务，以滑动窗口执行：同时在途的任务数使用传入的batch_size参数，最多5个（降低内存压力），
+        // 每完成一个就补交下一个，结果按完成顺序输出
+        const size_t window_size = batch_size > 0 ? std::min((size_t)batch_size, (size_t)5) : 5;
+        const size_t db_flush_size = 50;
+        auto tasks = processor.create_analysis_tasks(media_data, analysis_prompt, tokens, video_frames, save_to_db, model_name);
 
-            // 用于存储当前批次的结果
-            std::vector<AnalysisResult> batch_results;
+        LOG_DEBUG("🔄 [数据库媒体分析] 开始执行任务", {{"count", tasks.size()}, {"window", window_size}});
 
-            // 等待当前批次的所有任务完成
-            for (auto &future : futures)
-            {
-                TaskResult result = future.get();
-                all_results.push_back(result);
+        // 非流式模式按读取顺序返回所有结果（流式模式下结果直接输出，不在内存中累积）
+        std::vector<TaskResult> all_results(stream ? 0 : tasks.size());
+        std::vector<AnalysisResult> pending_db;
+        size_t success_count = 0;
 
-                // 将成功的分析结果添加到当前批次结果
-                if (result.success)
+        // 流式模式：先发出响应头，客户端可立即开始接收结果
+        if (stream)
+        {
+            stream->begin();
+        }
+
+        size_t processed_count = TaskManager::getInstance().runTasks(tasks, window_size, [&](size_t index, TaskResult &&result)
+                                                                     {
+            if (result.success)
+            {
+                success_count++;
+                if (save_to_db)
                 {
-                    batch_results.push_back(result.result);
+                    pending_db.push_back(result.result);
                 }
             }
 
-            // 直接保存当前批次的结果到数据库
-            if (save_to_db && !batch_results.empty())
+            if (stream)
+            {
+                nlohmann::json line = media_result_to_json(result);
+                line["type"] = "result";
+                stream->write_line(line);
+            }
+            else
             {
-                std::cout << "💾 [数据库保存] 正在保存第 " << (i + 1) << "/" << total_batches << " 批次结果，包含 " << batch_results.size() << " 条记录" << std::endl;
+                all_results[index] = std::move(result);
+            }
 
-                if (!save_batch_to_database(batch_results))
-                {
-                    std::cerr << "❌ [数据库保存] 第 " << (i + 1) << " 批次保存失败" << std::endl;
-                }
-                else
+            // 成功的结果分段保存到数据库
+            if (pending_db.size() >= db_flush_size)
+            {
+                if (!save_batch_to_database(pending_db))
                 {
-                    std::cout << "✅ [数据库保存] 第 " << (i + 1) << " 批次保存成功" << std::endl;
+                    LOG_ERROR("❌ [数据库保存] 批量保存失败", {{"count", pending_db.size()}});
                 }
+                pending_db.clear();
             }
 
-            std::cout << "✅ [批次处理] 第 " << (i + 1) << " 批次处理完成" << std::endl;
+            // 客户端断开后不再提交剩余任务
+            return !(stream && stream->aborted()); });
+
+        if (!pending_db.empty() && !save_batch_to_database(pending_db))
+        {
+            LOG_ERROR("❌ [数据库保存] 批量保存失败", {{"count", pending_db.size()}});
         }
 
-        std::cout << "🎉 [批次处理] 所有批次处理完成，共处理 " << all_results.size() << " 个任务" << std::endl;
+        LOG_INFO("🎉 [数据库媒体分析] 所有任务处理完成", {{"count", processed_count}});
 
         // 准备响应
         response.success = true;
-        response.message = "数据库媒体处理完成，共分析 " + std::to_string(all_results.size()) + " 个媒体文件";
-        response.data["total_tasks"] = all_results.size();
-        response.data["successful_tasks"] = std::count_if(all_results.begin(), all_results.end(),
-                                                          [](const TaskResult &r)
-                                                          { return r.success; });
-        response.data["failed_tasks"] = std::count_if(all_results.begin(), all_results.end(),
-                                                      [](const TaskResult &r)
-                                                      { return !r.success; });
+        response.message = "数据库媒体处理完成，共分析 " + std::to_string(processed_count) + " 个媒体文件";
+        response.data["total_tasks"] = processed_count;
+        response.data["successful_tasks"] = success_count;
+        response.data["failed_tasks"] = processed_count - success_count;
 
-        // 添加详细结果
-        nlohmann::json results_json = nlohmann::json::array();
-        for (const auto &result : all_results)
+        // 添加详细结果（流式模式下结果已逐条输出）
+        if (!stream)
         {
-            nlohmann::json result_json;
-            result_json["task_id"] = result.task_id;
-            result_json["success"] = result.success;
-            result_json["file_id"] = result.result.raw_response.contains("file_id") ? result.result.raw_response["file_id"] : "";
-            result_json["media_url"] = result.result.raw_response.contains("path") ? result.result.raw_response["path"] : "";
-            result_json["media_type"] = result.result.raw_response.contains("type") ? result.result.raw_response["type"] : "";
-
-            if (!result.success)
-            {
-                result_json["error"] = result.error;
-            }
-            else
+            nlohmann::json results_json = nlohmann::json::array();
+            for (const auto &result : all_results)
             {
-                result_json["content"] = result.result.content;
-                result_json["response_time"] = result.result.response_time;
-
-                // 添加标签
-                if (result.result.raw_response.contains("tags"))
-                {
-                    result_json["tags"] = result.result.raw_response["tags"];
-                }
-                else
-                {
-                    auto extracted_tags = analyzer_->extract_tags(result.result.content);
-                    result_json["tags"] = extracted_tags;
-                }
+                results_json.push_back(media_result_to_json(result));
             }
-
-            results_json.push_back(result_json);
+            response.data["results"] = results_json;
         }
-
-        response.data["results"] = results_json;
         response.response_time = utils::get_current_time() - start_time;
     }
     catch (const std::exception &e)
@@ -2019,5 +3359,128 @@ ApiResponse ApiServer::handle_db_media_analysis(const std::string &prompt, int m
         response.response_time = utils::get_current_time() - start_time;
     }
 
+    if (stream && stream->started())
+    {
+        finish_stream(stream, response);
+    }
+
+    return response;
+}
+
+AnalysisTask ApiServer::create_analysis_task(const ApiRequest &request, const std::string &task_id)
+{
+    AnalysisTask task;
+    task.id = task_id;
+    task.media_url = request.media_url;
+    task.media_type = request.media_type;
+    // 大模型
+    task.model_name = request.model_name;
+    task.prompt = request.prompt.empty() ? (request.media_type == "video" ? get_video_prompt() : get_image_prompt()) : request.prompt;
+    task.max_tokens = request.max_tokens > 0 ? request.max_tokens : config::DEFAULT_MAX_TOKENS;
+    task.video_frames = request.video_frames > 0 ? request.video_frames : config::DEFAULT_VIDEO_FRAMES;
+    task.save_to_db = request.save_to_db;
+    return task;
+}
+
+// 提交异步作业，结果通过 GET /api/jobs/{id} 获取
+ApiResponse ApiServer::submit_job(const std::string &type, const std::vector<AnalysisTask> &tasks, const nlohmann::json &metadata)
+{
+    ApiResponse response;
+
+    try
+    {
+        std::string job_id = JobManager::getInstance().submit(type, tasks, metadata);
+
+        response.success = true;
+        response.message = "作业已提交，共 " + std::to_string(tasks.size()) + " 个任务";
+        response.data["job_id"] = job_id;
+        response.data["status"] = "queued";
+        response.data["total_tasks"] = tasks.size();
+        response.data["status_url"] = "/api/jobs/" + job_id;
+        response.data["cancel_url"] = "/api/jobs/" + job_id + "/cancel";
+    }
+    catch (const std::exception &e)
+    {
+        response.success = false;
+        response.message = "提交作业失败: " + std::string(e.what());
+        response.error = "Job submission error";
+    }
+
+    return response;
+}
+
+ApiResponse ApiServer::handle_job_request(std::string_view path, std::string_view query)
+{
+    ApiResponse response;
+    double start_time = utils::get_current_time();
+
+    // 作业列表
+    if (path == "/api/jobs" || path == "/api/jobs/")
+    {
+        response.success = true;
+        response.message = "作业列表查询成功";
+        response.data["jobs"] = JobManager::getInstance().list_jobs();
+        response.response_time = utils::get_current_time() - start_time;
+        return response;
+    }
+
+    std::string_view job_id = path.substr(std::string_view("/api/jobs/").size());
+    bool cancel = false;
+    const std::string_view cancel_suffix = "/cancel";
+    if (job_id.size() > cancel_suffix.size() && job_id.substr(job_id.size() - cancel_suffix.size()) == cancel_suffix)
+    {
+        job_id.remove_suffix(cancel_suffix.size());
+        cancel = true;
+    }
+
+    bool found;
+    if (cancel)
+    {
+        found = JobManager::getInstance().cancel(std::string(job_id), response.data);
+    }
+    else
+    {
+        // 结果分页：?offset=0&limit=100，limit上限1000
+        size_t offset = 0;
+        size_t limit = 100;
+        try
+        {
+            std::string offset_param = get_query_param(query, "offset");
+            std::string limit_param = get_query_param(query, "limit");
+            if (!offset_param.empty())
+                offset = std::stoul(offset_param);
+            if (!limit_param.empty())
+                limit = std::min<size_t>(std::stoul(limit_param), 1000);
+        }
+        catch (const std::exception &)
+        {
+            response.success = false;
+            response.message = "offset/limit 参数无效";
+            response.error = "Invalid request format";
+            return response;
+        }
+
+        found = JobManager::getInstance().get_job(std::string(job_id), response.data, offset, limit);
+    }
+
+    if (!found)
+    {
+        response.success = false;
+        response.message = "作业不存在或已过期: " + std::string(job_id);
+        response.error = "Job not found";
+        response.data = nullptr;
+    }
+    else
+    {
+        response.success = true;
+        if (!cancel)
+            response.message = "作业查询成功";
+        else if (response.data["status"] == "completed")
+            response.message = "作业已完成，无需取消";
+        else
+            response.message = "作业已取消，正在执行的任务完成后结束";
+    }
+
+    response.response_time = utils::get_current_time() - start_time;
     return response;
 }
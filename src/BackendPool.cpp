@@ -0,0 +1,377 @@
+#include "BackendPool.hpp"
+#include "CurlMultiClient.hpp"
+#include "Logger.hpp"
+#include "Metrics.hpp"
+#include "config.hpp"
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <set>
+
+static const double LATENCY_SMOOTHING = 0.2; // 延迟滑动平均中新样本的权重
+
+static std::mutex registry_mutex;
+static std::map<std::string, std::unique_ptr<BackendPool>> &registry()
+{
+    static auto *pools = new std::map<std::string, std::unique_ptr<BackendPool>>();
+    return *pools;
+}
+
+BackendPool &BackendPool::for_url(const std::string &base_url)
+{
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    auto &item = registry()[base_url];
+    if (!item)
+    {
+        item.reset(new BackendPool(base_url));
+    }
+    return *item;
+}
+
+nlohmann::json BackendPool::get_all_stats()
+{
+    nlohmann::json stats = nlohmann::json::array();
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    for (const auto &item : registry())
+    {
+        stats.push_back(item.second->get_stats());
+    }
+    return stats;
+}
+
+std::vector<std::string> BackendPool::split_urls(const std::string &base_url)
+{
+    std::vector<std::string> urls;
+    size_t start = 0;
+    while (start <= base_url.size())
+    {
+        size_t end = base_url.find(',', start);
+        if (end == std::string::npos)
+        {
+            end = base_url.size();
+        }
+
+        std::string url = base_url.substr(start, end - start);
+        url.erase(0, url.find_first_not_of(" \t"));
+        url.erase(url.find_last_not_of(" \t") + 1);
+        if (!url.empty())
+        {
+            urls.push_back(url);
+        }
+        start = end + 1;
+    }
+    return urls;
+}
+
+std::string BackendPool::origin_of(const std::string &url)
+{
+    size_t scheme_end = url.find("://");
+    size_t host_start = scheme_end == std::string::npos ? 0 : scheme_end + 3;
+    size_t path_start = url.find('/', host_start);
+    return path_start == std::string::npos ? url : url.substr(0, path_start);
+}
+
+BackendPool::BackendPool(const std::string &base_url)
+    : base_url_(base_url), next_(0), panic_(0), warmed_up_(false)
+{
+    std::vector<std::string> urls = split_urls(base_url);
+    if (urls.empty())
+    {
+        urls.push_back(base_url);
+    }
+
+    Metrics &metrics = Metrics::getInstance();
+    std::set<std::string> origins;
+    for (const auto &url : urls)
+    {
+        auto endpoint = std::make_unique<Endpoint>();
+        endpoint->url = url;
+        // Ollama提供/api/version，vLLM等OpenAI兼容服务提供/health
+        bool is_ollama = url.find("/api/generate") != std::string::npos || url.find("/api/chat") != std::string::npos;
+        endpoint->health_url = origin_of(url) + (is_ollama ? "/api/version" : "/health");
+        origins.insert(origin_of(url));
+
+        MetricLabels labels = {{"endpoint", url}};
+        endpoint->latency_seconds = &metrics.histogram("doubao_backend_request_seconds", "发往各模型副本的请求耗时（秒）", labels);
+        endpoint->healthy_gauge = &metrics.gauge("doubao_backend_healthy", "模型副本是否参与路由（1为可用）", labels);
+        endpoint->healthy_gauge->set(1);
+        endpoints_.push_back(std::move(endpoint));
+    }
+
+    // 按副本所在的主机数扩大HTTP客户端的连接缓存
+    CurlMultiClient::getInstance().add_target_hosts(origins.size());
+
+    // 只有一个副本时没有其他副本可选，不做主动探测
+    if (endpoints_.size() > 1)
+    {
+        CurlMultiClient::getInstance().run_every(config::BACKEND_HEALTH_CHECK_INTERVAL_MS, [this]
+                                                 { check_health(); });
+        std::cout << "🔧 [后端池] 已配置 " << endpoints_.size() << " 个模型副本，按在途请求数最少路由" << std::endl;
+    }
+}
+
+bool BackendPool::available(const Endpoint &endpoint, std::chrono::steady_clock::time_point now) const
+{
+    return endpoint.probe_ok && now >= endpoint.ejected_until;
+}
+
+void BackendPool::update_gauge(Endpoint &endpoint, std::chrono::steady_clock::time_point now)
+{
+    endpoint.healthy_gauge->set(available(endpoint, now) ? 1 : 0);
+}
+
+BackendPool::Endpoint *BackendPool::acquire(const Endpoint *exclude)
+{
+    auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // 从轮转位置开始找在途请求最少的可用副本，在途数相同时各副本轮流被选中
+    Endpoint *best = nullptr;
+    size_t count = endpoints_.size();
+    for (size_t i = 0; i < count; ++i)
+    {
+        Endpoint *endpoint = endpoints_[(next_ + i) % count].get();
+        if (endpoint != exclude && available(*endpoint, now) && (!best || endpoint->in_flight < best->in_flight))
+        {
+            best = endpoint;
+        }
+    }
+
+    if (!best && exclude)
+    {
+        return nullptr;
+    }
+
+    if (!best)
+    {
+        panic_++;
+        for (size_t i = 0; i < count; ++i)
+        {
+            Endpoint *endpoint = endpoints_[(next_ + i) % count].get();
+            if (!best || endpoint->in_flight < best->in_flight)
+            {
+                best = endpoint;
+            }
+        }
+    }
+
+    next_++;
+    best->in_flight++;
+    best->requests++;
+    return best;
+}
+
+void BackendPool::release(Endpoint *endpoint, double latency_seconds, bool ok)
+{
+    auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(mutex_);
+    endpoint->in_flight--;
+
+    if (ok)
+    {
+        endpoint->consecutive_failures = 0;
+        endpoint->ejections = 0;
+        endpoint->latency_ewma = endpoint->latency_ewma == 0.0
+                                     ? latency_seconds
+                                     : endpoint->latency_ewma + (latency_seconds - endpoint->latency_ewma) * LATENCY_SMOOTHING;
+        endpoint->latency_seconds->observe(latency_seconds);
+        update_gauge(*endpoint, now);
+        return;
+    }
+
+    endpoint->failures++;
+    endpoint->consecutive_failures++;
+    // 已摘除的副本（全部不可用时仍会被选中）不再延长摘除时间
+    if (endpoint->consecutive_failures >= config::BACKEND_EJECT_AFTER_FAILURES && now >= endpoint->ejected_until)
+    {
+        eject(*endpoint, now);
+    }
+}
+
+void BackendPool::cancel(Endpoint *endpoint)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    endpoint->in_flight--;
+    endpoint->requests--;
+}
+
+void BackendPool::eject(Endpoint &endpoint, std::chrono::steady_clock::time_point now)
+{
+    int seconds = config::BACKEND_BASE_EJECTION_SECONDS << std::min(endpoint.ejections, 10);
+    seconds = std::min(seconds, config::BACKEND_MAX_EJECTION_SECONDS);
+    endpoint.ejections++;
+    endpoint.consecutive_failures = 0;
+    endpoint.ejected_until = now + std::chrono::seconds(seconds);
+    update_gauge(endpoint, now);
+
+    LOG_WARN("⚠️ [后端池] 模型副本连续请求失败，暂时摘除",
+             {{"endpoint", endpoint.url}, {"seconds", seconds}, {"ejections", endpoint.ejections}});
+}
+
+void BackendPool::warm_up()
+{
+    if (config::BACKEND_WARMUP_CONNECTIONS <= 0)
+    {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (warmed_up_)
+        {
+            return;
+        }
+        warmed_up_ = true;
+    }
+
+    // 每个副本同时发出多个轻量请求：HTTP/1.1后端各建立一个连接，HTTP/2后端等待同一个连接后复用为多个流。
+    // 完成后连接留在HTTP客户端的连接缓存中，第一批模型请求不再承担握手耗时
+    struct Progress
+    {
+        int remaining;
+        int connected = 0;
+        double connect_seconds = 0.0; // 最慢的一次建连耗时（含TLS握手）
+        std::string error;
+    };
+
+    for (auto &item : endpoints_)
+    {
+        Endpoint *endpoint = item.get();
+        auto progress = std::make_shared<Progress>();
+        progress->remaining = config::BACKEND_WARMUP_CONNECTIONS;
+
+        for (int i = 0; i < config::BACKEND_WARMUP_CONNECTIONS; ++i)
+        {
+            UpstreamRequest request;
+            request.url = endpoint->health_url;
+            request.method = "GET";
+            request.timeout = config::CONNECTION_TIMEOUT;
+            CurlMultiClient::getInstance().submit(std::move(request), [endpoint, progress](UpstreamResponse &&response)
+                                                  {
+                                                      // 有任何HTTP响应（包括404）连接都已建立
+                                                      if (response.code == CURLE_OK)
+                                                      {
+                                                          progress->connected++;
+                                                          progress->connect_seconds = std::max(progress->connect_seconds,
+                                                                                               std::max(response.connect_time, response.appconnect_time));
+                                                      }
+                                                      else
+                                                      {
+                                                          progress->error = response.error;
+                                                      }
+
+                                                      if (--progress->remaining > 0)
+                                                          return;
+                                                      if (progress->connected > 0)
+                                                      {
+                                                          LOG_INFO("🔥 [后端池] 模型副本连接预热完成",
+                                                                   {{"endpoint", endpoint->url}, {"requests", progress->connected}, {"connect_seconds", progress->connect_seconds}});
+                                                      }
+                                                      else
+                                                      {
+                                                          LOG_WARN("⚠️ [后端池] 模型副本连接预热失败", {{"endpoint", endpoint->url}, {"error", progress->error}});
+                                                      } });
+        }
+    }
+}
+
+void BackendPool::check_health()
+{
+    auto now = std::chrono::steady_clock::now();
+    std::vector<Endpoint *> targets;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto &endpoint : endpoints_)
+        {
+            // 摘除到期的副本没有状态变化事件，在这里刷新指标
+            update_gauge(*endpoint, now);
+
+            // 上一次探测还没有结果时不重复探测
+            if (!endpoint->probing)
+            {
+                endpoint->probing = true;
+                targets.push_back(endpoint.get());
+            }
+        }
+    }
+
+    for (Endpoint *endpoint : targets)
+    {
+        UpstreamRequest request;
+        request.url = endpoint->health_url;
+        request.method = "GET";
+        request.timeout = config::BACKEND_HEALTH_CHECK_TIMEOUT;
+        request.enable_http2 = false;
+        CurlMultiClient::getInstance().submit(std::move(request), [this, endpoint](UpstreamResponse &&response)
+                                              {
+                                                  // 有HTTP响应且不是5xx即认为服务存活
+                                                  bool ok = response.code == CURLE_OK && response.status > 0 && response.status < 500;
+                                                  std::string error = response.code != CURLE_OK ? response.error : "HTTP " + std::to_string(response.status);
+                                                  on_probe_result(endpoint, ok, error); });
+    }
+}
+
+void BackendPool::on_probe_result(Endpoint *endpoint, bool ok, const std::string &error)
+{
+    auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(mutex_);
+    endpoint->probing = false;
+    if (ok == endpoint->probe_ok)
+    {
+        return;
+    }
+
+    endpoint->probe_ok = ok;
+    update_gauge(*endpoint, now);
+    if (ok)
+    {
+        LOG_INFO("✅ [后端池] 模型副本健康检查恢复，重新加入路由", {{"endpoint", endpoint->url}});
+    }
+    else
+    {
+        LOG_WARN("⚠️ [后端池] 模型副本健康检查失败，停止路由", {{"endpoint", endpoint->url}, {"error", error}});
+    }
+}
+
+nlohmann::json BackendPool::get_stats() const
+{
+    auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    nlohmann::json endpoints = nlohmann::json::array();
+    for (const auto &endpoint : endpoints_)
+    {
+        double ejected_for = std::max(0.0, std::chrono::duration<double>(endpoint->ejected_until - now).count());
+        endpoints.push_back({{"url", endpoint->url},
+                             {"healthy", available(*endpoint, now)},
+                             {"probe_ok", endpoint->probe_ok},
+                             {"ejected_seconds", ejected_for},
+                             {"in_flight", endpoint->in_flight},
+                             {"requests", endpoint->requests},
+                             {"failures", endpoint->failures},
+                             {"latency_ewma", endpoint->latency_ewma},
+                             {"latency_p50", endpoint->latency_seconds->quantile(0.5)},
+                             {"latency_p95", endpoint->latency_seconds->quantile(0.95)},
+                             {"latency_p99", endpoint->latency_seconds->quantile(0.99)}});
+    }
+
+    return {{"base_url", base_url_}, {"endpoints", endpoints}, {"panic", panic_}};
+}
+
+BackendLease::BackendLease(BackendPool &pool, const BackendLease *other)
+    : pool_(pool), endpoint_(pool.acquire(other ? other->endpoint_ : nullptr)), succeeded_(false), cancelled_(false), latency_seconds_(0.0)
+{
+}
+
+BackendLease::~BackendLease()
+{
+    if (!endpoint_)
+    {
+        return;
+    }
+    if (cancelled_)
+    {
+        pool_.cancel(endpoint_);
+        return;
+    }
+    pool_.release(endpoint_, latency_seconds_, succeeded_);
+}
@@ -0,0 +1,98 @@
+#include "ChunkedResponseWriter.hpp"
+#include <cstdio>
+
+ChunkedResponseWriter::ChunkedResponseWriter(Sink sink, bool keep_alive, ContentEncoding encoding, FlowControl flow_control)
+    : sink_(std::move(sink)), flow_control_(std::move(flow_control)), keep_alive_(keep_alive), started_(false), finished_(false),
+      aborted_(false), encoding_(encoding)
+{
+}
+
+void ChunkedResponseWriter::begin(const std::string &content_type)
+{
+    if (started_)
+        return;
+    started_ = true;
+
+    std::string header = "HTTP/1.1 200 OK\r\n";
+    header += "Content-Type: " + content_type + "\r\n";
+    header += "Transfer-Encoding: chunked\r\n";
+    if (encoding_ != ContentEncoding::Identity)
+    {
+        compressor_ = std::make_unique<ResponseCompressor>(encoding_);
+        header += std::string("Content-Encoding: ") + ResponseCompressor::encoding_name(encoding_) + "\r\n";
+        header += "Vary: Accept-Encoding\r\n";
+    }
+    header += "Cache-Control: no-cache\r\n";
+    // 关闭nginx的代理缓冲，否则结果会被攒到缓冲区满才转发给客户端
+    header += "X-Accel-Buffering: no\r\n";
+    header += keep_alive_ ? "Connection: keep-alive\r\n" : "Connection: close\r\n";
+    header += "\r\n";
+
+    emit(std::move(header), false, false);
+}
+
+void ChunkedResponseWriter::write(std::string data, bool wait)
+{
+    if (finished_ || data.empty())
+        return;
+    begin();
+
+    if (compressor_)
+        send_chunk(compressor_->write(data), wait);
+    else
+        send_chunk(std::move(data), wait);
+}
+
+void ChunkedResponseWriter::send_chunk(std::string data, bool wait)
+{
+    if (data.empty())
+        return;
+
+    char size_line[24];
+    int n = snprintf(size_line, sizeof(size_line), "%zx\r\n", data.size());
+
+    OutputBuffer chunk;
+    chunk.append(std::string(size_line, n));
+    chunk.append(std::move(data));
+    chunk.append("\r\n");
+
+    emit(std::move(chunk), false, wait);
+}
+
+void ChunkedResponseWriter::emit(OutputBuffer data, bool finished, bool wait)
+{
+    if (aborted_)
+        return;
+
+    if (flow_control_ && !flow_control_(data.size(), wait))
+    {
+        // 连接已关闭（或因长时间不可写而被关闭），不再输出
+        aborted_ = true;
+        finished_ = true;
+        return;
+    }
+
+    sink_(std::move(data), finished);
+}
+
+void ChunkedResponseWriter::write_line(const nlohmann::json &line, bool wait)
+{
+    std::string data;
+    OutputBuffer::append_json(data, line);
+    data.push_back('\n');
+    write(std::move(data), wait);
+}
+
+void ChunkedResponseWriter::finish()
+{
+    if (finished_)
+        return;
+    begin();
+    finished_ = true;
+
+    // 压缩流的结尾（gzip尾部校验等）
+    if (compressor_)
+        send_chunk(compressor_->finish(), false);
+
+    emit(std::string("0\r\n\r\n"), true, false);
+}
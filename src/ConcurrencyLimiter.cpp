@@ -0,0 +1,260 @@
+#include "ConcurrencyLimiter.hpp"
+#include "Metrics.hpp"
+#include "config.hpp"
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <memory>
+
+// 梯度算法参数
+static const double RTT_TOLERANCE = 1.5;           // 短期延迟不超过基线的该倍数时不降低上限
+static const double BASELINE_RISE_SECONDS = 600.0; // 延迟基线上升的时间常数（秒），下降时按短期窗口快速跟随
+static const double SHORT_RTT_WINDOW = 10.0;       // 短期延迟的平滑窗口（样本数）
+static const double SMOOTHING = 0.2;               // 每次调整向新上限移动的比例
+static const double BACKOFF_RATIO = 0.9;           // 超时、连接失败时的乘性减小比例
+
+static std::mutex registry_mutex;
+static std::map<std::string, std::unique_ptr<ConcurrencyLimiter>> &registry()
+{
+    static auto *limiters = new std::map<std::string, std::unique_ptr<ConcurrencyLimiter>>();
+    return *limiters;
+}
+
+ConcurrencyLimiter &ConcurrencyLimiter::for_backend(const std::string &backend)
+{
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    auto &item = registry()[backend];
+    if (!item)
+    {
+        item.reset(new ConcurrencyLimiter(backend));
+    }
+    return *item;
+}
+
+nlohmann::json ConcurrencyLimiter::get_all_stats()
+{
+    nlohmann::json stats = nlohmann::json::array();
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    for (const auto &item : registry())
+    {
+        stats.push_back(item.second->get_stats());
+    }
+    return stats;
+}
+
+ConcurrencyLimiter::ConcurrencyLimiter(const std::string &backend)
+    : backend_(backend), next_ticket_(1), limit_(config::UPSTREAM_INITIAL_CONCURRENCY), long_rtt_(0.0), short_rtt_(0.0),
+      in_flight_(0), rejected_(0), dropped_(0)
+{
+    Metrics &metrics = Metrics::getInstance();
+    MetricLabels labels = {{"backend", backend}};
+    limit_gauge_ = &metrics.gauge("doubao_upstream_concurrency_limit", "上游后端当前的自适应并发上限", labels);
+    in_flight_gauge_ = &metrics.gauge("doubao_upstream_in_flight", "发往上游后端的在途请求数", labels);
+    queued_gauge_ = &metrics.gauge("doubao_upstream_queued", "等待上游并发名额的请求数", labels);
+    rejected_counter_ = &metrics.counter("doubao_upstream_rejected_total", "排队超时或排队已满而未发出的上游请求数", labels);
+    queue_wait_seconds_ = &metrics.histogram("doubao_upstream_queue_wait_seconds", "等待上游并发名额的耗时（秒）", labels);
+    update_gauges();
+}
+
+void ConcurrencyLimiter::update_gauges()
+{
+    limit_gauge_->set(static_cast<int64_t>(limit_));
+    in_flight_gauge_->set(in_flight_);
+    queued_gauge_->set(static_cast<int64_t>(waiting_.size()));
+}
+
+uint64_t ConcurrencyLimiter::acquire_async(Waiter waiter)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    // 已有请求在排队时新请求排在后面，不插队
+    if (waiting_.empty() && in_flight_ < static_cast<int>(limit_))
+    {
+        in_flight_++;
+        update_gauges();
+        lock.unlock();
+        queue_wait_seconds_->observe(0.0);
+        waiter(true);
+        return 0;
+    }
+
+    if (static_cast<int>(waiting_.size()) >= config::UPSTREAM_MAX_QUEUE)
+    {
+        rejected_++;
+        lock.unlock();
+        rejected_counter_->inc();
+        waiter(false);
+        return 0;
+    }
+
+    uint64_t ticket = next_ticket_++;
+    waiting_.push_back(Waiting{ticket, std::chrono::steady_clock::now(), std::move(waiter)});
+    update_gauges();
+    return ticket;
+}
+
+void ConcurrencyLimiter::cancel_wait(uint64_t ticket)
+{
+    if (ticket == 0)
+        return;
+
+    Waiter waiter;
+    std::chrono::steady_clock::time_point start;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = std::find_if(waiting_.begin(), waiting_.end(), [ticket](const Waiting &w)
+                               { return w.ticket == ticket; });
+        if (it == waiting_.end())
+            return;
+
+        waiter = std::move(it->waiter);
+        start = it->start;
+        waiting_.erase(it);
+        rejected_++;
+        update_gauges();
+    }
+
+    rejected_counter_->inc();
+    queue_wait_seconds_->observe(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    waiter(false);
+}
+
+std::vector<ConcurrencyLimiter::Waiter> ConcurrencyLimiter::grant_waiting()
+{
+    std::vector<Waiter> granted;
+    auto now = std::chrono::steady_clock::now();
+    while (!waiting_.empty() && in_flight_ < static_cast<int>(limit_))
+    {
+        queue_wait_seconds_->observe(std::chrono::duration<double>(now - waiting_.front().start).count());
+        granted.push_back(std::move(waiting_.front().waiter));
+        waiting_.pop_front();
+        in_flight_++;
+    }
+    return granted;
+}
+
+bool ConcurrencyLimiter::try_acquire()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!waiting_.empty() || in_flight_ >= static_cast<int>(limit_))
+    {
+        return false;
+    }
+
+    in_flight_++;
+    update_gauges();
+    return true;
+}
+
+void ConcurrencyLimiter::release(double rtt_seconds, bool dropped)
+{
+    auto now = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> lock(mutex_);
+    // 释放前的在途请求数（包含本次请求）
+    int in_flight = in_flight_--;
+
+    if (dropped)
+    {
+        // 同一周期内的多次失败只减小一次
+        dropped_++;
+        if (std::chrono::duration<double>(now - last_adjust_).count() >= short_rtt_)
+        {
+            limit_ = std::max<double>(config::UPSTREAM_MIN_CONCURRENCY, limit_ * BACKOFF_RATIO);
+            last_adjust_ = now;
+        }
+    }
+    else if (rtt_seconds > 0.0)
+    {
+        if (long_rtt_ == 0.0)
+        {
+            long_rtt_ = rtt_seconds;
+            short_rtt_ = rtt_seconds;
+        }
+        else
+        {
+            short_rtt_ += (rtt_seconds - short_rtt_) / SHORT_RTT_WINDOW;
+            // 基线近似无负载时的延迟：延迟下降时很快跟随，上升时按时间缓慢跟随（后端本身变慢时最终也会适应）；
+            // 按样本数平滑的话，持续过载时基线会很快随之升高，梯度始终接近1
+            if (short_rtt_ < long_rtt_)
+            {
+                long_rtt_ += (short_rtt_ - long_rtt_) / SHORT_RTT_WINDOW;
+            }
+            else
+            {
+                double elapsed = std::chrono::duration<double>(now - last_update_).count();
+                long_rtt_ += (short_rtt_ - long_rtt_) * std::min(1.0, elapsed / BASELINE_RISE_SECONDS);
+            }
+        }
+        last_update_ = now;
+
+        // 每个往返周期（约一个短期延迟）最多调整一次：按样本调整时吞吐越高调整越快，
+        // 而且在上一次调整的效果反映到延迟上之前就会继续调整，上限来回振荡
+        double since_adjust = std::chrono::duration<double>(now - last_adjust_).count();
+        if (since_adjust >= short_rtt_)
+        {
+            double gradient = std::max(0.5, std::min(1.0, RTT_TOLERANCE * long_rtt_ / short_rtt_));
+            double new_limit = limit_ * gradient + std::sqrt(limit_);
+            new_limit = limit_ * (1.0 - SMOOTHING) + new_limit * SMOOTHING;
+
+            // 在途请求远低于上限时，延迟反映不出后端还能承受多少，只允许降低上限
+            if (new_limit < limit_ || in_flight * 2 >= limit_)
+            {
+                limit_ = std::max<double>(config::UPSTREAM_MIN_CONCURRENCY, std::min<double>(config::UPSTREAM_MAX_CONCURRENCY, new_limit));
+            }
+            last_adjust_ = now;
+        }
+    }
+
+    // 上限提高时可能可以放行多个排队的请求；回调会发起新请求，在锁外执行
+    std::vector<Waiter> granted = grant_waiting();
+    update_gauges();
+    lock.unlock();
+
+    for (auto &waiter : granted)
+    {
+        waiter(true);
+    }
+}
+
+int ConcurrencyLimiter::get_limit() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return static_cast<int>(limit_);
+}
+
+nlohmann::json ConcurrencyLimiter::get_stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return {
+        {"backend", backend_},
+        {"limit", static_cast<int>(limit_)},
+        {"in_flight", in_flight_},
+        {"queued", waiting_.size()},
+        {"long_rtt", long_rtt_},
+        {"short_rtt", short_rtt_},
+        {"rejected", rejected_},
+        {"dropped", dropped_}};
+}
+
+ConcurrencyPermit::ConcurrencyPermit(ConcurrencyLimiter &limiter)
+    : limiter_(limiter), acquired_(limiter.try_acquire()), succeeded_(false), cancelled_(false),
+      start_(std::chrono::steady_clock::now())
+{
+}
+
+ConcurrencyPermit::ConcurrencyPermit(ConcurrencyLimiter &limiter, std::adopt_lock_t)
+    : limiter_(limiter), acquired_(true), succeeded_(false), cancelled_(false), start_(std::chrono::steady_clock::now())
+{
+}
+
+ConcurrencyPermit::~ConcurrencyPermit()
+{
+    if (acquired_ && cancelled_)
+    {
+        limiter_.release(0.0, false);
+    }
+    else if (acquired_)
+    {
+        limiter_.release(std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count(), !succeeded_);
+    }
+}
@@ -0,0 +1,389 @@
+#include "CurlMultiClient.hpp"
+#include "Logger.hpp"
+#include "config.hpp"
+#include <cstring>
+#include <iostream>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+// 单例实现
+// 实例不析构：进程退出时事件线程可能仍在运行
+CurlMultiClient &CurlMultiClient::getInstance()
+{
+    static CurlMultiClient *instance = new CurlMultiClient();
+    return *instance;
+}
+
+CurlMultiClient::CurlMultiClient()
+    : multi_(nullptr), timer_fd_(-1), in_flight_(0), submitted_(0), failed_(0), cancelled_(0), timers_(0), next_id_(1), target_hosts_(0)
+{
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+
+    multi_ = curl_multi_init();
+    curl_multi_setopt(multi_, CURLMOPT_SOCKETFUNCTION, &CurlMultiClient::socket_callback);
+    curl_multi_setopt(multi_, CURLMOPT_SOCKETDATA, this);
+    curl_multi_setopt(multi_, CURLMOPT_TIMERFUNCTION, &CurlMultiClient::timer_callback);
+    curl_multi_setopt(multi_, CURLMOPT_TIMERDATA, this);
+    // HTTP/2多路复用：同一后端的并发请求作为同一连接上的多个流发送
+    curl_multi_setopt(multi_, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+    curl_multi_setopt(multi_, CURLMOPT_MAX_CONCURRENT_STREAMS, 256L);
+    // 单个后端主机的连接数上限（超出的传输在curl内部排队，正常情况下由自适应并发限制先行约束）
+    curl_multi_setopt(multi_, CURLMOPT_MAX_HOST_CONNECTIONS, static_cast<long>(config::UPSTREAM_MAX_HOST_CONNECTIONS));
+
+    // curl要求的超时由一个timerfd实现（事件线程启动前注册）
+    timer_fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    loop_.add(timer_fd_, EPOLLIN, [this](uint32_t)
+              { on_timer(); });
+
+    thread_ = std::thread([this]
+                          { loop_.run(); });
+
+    std::cout << "🔧 [上游] 异步HTTP客户端已启动（curl_multi + epoll）" << std::endl;
+}
+
+uint64_t CurlMultiClient::submit(UpstreamRequest request, Callback callback)
+{
+    Transfer *transfer = new Transfer();
+    transfer->request = std::move(request);
+    transfer->callback = std::move(callback);
+    transfer->id = next_id_.fetch_add(1, std::memory_order_relaxed);
+    uint64_t id = transfer->id;
+
+    submitted_.fetch_add(1, std::memory_order_relaxed);
+    in_flight_.fetch_add(1, std::memory_order_relaxed);
+    loop_.post([this, transfer]
+               { start_transfer(transfer); });
+    return id;
+}
+
+void CurlMultiClient::cancel(uint64_t transfer_id)
+{
+    // 与submit投递的start_transfer按顺序执行，取消时传输一定已经开始
+    loop_.post([this, transfer_id]
+               { abort_transfer(transfer_id); });
+}
+
+std::future<UpstreamResponse> CurlMultiClient::submit(UpstreamRequest request)
+{
+    auto promise = std::make_shared<std::promise<UpstreamResponse>>();
+    std::future<UpstreamResponse> future = promise->get_future();
+    submit(std::move(request), [promise](UpstreamResponse &&response)
+           { promise->set_value(std::move(response)); });
+    return future;
+}
+
+void CurlMultiClient::run_every(int interval_ms, std::function<void()> task)
+{
+    // 定时器只能在事件线程中注册
+    loop_.post([this, interval_ms, task = std::move(task)]
+               {
+                   if (loop_.run_every(interval_ms, task))
+                       timers_.fetch_add(1, std::memory_order_relaxed); });
+}
+
+void CurlMultiClient::run_after(int delay_ms, std::function<void()> task)
+{
+    loop_.post([this, delay_ms, task = std::move(task)]
+               {
+                   bool added = loop_.run_after(delay_ms, [this, task]
+                                                {
+                                                    timers_.fetch_sub(1, std::memory_order_relaxed);
+                                                    task(); });
+                   if (added)
+                       timers_.fetch_add(1, std::memory_order_relaxed); });
+}
+
+void CurlMultiClient::add_target_hosts(size_t count)
+{
+    // multi句柄的选项只能在事件线程中修改
+    loop_.post([this, count]
+               {
+                   // 默认的连接缓存大小随当前传输数变化，请求间歇时会关闭预热好的空闲连接
+                   target_hosts_ += count;
+                   long max_connects = static_cast<long>(target_hosts_ * config::UPSTREAM_IDLE_CONNECTIONS_PER_HOST);
+                   curl_multi_setopt(multi_, CURLMOPT_MAXCONNECTS, max_connects); });
+}
+
+CURL *CurlMultiClient::acquire_easy()
+{
+    CURL *easy;
+    if (!idle_easy_.empty())
+    {
+        easy = idle_easy_.back();
+        idle_easy_.pop_back();
+        curl_easy_reset(easy);
+    }
+    else
+    {
+        easy = curl_easy_init();
+    }
+    return easy;
+}
+
+void CurlMultiClient::recycle_easy(CURL *easy)
+{
+    // 保留的空闲句柄数不超过历史最大并发的量级，多余的直接释放
+    if (idle_easy_.size() < 256)
+    {
+        idle_easy_.push_back(easy);
+    }
+    else
+    {
+        curl_easy_cleanup(easy);
+    }
+}
+
+void CurlMultiClient::start_transfer(Transfer *transfer)
+{
+    CURL *easy = acquire_easy();
+    if (!easy)
+    {
+        transfer->response.code = CURLE_OUT_OF_MEMORY;
+        transfer->response.error = "无法创建CURL句柄";
+        failed_.fetch_add(1, std::memory_order_relaxed);
+        in_flight_.fetch_sub(1, std::memory_order_relaxed);
+        transfer->callback(std::move(transfer->response));
+        delete transfer;
+        return;
+    }
+    transfer->easy = easy;
+
+    const UpstreamRequest &request = transfer->request;
+    curl_easy_setopt(easy, CURLOPT_URL, request.url.c_str());
+    curl_easy_setopt(easy, CURLOPT_CUSTOMREQUEST, request.method.c_str());
+    if (request.body || request.method == "POST")
+    {
+        // 请求体由transfer->request持有到传输结束，CURLOPT_POSTFIELDS不拷贝数据
+        static const std::string empty_body;
+        const std::string &body = request.body ? *request.body : empty_body;
+        curl_easy_setopt(easy, CURLOPT_POSTFIELDS, body.data());
+        curl_easy_setopt(easy, CURLOPT_POSTFIELDSIZE_LARGE, static_cast<curl_off_t>(body.size()));
+    }
+    curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION, &CurlMultiClient::write_callback);
+    curl_easy_setopt(easy, CURLOPT_WRITEDATA, transfer);
+    curl_easy_setopt(easy, CURLOPT_TIMEOUT, static_cast<long>(request.timeout));
+    curl_easy_setopt(easy, CURLOPT_CONNECTTIMEOUT, 10L);
+    curl_easy_setopt(easy, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(easy, CURLOPT_TCP_NODELAY, 1L);
+    curl_easy_setopt(easy, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(easy, CURLOPT_TCP_KEEPIDLE, 60L);
+    curl_easy_setopt(easy, CURLOPT_TCP_KEEPINTVL, 30L);
+    curl_easy_setopt(easy, CURLOPT_ACCEPT_ENCODING, "gzip, deflate");
+    curl_easy_setopt(easy, CURLOPT_PRIVATE, transfer);
+
+    if (request.enable_http2)
+    {
+        curl_easy_setopt(easy, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+        // 已有连接正在建立时等待它而不是另开连接，以便复用为多路流
+        curl_easy_setopt(easy, CURLOPT_PIPEWAIT, 1L);
+    }
+
+    for (const auto &header : request.headers)
+    {
+        transfer->headers = curl_slist_append(transfer->headers, header.c_str());
+    }
+    curl_easy_setopt(easy, CURLOPT_HTTPHEADER, transfer->headers);
+
+    transfers_[transfer->id] = transfer;
+    CURLMcode code = curl_multi_add_handle(multi_, easy);
+    if (code != CURLM_OK)
+    {
+        transfer->response.code = CURLE_FAILED_INIT;
+        transfer->response.error = std::string("添加传输失败: ") + curl_multi_strerror(code);
+        transfers_.erase(transfer->id);
+        curl_slist_free_all(transfer->headers);
+        recycle_easy(easy);
+        failed_.fetch_add(1, std::memory_order_relaxed);
+        in_flight_.fetch_sub(1, std::memory_order_relaxed);
+        transfer->callback(std::move(transfer->response));
+        delete transfer;
+    }
+    // 添加后curl会通过timer_callback要求立即处理，传输从on_timer开始
+}
+
+void CurlMultiClient::finish_transfers()
+{
+    int pending;
+    CURLMsg *message;
+    while ((message = curl_multi_info_read(multi_, &pending)) != nullptr)
+    {
+        if (message->msg != CURLMSG_DONE)
+            continue;
+
+        CURL *easy = message->easy_handle;
+        CURLcode result = message->data.result;
+        Transfer *transfer = nullptr;
+        curl_easy_getinfo(easy, CURLINFO_PRIVATE, &transfer);
+
+        UpstreamResponse &response = transfer->response;
+        response.code = result;
+        curl_easy_getinfo(easy, CURLINFO_RESPONSE_CODE, &response.status);
+        curl_easy_getinfo(easy, CURLINFO_NAMELOOKUP_TIME, &response.namelookup_time);
+        curl_easy_getinfo(easy, CURLINFO_CONNECT_TIME, &response.connect_time);
+        curl_easy_getinfo(easy, CURLINFO_APPCONNECT_TIME, &response.appconnect_time);
+        curl_easy_getinfo(easy, CURLINFO_PRETRANSFER_TIME, &response.pretransfer_time);
+        curl_easy_getinfo(easy, CURLINFO_STARTTRANSFER_TIME, &response.starttransfer_time);
+        curl_easy_getinfo(easy, CURLINFO_TOTAL_TIME, &response.total_time);
+        if (result != CURLE_OK)
+        {
+            response.error = curl_easy_strerror(result);
+            failed_.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        curl_multi_remove_handle(multi_, easy);
+        transfers_.erase(transfer->id);
+        curl_slist_free_all(transfer->headers);
+        recycle_easy(easy);
+        in_flight_.fetch_sub(1, std::memory_order_relaxed);
+
+        try
+        {
+            transfer->callback(std::move(response));
+        }
+        catch (const std::exception &e)
+        {
+            LOG_ERROR("❌ [上游] 完成回调异常", {{"error", e.what()}});
+        }
+        delete transfer;
+    }
+}
+
+void CurlMultiClient::abort_transfer(uint64_t transfer_id)
+{
+    auto it = transfers_.find(transfer_id);
+    if (it == transfers_.end())
+    {
+        return;
+    }
+
+    Transfer *transfer = it->second;
+    transfers_.erase(it);
+
+    // 从multi句柄中移除进行中的传输会关闭它使用的连接（HTTP/2下只重置该流）
+    curl_multi_remove_handle(multi_, transfer->easy);
+    curl_slist_free_all(transfer->headers);
+    recycle_easy(transfer->easy);
+    cancelled_.fetch_add(1, std::memory_order_relaxed);
+    in_flight_.fetch_sub(1, std::memory_order_relaxed);
+
+    transfer->response.code = CURLE_ABORTED_BY_CALLBACK;
+    transfer->response.error = "请求已取消";
+    try
+    {
+        transfer->callback(std::move(transfer->response));
+    }
+    catch (const std::exception &e)
+    {
+        LOG_ERROR("❌ [上游] 完成回调异常", {{"error", e.what()}});
+    }
+    delete transfer;
+}
+
+void CurlMultiClient::on_socket_event(curl_socket_t socket, uint32_t events)
+{
+    int flags = 0;
+    if (events & EPOLLIN)
+        flags |= CURL_CSELECT_IN;
+    if (events & EPOLLOUT)
+        flags |= CURL_CSELECT_OUT;
+    if (events & (EPOLLERR | EPOLLHUP))
+        flags |= CURL_CSELECT_ERR;
+
+    int running;
+    curl_multi_socket_action(multi_, socket, flags, &running);
+    finish_transfers();
+}
+
+void CurlMultiClient::on_timer()
+{
+    uint64_t expirations;
+    while (read(timer_fd_, &expirations, sizeof(expirations)) > 0)
+    {
+    }
+
+    int running;
+    curl_multi_socket_action(multi_, CURL_SOCKET_TIMEOUT, 0, &running);
+    finish_transfers();
+}
+
+int CurlMultiClient::socket_callback(CURL *, curl_socket_t socket, int what, void *userp, void *socketp)
+{
+    CurlMultiClient *client = static_cast<CurlMultiClient *>(userp);
+
+    if (what == CURL_POLL_REMOVE)
+    {
+        client->loop_.remove(socket);
+        return 0;
+    }
+
+    uint32_t events = 0;
+    if (what == CURL_POLL_IN || what == CURL_POLL_INOUT)
+        events |= EPOLLIN;
+    if (what == CURL_POLL_OUT || what == CURL_POLL_INOUT)
+        events |= EPOLLOUT;
+
+    if (socketp)
+    {
+        client->loop_.modify(socket, events);
+    }
+    else
+    {
+        // 首次出现的socket：注册到事件循环，并做标记以便之后区分新旧socket
+        client->loop_.add(socket, events, [client, socket](uint32_t ready)
+                          { client->on_socket_event(socket, ready); });
+        curl_multi_assign(client->multi_, socket, client);
+    }
+    return 0;
+}
+
+int CurlMultiClient::timer_callback(CURLM *, long timeout_ms, void *userp)
+{
+    CurlMultiClient *client = static_cast<CurlMultiClient *>(userp);
+
+    // timeout_ms为-1时取消定时器；为0时也通过timerfd在下一轮处理（不能在回调中调用curl_multi_socket_action）
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+    if (timeout_ms >= 0)
+    {
+        spec.it_value.tv_sec = timeout_ms / 1000;
+        spec.it_value.tv_nsec = (timeout_ms % 1000) * 1000000L;
+        if (timeout_ms == 0)
+            spec.it_value.tv_nsec = 1;
+    }
+    timerfd_settime(client->timer_fd_, 0, &spec, nullptr);
+    return 0;
+}
+
+size_t CurlMultiClient::write_callback(void *contents, size_t size, size_t nmemb, void *userp)
+{
+    size_t total_size = size * nmemb;
+    Transfer *transfer = static_cast<Transfer *>(userp);
+    if (!transfer->request.on_data)
+    {
+        transfer->response.body.append(static_cast<char *>(contents), total_size);
+        return total_size;
+    }
+
+    // 异常不能穿过curl的C代码，出错时中止该传输
+    try
+    {
+        transfer->request.on_data(static_cast<char *>(contents), total_size);
+    }
+    catch (const std::exception &e)
+    {
+        LOG_ERROR("❌ [上游] 流式数据处理异常", {{"url", transfer->request.url}, {"error", e.what()}});
+        return 0;
+    }
+    return total_size;
+}
+
+nlohmann::json CurlMultiClient::get_stats() const
+{
+    return {
+        {"in_flight", in_flight_.load()},
+        {"submitted", submitted_.load()},
+        {"failed", failed_.load()},
+        {"cancelled", cancelled_.load()},
+        {"sockets", loop_.get_handler_count() - 1 - timers_.load()}};
+}
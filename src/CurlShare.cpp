@@ -0,0 +1,56 @@
+#include "CurlShare.hpp"
+#include "BackendPool.hpp"
+#include <map>
+#include <memory>
+
+static std::mutex registry_mutex;
+static std::map<std::string, std::unique_ptr<CurlShare>> &registry()
+{
+    static auto *shares = new std::map<std::string, std::unique_ptr<CurlShare>>();
+    return *shares;
+}
+
+CURLSH *CurlShare::for_url(const std::string &url)
+{
+    std::string origin = BackendPool::origin_of(url);
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    auto &item = registry()[origin];
+    if (!item)
+    {
+        item.reset(new CurlShare(origin));
+    }
+    item->uses_++;
+    return item->share_;
+}
+
+nlohmann::json CurlShare::get_stats()
+{
+    nlohmann::json stats = nlohmann::json::array();
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    for (const auto &item : registry())
+    {
+        stats.push_back({{"host", item.first}, {"uses", item.second->uses_}});
+    }
+    return stats;
+}
+
+CurlShare::CurlShare(const std::string &origin)
+    : origin_(origin), share_(curl_share_init()), uses_(0)
+{
+    curl_share_setopt(share_, CURLSHOPT_LOCKFUNC, &CurlShare::lock_callback);
+    curl_share_setopt(share_, CURLSHOPT_UNLOCKFUNC, &CurlShare::unlock_callback);
+    curl_share_setopt(share_, CURLSHOPT_USERDATA, this);
+    curl_share_setopt(share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+}
+
+void CurlShare::lock_callback(CURL *, curl_lock_data data, curl_lock_access, void *userptr)
+{
+    // 共享和独占访问都使用互斥锁（持锁时间很短，区分读写锁没有收益）
+    static_cast<CurlShare *>(userptr)->locks_[data].lock();
+}
+
+void CurlShare::unlock_callback(CURL *, curl_lock_data data, void *userptr)
+{
+    static_cast<CurlShare *>(userptr)->locks_[data].unlock();
+}
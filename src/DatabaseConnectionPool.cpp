@@ -4,6 +4,14 @@
 #include <algorithm>
 #include <sstream>
 #include "ConfigManager.hpp"
+#include "Metrics.hpp"
+
+// 所有连接池共用的指标（进程内可能有多个连接池）
+static Gauge &pool_active_gauge()
+{
+    static Gauge &gauge = Metrics::getInstance().gauge("doubao_db_pool_active_connections", "数据库连接池中正在使用的连接数");
+    return gauge;
+}
 
 // ConnectionWrapper 实现
 ConnectionWrapper::ConnectionWrapper(MYSQL *conn, DatabaseConnectionPool *pool)
@@ -128,12 +136,20 @@ ConnectionWrapper DatabaseConnectionPool::get_connection()
         return ConnectionWrapper(nullptr, this);
     }
 
+    static Gauge &waiting = Metrics::getInstance().gauge("doubao_db_pool_waiting", "等待数据库连接的线程数");
+    static Histogram &wait_seconds = Metrics::getInstance().histogram("doubao_db_pool_wait_seconds", "获取数据库连接的等待耗时（秒）");
+    ScopedTimer wait_timer(wait_seconds);
+
     std::unique_lock<std::mutex> lock(mutex_);
 
     // 等待可用连接
     auto timeout = std::chrono::milliseconds(pool_config_.wait_timeout);
-    if (!condition_.wait_for(lock, timeout, [this]
-                             { return !available_connections_.empty() || shutdown_requested_; }))
+    waiting.add();
+    bool available = condition_.wait_for(lock, timeout, [this]
+                                         { return !available_connections_.empty() || shutdown_requested_; });
+    waiting.sub();
+    wait_timer.stop();
+    if (!available)
     {
         std::cerr << "Timeout waiting for database connection" << std::endl;
         return ConnectionWrapper(nullptr, this);
@@ -187,6 +203,7 @@ ConnectionWrapper DatabaseConnectionPool::get_connection()
     }
 
     active_connections_++;
+    pool_active_gauge().add();
 
     return ConnectionWrapper(connection, this);
 }
@@ -204,12 +221,14 @@ void DatabaseConnectionPool::return_connection(MYSQL *connection)
     {
         // 如果正在关闭，直接销毁连接
         destroy_connection(connection);
+        pool_active_gauge().sub();
         return;
     }
 
     // 将连接放回队列
     available_connections_.push(connection);
     active_connections_--;
+    pool_active_gauge().sub();
 
     // 通知等待的线程
     condition_.notify_one();
@@ -1,5 +1,6 @@
 #include "DatabaseManager.hpp"
 #include "utils.hpp"
+#include "Tracer.hpp"
 #include <iostream>
 #include <sstream>
 #include <iomanip>
@@ -183,7 +184,7 @@ bool DatabaseManager::create_refresh_token_record(const std::string &token_hash,
     return execute_query(q.str());
 }
 
-bool DatabaseManager::verify_refresh_token_record(const std::string &token_hash, std::string &out_user_id)
+bool DatabaseManager::verify_refresh_token_record(const std::string &token_hash, std::string &out_user_id, long *out_expires_at)
 {
     if (!connection_pool_ || !connection_pool_->is_valid())
         return false;
@@ -212,6 +213,8 @@ bool DatabaseManager::verify_refresh_token_record(const std::string &token_hash,
         if (now <= expires_at)
         {
             out_user_id = user;
+            if (out_expires_at)
+                *out_expires_at = expires_at;
             ok = true;
         }
     }
@@ -227,6 +230,7 @@ bool DatabaseManager::revoke_refresh_token_record(const std::string &token_hash)
 
 bool DatabaseManager::save_analysis_result(const MediaAnalysisRecord &record)
 {
+    Span span("db_save_result");
     std::stringstream query;
     query << "INSERT INTO media_analysis (file_path, file_name, file_type, analysis_result, tags, response_time, file_id) VALUES (";
     query << "'" << utils::replace_all(record.file_path, "'", "''") << "', ";
@@ -248,6 +252,9 @@ bool DatabaseManager::save_batch_results(const std::vector<MediaAnalysisRecord>
         return true;
     }
 
+    Span span("db_save_batch");
+    span.set_arg("records", static_cast<int64_t>(records.size()));
+
     // 最大重试次数
     const int max_retries = 3;
     int retry_count = 0;
@@ -2,21 +2,23 @@
 #include "utils.hpp"
 #include "config.hpp"
 #include "ConfigManager.hpp"
-#include "CurlConnectionPool.hpp"
+#include "CurlMultiClient.hpp"
+#include "StreamingResponseParser.hpp"
+#include "ConcurrencyLimiter.hpp"
+#include "BackendPool.hpp"
+#include "HedgePolicy.hpp"
+#include "ResultCache.hpp"
+#include "Logger.hpp"
+#include "Metrics.hpp"
+#include "Tracer.hpp"
 #include <curl/curl.h>
 #include <curl/easy.h>
 #include <sstream>
 #include <iostream>
 #include <algorithm>
 #include <cctype>
-
-// HTTP回调函数
-static size_t write_callback(void *contents, size_t size, size_t nmemb, std::string *response)
-{
-    size_t total_size = size * nmemb;
-    response->append(static_cast<char *>(contents), total_size);
-    return total_size;
-}
+#include <future>
+#include <atomic>
 
 // 判断是否使用Ollama API
 bool DoubaoMediaAnalyzer::is_ollama_api(const std::string &url) const
@@ -45,9 +47,6 @@ DoubaoMediaAnalyzer::DoubaoMediaAnalyzer(const std::string &api_key)
 
     curl_global_init(CURL_GLOBAL_DEFAULT);
 
-    // 初始化连接池
-    CurlConnectionPool::getInstance().initialize(20);
-
     // 从配置文件加载数据库配置
     ConfigManager config_manager;
     if (config_manager.load_config())
@@ -88,9 +87,6 @@ DoubaoMediaAnalyzer::DoubaoMediaAnalyzer(const std::string &api_key, const std::
 
     curl_global_init(CURL_GLOBAL_DEFAULT);
 
-    // 初始化连接池
-    CurlConnectionPool::getInstance().initialize(20);
-
     // 从配置文件加载数据库配置
     ConfigManager config_manager;
     if (config_manager.load_config())
@@ -126,9 +122,6 @@ DoubaoMediaAnalyzer::DoubaoMediaAnalyzer(const config::ApiConfig &api_config)
 {
     curl_global_init(CURL_GLOBAL_DEFAULT);
 
-    // 初始化连接池
-    CurlConnectionPool::getInstance().initialize(20);
-
     // 从配置文件加载数据库配置
     ConfigManager config_manager;
     if (config_manager.load_config())
@@ -163,6 +156,11 @@ DoubaoMediaAnalyzer::~DoubaoMediaAnalyzer()
     curl_global_cleanup();
 }
 
+void DoubaoMediaAnalyzer::warm_up_backends()
+{
+    BackendPool::for_url(base_url_).warm_up();
+}
+
 bool DoubaoMediaAnalyzer::test_connection()
 {
     try
@@ -175,7 +173,8 @@ bool DoubaoMediaAnalyzer::test_connection()
             // 简单的HTTP GET请求检查服务是否可用
             // std::string check_url = base_url_.substr(0, base_url_.find_last_of("/"));
             //
-            std::string check_url = base_url_.substr(0, base_url_.rfind("/api"));
+            std::string first_url = BackendPool::for_url(base_url_).first_url();
+            std::string check_url = first_url.substr(0, first_url.rfind("/api"));
             // 结果: "http://localhost:11434"
             std::cout << "🔍 [检查] 检查URL: " << check_url << std::endl;
 
@@ -248,12 +247,65 @@ bool DoubaoMediaAnalyzer::test_connection()
     }
 }
 
+// 查询结果缓存，命中时填充result（response_time为查询耗时）
+static bool find_cached_result(const std::string &cache_key, AnalysisResult &result)
+{
+    double lookup_start = utils::get_current_time();
+    ResultCache::Entry entry;
+    ResultCache::Tier tier = ResultCache::getInstance().get(cache_key, entry);
+    if (tier == ResultCache::Tier::Miss)
+    {
+        return false;
+    }
+
+    result.success = true;
+    result.cached = true;
+    result.content = std::move(entry.content);
+    result.usage = std::move(entry.usage);
+    result.raw_response = std::move(entry.raw_response);
+    result.response_time = utils::get_current_time() - lookup_start;
+    LOG_DEBUG("🗄️ [结果缓存] 命中缓存，跳过模型调用",
+              {{"tier", ResultCache::tier_name(tier)}, {"key", cache_key.substr(0, 16)}, {"seconds", result.response_time}});
+    return true;
+}
+
+// 保存成功的分析结果
+static void store_cached_result(const std::string &cache_key, const AnalysisResult &result)
+{
+    if (!result.success || result.cached)
+    {
+        return;
+    }
+
+    ResultCache::Entry entry;
+    entry.content = result.content;
+    entry.usage = result.usage;
+    entry.raw_response = result.raw_response;
+    ResultCache::getInstance().put(cache_key, std::move(entry));
+}
+
 AnalysisResult DoubaoMediaAnalyzer::analyze_single_image(const std::string &image_path,
                                                          const std::string &prompt,
                                                          int max_tokens,
-                                                         const std::string &model_name)
+                                                         const std::string &model_name,
+                                                         TokenCallback on_token)
+{
+    std::promise<AnalysisResult> promise;
+    std::future<AnalysisResult> future = promise.get_future();
+    analyze_single_image_async(image_path, prompt, max_tokens, model_name, [&promise](AnalysisResult &&result)
+                               { promise.set_value(std::move(result)); }, std::move(on_token));
+    return future.get();
+}
+
+void DoubaoMediaAnalyzer::analyze_single_image_async(const std::string &image_path,
+                                                     const std::string &prompt,
+                                                     int max_tokens,
+                                                     const std::string &model_name,
+                                                     AnalysisCallback callback,
+                                                     TokenCallback on_token)
 {
     AnalysisResult result;
+    std::vector<unsigned char> image_data;
 
     try
     {
@@ -261,44 +313,54 @@ AnalysisResult DoubaoMediaAnalyzer::analyze_single_image(const std::string &imag
         {
             result.success = false;
             result.error = "图片文件不存在: " + image_path;
-            return result;
+            callback(std::move(result));
+            return;
         }
 
-        // 记录图片编码开始时间
+        // 记录图片读取开始时间（Base64编码在写入请求体时完成）
         double encode_start = utils::get_current_time();
-        std::cout << "⏰ [性能] 开始编码图片: " << image_path << std::endl;
-        std::string image_data = utils::base64_encode_file(image_path);
+        image_data = utils::load_image_for_request(image_path);
         double encode_end = utils::get_current_time();
         double encode_time = encode_end - encode_start;
-        std::cout << "⏰ [性能] 图片编码完成，耗时: " << encode_time << " 秒" << std::endl;
-        std::cout << "⏰ [性能] 编码后大小: " << image_data.size() << " 字节" << std::endl;
+        LOG_DEBUG("⏰ [性能] 图片读取完成", {{"path", image_path}, {"seconds", encode_time}, {"bytes", image_data.size()}});
+    }
+    catch (const std::exception &e)
+    {
+        result.success = false;
+        result.error = "分析异常: " + std::string(e.what());
+        callback(std::move(result));
+        return;
+    }
 
-        // 按传递模型名称（如果有）或默认模型名称构建请求
-        std::string original_model_name = model_name_;
-        if (!model_name.empty())
+    analyze_image_bytes_async(std::move(image_data), prompt, max_tokens, model_name, std::move(callback), std::move(on_token));
+}
+
+AnalysisResult DoubaoMediaAnalyzer::analyze_image_data(std::string_view image_data,
+                                                       const std::string &prompt,
+                                                       int max_tokens,
+                                                       const std::string &model_name)
+{
+    AnalysisResult result;
+
+    try
+    {
+        if (image_data.empty())
         {
-            original_model_name = model_name;
+            result.success = false;
+            result.error = "图片数据为空";
+            return result;
         }
 
-        // 记录载荷构建开始时间
-        double payload_start = utils::get_current_time();
-        nlohmann::json payload = {
-            {"model", original_model_name},
-            {"messages", {{{"role", "user"}, {"content", {{{"type", "image_url"}, {"image_url", {{"url", "data:image/jpeg;base64," + image_data}}}}, {{"type", "text"}, {"text", prompt}}}}}}},
-            {"max_tokens", max_tokens},
-            {"temperature", config::DEFAULT_TEMPERATURE},
-            {"stream", false}};
-        double payload_end = utils::get_current_time();
-        double payload_time = payload_end - payload_start;
-        std::cout << "⏰ [性能] 载荷构建完成，耗时: " << payload_time << " 秒" << std::endl;
-
-        // 记录API请求开始时间
-        double request_start = utils::get_current_time();
-        std::cout << "⏰ [性能] 开始发送API请求，使用模型: " << original_model_name << std::endl;
-        result = send_analysis_request(payload, config::IMAGE_ANALYSIS_TIMEOUT);
-        double request_end = utils::get_current_time();
-        result.response_time = request_end - request_start;
-        std::cout << "⏰ [性能] API请求完成，总耗时: " << result.response_time << " 秒" << std::endl;
+        double encode_start = utils::get_current_time();
+        std::vector<unsigned char> prepared = utils::prepare_image_for_request(image_data);
+        LOG_DEBUG("⏰ [性能] 图片预处理完成",
+                  {{"input_bytes", image_data.size()}, {"seconds", utils::get_current_time() - encode_start}, {"bytes", prepared.size()}});
+
+        std::promise<AnalysisResult> promise;
+        std::future<AnalysisResult> future = promise.get_future();
+        analyze_image_bytes_async(std::move(prepared), prompt, max_tokens, model_name, [&promise](AnalysisResult &&result)
+                                  { promise.set_value(std::move(result)); });
+        result = future.get();
     }
     catch (const std::exception &e)
     {
@@ -309,6 +371,78 @@ AnalysisResult DoubaoMediaAnalyzer::analyze_single_image(const std::string &imag
     return result;
 }
 
+void DoubaoMediaAnalyzer::analyze_image_bytes_async(std::vector<unsigned char> image_data,
+                                                    const std::string &prompt,
+                                                    int max_tokens,
+                                                    const std::string &model_name,
+                                                    AnalysisCallback callback,
+                                                    TokenCallback on_token)
+{
+    // 按送给模型之前的规范化图片字节查询结果缓存（Ollama的压缩参数不变，不影响键）
+    std::string original_model_name = model_name.empty() ? model_name_ : model_name;
+    std::string cache_key = ResultCache::make_key(ResultCache::media_hash(image_data), prompt, original_model_name, max_tokens, 0);
+    AnalysisResult cached;
+    if (find_cached_result(cache_key, cached))
+    {
+        if (on_token && !cached.content.empty())
+        {
+            on_token(cached.content);
+        }
+        callback(std::move(cached));
+        return;
+    }
+
+    UpstreamRequest request;
+    try
+    {
+        prepare_image_for_backend(image_data);
+
+        // 请求体一次写出，图片字节直接编码进请求体
+        PayloadWriter writer = make_payload_writer(model_name, max_tokens);
+        writer.set_stream(on_token != nullptr);
+        writer.add_image(image_data);
+        writer.add_text(prompt);
+        request = build_analysis_request(writer, config::IMAGE_ANALYSIS_TIMEOUT);
+    }
+    catch (const std::exception &e)
+    {
+        callback(request_error_result(e.what()));
+        return;
+    }
+
+    // 记录API请求开始时间
+    double request_start = utils::get_current_time();
+    send_upstream_request_async(std::move(request), config::IMAGE_ANALYSIS_TIMEOUT,
+                                [request_start, original_model_name, cache_key, callback = std::move(callback)](AnalysisResult &&result)
+                                {
+                                    double request_end = utils::get_current_time();
+                                    result.response_time = request_end - request_start;
+                                    LOG_DEBUG("⏰ [性能] API请求完成", {{"model", original_model_name}, {"seconds", result.response_time}});
+                                    store_cached_result(cache_key, result);
+                                    callback(std::move(result));
+                                },
+                                std::move(on_token));
+}
+
+UpstreamRequest DoubaoMediaAnalyzer::build_video_request(std::vector<std::vector<unsigned char>> &frames,
+                                                         const std::string &prompt,
+                                                         int max_tokens,
+                                                         const std::string &model_name,
+                                                         bool stream)
+{
+    // 构建多图消息：提示词在前，每帧后附带序号说明
+    PayloadWriter writer = make_payload_writer(model_name, max_tokens);
+    writer.set_stream(stream);
+    writer.add_text(prompt);
+    for (size_t i = 0; i < frames.size(); ++i)
+    {
+        prepare_image_for_backend(frames[i]);
+        writer.add_image(frames[i], "low");
+        writer.add_text("这是视频的第" + std::to_string(i + 1) + "个关键帧");
+    }
+    return build_analysis_request(writer, config::VIDEO_ANALYSIS_TIMEOUT);
+}
+
 AnalysisResult DoubaoMediaAnalyzer::analyze_single_video(const std::string &video_path,
                                                          const std::string &prompt,
                                                          int max_tokens,
@@ -326,67 +460,30 @@ AnalysisResult DoubaoMediaAnalyzer::analyze_single_video(const std::string &vide
             return result;
         }
 
-        std::cout << "🎬 正在提取视频关键帧..." << std::endl;
-        std::cout << "⏰ [时间戳] 帧提取开始时间: " << utils::get_formatted_timestamp() << std::endl;
         auto frames_start_time = utils::get_current_time();
 
-        auto frames_base64 = extract_video_frames(video_path, num_frames);
+        auto frames = extract_video_frames(video_path, num_frames);
 
         double frames_time = utils::get_current_time() - frames_start_time;
-        std::cout << "⏱️ [耗时] 帧提取耗时: " << frames_time << " 秒" << std::endl;
-        std::cout << "⏰ [时间戳] 帧提取完成时间: " << utils::get_formatted_timestamp() << std::endl;
 
-        if (frames_base64.empty())
+        if (frames.empty())
         {
             result.success = false;
             result.error = "无法从视频中提取有效帧";
             return result;
         }
 
-        std::cout << "✅ 成功提取 " << frames_base64.size() << " 个关键帧" << std::endl;
-
-        // 构建多图消息
-        nlohmann::json content = nlohmann::json::array();
-        content.push_back({{"type", "text"}, {"text", prompt}});
+        LOG_DEBUG("🎬 视频关键帧提取完成", {{"path", video_path}, {"frames", frames.size()}, {"seconds", frames_time}});
 
-        for (size_t i = 0; i < frames_base64.size(); ++i)
-        {
-            content.push_back({{"type", "image_url"},
-                               {"image_url", {{"url", "data:image/jpeg;base64," + frames_base64[i]}, {"detail", "low"}}}});
-
-            content.push_back({{"type", "text"},
-                               {"text", "这是视频的第" + std::to_string(i + 1) + "个关键帧"}});
-        }
-        // 按传递模型名称（如果有）或默认模型名称构建请求
-        std::string original_model_name = model_name_;
-        if (!model_name.empty())
-        {
-            original_model_name = model_name;
-        }
-        //
-        nlohmann::json payload = {
-            {"model", original_model_name},
-            {"messages", {{{"role", "user"}, {"content", content}}}},
-            {"max_tokens", max_tokens},
-            {"temperature", config::DEFAULT_TEMPERATURE},
-            {"stream", false}};
-
-        std::cout << "📡 [API调用] 开始发送分析请求..." << std::endl;
-        std::cout << "⏰ [时间戳] API请求开始时间: " << utils::get_formatted_timestamp() << std::endl;
-        std::cout << "📊 [参数] 请求帧数: " << frames_base64.size() << std::endl;
-        std::cout << "📊 [参数] 最大令牌数: " << max_tokens << std::endl;
+        UpstreamRequest request = build_video_request(frames, prompt, max_tokens, model_name);
 
         double start_time = utils::get_current_time();
-        result = send_analysis_request(payload, config::VIDEO_ANALYSIS_TIMEOUT);
+        result = send_upstream_request(std::move(request), config::VIDEO_ANALYSIS_TIMEOUT);
         result.response_time = utils::get_current_time() - start_time;
 
-        std::cout << "⏱️ [耗时] API请求耗时: " << result.response_time << " 秒" << std::endl;
-        std::cout << "⏰ [时间戳] API请求完成时间: " << utils::get_formatted_timestamp() << std::endl;
-
-        if (result.success)
-        {
-            std::cout << "📊 [响应] 令牌使用情况: " << result.usage.dump() << std::endl;
-        }
+        LOG_DEBUG("📡 [API调用] 视频分析请求完成",
+                  {{"frames", frames.size()}, {"max_tokens", max_tokens}, {"seconds", result.response_time},
+                   {"success", result.success}, {"usage", result.success ? result.usage.dump() : std::string()}});
     }
     catch (const std::exception &e)
     {
@@ -402,7 +499,8 @@ AnalysisResult DoubaoMediaAnalyzer::analyze_video_efficiently(const std::string
                                                               int max_tokens,
                                                               const std::string &method,
                                                               int num_frames,
-                                                              const std::string &model_name)
+                                                              const std::string &model_name,
+                                                              TokenCallback on_token)
 {
     AnalysisResult result;
 
@@ -415,86 +513,71 @@ AnalysisResult DoubaoMediaAnalyzer::analyze_video_efficiently(const std::string
             return result;
         }
 
-        std::cout << "🎬 正在高效分析视频（无需完整下载）..." << std::endl;
-        std::cout << "⏰ [时间戳] 分析开始时间: " << utils::get_formatted_timestamp() << std::endl;
-        std::cout << "🔗 视频URL: " << video_url << std::endl;
-        std::cout << "📊 [方法] 使用 " << method << " 方法提取帧" << std::endl;
+        // 按传递模型名称（如果有）或默认模型名称构建请求
+        std::string original_model_name = model_name.empty() ? model_name_ : model_name;
+
+        // 抽帧之前查询结果缓存，命中时跳过下载、ffprobe和ffmpeg：本地文件按内容哈希（同一视频换了文件名也能命中），
+        // 远程视频按URL
+        std::string source_id;
+        if (utils::file_exists(video_url))
+        {
+            std::string hash = ResultCache::file_hash(video_url);
+            source_id = hash.empty() ? "path:" + video_url : "file:" + hash;
+        }
+        else
+        {
+            source_id = "url:" + video_url;
+        }
+        std::string cache_key = ResultCache::make_key(method + ":" + source_id, prompt, original_model_name,
+                                                      max_tokens, num_frames);
+        if (find_cached_result(cache_key, result))
+        {
+            result.raw_response["extraction_time"] = 0.0;
+            if (on_token && !result.content.empty())
+            {
+                on_token(result.content);
+            }
+            return result;
+        }
 
         auto frames_start_time = utils::get_current_time();
 
         // 提取关键帧或采样帧
-        std::vector<std::string> frames_base64;
+        std::vector<std::vector<unsigned char>> frames;
         if (method == "keyframes")
         {
-            frames_base64 = video_analyzer_->extract_keyframes(video_url, num_frames); // 传递请求的帧数
+            frames = video_analyzer_->extract_keyframes(video_url, num_frames); // 传递请求的帧数
         }
         else
         {
-            frames_base64 = video_analyzer_->extract_sample_frames(video_url, num_frames); // 传递请求的帧数
+            frames = video_analyzer_->extract_sample_frames(video_url, num_frames); // 传递请求的帧数
         }
 
         double frames_time = utils::get_current_time() - frames_start_time;
-        std::cout << "⏱️ [耗时] 帧提取耗时: " << frames_time << " 秒" << std::endl;
-        std::cout << "⏰ [时间戳] 帧提取完成时间: " << utils::get_formatted_timestamp() << std::endl;
 
-        if (frames_base64.empty())
+        if (frames.empty())
         {
             result.success = false;
             result.error = "无法从视频中提取有效帧";
             return result;
         }
 
-        std::cout << "✅ 成功提取 " << frames_base64.size() << " 个帧" << std::endl;
-
         // 获取视频元数据
         VideoMetadata metadata = video_analyzer_->get_video_metadata(video_url);
-        std::cout << "📹 视频信息: " << metadata.width << "x" << metadata.height
-                  << ", " << metadata.duration << "秒, " << metadata.fps << " FPS" << std::endl;
-
-        // 构建多图消息
-        nlohmann::json content = nlohmann::json::array();
-        content.push_back({{"type", "text"}, {"text", prompt}});
-
-        for (size_t i = 0; i < frames_base64.size(); ++i)
-        {
-            content.push_back({{"type", "image_url"},
-                               {"image_url", {{"url", "data:image/jpeg;base64," + frames_base64[i]}, {"detail", "low"}}}});
-
-            content.push_back({{"type", "text"},
-                               {"text", "这是视频的第" + std::to_string(i + 1) + "个关键帧"}});
-        }
-
-        // 按传递模型名称（如果有）或默认模型名称构建请求
-        std::string original_model_name = model_name_;
-        if (!model_name.empty())
-        {
-            original_model_name = model_name;
-        }
-
-        nlohmann::json payload = {
-            {"model", original_model_name},
-            {"messages", {{{"role", "user"}, {"content", content}}}},
-            {"max_tokens", max_tokens},
-            {"temperature", config::DEFAULT_TEMPERATURE},
-            {"stream", false}};
+        LOG_DEBUG("🎬 视频帧提取完成",
+                  {{"url", video_url}, {"method", method}, {"frames", frames.size()}, {"seconds", frames_time},
+                   {"width", metadata.width}, {"height", metadata.height}, {"duration", metadata.duration}, {"fps", metadata.fps}});
 
-        std::cout << "📡 [API调用] 开始发送分析请求..." << std::endl;
-        std::cout << "⏰ [时间戳] API请求开始时间: " << utils::get_formatted_timestamp() << std::endl;
-        std::cout << "📊 [参数] 请求帧数: " << frames_base64.size() << std::endl;
-        std::cout << "📊 [参数] 最大令牌数: " << max_tokens << std::endl;
-        std::cout << "📊 [参数] 使用模型: " << original_model_name << std::endl;
+        UpstreamRequest request = build_video_request(frames, prompt, max_tokens, model_name, on_token != nullptr);
 
         double start_time = utils::get_current_time();
-        result = send_analysis_request(payload, config::VIDEO_ANALYSIS_TIMEOUT);
+        result = send_upstream_request(std::move(request), config::VIDEO_ANALYSIS_TIMEOUT, std::move(on_token));
         result.response_time = utils::get_current_time() - start_time;
 
-        std::cout << "⏱️ [耗时] API请求耗时: " << result.response_time << " 秒" << std::endl;
-        std::cout << "⏰ [时间戳] API请求完成时间: " << utils::get_formatted_timestamp() << std::endl;
-
-        if (result.success)
-        {
-            std::cout << "📊 [响应] 令牌使用情况: " << result.usage.dump() << std::endl;
-        }
+        LOG_DEBUG("📡 [API调用] 视频分析请求完成",
+                  {{"model", original_model_name}, {"frames", frames.size()}, {"max_tokens", max_tokens},
+                   {"seconds", result.response_time}, {"success", result.success},
+                   {"usage", result.success ? result.usage.dump() : std::string()}});
 
         // 将视频元数据添加到响应中
         result.raw_response["video_metadata"] = {
@@ -507,7 +590,10 @@ AnalysisResult DoubaoMediaAnalyzer::analyze_video_efficiently(const std::string
 
         result.raw_response["extraction_method"] = method;
         result.raw_response["extraction_time"] = frames_time;
-        result.raw_response["frames_extracted"] = frames_base64.size();
+        result.raw_response["frames_extracted"] = frames.size();
+
+        // 元数据一并缓存，命中时的响应与首次分析一致
+        store_cached_result(cache_key, result);
     }
     catch (const std::exception &e)
     {
@@ -637,7 +723,8 @@ std::vector<std::string> DoubaoMediaAnalyzer::extract_tags(const std::string &co
 AnalysisResult DoubaoMediaAnalyzer::analyze_text(const std::string &text,
                                                  const std::string &prompt,
                                                  int max_tokens,
-                                                 const std::string &model_name)
+                                                 const std::string &model_name,
+                                                 TokenCallback on_token)
 {
     AnalysisResult result;
 
@@ -651,7 +738,7 @@ AnalysisResult DoubaoMediaAnalyzer::analyze_text(const std::string &text,
             {"temperature", config::DEFAULT_TEMPERATURE}};
 
         // 发送请求
-        result = send_analysis_request(payload, config::TEXT_ANALYSIS_TIMEOUT);
+        result = send_analysis_request(payload, config::TEXT_ANALYSIS_TIMEOUT, std::move(on_token));
 
         if (result.success)
         {
@@ -818,9 +905,9 @@ AnalysisResult DoubaoMediaAnalyzer::analyze_file(const std::string &file_path,
 }
 
 // 私有方法实现
-std::vector<std::string> DoubaoMediaAnalyzer::extract_video_frames(const std::string &video_path, int num_frames)
+std::vector<std::vector<unsigned char>> DoubaoMediaAnalyzer::extract_video_frames(const std::string &video_path, int num_frames)
 {
-    std::vector<std::string> frames_base64;
+    std::vector<std::vector<unsigned char>> frames;
 
     try
     {
@@ -834,9 +921,7 @@ std::vector<std::string> DoubaoMediaAnalyzer::extract_video_frames(const std::st
         double fps = cap.get(cv::CAP_PROP_FPS);
         double duration = (fps > 0) ? total_frames / fps : 0;
 
-        std::cout << "📹 视频信息: " << total_frames << "帧, "
-                  << fps << "FPS, " << duration << "秒" << std::endl;
-        std::cout << "⏰ [时间戳] 视频信息获取完成: " << utils::get_formatted_timestamp() << std::endl;
+        LOG_DEBUG("📹 视频信息", {{"frames", total_frames}, {"fps", fps}, {"duration", duration}});
 
         // 计算提取帧的位置
         std::vector<int> frame_positions;
@@ -857,9 +942,6 @@ std::vector<std::string> DoubaoMediaAnalyzer::extract_video_frames(const std::st
             frame_positions.push_back(total_frames - 1); // 确保包含最后一帧
         }
 
-        std::cout << "🔄 [帧处理] 开始提取关键帧..." << std::endl;
-        std::cout << "⏰ [时间戳] 帧处理开始时间: " << utils::get_formatted_timestamp() << std::endl;
-
         for (size_t i = 0; i < frame_positions.size(); ++i)
         {
             double frame_start_time = utils::get_current_time();
@@ -873,27 +955,15 @@ std::vector<std::string> DoubaoMediaAnalyzer::extract_video_frames(const std::st
                 // 调整帧大小以控制文件大小
                 cv::Mat resized_frame = utils::resize_image(frame, 800);
 
-                // 编码为base64
-                auto jpeg_data = utils::encode_image_to_jpeg(resized_frame, 85);
-                std::string frame_base64 = utils::base64_encode(jpeg_data);
-
-                // 如果使用Ollama API，对帧数据进行优化
-                if (use_ollama_)
-                {
-                    frame_base64 = utils::optimize_image_for_ollama(frame_base64, "data:image/jpeg;base64,");
-                }
-
-                frames_base64.push_back(frame_base64);
+                // 编码为JPEG（Base64编码在写入请求体时完成）
+                frames.push_back(utils::encode_image_to_jpeg(resized_frame, 85));
 
                 double frame_time = utils::get_current_time() - frame_start_time;
-                std::cout << "  ✅ 提取第" << i + 1 << "/" << frame_positions.size()
-                          << "帧 (位置: " << frame_positions[i] << "/" << total_frames << "), 耗时: "
-                          << frame_time << "秒" << std::endl;
+                LOG_TRACE("  ✅ 提取帧",
+                          {{"index", i + 1}, {"count", frame_positions.size()}, {"position", frame_positions[i]}, {"seconds", frame_time}});
             }
         }
 
-        std::cout << "⏰ [时间戳] 帧处理完成时间: " << utils::get_formatted_timestamp() << std::endl;
-
         cap.release();
     }
     catch (const std::exception &e)
@@ -901,119 +971,300 @@ std::vector<std::string> DoubaoMediaAnalyzer::extract_video_frames(const std::st
         throw std::runtime_error("视频帧提取失败: " + std::string(e.what()));
     }
 
-    return frames_base64;
+    return frames;
 }
 
-AnalysisResult DoubaoMediaAnalyzer::send_analysis_request(const nlohmann::json &payload, int timeout)
+// 记录一次上游HTTP请求的各阶段耗时
+static void record_upstream_metrics(const UpstreamResponse &response)
 {
-    AnalysisResult result;
+    static Histogram &upstream_seconds = Metrics::getInstance().stage("upstream_http");
+    upstream_seconds.observe(response.total_time);
+
+    LOG_DEBUG("⏰ [性能] CURL执行完成",
+              {{"dns", response.namelookup_time}, {"connect", response.connect_time}, {"tls", response.appconnect_time},
+               {"pretransfer", response.pretransfer_time}, {"ttfb", response.starttransfer_time}, {"total", response.total_time}});
+
+    // CURL各阶段耗时是从请求开始的累计值，这里换算为各阶段自身的耗时
+    static Metrics &metrics = Metrics::getInstance();
+    static Histogram &dns_seconds = metrics.histogram("doubao_upstream_phase_seconds", "上游HTTP请求各阶段耗时（秒）", {{"phase", "dns"}});
+    static Histogram &connect_seconds = metrics.histogram("doubao_upstream_phase_seconds", "上游HTTP请求各阶段耗时（秒）", {{"phase", "connect"}});
+    static Histogram &tls_seconds = metrics.histogram("doubao_upstream_phase_seconds", "上游HTTP请求各阶段耗时（秒）", {{"phase", "tls"}});
+    static Histogram &ttfb_seconds = metrics.histogram("doubao_upstream_phase_seconds", "上游HTTP请求各阶段耗时（秒）", {{"phase", "ttfb"}});
+    static Counter &upstream_ok = metrics.counter("doubao_upstream_requests_total", "上游HTTP请求次数", {{"result", "ok"}});
+    static Counter &upstream_error = metrics.counter("doubao_upstream_requests_total", "上游HTTP请求次数", {{"result", "error"}});
+    if (response.code == CURLE_OK)
+    {
+        dns_seconds.observe(response.namelookup_time);
+        connect_seconds.observe(response.connect_time - response.namelookup_time);
+        if (response.appconnect_time > 0.0)
+            tls_seconds.observe(response.appconnect_time - response.connect_time);
+        ttfb_seconds.observe(response.starttransfer_time - response.pretransfer_time);
+        upstream_ok.inc();
+    }
+    else
+    {
+        upstream_error.inc();
+    }
+}
 
-    try
+// 把各阶段耗时附加到span
+static void set_upstream_span_args(Span &span, const UpstreamResponse &response)
+{
+    if (span.active())
     {
-        std::vector<std::string> headers;
+        span.set_arg("result", response.code == CURLE_OK ? "ok" : response.error);
+        span.set_arg("dns", LogField::format_double(response.namelookup_time));
+        span.set_arg("connect", LogField::format_double(response.connect_time));
+        span.set_arg("tls", LogField::format_double(response.appconnect_time));
+        span.set_arg("ttfb", LogField::format_double(response.starttransfer_time));
+    }
+}
 
-        // 根据API类型设置不同的请求头
-        if (use_ollama_)
-        {
-            // Ollama API不需要Authorization头
-            headers = {"Content-Type: application/json"};
-        }
-        else if (use_vllm_)
+// 传输失败时的错误描述
+static std::string upstream_error_message(const UpstreamResponse &response)
+{
+    std::string error_msg = "HTTP请求失败: " + response.error;
+    if (response.status > 0)
+    {
+        error_msg += " (HTTP状态码: " + std::to_string(response.status) + ")";
+    }
+    return error_msg;
+}
+
+std::string DoubaoMediaAnalyzer::api_type_name() const
+{
+    if (use_ollama_)
+    {
+        return "Ollama";
+    }
+    else if (use_vllm_)
+    {
+        return "vLLM";
+    }
+    return "豆包";
+}
+
+UpstreamRequest DoubaoMediaAnalyzer::make_upstream_request(int timeout) const
+{
+    // 请求地址在发送时从后端池中选择
+    UpstreamRequest request;
+    request.method = "POST";
+    request.timeout = timeout;
+
+    // 根据API类型设置不同的请求头
+    if (use_ollama_)
+    {
+        // Ollama API不需要Authorization头
+        request.headers = {"Content-Type: application/json"};
+    }
+    else if (use_vllm_)
+    {
+        // vLLM API可能需要Authorization头，取决于配置
+        if (!api_key_.empty())
         {
-            // vLLM API可能需要Authorization头，取决于配置
-            if (!api_key_.empty())
-            {
-                headers = {
-                    "Authorization: Bearer " + api_key_,
-                    "Content-Type: application/json"};
-            }
-            else
-            {
-                headers = {"Content-Type: application/json"};
-            }
+            request.headers = {
+                "Authorization: Bearer " + api_key_,
+                "Content-Type: application/json"};
         }
         else
         {
-            // 豆包API需要Authorization头
-            headers = {
-                "Authorization: Bearer " + api_key_,
-                "Content-Type: application/json"};
+            request.headers = {"Content-Type: application/json"};
         }
+    }
+    else
+    {
+        // 豆包API需要Authorization头
+        request.headers = {
+            "Authorization: Bearer " + api_key_,
+            "Content-Type: application/json"};
+    }
+
+    request.enable_http2 = true; // 根据需要启用HTTP/2
+    if (use_ollama_)             // 先假设所有请求都不是Ollama API，便于调试
+    {
+        request.enable_http2 = false; // Ollama API不支持HTTP/2
+    }
+    else if (use_vllm_)
+    {
+        request.enable_http2 = false; // vLLM API通常不支持HTTP/2
+    }
+
+    return request;
+}
 
-        // 根据API类型调整payload格式
-        nlohmann::json adjusted_payload;
-        if (use_ollama_) // 先假设所有请求都不是Ollama API，便于调试
+PayloadWriter DoubaoMediaAnalyzer::make_payload_writer(const std::string &model_name, int max_tokens) const
+{
+    PayloadWriter::Format format = PayloadWriter::Format::Doubao;
+    if (use_ollama_)
+    {
+        // 检查是否使用/api/generate端点
+        bool is_generate_endpoint = (base_url_.find("/api/generate") != std::string::npos);
+        format = is_generate_endpoint ? PayloadWriter::Format::OllamaGenerate : PayloadWriter::Format::OllamaChat;
+    }
+    else if (use_vllm_)
+    {
+        format = PayloadWriter::Format::VLLM;
+    }
+
+    // 按传递模型名称（如果有）或默认模型名称构建请求
+    return PayloadWriter(format, model_name.empty() ? model_name_ : model_name, max_tokens, config::DEFAULT_TEMPERATURE);
+}
+
+void DoubaoMediaAnalyzer::prepare_image_for_backend(std::vector<unsigned char> &image_data) const
+{
+    // Ollama需要JPEG/PNG且尺寸较小，直接对原始字节处理，不再经过Base64解码和重新编码
+    if (use_ollama_)
+    {
+        utils::optimize_image_for_ollama(image_data, false);
+    }
+}
+
+UpstreamRequest DoubaoMediaAnalyzer::build_analysis_request(const nlohmann::json &payload, int timeout, bool stream)
+{
+    UpstreamRequest request = make_upstream_request(timeout);
+
+    // 根据API类型调整payload格式（调整和序列化计入载荷构建耗时）
+    static Histogram &payload_seconds = Metrics::getInstance().stage("payload_build");
+    ScopedTimer payload_timer(payload_seconds);
+    nlohmann::json adjusted_payload;
+    if (use_ollama_) // 先假设所有请求都不是Ollama API，便于调试
+    {
+        // 检查是否使用/api/generate端点
+        bool is_generate_endpoint = (base_url_.find("/api/generate") != std::string::npos);
+
+        if (is_generate_endpoint)
         {
-            // 检查是否使用/api/generate端点
-            bool is_generate_endpoint = (base_url_.find("/api/generate") != std::string::npos);
+            // Ollama /api/generate端点格式
+            adjusted_payload["model"] = payload["model"];
+            adjusted_payload["prompt"] = "请分析这张图片"; // 默认提示，将被实际提示覆盖
+            adjusted_payload["stream"] = false;
 
-            if (is_generate_endpoint)
+            // 从messages中提取文本和图片
+            if (payload.contains("messages") && !payload["messages"].empty())
             {
-                // Ollama /api/generate端点格式
-                adjusted_payload["model"] = payload["model"];
-                adjusted_payload["prompt"] = "请分析这张图片"; // 默认提示，将被实际提示覆盖
-                adjusted_payload["stream"] = false;
-
-                // 从messages中提取文本和图片
-                if (payload.contains("messages") && !payload["messages"].empty())
+                auto messages = payload["messages"][0];
+                if (messages.contains("content"))
                 {
-                    auto messages = payload["messages"][0];
-                    if (messages.contains("content"))
+                    auto content = messages["content"];
+                    std::string prompt_text = "";
+
+                    // 提取文本和图片
+                    if (content.is_array())
                     {
-                        auto content = messages["content"];
-                        std::string prompt_text = "";
+                        for (const auto &item : content)
+                        {
+                            if (item.contains("type") && item["type"] == "text")
+                            {
+                                prompt_text += item["text"].get<std::string>();
+                            }
+                        }
+                    }
+                    else if (content.is_string())
+                    {
+                        prompt_text = content.get<std::string>();
+                    }
 
-                        // 提取文本和图片
-                        if (content.is_array())
+                    adjusted_payload["prompt"] = prompt_text;
+                }
+            }
+
+            // 添加选项
+            if (payload.contains("max_tokens"))
+            {
+                adjusted_payload["options"] = {
+                    {"num_predict", payload["max_tokens"]}};
+            }
+
+            // 处理图片数据 - 优化图片处理
+            if (payload.contains("messages") && !payload["messages"].empty())
+            {
+                auto messages = payload["messages"][0];
+                if (messages.contains("content"))
+                {
+                    auto content = messages["content"];
+                    if (content.is_array())
+                    {
+                        std::vector<std::string> optimized_images;
+                        for (const auto &item : content)
                         {
-                            for (const auto &item : content)
+                            if (item.contains("type") && item["type"] == "image_url" && item.contains("image_url"))
                             {
-                                if (item.contains("type") && item["type"] == "text")
+                                auto img_url = item["image_url"];
+                                if (img_url.contains("url"))
                                 {
-                                    prompt_text += item["text"].get<std::string>();
+                                    std::string url = img_url["url"].get<std::string>();
+                                    if (url.find("data:image/") == 0 && url.find("base64,") != std::string::npos)
+                                    {
+                                        size_t pos = url.find("base64,") + 7;
+                                        std::string base64_data = url.substr(pos);
+
+                                        // 优化：对图片数据进行压缩和格式转换（如果需要）
+                                        std::string optimized_data = utils::optimize_image_for_ollama(base64_data, url);
+                                        optimized_images.push_back(optimized_data);
+                                    }
                                 }
                             }
                         }
-                        else if (content.is_string())
+
+                        if (!optimized_images.empty())
                         {
-                            prompt_text = content.get<std::string>();
+                            adjusted_payload["images"] = optimized_images;
                         }
-
-                        adjusted_payload["prompt"] = prompt_text;
                     }
                 }
-
-                // 添加选项
-                if (payload.contains("max_tokens"))
+            }
+            if (payload.contains("temperature"))
+            {
+                if (!adjusted_payload.contains("options"))
                 {
-                    adjusted_payload["options"] = {
-                        {"num_predict", payload["max_tokens"]}};
+                    adjusted_payload["options"] = nlohmann::json::object();
                 }
+                adjusted_payload["options"]["temperature"] = payload["temperature"];
+            }
+        }
+        else
+        {
+            // Ollama /api/chat端点格式
+            adjusted_payload["model"] = payload["model"];
 
-                // 处理图片数据 - 优化图片处理
-                if (payload.contains("messages") && !payload["messages"].empty())
+            // 处理messages，确保content是字符串而不是数组
+            nlohmann::json adjusted_messages = nlohmann::json::array();
+            if (payload.contains("messages") && !payload["messages"].empty())
+            {
+                for (const auto &msg : payload["messages"])
                 {
-                    auto messages = payload["messages"][0];
-                    if (messages.contains("content"))
+                    nlohmann::json adjusted_msg;
+                    adjusted_msg["role"] = msg["role"];
+
+                    // 将content数组转换为字符串
+                    if (msg.contains("content"))
                     {
-                        auto content = messages["content"];
-                        if (content.is_array())
+                        if (msg["content"].is_array())
                         {
+                            std::string content_str = "";
                             std::vector<std::string> optimized_images;
-                            for (const auto &item : content)
+
+                            for (const auto &item : msg["content"])
                             {
-                                if (item.contains("type") && item["type"] == "image_url" && item.contains("image_url"))
+                                if (item.contains("type") && item["type"] == "text" && item.contains("text"))
                                 {
+                                    content_str += item["text"].get<std::string>();
+                                }
+                                else if (item.contains("type") && item["type"] == "image_url" && item.contains("image_url"))
+                                {
+                                    // 提取图片URL并转换为base64
                                     auto img_url = item["image_url"];
                                     if (img_url.contains("url"))
                                     {
                                         std::string url = img_url["url"].get<std::string>();
+                                        // 检查是否是base64格式的图片
                                         if (url.find("data:image/") == 0 && url.find("base64,") != std::string::npos)
                                         {
+                                            // 提取base64数据部分
                                             size_t pos = url.find("base64,") + 7;
                                             std::string base64_data = url.substr(pos);
 
-                                            // 优化：对图片数据进行压缩和格式转换（如果需要）
+                                            // 优化：对图片数据进行压缩和格式转换
                                             std::string optimized_data = utils::optimize_image_for_ollama(base64_data, url);
                                             optimized_images.push_back(optimized_data);
                                         }
@@ -1021,257 +1272,441 @@ AnalysisResult DoubaoMediaAnalyzer::send_analysis_request(const nlohmann::json &
                                 }
                             }
 
+                            // 设置文本内容
+                            adjusted_msg["content"] = content_str;
+
+                            // 如果有图片，添加到消息中
                             if (!optimized_images.empty())
                             {
-                                adjusted_payload["images"] = optimized_images;
+                                adjusted_msg["images"] = optimized_images;
                             }
                         }
-                    }
-                }
-                if (payload.contains("temperature"))
-                {
-                    if (!adjusted_payload.contains("options"))
-                    {
-                        adjusted_payload["options"] = nlohmann::json::object();
-                    }
-                    adjusted_payload["options"]["temperature"] = payload["temperature"];
-                }
-            }
-            else
-            {
-                // Ollama /api/chat端点格式
-                adjusted_payload["model"] = payload["model"];
-
-                // 处理messages，确保content是字符串而不是数组
-                nlohmann::json adjusted_messages = nlohmann::json::array();
-                if (payload.contains("messages") && !payload["messages"].empty())
-                {
-                    for (const auto &msg : payload["messages"])
-                    {
-                        nlohmann::json adjusted_msg;
-                        adjusted_msg["role"] = msg["role"];
-
-                        // 将content数组转换为字符串
-                        if (msg.contains("content"))
+                        else
                         {
-                            if (msg["content"].is_array())
-                            {
-                                std::string content_str = "";
-                                std::vector<std::string> optimized_images;
-
-                                for (const auto &item : msg["content"])
-                                {
-                                    if (item.contains("type") && item["type"] == "text" && item.contains("text"))
-                                    {
-                                        content_str += item["text"].get<std::string>();
-                                    }
-                                    else if (item.contains("type") && item["type"] == "image_url" && item.contains("image_url"))
-                                    {
-                                        // 提取图片URL并转换为base64
-                                        auto img_url = item["image_url"];
-                                        if (img_url.contains("url"))
-                                        {
-                                            std::string url = img_url["url"].get<std::string>();
-                                            // 检查是否是base64格式的图片
-                                            if (url.find("data:image/") == 0 && url.find("base64,") != std::string::npos)
-                                            {
-                                                // 提取base64数据部分
-                                                size_t pos = url.find("base64,") + 7;
-                                                std::string base64_data = url.substr(pos);
-
-                                                // 优化：对图片数据进行压缩和格式转换
-                                                std::string optimized_data = utils::optimize_image_for_ollama(base64_data, url);
-                                                optimized_images.push_back(optimized_data);
-                                            }
-                                        }
-                                    }
-                                }
-
-                                // 设置文本内容
-                                adjusted_msg["content"] = content_str;
-
-                                // 如果有图片，添加到消息中
-                                if (!optimized_images.empty())
-                                {
-                                    adjusted_msg["images"] = optimized_images;
-                                }
-                            }
-                            else
-                            {
-                                adjusted_msg["content"] = msg["content"];
-                            }
+                            adjusted_msg["content"] = msg["content"];
                         }
-                        adjusted_messages.push_back(adjusted_msg);
                     }
+                    adjusted_messages.push_back(adjusted_msg);
                 }
-                adjusted_payload["messages"] = adjusted_messages;
-                adjusted_payload["stream"] = false;
-                if (payload.contains("max_tokens"))
-                {
-                    adjusted_payload["options"] = {
-                        {"num_predict", payload["max_tokens"]}};
-                }
-                if (payload.contains("temperature"))
+            }
+            adjusted_payload["messages"] = adjusted_messages;
+            adjusted_payload["stream"] = false;
+            if (payload.contains("max_tokens"))
+            {
+                adjusted_payload["options"] = {
+                    {"num_predict", payload["max_tokens"]}};
+            }
+            if (payload.contains("temperature"))
+            {
+                if (!adjusted_payload.contains("options"))
                 {
-                    if (!adjusted_payload.contains("options"))
-                    {
-                        adjusted_payload["options"] = nlohmann::json::object();
-                    }
-                    adjusted_payload["options"]["temperature"] = payload["temperature"];
+                    adjusted_payload["options"] = nlohmann::json::object();
                 }
+                adjusted_payload["options"]["temperature"] = payload["temperature"];
             }
         }
-        else if (use_vllm_)
+    }
+    else if (use_vllm_)
+    {
+        // vLLM API格式，兼容OpenAI格式
+        adjusted_payload = payload;
+
+        // vLLM API需要确保max_tokens参数存在
+        if (!adjusted_payload.contains("max_tokens"))
         {
-            // vLLM API格式，兼容OpenAI格式
-            adjusted_payload = payload;
+            adjusted_payload["max_tokens"] = 1000;
+        }
 
-            // vLLM API需要确保max_tokens参数存在
-            if (!adjusted_payload.contains("max_tokens"))
-            {
-                adjusted_payload["max_tokens"] = 1000;
-            }
+        // vLLM API不支持stream参数，移除它
+        if (adjusted_payload.contains("stream"))
+        {
+            adjusted_payload.erase("stream");
+        }
 
-            // vLLM API不支持stream参数，移除它
-            if (adjusted_payload.contains("stream"))
-            {
-                adjusted_payload.erase("stream");
-            }
+        // 确保model字段存在
+        if (!adjusted_payload.contains("model") || adjusted_payload["model"].empty())
+        {
+            adjusted_payload["model"] = model_name_;
+        }
 
-            // 确保model字段存在
-            if (!adjusted_payload.contains("model") || adjusted_payload["model"].empty())
+        // 验证messages字段格式
+        if (adjusted_payload.contains("messages"))
+        {
+            if (!adjusted_payload["messages"].is_array() || adjusted_payload["messages"].empty())
             {
-                adjusted_payload["model"] = model_name_;
+                throw std::runtime_error("vLLM API请求格式错误: messages必须是非空数组");
             }
 
-            // 验证messages字段格式
-            if (adjusted_payload.contains("messages"))
+            // 检查每个message是否有role和content
+            for (const auto &msg : adjusted_payload["messages"])
             {
-                if (!adjusted_payload["messages"].is_array() || adjusted_payload["messages"].empty())
+                if (!msg.contains("role") || !msg.contains("content"))
                 {
-                    throw std::runtime_error("vLLM API请求格式错误: messages必须是非空数组");
-                }
-
-                // 检查每个message是否有role和content
-                for (const auto &msg : adjusted_payload["messages"])
-                {
-                    if (!msg.contains("role") || !msg.contains("content"))
-                    {
-                        throw std::runtime_error("vLLM API请求格式错误: 每个消息必须包含role和content字段");
-                    }
+                    throw std::runtime_error("vLLM API请求格式错误: 每个消息必须包含role和content字段");
                 }
             }
         }
-        else
+    }
+    else
+    {
+        // 豆包API格式，直接使用原始payload
+        adjusted_payload = payload;
+    }
+
+    // 流式请求：OpenAI兼容后端需要显式要求在最后一个事件中返回usage
+    if (stream)
+    {
+        adjusted_payload["stream"] = true;
+        if (!use_ollama_)
         {
-            // 豆包API格式，直接使用原始payload
-            adjusted_payload = payload;
+            adjusted_payload["stream_options"] = {{"include_usage", true}};
         }
+    }
 
-        std::string payload_str = adjusted_payload.dump();
-        std::cout << "🔍 [调试] API请求URL: " << base_url_ << std::endl;
-        std::cout << "⏰ [性能] 准备发送API请求，载荷大小: " << payload_str.size() << " 字节" << std::endl;
+    request.body = std::make_shared<const std::string>(adjusted_payload.dump());
+    return request;
+}
 
-        bool enable_http2 = true; // 根据需要启用HTTP/2
-        if (use_ollama_)          // 先假设所有请求都不是Ollama API，便于调试
+UpstreamRequest DoubaoMediaAnalyzer::build_analysis_request(const PayloadWriter &writer, int timeout)
+{
+    UpstreamRequest request = make_upstream_request(timeout);
+
+    static Histogram &payload_seconds = Metrics::getInstance().stage("payload_build");
+    ScopedTimer payload_timer(payload_seconds);
+    request.body = std::make_shared<const std::string>(writer.finish());
+    return request;
+}
+
+std::string DoubaoMediaAnalyzer::describe_request_failure(const std::string &reason, int timeout) const
+{
+    std::string error_msg = api_type_name() + " 请求失败: " + reason;
+
+    // 为vLLM添加更详细的错误信息
+    if (use_vllm_)
+    {
+        error_msg += " (URL: " + base_url_ + ", Model: " + model_name_ + ", Timeout: " + std::to_string(timeout) + "s)";
+
+        // 检查是否是连接超时
+        if (reason.find("timeout") != std::string::npos ||
+            reason.find("timed out") != std::string::npos)
         {
-            enable_http2 = false; // Ollama API不支持HTTP/2
+            error_msg += " - 建议检查vLLM服务是否运行正常，或增加超时时间";
         }
-        else if (use_vllm_)
+
+        // 检查是否是连接被拒绝
+        if (reason.find("Connection refused") != std::string::npos ||
+            reason.find("Failed to connect") != std::string::npos)
         {
-            enable_http2 = false; // vLLM API通常不支持HTTP/2
+            error_msg += " - 建议检查vLLM服务地址和端口是否正确";
         }
+    }
 
-        // 记录请求开始时间
-        double request_start = utils::get_current_time();
-        std::cout << "⏰ [性能] 开始发送HTTP请求，超时设置: " << timeout << " 秒" << std::endl;
+    return error_msg;
+}
 
-        std::string response;
-        try
-        {
-            response = make_http_request(base_url_, "POST", payload_str, headers, timeout, enable_http2);
+AnalysisResult DoubaoMediaAnalyzer::request_error_result(const std::string &error) const
+{
+    AnalysisResult result;
+    result.success = false;
+    result.error = api_type_name() + " HTTP请求异常: " + error;
 
-            // 检查响应是否为空
-            if (response.empty())
-            {
-                throw std::runtime_error("服务器返回空响应");
-            }
-        }
-        catch (const std::exception &e)
-        {
-            std::string api_type = "豆包";
-            if (use_ollama_)
-            {
-                api_type = "Ollama";
-            }
-            else if (use_vllm_)
-            {
-                api_type = "vLLM";
-            }
+    // 添加额外的调试信息
+    if (use_vllm_)
+    {
+        result.error += " (URL: " + base_url_ + ", Model: " + model_name_ + ")";
+    }
 
-            std::string error_msg = api_type + " 请求失败: " + std::string(e.what());
+    return result;
+}
 
-            // 为vLLM添加更详细的错误信息
-            if (use_vllm_)
-            {
-                error_msg += " (URL: " + base_url_ + ", Model: " + model_name_ + ", Timeout: " + std::to_string(timeout) + "s)";
+AnalysisResult DoubaoMediaAnalyzer::send_analysis_request(const nlohmann::json &payload, int timeout, TokenCallback on_token)
+{
+    UpstreamRequest request;
+    try
+    {
+        request = build_analysis_request(payload, timeout, on_token != nullptr);
+    }
+    catch (const std::exception &e)
+    {
+        return request_error_result(e.what());
+    }
+    return send_upstream_request(std::move(request), timeout, std::move(on_token));
+}
 
-                // 检查是否是连接超时
-                if (std::string(e.what()).find("timeout") != std::string::npos ||
-                    std::string(e.what()).find("timed out") != std::string::npos)
-                {
-                    error_msg += " - 建议检查vLLM服务是否运行正常，或增加超时时间";
-                }
+AnalysisResult DoubaoMediaAnalyzer::send_upstream_request(UpstreamRequest request, int timeout, TokenCallback on_token)
+{
+    Span span("send_analysis_request");
+
+    // 同步调用方在当前线程等待异步请求完成
+    std::promise<AnalysisResult> promise;
+    std::future<AnalysisResult> future = promise.get_future();
+    send_upstream_request_async(std::move(request), timeout, [&promise](AnalysisResult &&result)
+                                { promise.set_value(std::move(result)); }, std::move(on_token));
+    return future.get();
+}
 
-                // 检查是否是连接被拒绝
-                if (std::string(e.what()).find("Connection refused") != std::string::npos ||
-                    std::string(e.what()).find("Failed to connect") != std::string::npos)
-                {
-                    error_msg += " - 建议检查vLLM服务地址和端口是否正确";
-                }
+struct DoubaoMediaAnalyzer::UpstreamCall
+{
+    int timeout = 0;
+    TraceContext trace;
+    AnalysisCallback callback;
+    std::shared_ptr<StreamingResponseParser> stream_parser;
+    HedgePolicy *hedge_policy = nullptr; // 为空表示不对冲
+    double start = 0.0;
+    int64_t attempt_start_us[2] = {0, 0}; // 原请求和对冲请求的发出时间（跟踪span）
+
+    bool finished = false; // 已经有请求给出结果并调用了callback
+    int pending = 0;       // 尚未完成的请求数
+    // 原请求和对冲请求：原请求的编号在提交线程中写入，在事件线程中读取
+    std::atomic<uint64_t> transfer_ids[2] = {{0}, {0}};
+};
+
+void DoubaoMediaAnalyzer::send_upstream_request_async(UpstreamRequest request, int timeout, AnalysisCallback callback, TokenCallback on_token)
+{
+    // 从后端池中选择在途请求最少的副本（排队等待并发名额的请求也计入在途数）
+    BackendPool &pool = BackendPool::for_url(base_url_);
+    auto lease = std::make_shared<BackendLease>(pool);
+    request.url = lease->url();
+
+    LOG_DEBUG("🔍 [调试] 准备发送API请求", {{"url", request.url}, {"bytes", request.body->size()}, {"timeout", timeout}});
+    LOG_TRACE("🔍 [调试] API请求载荷", {{"payload", Logger::truncate(*request.body)}});
+
+    // 按副本的自适应并发上限排队（最多等待timeout秒），排队不占用调用线程：
+    // 名额空出时由归还名额的线程（通常是HTTP客户端的事件线程）发起请求，名额在请求完成时归还并反馈耗时
+    struct QueuedRequest
+    {
+        UpstreamRequest request;
+        AnalysisCallback callback;
+        TokenCallback on_token;
+        std::shared_ptr<BackendLease> lease;
+        TraceContext trace;
+    };
+    auto queued = std::make_shared<QueuedRequest>();
+    queued->request = std::move(request);
+    queued->callback = std::move(callback);
+    queued->on_token = std::move(on_token);
+    queued->lease = std::move(lease);
+    queued->trace = Tracer::current();
+
+    ConcurrencyLimiter &limiter = ConcurrencyLimiter::for_backend(queued->request.url);
+    uint64_t ticket = limiter.acquire_async([this, &limiter, queued, timeout](bool acquired)
+                                            {
+                                                TraceScope trace_scope(queued->trace);
+                                                if (!acquired)
+                                                {
+                                                    queued->lease->cancelled();
+                                                    queued->lease.reset();
+                                                    queued->callback(request_error_result(describe_request_failure("上游后端繁忙，等待并发名额超时", timeout)));
+                                                    return;
+                                                }
+                                                start_upstream_request(std::move(queued->request), timeout, std::move(queued->callback),
+                                                                       std::move(queued->on_token), std::move(queued->lease),
+                                                                       std::make_shared<ConcurrencyPermit>(limiter, std::adopt_lock)); });
+    if (ticket != 0)
+    {
+        // 超过timeout秒仍在排队时放弃（已获得名额时无操作）
+        CurlMultiClient::getInstance().run_after(timeout * 1000, [&limiter, ticket]
+                                                 { limiter.cancel_wait(ticket); });
+    }
+}
+
+void DoubaoMediaAnalyzer::start_upstream_request(UpstreamRequest request, int timeout, AnalysisCallback callback, TokenCallback on_token,
+                                                 std::shared_ptr<BackendLease> lease, std::shared_ptr<ConcurrencyPermit> permit)
+{
+    BackendPool &pool = BackendPool::for_url(base_url_);
+    auto call = std::make_shared<UpstreamCall>();
+    call->timeout = timeout;
+    call->trace = Tracer::current();
+    call->callback = std::move(callback);
+    call->start = utils::get_current_time();
+
+    // 流式请求：在写回调中增量解析SSE/NDJSON，每收到一段数据就把新增内容交给on_token
+    if (on_token)
+    {
+        auto stream_parser = std::make_shared<StreamingResponseParser>(use_ollama_ ? StreamingResponseParser::Format::NDJSON
+                                                                                   : StreamingResponseParser::Format::SSE);
+        call->stream_parser = stream_parser;
+        double request_start = call->start;
+        bool first_token = true;
+        request.on_data = [stream_parser, on_token = std::move(on_token), request_start, first_token](const char *data, size_t size) mutable
+        {
+            stream_parser->feed(data, size);
+            std::string delta = stream_parser->take_delta();
+            if (delta.empty())
+                return;
+
+            if (first_token)
+            {
+                first_token = false;
+                static Histogram &first_token_seconds = Metrics::getInstance().stage("first_token");
+                first_token_seconds.observe(utils::get_current_time() - request_start);
             }
+            on_token(delta);
+        };
+    }
 
-            throw std::runtime_error(error_msg);
+    // 对冲：有多个副本的非流式请求，超过近期延迟分位数仍未返回时在另一个副本上重发
+    // （流式请求的内容已经转发给客户端，不能换用另一个副本的结果）
+    int hedge_delay_ms = 0;
+    std::shared_ptr<UpstreamRequest> hedge_request;
+    if (!call->stream_parser && pool.size() > 1)
+    {
+        call->hedge_policy = &HedgePolicy::for_requests(base_url_, timeout);
+        hedge_delay_ms = call->hedge_policy->on_request();
+        if (hedge_delay_ms > 0)
+        {
+            // 只复制URL和请求头，请求体与原请求共享同一份只读数据
+            hedge_request = std::make_shared<UpstreamRequest>(request);
         }
+    }
 
-        // 记录请求结束时间
-        double request_end = utils::get_current_time();
-        double request_time = request_end - request_start;
-        std::cout << "⏰ [性能] HTTP请求完成，耗时: " << request_time << " 秒" << std::endl;
-        std::cout << "⏰ [性能] 响应大小: " << response.size() << " 字节" << std::endl;
+    CurlMultiClient &client = CurlMultiClient::getInstance();
+    call->pending = 1;
+    call->attempt_start_us[0] = Tracer::now_us();
+    std::weak_ptr<BackendLease> primary_lease = lease;
+    call->transfer_ids[0] = client.submit(std::move(request), [this, call, lease, permit](UpstreamResponse &&response) mutable
+                                          { on_upstream_attempt_done(call, 0, lease, permit, response); });
+    if (!hedge_request)
+    {
+        return;
+    }
 
-        // 记录响应处理开始时间
-        double process_start = utils::get_current_time();
-        auto result = process_response(response, 0); // response_time will be set by caller
-        double process_end = utils::get_current_time();
-        double process_time = process_end - process_start;
-        std::cout << "⏰ [性能] 响应处理完成，耗时: " << process_time << " 秒" << std::endl;
+    // 定时器在事件线程中触发，与各次请求的完成回调串行执行
+    client.run_after(hedge_delay_ms, [this, call, hedge_request, primary_lease, &pool]
+                     {
+                         auto primary = primary_lease.lock();
+                         if (call->finished || !primary)
+                         {
+                             return;
+                         }
+
+                         // 对冲请求只发往另一个可用副本，且不排队等待并发名额
+                         auto hedge_lease = std::make_shared<BackendLease>(pool, primary.get());
+                         if (!hedge_lease->acquired())
+                         {
+                             return;
+                         }
+                         if (!call->hedge_policy->try_hedge())
+                         {
+                             hedge_lease->cancelled();
+                             return;
+                         }
+                         hedge_request->url = hedge_lease->url();
+                         auto hedge_permit = std::make_shared<ConcurrencyPermit>(ConcurrencyLimiter::for_backend(hedge_request->url));
+                         if (!hedge_permit->acquired())
+                         {
+                             hedge_lease->cancelled();
+                             return;
+                         }
+
+                         LOG_DEBUG("🔀 [上游] 请求超过对冲延迟仍未返回，发往另一个副本", {{"url", hedge_request->url}});
+                         call->pending++;
+                         call->attempt_start_us[1] = Tracer::now_us();
+                         call->transfer_ids[1] = CurlMultiClient::getInstance().submit(
+                             std::move(*hedge_request), [this, call, hedge_lease, hedge_permit](UpstreamResponse &&response) mutable
+                             { on_upstream_attempt_done(call, 1, hedge_lease, hedge_permit, response); }); });
+}
 
-        return result;
+void DoubaoMediaAnalyzer::on_upstream_attempt_done(const std::shared_ptr<UpstreamCall> &call, int attempt,
+                                                   std::shared_ptr<BackendLease> &lease, std::shared_ptr<ConcurrencyPermit> &permit,
+                                                   UpstreamResponse &response)
+{
+    call->pending--;
+
+    // 每次请求（原请求和对冲请求）从发出到完成记录为任务跟踪中的一个span
+    TraceScope trace_scope(call->trace);
+    {
+        Span span("upstream_request", call->attempt_start_us[attempt]);
+        span.set_arg("attempt", attempt == 0 ? "primary" : "hedge");
+        span.set_arg("url", lease->url());
+        span.set_arg("status", static_cast<int64_t>(response.status));
+        set_upstream_span_args(span, response);
     }
-    catch (const std::exception &e)
+
+    // 另一个请求已经给出结果（被取消或随后完成），不计入副本和并发限制的统计
+    if (call->finished)
     {
-        result.success = false;
-        std::string api_type = "豆包";
-        if (use_ollama_)
+        lease->cancelled();
+        permit->cancelled();
+        return;
+    }
+    bool failed = response.code != CURLE_OK || response.status >= 500;
+    if (failed && call->pending > 0)
+    {
+        // 另一个请求仍在进行，等待它的结果（本次失败照常计入副本的连续失败）
+        Span span("http_response");
+        set_upstream_span_args(span, response);
+        record_upstream_metrics(response);
+        LOG_DEBUG("🔀 [上游] 对冲中的一个请求失败，等待另一个请求", {{"url", lease->url()}, {"status", response.status}});
+        return;
+    }
+
+    call->finished = true;
+    if (call->pending > 0)
+    {
+        CurlMultiClient::getInstance().cancel(call->transfer_ids[1 - attempt]);
+    }
+    if (call->hedge_policy)
+    {
+        if (attempt == 1)
         {
-            api_type = "Ollama";
+            call->hedge_policy->hedge_won();
         }
-        else if (use_vllm_)
+        if (!failed)
         {
-            api_type = "vLLM";
+            call->hedge_policy->record(utils::get_current_time() - call->start);
         }
+    }
+
+    AnalysisResult result = complete_upstream_request(response, lease, permit, call->stream_parser.get(), call->timeout);
+    call->callback(std::move(result));
+}
 
-        result.error = api_type + " HTTP请求异常: " + std::string(e.what());
+AnalysisResult DoubaoMediaAnalyzer::complete_upstream_request(UpstreamResponse &response, std::shared_ptr<BackendLease> &lease,
+                                                              std::shared_ptr<ConcurrencyPermit> &permit,
+                                                              StreamingResponseParser *stream_parser, int timeout)
+{
+    Span span("http_response");
+    set_upstream_span_args(span, response);
+    record_upstream_metrics(response);
 
-        // 添加额外的调试信息
-        if (use_vllm_)
-        {
-            result.error += " (URL: " + base_url_ + ", Model: " + model_name_ + ")";
-        }
+    // 连接错误、超时和5xx计入副本的连续失败（被动健康检查）
+    if (response.code == CURLE_OK && response.status < 500)
+    {
+        lease->succeeded(response.total_time);
+    }
+    lease.reset();
 
-        return result;
+    if (response.code != CURLE_OK)
+    {
+        permit.reset();
+        return request_error_result(describe_request_failure(upstream_error_message(response), timeout));
     }
+    if (stream_parser)
+    {
+        permit->succeeded();
+        permit.reset();
+        stream_parser->finish();
+        return process_stream_response(*stream_parser);
+    }
+    if (response.body.empty())
+    {
+        permit.reset();
+        return request_error_result(describe_request_failure("服务器返回空响应", timeout));
+    }
+
+    permit->succeeded();
+    permit.reset();
+    LOG_TRACE("🔍 [调试] API响应内容", {{"body", Logger::truncate(response.body)}});
+
+    // 解析响应（模型响应通常只有几KB，直接在事件线程中处理）
+    double process_start = utils::get_current_time();
+    AnalysisResult result = process_response(response.body, 0); // response_time will be set by caller
+    double process_time = utils::get_current_time() - process_start;
+    static Histogram &parse_seconds = Metrics::getInstance().stage("response_parse");
+    parse_seconds.observe(process_time);
+    LOG_DEBUG("⏰ [性能] 响应处理完成", {{"seconds", process_time}});
+    return result;
 }
 
 AnalysisResult DoubaoMediaAnalyzer::process_response(const std::string &response_text, double response_time)
@@ -1447,104 +1882,60 @@ AnalysisResult DoubaoMediaAnalyzer::process_response(const std::string &response
     return result;
 }
 
-// 使用连接池替代单一静态CURL句柄
-
-std::string DoubaoMediaAnalyzer::make_http_request(const std::string &url,
-                                                   const std::string &method,
-                                                   const std::string &data,
-                                                   const std::vector<std::string> &headers,
-                                                   int timeout,
-                                                   bool enable_http2)
+AnalysisResult DoubaoMediaAnalyzer::process_stream_response(const StreamingResponseParser &parser)
 {
-    // 获取连接池实例
-    auto &pool = CurlConnectionPool::getInstance();
+    AnalysisResult result;
 
-    // 从连接池获取连接
-    auto connection = pool.acquire();
-    if (!connection || !connection->is_valid())
+    if (!parser.error().empty())
     {
-        throw std::runtime_error("无法从连接池获取有效连接");
+        result.success = false;
+        result.error = api_type_name() + " API错误: " + parser.error();
     }
-
-    // 使用RAII确保连接归还
-    auto connection_guard = std::shared_ptr<void>(nullptr, [&](void *)
-                                                  { pool.release(connection); });
-
-    std::string response;
-    CURL *curl = connection->get();
-
-    // 设置请求特定选项
-    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-    curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, method.c_str());
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, data.c_str());
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, data.length());
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-    curl_easy_setopt(curl, CURLOPT_TIMEOUT, timeout);
-
-    // 启用HTTP/2和压缩
-    if (enable_http2)
+    else if (!parser.received_events())
     {
-        curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2_PRIOR_KNOWLEDGE);
+        result.success = false;
+        result.error = parser.unparsed().empty() ? "服务器返回空响应" : "流式响应格式异常: " + parser.unparsed();
     }
-    // 压缩
-    curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, "gzip, deflate");
-
-    // 设置headers
-    struct curl_slist *header_list = nullptr;
-    for (const auto &header : headers)
+    else
     {
-        header_list = curl_slist_append(header_list, header.c_str());
+        result.success = true;
+        result.content = parser.content();
+        result.usage = parser.usage();
+        result.raw_response = parser.last_event();
     }
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, header_list);
-
-    // 执行请求
-    double perform_start = utils::get_current_time();
-    CURLcode res = curl_easy_perform(curl);
-    double perform_end = utils::get_current_time();
-    double perform_time = perform_end - perform_start;
-
-    // 获取请求统计信息
-    double total_time;
-    double namelookup_time;
-    double connect_time;
-    double appconnect_time;
-    double pretransfer_time;
-    double starttransfer_time;
-
-    curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME, &total_time);
-    curl_easy_getinfo(curl, CURLINFO_NAMELOOKUP_TIME, &namelookup_time);
-    curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME, &connect_time);
-    curl_easy_getinfo(curl, CURLINFO_APPCONNECT_TIME, &appconnect_time);
-    curl_easy_getinfo(curl, CURLINFO_PRETRANSFER_TIME, &pretransfer_time);
-    curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME, &starttransfer_time);
-
-    std::cout << "⏰ [性能] CURL执行完成，耗时: " << perform_time << " 秒" << std::endl;
-    std::cout << "⏰ [性能] DNS解析: " << namelookup_time << " 秒" << std::endl;
-    std::cout << "⏰ [性能] 建立连接: " << connect_time << " 秒" << std::endl;
-    std::cout << "⏰ [性能] SSL握手: " << appconnect_time << " 秒" << std::endl;
-    std::cout << "⏰ [性能] 传输准备: " << pretransfer_time << " 秒" << std::endl;
-    std::cout << "⏰ [性能] 首字节响应: " << starttransfer_time << " 秒" << std::endl;
-    std::cout << "⏰ [性能] 总耗时: " << total_time << " 秒" << std::endl;
-    std::cout << "🔗 [连接池] 活跃连接: " << pool.get_active_connections()
-              << ", 空闲连接: " << pool.get_idle_connections() << std::endl;
 
-    curl_slist_free_all(header_list);
+    return result;
+}
 
-    if (res != CURLE_OK)
+// 同步请求：提交给异步HTTP客户端并等待完成（用于连接测试等非热点路径）
+std::string DoubaoMediaAnalyzer::make_http_request(const std::string &url,
+                                                   const std::string &method,
+                                                   const std::string &data,
+                                                   const std::vector<std::string> &headers,
+                                                   int timeout,
+                                                   bool enable_http2)
+{
+    Span span("http_request");
+    span.set_arg("method", method);
+    span.set_arg("bytes", static_cast<int64_t>(data.size()));
+
+    UpstreamRequest request;
+    request.url = url;
+    request.method = method;
+    if (!data.empty())
+        request.body = std::make_shared<const std::string>(data);
+    request.headers = headers;
+    request.timeout = timeout;
+    request.enable_http2 = enable_http2;
+
+    UpstreamResponse response = CurlMultiClient::getInstance().submit(std::move(request)).get();
+    record_upstream_metrics(response);
+    set_upstream_span_args(span, response);
+
+    if (response.code != CURLE_OK)
     {
-        std::string error_msg = "HTTP请求失败: " + std::string(curl_easy_strerror(res));
-
-        // 添加更多调试信息
-        long response_code;
-        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response_code);
-        if (response_code > 0)
-        {
-            error_msg += " (HTTP状态码: " + std::to_string(response_code) + ")";
-        }
-
-        throw std::runtime_error(error_msg);
+        throw std::runtime_error(upstream_error_message(response));
     }
 
-    return response;
+    return std::move(response.body);
 }
@@ -1,5 +1,6 @@
 #include "DoubaoMediaAnalyzer.hpp"
 #include "config.hpp"
+#include "Metrics.hpp"
 #include <filesystem>
 #include <iostream>
 
@@ -55,6 +56,8 @@ bool DoubaoMediaAnalyzer::save_result_to_database(const AnalysisResult &result)
         record.tags = tags_str;
     }
 
+    static Histogram &db_write_seconds = Metrics::getInstance().stage("db_write");
+    ScopedTimer timer(db_write_seconds);
     return db_manager_->save_analysis_result(record);
 }
 
@@ -113,7 +116,10 @@ bool DoubaoMediaAnalyzer::save_batch_results_to_database(const std::vector<Analy
 
     // 尝试保存到数据库
     try {
+        static Histogram &db_write_seconds = Metrics::getInstance().stage("db_write");
+        ScopedTimer timer(db_write_seconds);
         bool result = db_manager_->save_batch_results(records);
+        timer.stop();
         if (result) {
             std::cout << "✅ 成功保存 " << records.size() << " 条记录到数据库" << std::endl;
         } else {
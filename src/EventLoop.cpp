@@ -0,0 +1,259 @@
+#include "EventLoop.hpp"
+#include <iostream>
+#include <cerrno>
+#include <cstring>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+EventLoop::EventLoop()
+    : epoll_fd_(-1), wakeup_fd_(-1), running_(false), quit_(false), handler_count_(0)
+{
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd_ < 0)
+    {
+        std::cerr << "❌ [事件循环] epoll_create1失败: " << strerror(errno) << std::endl;
+        return;
+    }
+
+    wakeup_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wakeup_fd_ < 0)
+    {
+        std::cerr << "❌ [事件循环] eventfd创建失败: " << strerror(errno) << std::endl;
+        return;
+    }
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = wakeup_fd_;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wakeup_fd_, &ev);
+}
+
+EventLoop::~EventLoop()
+{
+    for (int timer_fd : timer_fds_)
+    {
+        close(timer_fd);
+    }
+    if (wakeup_fd_ >= 0)
+    {
+        close(wakeup_fd_);
+    }
+    if (epoll_fd_ >= 0)
+    {
+        close(epoll_fd_);
+    }
+}
+
+bool EventLoop::add(int fd, uint32_t events, EventCallback callback)
+{
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.fd = fd;
+
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) < 0)
+    {
+        std::cerr << "❌ [事件循环] 注册fd失败: " << fd << ", " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    handlers_[fd] = std::move(callback);
+    handler_count_ = handlers_.size();
+    return true;
+}
+
+bool EventLoop::modify(int fd, uint32_t events)
+{
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.fd = fd;
+
+    return epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &ev) == 0;
+}
+
+void EventLoop::remove(int fd)
+{
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+    handlers_.erase(fd);
+    handler_count_ = handlers_.size();
+}
+
+void EventLoop::post(Task task)
+{
+    {
+        std::lock_guard<std::mutex> lock(pending_mutex_);
+        pending_tasks_.push_back(std::move(task));
+    }
+    wakeup();
+}
+
+bool EventLoop::run_every(int interval_ms, Task task)
+{
+    int timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timer_fd < 0)
+    {
+        std::cerr << "❌ [事件循环] timerfd创建失败: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+    spec.it_interval.tv_sec = interval_ms / 1000;
+    spec.it_interval.tv_nsec = (interval_ms % 1000) * 1000000L;
+    spec.it_value = spec.it_interval;
+
+    if (timerfd_settime(timer_fd, 0, &spec, nullptr) < 0)
+    {
+        std::cerr << "❌ [事件循环] timerfd设置失败: " << strerror(errno) << std::endl;
+        close(timer_fd);
+        return false;
+    }
+
+    bool added = add(timer_fd, EPOLLIN, [timer_fd, task](uint32_t)
+                     {
+                         uint64_t expirations;
+                         while (read(timer_fd, &expirations, sizeof(expirations)) > 0)
+                         {
+                         }
+                         task(); });
+    if (!added)
+    {
+        close(timer_fd);
+        return false;
+    }
+
+    timer_fds_.push_back(timer_fd);
+    return true;
+}
+
+bool EventLoop::run_after(int delay_ms, Task task)
+{
+    int timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timer_fd < 0)
+    {
+        std::cerr << "❌ [事件循环] timerfd创建失败: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    // it_value全为0会停止定时器，延迟为0时设为1纳秒
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+    spec.it_value.tv_sec = delay_ms / 1000;
+    spec.it_value.tv_nsec = (delay_ms % 1000) * 1000000L;
+    if (delay_ms <= 0)
+    {
+        spec.it_value.tv_sec = 0;
+        spec.it_value.tv_nsec = 1;
+    }
+
+    if (timerfd_settime(timer_fd, 0, &spec, nullptr) < 0)
+    {
+        std::cerr << "❌ [事件循环] timerfd设置失败: " << strerror(errno) << std::endl;
+        close(timer_fd);
+        return false;
+    }
+
+    // 回调执行前已被拷贝，可以在回调中移除自身
+    bool added = add(timer_fd, EPOLLIN, [this, timer_fd, task](uint32_t)
+                     {
+                         remove(timer_fd);
+                         close(timer_fd);
+                         task(); });
+    if (!added)
+    {
+        close(timer_fd);
+        return false;
+    }
+    return true;
+}
+
+void EventLoop::wakeup()
+{
+    uint64_t one = 1;
+    ssize_t n = write(wakeup_fd_, &one, sizeof(one));
+    (void)n;
+}
+
+void EventLoop::run_pending_tasks()
+{
+    std::vector<Task> tasks;
+    {
+        std::lock_guard<std::mutex> lock(pending_mutex_);
+        tasks.swap(pending_tasks_);
+    }
+
+    for (auto &task : tasks)
+    {
+        try
+        {
+            task();
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "❌ [事件循环] 任务执行异常: " << e.what() << std::endl;
+        }
+    }
+}
+
+void EventLoop::run()
+{
+    loop_thread_id_ = std::this_thread::get_id();
+    running_ = true;
+
+    const int max_events = 256;
+    struct epoll_event events[max_events];
+
+    while (!quit_)
+    {
+        int n = epoll_wait(epoll_fd_, events, max_events, -1);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            std::cerr << "❌ [事件循环] epoll_wait失败: " << strerror(errno) << std::endl;
+            break;
+        }
+
+        for (int i = 0; i < n; ++i)
+        {
+            int fd = events[i].data.fd;
+            if (fd == wakeup_fd_)
+            {
+                uint64_t value;
+                while (read(wakeup_fd_, &value, sizeof(value)) > 0)
+                {
+                }
+                continue;
+            }
+
+            // 回调可能移除自身或其他fd，因此先拷贝一份回调
+            auto it = handlers_.find(fd);
+            if (it == handlers_.end())
+                continue;
+
+            EventCallback callback = it->second;
+            try
+            {
+                callback(events[i].events);
+            }
+            catch (const std::exception &e)
+            {
+                std::cerr << "❌ [事件循环] 事件处理异常: " << e.what() << std::endl;
+            }
+        }
+
+        run_pending_tasks();
+    }
+
+    running_ = false;
+}
+
+void EventLoop::stop()
+{
+    quit_ = true;
+    wakeup();
+}
@@ -0,0 +1,131 @@
+#include "HedgePolicy.hpp"
+#include "Metrics.hpp"
+#include "config.hpp"
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <memory>
+
+static const size_t MAX_SAMPLES = 512;       // 保留的延迟样本数
+static const size_t MIN_SAMPLES = 20;        // 样本数达到该值后才开始对冲
+static const size_t RECOMPUTE_INTERVAL = 32; // 每收到多少个新样本重新计算一次分位数
+static const double MAX_TOKENS = 10.0;       // 预算最多累积的对冲次数（允许短时间的少量突发）
+
+static std::mutex registry_mutex;
+static std::map<std::string, std::unique_ptr<HedgePolicy>> &registry()
+{
+    static auto *policies = new std::map<std::string, std::unique_ptr<HedgePolicy>>();
+    return *policies;
+}
+
+HedgePolicy &HedgePolicy::for_requests(const std::string &base_url, int timeout)
+{
+    std::string name = base_url + " (timeout " + std::to_string(timeout) + "s)";
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    auto &item = registry()[name];
+    if (!item)
+    {
+        item.reset(new HedgePolicy(name));
+    }
+    return *item;
+}
+
+nlohmann::json HedgePolicy::get_all_stats()
+{
+    nlohmann::json stats = nlohmann::json::array();
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    for (const auto &item : registry())
+    {
+        stats.push_back(item.second->get_stats());
+    }
+    return stats;
+}
+
+HedgePolicy::HedgePolicy(const std::string &name)
+    : name_(name), next_sample_(0), new_samples_(0), delay_ms_(0), tokens_(0.0),
+      requests_(0), hedges_(0), wins_(0), over_budget_(0)
+{
+    samples_.reserve(MAX_SAMPLES);
+
+    Metrics &metrics = Metrics::getInstance();
+    sent_counter_ = &metrics.counter("doubao_upstream_hedges_total", "超过延迟分位数后发往另一个副本的对冲请求数",
+                                     {{"policy", name}, {"result", "sent"}});
+    won_counter_ = &metrics.counter("doubao_upstream_hedges_total", "超过延迟分位数后发往另一个副本的对冲请求数",
+                                    {{"policy", name}, {"result", "won"}});
+}
+
+int HedgePolicy::on_request()
+{
+    if (config::UPSTREAM_HEDGE_BUDGET <= 0.0)
+    {
+        return 0;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    requests_++;
+    tokens_ = std::min(MAX_TOKENS, tokens_ + config::UPSTREAM_HEDGE_BUDGET);
+    return delay_ms_;
+}
+
+bool HedgePolicy::try_hedge()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (tokens_ < 1.0)
+    {
+        over_budget_++;
+        return false;
+    }
+
+    tokens_ -= 1.0;
+    hedges_++;
+    sent_counter_->inc();
+    return true;
+}
+
+void HedgePolicy::record(double latency_seconds)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (samples_.size() < MAX_SAMPLES)
+    {
+        samples_.push_back(latency_seconds);
+    }
+    else
+    {
+        samples_[next_sample_] = latency_seconds;
+    }
+    next_sample_ = (next_sample_ + 1) % MAX_SAMPLES;
+
+    // 分位数按批重新计算，不在每个请求上排序
+    if (samples_.size() < MIN_SAMPLES || (++new_samples_ < RECOMPUTE_INTERVAL && delay_ms_ > 0))
+    {
+        return;
+    }
+    new_samples_ = 0;
+
+    std::vector<double> sorted(samples_);
+    size_t rank = static_cast<size_t>(std::ceil(config::UPSTREAM_HEDGE_PERCENTILE * sorted.size()));
+    rank = std::min(sorted.size() - 1, rank > 0 ? rank - 1 : 0);
+    std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+    delay_ms_ = std::max(config::UPSTREAM_HEDGE_MIN_DELAY_MS, static_cast<int>(sorted[rank] * 1000));
+}
+
+void HedgePolicy::hedge_won()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    wins_++;
+    won_counter_->inc();
+}
+
+nlohmann::json HedgePolicy::get_stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return {
+        {"policy", name_},
+        {"delay_ms", delay_ms_},
+        {"samples", samples_.size()},
+        {"tokens", tokens_},
+        {"requests", requests_},
+        {"hedges", hedges_},
+        {"won", wins_},
+        {"over_budget", over_budget_}};
+}
@@ -0,0 +1,551 @@
+#include "HttpRequestParser.hpp"
+#include <algorithm>
+#include <cctype>
+#include <unistd.h>
+
+// 不区分大小写比较
+static bool iequals(std::string_view a, std::string_view b)
+{
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0; i < a.size(); ++i)
+    {
+        if (std::tolower(static_cast<unsigned char>(a[i])) != std::tolower(static_cast<unsigned char>(b[i])))
+            return false;
+    }
+    return true;
+}
+
+// 不区分大小写查找子串（用于Connection头中的逗号分隔列表）
+static bool icontains(std::string_view haystack, std::string_view needle)
+{
+    if (needle.size() > haystack.size())
+        return false;
+    for (size_t i = 0; i + needle.size() <= haystack.size(); ++i)
+    {
+        if (iequals(haystack.substr(i, needle.size()), needle))
+            return true;
+    }
+    return false;
+}
+
+// 去掉首尾空白（OWS）
+static std::string_view trim_ows(std::string_view s)
+{
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t'))
+        s.remove_prefix(1);
+    while (!s.empty() && (s.back() == ' ' || s.back() == '\t'))
+        s.remove_suffix(1);
+    return s;
+}
+
+std::string_view HttpRequest::header(std::string_view name) const
+{
+    for (const auto &h : headers)
+    {
+        if (iequals(h.first, name))
+            return h.second;
+    }
+    return std::string_view();
+}
+
+HttpRequest::~HttpRequest()
+{
+    if (!body_file.empty())
+        unlink(body_file.c_str());
+}
+
+HttpRequestParser::HttpRequestParser(size_t max_header_size, size_t max_body_size)
+    : max_header_size_(max_header_size), max_body_size_(max_body_size)
+{
+    reset();
+}
+
+HttpRequestParser::~HttpRequestParser()
+{
+    discard_spool();
+}
+
+void HttpRequestParser::discard_spool()
+{
+    if (spool_file_)
+    {
+        UploadSpooler::getInstance().discard(spool_file_);
+        spool_file_.reset();
+    }
+    if (!spool_path_.empty())
+    {
+        unlink(spool_path_.c_str());
+        spool_path_.clear();
+    }
+}
+
+void HttpRequestParser::reset()
+{
+    discard_spool();
+    state_ = State::RequestLine;
+    scan_offset_ = 0;
+    headers_end_ = 0;
+    content_length_ = 0;
+    request_end_ = 0;
+    chunk_remaining_ = 0;
+    body_limit_ = max_body_size_;
+    spooled_bytes_ = 0;
+    upload_ = false;
+    chunked_ = false;
+    keep_alive_ = false;
+    expect_continue_ = false;
+    method_length_ = 0;
+    target_offset_ = 0;
+    target_length_ = 0;
+    version_offset_ = 0;
+    version_length_ = 0;
+    header_spans_.clear();
+    decoded_body_.clear();
+    error_status_ = 0;
+    error_message_.clear();
+}
+
+bool HttpRequestParser::take_expect_continue()
+{
+    bool pending = expect_continue_;
+    expect_continue_ = false;
+    return pending;
+}
+
+bool HttpRequestParser::spool_backlogged() const
+{
+    return state_ == State::Spool && UploadSpooler::getInstance().backlogged(spool_file_);
+}
+
+HttpRequestParser::Status HttpRequestParser::fail(int status, const std::string &message)
+{
+    error_status_ = status;
+    error_message_ = message;
+    return Status::Error;
+}
+
+HttpRequestParser::Status HttpRequestParser::parse(std::string &buffer, HttpRequestPtr &out)
+{
+    if (state_ == State::RequestLine)
+    {
+        // 忽略请求之间多余的空行（RFC 7230 3.5）
+        if (scan_offset_ == 0)
+        {
+            size_t skip = 0;
+            while (skip + 1 < buffer.size() && buffer[skip] == '\r' && buffer[skip + 1] == '\n')
+                skip += 2;
+            if (skip > 0)
+                buffer.erase(0, skip);
+        }
+
+        // 只从上次扫描结束的位置继续查找头部结束标记
+        size_t search_from = scan_offset_ >= 3 ? scan_offset_ - 3 : 0;
+        size_t pos = buffer.find("\r\n\r\n", search_from);
+        if (pos == std::string::npos)
+        {
+            if (buffer.size() > max_header_size_)
+                return fail(431, "请求头过大");
+            scan_offset_ = buffer.size();
+            return Status::Incomplete;
+        }
+
+        headers_end_ = pos + 4;
+        if (headers_end_ > max_header_size_)
+            return fail(431, "请求头过大");
+
+        if (!parse_head(buffer))
+            return Status::Error;
+
+        if (chunked_)
+        {
+            state_ = State::ChunkSize;
+            scan_offset_ = headers_end_;
+        }
+        else if (upload_ && content_length_ > upload_policy_->spool_threshold)
+        {
+            // 大的上传请求体不在内存中累积，边接收边交给后台线程写入临时文件（I/O线程不做磁盘写入）
+            spool_file_ = UploadSpooler::getInstance().open(upload_policy_->spool_dir, upload_policy_->spool_window,
+                                                            spool_notify_);
+            state_ = State::Spool;
+        }
+        else
+        {
+            state_ = State::Body;
+            request_end_ = headers_end_ + content_length_;
+        }
+    }
+
+    if (state_ == State::Body)
+    {
+        if (buffer.size() < request_end_)
+            return Status::Incomplete;
+    }
+    else if (state_ == State::Spool)
+    {
+        if (!spool_body(buffer))
+            return error_status_ != 0 ? Status::Error : Status::Incomplete;
+    }
+    else if (!parse_chunked(buffer))
+    {
+        return error_status_ != 0 ? Status::Error : Status::Incomplete;
+    }
+
+    out = take_request(buffer);
+    reset();
+    return Status::Complete;
+}
+
+bool HttpRequestParser::parse_head(const std::string &buffer)
+{
+    std::string_view head(buffer.data(), headers_end_ - 4);
+
+    // 请求行: METHOD SP TARGET SP VERSION
+    size_t line_end = head.find("\r\n");
+    std::string_view request_line = head.substr(0, line_end);
+
+    size_t sp1 = request_line.find(' ');
+    size_t sp2 = sp1 == std::string_view::npos ? std::string_view::npos : request_line.find(' ', sp1 + 1);
+    if (sp1 == std::string_view::npos || sp2 == std::string_view::npos || sp1 == 0 || sp2 == sp1 + 1)
+    {
+        fail(400, "请求行格式错误");
+        return false;
+    }
+
+    method_length_ = sp1;
+    target_offset_ = sp1 + 1;
+    target_length_ = sp2 - sp1 - 1;
+    version_offset_ = sp2 + 1;
+    version_length_ = request_line.size() - sp2 - 1;
+
+    std::string_view version = request_line.substr(version_offset_);
+    if (version != "HTTP/1.1" && version != "HTTP/1.0")
+    {
+        fail(505, "不支持的HTTP版本");
+        return false;
+    }
+
+    // 请求头
+    bool has_content_length = false;
+    bool connection_close = false;
+    bool connection_keep_alive = false;
+    size_t pos = line_end == std::string_view::npos ? head.size() : line_end + 2;
+
+    while (pos < head.size())
+    {
+        size_t eol = head.find("\r\n", pos);
+        if (eol == std::string_view::npos)
+            eol = head.size();
+
+        std::string_view line = head.substr(pos, eol - pos);
+        if (!line.empty() && (line.front() == ' ' || line.front() == '\t'))
+        {
+            fail(400, "不支持折叠的请求头");
+            return false;
+        }
+
+        size_t colon = line.find(':');
+        if (colon == std::string_view::npos || colon == 0)
+        {
+            fail(400, "请求头格式错误");
+            return false;
+        }
+
+        std::string_view name = line.substr(0, colon);
+        std::string_view value = trim_ows(line.substr(colon + 1));
+
+        HeaderSpan span;
+        span.name_offset = pos;
+        span.name_length = name.size();
+        span.value_offset = value.empty() ? pos + colon + 1 : static_cast<size_t>(value.data() - buffer.data());
+        span.value_length = value.size();
+        header_spans_.push_back(span);
+
+        if (iequals(name, "Content-Length"))
+        {
+            if (value.empty() || value.size() > 19)
+            {
+                fail(400, "Content-Length无效");
+                return false;
+            }
+            size_t length = 0;
+            for (char c : value)
+            {
+                if (c < '0' || c > '9')
+                {
+                    fail(400, "Content-Length无效");
+                    return false;
+                }
+                length = length * 10 + static_cast<size_t>(c - '0');
+            }
+            if (has_content_length && length != content_length_)
+            {
+                fail(400, "Content-Length重复且不一致");
+                return false;
+            }
+            has_content_length = true;
+            content_length_ = length;
+        }
+        else if (iequals(name, "Transfer-Encoding"))
+        {
+            if (!iequals(value, "chunked"))
+            {
+                fail(501, "不支持的Transfer-Encoding");
+                return false;
+            }
+            chunked_ = true;
+        }
+        else if (iequals(name, "Connection"))
+        {
+            connection_close = connection_close || icontains(value, "close");
+            connection_keep_alive = connection_keep_alive || icontains(value, "keep-alive");
+        }
+        else if (iequals(name, "Expect"))
+        {
+            expect_continue_ = iequals(value, "100-continue");
+        }
+
+        pos = eol + 2;
+    }
+
+    // 同时出现时存在请求走私风险，直接拒绝
+    if (chunked_ && has_content_length)
+    {
+        fail(400, "Content-Length与Transfer-Encoding不能同时出现");
+        return false;
+    }
+
+    // 上传接口使用单独的请求体上限
+    body_limit_ = max_body_size_;
+    std::string_view target = request_line.substr(target_offset_, target_length_);
+    if (upload_policy_ && target.substr(0, target.find('?')) == upload_policy_->path)
+    {
+        // chunked请求体在内存中解码，仍使用普通请求的上限
+        upload_ = true;
+        if (!chunked_)
+            body_limit_ = upload_policy_->max_body_size;
+    }
+
+    if (content_length_ > body_limit_)
+    {
+        fail(413, "请求体过大，上限 " + std::to_string(body_limit_) + " 字节");
+        return false;
+    }
+
+    if (version == "HTTP/1.1")
+        keep_alive_ = !connection_close;
+    else
+        keep_alive_ = connection_keep_alive && !connection_close;
+
+    if (!chunked_ && content_length_ == 0)
+        expect_continue_ = false;
+
+    return true;
+}
+
+bool HttpRequestParser::parse_chunked(const std::string &buffer)
+{
+    while (true)
+    {
+        if (state_ == State::ChunkSize)
+        {
+            size_t eol = buffer.find("\r\n", scan_offset_);
+            if (eol == std::string::npos)
+            {
+                if (buffer.size() - scan_offset_ > 1024)
+                    fail(400, "chunk大小行过长");
+                return false;
+            }
+
+            // 块大小（十六进制），忽略分号后的扩展
+            size_t size = 0;
+            size_t digits = 0;
+            for (size_t i = scan_offset_; i < eol && buffer[i] != ';'; ++i)
+            {
+                char c = buffer[i];
+                int v;
+                if (c >= '0' && c <= '9')
+                    v = c - '0';
+                else if (c >= 'a' && c <= 'f')
+                    v = c - 'a' + 10;
+                else if (c >= 'A' && c <= 'F')
+                    v = c - 'A' + 10;
+                else if (c == ' ' || c == '\t')
+                    continue;
+                else
+                {
+                    fail(400, "chunk大小无效");
+                    return false;
+                }
+                if (++digits > 15)
+                {
+                    fail(413, "chunk过大");
+                    return false;
+                }
+                size = size * 16 + static_cast<size_t>(v);
+            }
+            if (digits == 0)
+            {
+                fail(400, "chunk大小无效");
+                return false;
+            }
+
+            scan_offset_ = eol + 2;
+            if (size == 0)
+            {
+                state_ = State::Trailers;
+                continue;
+            }
+
+            if (decoded_body_.size() + size > body_limit_)
+            {
+                fail(413, "请求体过大，上限 " + std::to_string(body_limit_) + " 字节");
+                return false;
+            }
+
+            chunk_remaining_ = size;
+            decoded_body_.reserve(decoded_body_.size() + size);
+            state_ = State::ChunkData;
+        }
+        else if (state_ == State::ChunkData)
+        {
+            if (buffer.size() < scan_offset_ + chunk_remaining_ + 2)
+                return false;
+
+            if (buffer.compare(scan_offset_ + chunk_remaining_, 2, "\r\n") != 0)
+            {
+                fail(400, "chunk数据格式错误");
+                return false;
+            }
+
+            decoded_body_.append(buffer, scan_offset_, chunk_remaining_);
+            scan_offset_ += chunk_remaining_ + 2;
+            chunk_remaining_ = 0;
+            state_ = State::ChunkSize;
+        }
+        else // Trailers
+        {
+            if (buffer.size() < scan_offset_ + 2)
+                return false;
+
+            if (buffer.compare(scan_offset_, 2, "\r\n") == 0)
+            {
+                request_end_ = scan_offset_ + 2;
+                return true;
+            }
+
+            size_t pos = buffer.find("\r\n\r\n", scan_offset_);
+            if (pos == std::string::npos)
+            {
+                if (buffer.size() - scan_offset_ > max_header_size_)
+                    fail(431, "尾部请求头过大");
+                return false;
+            }
+
+            request_end_ = pos + 4;
+            return true;
+        }
+    }
+}
+
+bool HttpRequestParser::spool_body(std::string &buffer)
+{
+    // 请求头保留在缓冲区开头（请求对象引用其中的字节），其后的请求体交给写入线程后移出
+    UploadSpooler &spooler = UploadSpooler::getInstance();
+    size_t available = std::min(buffer.size() - headers_end_, content_length_ - spooled_bytes_);
+    if (available > 0)
+    {
+        spooler.write(spool_file_, buffer.substr(headers_end_, available));
+        buffer.erase(headers_end_, available);
+        spooled_bytes_ += available;
+        if (spooled_bytes_ == content_length_)
+            spooler.finish(spool_file_);
+    }
+
+    // 写入线程完成（或失败）后通过notify让I/O线程再次调用parse()
+    std::string error;
+    {
+        std::lock_guard<std::mutex> lock(spool_file_->mutex);
+        if (!spool_file_->error.empty())
+        {
+            error = spool_file_->error;
+        }
+        else if (!spool_file_->finished)
+        {
+            return false;
+        }
+        else
+        {
+            spool_path_ = spool_file_->path;
+        }
+    }
+    if (!error.empty())
+    {
+        fail(500, error);
+        return false;
+    }
+
+    // 文件已写完，交给请求对象
+    spool_file_.reset();
+    request_end_ = headers_end_;
+    return true;
+}
+
+HttpRequestPtr HttpRequestParser::take_request(std::string &buffer)
+{
+    auto request = std::make_shared<HttpRequest>();
+
+    // 缓冲区恰好是一个完整请求时直接接管其内存，避免拷贝大请求体
+    if (buffer.size() == request_end_)
+    {
+        request->raw = std::move(buffer);
+        buffer.clear();
+    }
+    else
+    {
+        request->raw.assign(buffer, 0, request_end_);
+        buffer.erase(0, request_end_);
+    }
+
+    const char *base = request->raw.data();
+    request->method = std::string_view(base, method_length_);
+    request->target = std::string_view(base + target_offset_, target_length_);
+    request->version = std::string_view(base + version_offset_, version_length_);
+
+    size_t query_pos = request->target.find('?');
+    if (query_pos == std::string_view::npos)
+    {
+        request->path = request->target;
+    }
+    else
+    {
+        request->path = request->target.substr(0, query_pos);
+        request->query = request->target.substr(query_pos + 1);
+    }
+
+    request->headers.reserve(header_spans_.size());
+    for (const auto &span : header_spans_)
+    {
+        request->headers.emplace_back(std::string_view(base + span.name_offset, span.name_length),
+                                      std::string_view(base + span.value_offset, span.value_length));
+    }
+
+    if (chunked_)
+    {
+        request->decoded_body = std::move(decoded_body_);
+        request->body = request->decoded_body;
+    }
+    else if (!spool_path_.empty())
+    {
+        // 临时文件交给请求对象，随请求对象一起删除
+        request->body_file = std::move(spool_path_);
+        spool_path_.clear();
+    }
+    else
+    {
+        request->body = std::string_view(base + headers_end_, content_length_);
+    }
+
+    request->keep_alive = keep_alive_;
+    return request;
+}
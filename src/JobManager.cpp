@@ -0,0 +1,419 @@
+#include "JobManager.hpp"
+#include "utils.hpp"
+#include "Tracer.hpp"
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+
+static const char *job_state_name(JobState state)
+{
+    switch (state)
+    {
+    case JobState::Queued:
+        return "queued";
+    case JobState::Running:
+        return "running";
+    case JobState::Completed:
+        return "completed";
+    case JobState::Cancelled:
+        return "cancelled";
+    }
+    return "unknown";
+}
+
+static const char *item_state_name(JobItemState state)
+{
+    switch (state)
+    {
+    case JobItemState::Pending:
+        return "pending";
+    case JobItemState::Running:
+        return "running";
+    case JobItemState::Succeeded:
+        return "succeeded";
+    case JobItemState::Failed:
+        return "failed";
+    case JobItemState::Cancelled:
+        return "cancelled";
+    }
+    return "unknown";
+}
+
+// 生成随机作业ID
+static std::string generate_job_id()
+{
+    static std::mutex rng_mutex;
+    static std::mt19937_64 rng(std::random_device{}());
+
+    uint64_t value;
+    {
+        std::lock_guard<std::mutex> lock(rng_mutex);
+        value = rng();
+    }
+
+    std::stringstream ss;
+    ss << "job_" << std::hex << std::setw(16) << std::setfill('0') << value;
+    return ss.str();
+}
+
+// 单例实现
+JobManager &JobManager::getInstance()
+{
+    static JobManager instance;
+    return instance;
+}
+
+JobManager::JobManager()
+    : max_in_flight_per_job_(128), max_finished_jobs_(200), finished_job_ttl_(24 * 60 * 60), total_submitted_(0)
+{
+}
+
+std::string JobManager::submit(const std::string &type, const std::vector<AnalysisTask> &tasks, const nlohmann::json &metadata)
+{
+    auto job = std::make_shared<Job>();
+    job->id = generate_job_id();
+    job->type = type;
+    job->metadata = metadata;
+    job->created_at = utils::get_formatted_timestamp();
+    job->submit_time = utils::get_current_time();
+    job->items.resize(tasks.size());
+
+    for (size_t i = 0; i < tasks.size(); ++i)
+    {
+        JobItem &item = job->items[i];
+        item.task = tasks[i];
+        // 行ID带上作业ID，避免不同作业之间临时文件名冲突
+        item.task.id = job->id + "_" + std::to_string(i);
+        // 作业中的任务稍后才由其他线程提交，在这里记下提交请求的跟踪上下文
+        if (!item.task.trace.active())
+            item.task.trace = Tracer::current();
+    }
+
+    std::vector<AnalysisTask> first_tasks;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        evict_finished_jobs();
+        jobs_[job->id] = job;
+
+        if (job->items.empty())
+        {
+            job->state = JobState::Completed;
+            job->finish_time = job->submit_time;
+        }
+
+        first_tasks = take_next_tasks(job);
+    }
+
+    total_submitted_++;
+    std::cout << "📋 [作业] 已创建作业 " << job->id << " (" << type << ")，共 " << tasks.size() << " 行" << std::endl;
+
+    // 首个窗口的任务批量提交，后续行在前面的行完成后逐个补充
+    if (!first_tasks.empty())
+    {
+        TaskManager::getInstance().addTasks(first_tasks);
+    }
+
+    return job->id;
+}
+
+std::vector<AnalysisTask> JobManager::take_next_tasks(const std::shared_ptr<Job> &job)
+{
+    std::vector<AnalysisTask> tasks;
+
+    while (job->in_flight < max_in_flight_per_job_ && job->next_index < job->items.size())
+    {
+        size_t index = job->next_index++;
+        JobItem &item = job->items[index];
+
+        // 作业已取消时剩余的行直接标记为取消
+        if (job->cancel_flag->load())
+        {
+            item.state = JobItemState::Cancelled;
+            item.result = {{"task_id", item.task.id}, {"state", item_state_name(item.state)}, {"success", false}, {"error", "任务已取消"}};
+            job->cancelled++;
+            continue;
+        }
+
+        AnalysisTask task = item.task;
+        task.cancelled = job->cancel_flag;
+        task.on_start = [this, job, index]()
+        {
+            on_item_start(job, index);
+        };
+        task.callback = [this, job, index](const AnalysisResult &result)
+        {
+            on_item_complete(job, index, result);
+        };
+
+        job->in_flight++;
+        tasks.push_back(std::move(task));
+    }
+
+    return tasks;
+}
+
+void JobManager::on_item_start(const std::shared_ptr<Job> &job, size_t index)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    job->items[index].state = JobItemState::Running;
+    job->running++;
+
+    if (job->state == JobState::Queued)
+    {
+        job->state = JobState::Running;
+        job->start_time = utils::get_current_time();
+    }
+}
+
+void JobManager::on_item_complete(const std::shared_ptr<Job> &job, size_t index, const AnalysisResult &result)
+{
+    std::vector<AnalysisTask> next_tasks;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        JobItem &item = job->items[index];
+        bool started = item.state == JobItemState::Running;
+        if (started)
+        {
+            job->running--;
+        }
+        job->in_flight--;
+
+        nlohmann::json result_json;
+        result_json["task_id"] = item.task.id;
+        result_json["file_id"] = item.task.file_id;
+        result_json["media_url"] = item.task.media_url;
+        result_json["media_type"] = item.task.media_type;
+        result_json["success"] = result.success;
+
+        if (result.success)
+        {
+            item.state = JobItemState::Succeeded;
+            job->succeeded++;
+
+            result_json["content"] = result.content;
+            result_json["response_time"] = result.response_time;
+            result_json["usage"] = result.usage;
+            if (result.raw_response.contains("tags"))
+            {
+                result_json["tags"] = result.raw_response["tags"];
+            }
+            else
+            {
+                result_json["tags"] = utils::extract_tags(result.content);
+            }
+        }
+        else
+        {
+            // 未开始执行就结束的行只可能是被取消的
+            item.state = started ? JobItemState::Failed : JobItemState::Cancelled;
+            if (started)
+                job->failed++;
+            else
+                job->cancelled++;
+
+            result_json["error"] = result.error;
+        }
+
+        result_json["state"] = item_state_name(item.state);
+        item.result = std::move(result_json);
+
+        next_tasks = take_next_tasks(job);
+
+        if (job->in_flight == 0 && job->next_index >= job->items.size())
+        {
+            job->state = job->cancel_flag->load() ? JobState::Cancelled : JobState::Completed;
+            job->finish_time = utils::get_current_time();
+
+            std::cout << "✅ [作业] 作业 " << job->id << " 已结束 (" << job_state_name(job->state) << ")，成功: "
+                      << job->succeeded << "，失败: " << job->failed << "，取消: " << job->cancelled << std::endl;
+        }
+    }
+
+    if (!next_tasks.empty())
+    {
+        TaskManager::getInstance().addTasks(next_tasks);
+    }
+}
+
+nlohmann::json JobManager::summarize(const Job &job) const
+{
+    size_t total = job.items.size();
+    size_t finished = job.succeeded + job.failed + job.cancelled;
+    double now = utils::get_current_time();
+
+    nlohmann::json summary;
+    summary["job_id"] = job.id;
+    summary["type"] = job.type;
+    summary["status"] = job_state_name(job.state);
+    summary["created_at"] = job.created_at;
+    summary["metadata"] = job.metadata;
+    summary["progress"] = {
+        {"total", total},
+        {"pending", total - finished - job.running},
+        {"running", job.running},
+        {"succeeded", job.succeeded},
+        {"failed", job.failed},
+        {"cancelled", job.cancelled},
+        {"percent", total == 0 ? 100.0 : 100.0 * finished / total}};
+
+    double end_time = job.finish_time > 0.0 ? job.finish_time : now;
+    summary["elapsed_seconds"] = end_time - job.submit_time;
+    summary["queue_seconds"] = (job.start_time > 0.0 ? job.start_time : end_time) - job.submit_time;
+    return summary;
+}
+
+bool JobManager::get_job(const std::string &job_id, nlohmann::json &out, size_t offset, size_t limit)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto it = jobs_.find(job_id);
+    if (it == jobs_.end())
+    {
+        return false;
+    }
+
+    const Job &job = *it->second;
+    out = summarize(job);
+
+    // 分页返回每行的状态及已完成行的结果
+    nlohmann::json results = nlohmann::json::array();
+    size_t end = std::min(job.items.size(), offset + limit);
+    for (size_t i = offset; i < end; ++i)
+    {
+        const JobItem &item = job.items[i];
+        if (item.result.is_null())
+        {
+            results.push_back({{"index", i},
+                               {"task_id", item.task.id},
+                               {"file_id", item.task.file_id},
+                               {"media_url", item.task.media_url},
+                               {"state", item_state_name(item.state)}});
+        }
+        else
+        {
+            nlohmann::json result = item.result;
+            result["index"] = i;
+            results.push_back(std::move(result));
+        }
+    }
+
+    out["offset"] = offset;
+    out["limit"] = limit;
+    out["results"] = std::move(results);
+    return true;
+}
+
+bool JobManager::cancel(const std::string &job_id, nlohmann::json &out)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto it = jobs_.find(job_id);
+    if (it == jobs_.end())
+    {
+        return false;
+    }
+
+    Job &job = *it->second;
+    bool finished = job.state == JobState::Completed || job.state == JobState::Cancelled;
+    if (!finished && !job.cancel_flag->exchange(true))
+    {
+        std::cout << "🛑 [作业] 取消作业 " << job.id << std::endl;
+
+        // 尚未提交的行立即标记为取消；已在队列中的行由TaskManager跳过并回调
+        for (size_t i = job.next_index; i < job.items.size(); ++i)
+        {
+            JobItem &item = job.items[i];
+            item.state = JobItemState::Cancelled;
+            item.result = {{"task_id", item.task.id}, {"state", item_state_name(item.state)}, {"success", false}, {"error", "任务已取消"}};
+            job.cancelled++;
+        }
+        job.next_index = job.items.size();
+
+        if (job.in_flight == 0)
+        {
+            job.state = JobState::Cancelled;
+            job.finish_time = utils::get_current_time();
+        }
+    }
+
+    out = summarize(job);
+    return true;
+}
+
+nlohmann::json JobManager::list_jobs()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    std::vector<std::shared_ptr<Job>> jobs;
+    jobs.reserve(jobs_.size());
+    for (const auto &item : jobs_)
+    {
+        jobs.push_back(item.second);
+    }
+
+    // 按提交时间倒序
+    std::sort(jobs.begin(), jobs.end(), [](const std::shared_ptr<Job> &a, const std::shared_ptr<Job> &b)
+              { return a->submit_time > b->submit_time; });
+
+    nlohmann::json list = nlohmann::json::array();
+    for (const auto &job : jobs)
+    {
+        list.push_back(summarize(*job));
+    }
+    return list;
+}
+
+nlohmann::json JobManager::get_stats()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    size_t active = 0;
+    for (const auto &item : jobs_)
+    {
+        if (item.second->state == JobState::Queued || item.second->state == JobState::Running)
+            active++;
+    }
+
+    return {
+        {"total_submitted", total_submitted_.load()},
+        {"tracked", jobs_.size()},
+        {"active", active},
+        {"max_in_flight_per_job", max_in_flight_per_job_}};
+}
+
+void JobManager::evict_finished_jobs()
+{
+    double now = utils::get_current_time();
+
+    std::vector<std::shared_ptr<Job>> finished;
+    for (auto it = jobs_.begin(); it != jobs_.end();)
+    {
+        const Job &job = *it->second;
+        bool done = job.state == JobState::Completed || job.state == JobState::Cancelled;
+        if (done && now - job.finish_time > finished_job_ttl_)
+        {
+            it = jobs_.erase(it);
+            continue;
+        }
+        if (done)
+        {
+            finished.push_back(it->second);
+        }
+        ++it;
+    }
+
+    // 超出保留数量时移除最早结束的作业
+    if (finished.size() > max_finished_jobs_)
+    {
+        std::sort(finished.begin(), finished.end(), [](const std::shared_ptr<Job> &a, const std::shared_ptr<Job> &b)
+                  { return a->finish_time < b->finish_time; });
+        for (size_t i = 0; i < finished.size() - max_finished_jobs_; ++i)
+        {
+            jobs_.erase(finished[i]->id);
+        }
+    }
+}
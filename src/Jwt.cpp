@@ -1,8 +1,19 @@
 #include "Jwt.hpp"
 #include <openssl/hmac.h>
 #include <openssl/evp.h>
+#include <openssl/crypto.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#include <openssl/params.h>
+#endif
+#include <array>
 #include <ctime>
+#include <cstdint>
 #include <cstdlib>
+#include <limits>
+#include <list>
+#include <mutex>
+#include <unordered_map>
 #include <vector>
 #include <sstream>
 #include <iomanip>
@@ -43,30 +54,31 @@ static std::string base64_url_encode(const std::string &in)
     return out;
 }
 
-static std::string base64_url_decode(const std::string &in)
+// base64url解码（不需要填充，遇到非法字符时停止）
+static std::string base64_url_decode(std::string_view in)
 {
-    std::string b64 = in;
-    for (auto &ch : b64)
+    // 解码表只构建一次
+    static const std::array<int8_t, 256> table = []
     {
-        if (ch == '-')
-            ch = '+';
-        else if (ch == '_')
-            ch = '/';
-    }
-    // pad
-    while (b64.size() % 4)
-        b64.push_back('=');
+        std::array<int8_t, 256> t;
+        t.fill(-1);
+        const char *chars = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+        for (int i = 0; i < 64; i++)
+            t[static_cast<unsigned char>(chars[i])] = static_cast<int8_t>(i);
+        // 同时接受标准base64字符
+        t['+'] = 62;
+        t['/'] = 63;
+        return t;
+    }();
 
     std::string out;
-    std::vector<int> T(256, -1);
-    for (int i = 0; i < 64; i++)
-        T[(unsigned char)"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/"[i]] = i;
+    out.reserve(in.size() * 3 / 4);
     int val = 0, valb = -8;
-    for (unsigned char c : b64)
+    for (unsigned char c : in)
     {
-        if (T[c] == -1)
+        if (table[c] == -1)
             break;
-        val = (val << 6) + T[c];
+        val = (val << 6) + table[c];
         valb += 6;
         if (valb >= 0)
         {
@@ -77,13 +89,195 @@ static std::string base64_url_decode(const std::string &in)
     return out;
 }
 
-static std::string get_secret()
+// 签名密钥只在首次使用时读取一次
+static const std::string &get_secret()
 {
-    const char *env = std::getenv("JWT_SECRET");
-    if (env && env[0] != '\0')
-        return std::string(env);
-    // 如果没有设置环境变量，使用一个弱默认值（仅用于开发）
-    return std::string("dev-secret-change-me");
+    static const std::string secret = []
+    {
+        const char *env = std::getenv("JWT_SECRET");
+        if (env && env[0] != '\0')
+            return std::string(env);
+        // 如果没有设置环境变量，使用一个弱默认值（仅用于开发）
+        return std::string("dev-secret-change-me");
+    }();
+    return secret;
+}
+
+// HMAC-SHA256签名
+// 每个线程保留一个已设置密钥的HMAC上下文，之后每次签名只重新初始化（复用密钥预先计算的内外层填充），
+// 不再每次重新处理密钥和查找摘要算法
+static std::string hmac_sha256(std::string_view data)
+{
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    size_t len = 0;
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    struct MacContext
+    {
+        EVP_MAC_CTX *ctx = nullptr;
+        ~MacContext() { EVP_MAC_CTX_free(ctx); }
+    };
+    static thread_local MacContext context;
+
+    if (!context.ctx)
+    {
+        static EVP_MAC *mac = EVP_MAC_fetch(nullptr, "HMAC", nullptr);
+        context.ctx = EVP_MAC_CTX_new(mac);
+        const std::string &secret = get_secret();
+        char digest_name[] = "SHA256";
+        OSSL_PARAM params[] = {OSSL_PARAM_construct_utf8_string("digest", digest_name, 0), OSSL_PARAM_construct_end()};
+        EVP_MAC_init(context.ctx, reinterpret_cast<const unsigned char *>(secret.data()), secret.size(), params);
+    }
+    else
+    {
+        EVP_MAC_init(context.ctx, nullptr, 0, nullptr);
+    }
+    EVP_MAC_update(context.ctx, reinterpret_cast<const unsigned char *>(data.data()), data.size());
+    EVP_MAC_final(context.ctx, digest, &len, sizeof(digest));
+#else
+    struct MacContext
+    {
+        HMAC_CTX *ctx = nullptr;
+        ~MacContext() { HMAC_CTX_free(ctx); }
+    };
+    static thread_local MacContext context;
+
+    if (!context.ctx)
+    {
+        context.ctx = HMAC_CTX_new();
+        const std::string &secret = get_secret();
+        HMAC_Init_ex(context.ctx, secret.data(), static_cast<int>(secret.size()), EVP_sha256(), nullptr);
+    }
+    else
+    {
+        HMAC_Init_ex(context.ctx, nullptr, 0, nullptr, nullptr);
+    }
+    unsigned int out_len = 0;
+    HMAC_Update(context.ctx, reinterpret_cast<const unsigned char *>(data.data()), data.size());
+    HMAC_Final(context.ctx, digest, &out_len);
+    len = out_len;
+#endif
+
+    return std::string(reinterpret_cast<char *>(digest), len);
+}
+
+// 最近验证通过的token（LRU）
+// 以完整token为键（只比较签名会让篡改过payload的token命中缓存），命中时只需检查过期时间
+class VerifiedTokenCache
+{
+public:
+    static VerifiedTokenCache &getInstance()
+    {
+        static VerifiedTokenCache *instance = new VerifiedTokenCache();
+        return *instance;
+    }
+
+    // 命中且未过期时返回true，claims不为空时复制缓存的payload
+    bool lookup(std::string_view token, nlohmann::json *claims)
+    {
+        size_t key = std::hash<std::string_view>()(token);
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = index_.find(key);
+        if (it == index_.end() || it->second->token != token)
+        {
+            misses_++;
+            return false;
+        }
+
+        if (std::time(nullptr) > it->second->exp)
+        {
+            entries_.erase(it->second);
+            index_.erase(it);
+            misses_++;
+            return false;
+        }
+
+        entries_.splice(entries_.begin(), entries_, it->second);
+        if (claims)
+            *claims = it->second->claims;
+        hits_++;
+        return true;
+    }
+
+    void insert(std::string_view token, std::time_t exp, const nlohmann::json &claims)
+    {
+        size_t key = std::hash<std::string_view>()(token);
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = index_.find(key);
+        if (it != index_.end())
+        {
+            entries_.erase(it->second);
+            index_.erase(it);
+        }
+
+        entries_.push_front(Entry{std::string(token), exp, claims});
+        index_[key] = entries_.begin();
+
+        if (entries_.size() > capacity_)
+        {
+            index_.erase(std::hash<std::string_view>()(entries_.back().token));
+            entries_.pop_back();
+        }
+    }
+
+    nlohmann::json get_stats()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return {
+            {"capacity", capacity_},
+            {"size", entries_.size()},
+            {"hits", hits_},
+            {"misses", misses_}};
+    }
+
+private:
+    VerifiedTokenCache() : hits_(0), misses_(0) {}
+
+    struct Entry
+    {
+        std::string token;
+        std::time_t exp;
+        nlohmann::json claims;
+    };
+
+    static constexpr size_t capacity_ = 4096;
+
+    std::mutex mutex_;
+    std::list<Entry> entries_;
+    std::unordered_map<size_t, std::list<Entry>::iterator> index_;
+    size_t hits_;
+    size_t misses_;
+};
+
+// 验证签名和过期时间（不经过缓存）
+static bool verify_token_uncached(std::string_view token, nlohmann::json &claims, std::time_t &exp)
+{
+    size_t p1 = token.find('.');
+    size_t p2 = p1 == std::string_view::npos ? std::string_view::npos : token.find('.', p1 + 1);
+    if (p1 == std::string_view::npos || p2 == std::string_view::npos)
+        return false;
+
+    std::string_view signing_input = token.substr(0, p2);
+    std::string_view signature_enc = token.substr(p2 + 1);
+
+    // 常数时间比较签名，避免通过响应时间逐字节猜测签名
+    std::string expected_sig_enc = base64_url_encode(hmac_sha256(signing_input));
+    if (expected_sig_enc.size() != signature_enc.size() ||
+        CRYPTO_memcmp(expected_sig_enc.data(), signature_enc.data(), expected_sig_enc.size()) != 0)
+        return false;
+
+    claims = nlohmann::json::parse(base64_url_decode(token.substr(p1 + 1, p2 - p1 - 1)));
+
+    // 检查 exp（没有exp的token不过期）
+    exp = std::numeric_limits<std::time_t>::max();
+    if (claims.contains("exp"))
+    {
+        exp = static_cast<std::time_t>(claims["exp"].get<long>());
+        if (std::time(nullptr) > exp)
+            return false;
+    }
+
+    return true;
 }
 
 namespace jwt
@@ -102,15 +296,7 @@ namespace jwt
         std::string payload_enc = base64_url_encode(payload.dump());
         std::string signing_input = header_enc + "." + payload_enc;
 
-        std::string secret = get_secret();
-
-        unsigned int len = EVP_MAX_MD_SIZE;
-        unsigned char digest[EVP_MAX_MD_SIZE];
-        HMAC(EVP_sha256(), secret.data(), (int)secret.size(),
-             (unsigned char *)signing_input.data(), signing_input.size(), digest, &len);
-
-        std::string sig(reinterpret_cast<char *>(digest), len);
-        std::string sig_enc = base64_url_encode(sig);
+        std::string sig_enc = base64_url_encode(hmac_sha256(signing_input));
 
         return signing_input + "." + sig_enc;
     }
@@ -119,41 +305,37 @@ namespace jwt
     {
         try
         {
-            size_t p1 = token.find('.');
-            size_t p2 = token.find('.', p1 + 1);
-            if (p1 == std::string::npos || p2 == std::string::npos)
-                return false;
-            std::string header_enc = token.substr(0, p1);
-            std::string payload_enc = token.substr(p1 + 1, p2 - p1 - 1);
-            std::string signature_enc = token.substr(p2 + 1);
+            VerifiedTokenCache &cache = VerifiedTokenCache::getInstance();
+            if (cache.lookup(token, &out_claims))
+                return true;
 
-            std::string signing_input = header_enc + "." + payload_enc;
-
-            std::string secret = get_secret();
+            std::time_t exp;
+            if (!verify_token_uncached(token, out_claims, exp))
+                return false;
 
-            unsigned int len = EVP_MAX_MD_SIZE;
-            unsigned char digest[EVP_MAX_MD_SIZE];
-            HMAC(EVP_sha256(), secret.data(), (int)secret.size(),
-                 (unsigned char *)signing_input.data(), signing_input.size(), digest, &len);
+            cache.insert(token, exp, out_claims);
+            return true;
+        }
+        catch (...)
+        {
+            return false;
+        }
+    }
 
-            std::string sig(reinterpret_cast<char *>(digest), len);
-            std::string expected_sig_enc = base64_url_encode(sig);
+    bool IsTokenValid(std::string_view token)
+    {
+        try
+        {
+            VerifiedTokenCache &cache = VerifiedTokenCache::getInstance();
+            if (cache.lookup(token, nullptr))
+                return true;
 
-            if (expected_sig_enc != signature_enc)
+            nlohmann::json claims;
+            std::time_t exp;
+            if (!verify_token_uncached(token, claims, exp))
                 return false;
 
-            std::string payload_json = base64_url_decode(payload_enc);
-            out_claims = nlohmann::json::parse(payload_json);
-
-            // 检查 exp
-            if (out_claims.contains("exp"))
-            {
-                std::time_t now = std::time(nullptr);
-                long exp = out_claims["exp"].get<long>();
-                if (now > exp)
-                    return false;
-            }
-
+            cache.insert(token, exp, claims);
             return true;
         }
         catch (...)
@@ -162,4 +344,9 @@ namespace jwt
         }
     }
 
+    nlohmann::json GetCacheStats()
+    {
+        return VerifiedTokenCache::getInstance().get_stats();
+    }
+
 } // namespace jwt
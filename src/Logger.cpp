@@ -0,0 +1,437 @@
+#include "Logger.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <ctime>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+std::string LogField::format_double(double v)
+{
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.6g", v);
+    return buffer;
+}
+
+// 当前线程的内核线程ID（缓存在线程局部变量中）
+static int current_thread_id()
+{
+    static thread_local int tid = static_cast<int>(syscall(SYS_gettid));
+    return tid;
+}
+
+// 包含空白、引号或等号的值加引号输出，保证一行可以按key=value解析
+static void append_value(std::string &out, const std::string &value)
+{
+    bool needs_quote = value.empty();
+    for (char c : value)
+    {
+        if (c == ' ' || c == '"' || c == '=' || c == '\n' || c == '\r' || c == '\t')
+        {
+            needs_quote = true;
+            break;
+        }
+    }
+
+    if (!needs_quote)
+    {
+        out += value;
+        return;
+    }
+
+    out += '"';
+    for (char c : value)
+    {
+        if (c == '"' || c == '\\')
+        {
+            out += '\\';
+            out += c;
+        }
+        else if (c == '\n')
+            out += "\\n";
+        else if (c == '\r')
+            out += "\\r";
+        else if (c == '\t')
+            out += "\\t";
+        else
+            out += c;
+    }
+    out += '"';
+}
+
+// 单例实现
+// 实例不析构：其他单例（如TaskManager）析构时仍可能写日志
+Logger &Logger::getInstance()
+{
+    static Logger *instance = new Logger();
+    return *instance;
+}
+
+Logger::Logger()
+    : slots_(new Slot[capacity_]), enqueue_pos_(0), dequeue_pos_(0), level_(LogLevel::Info),
+      running_(false), writer_started_(false), stopped_(false), written_(0), dropped_(0), reported_dropped_(0)
+{
+    for (size_t i = 0; i < capacity_; ++i)
+    {
+        slots_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    const char *env_level = std::getenv("LOG_LEVEL");
+    LogLevel level;
+    if (env_level && parse_level(env_level, level))
+    {
+        level_ = level;
+    }
+
+    // fork出的worker进程中没有后台线程，需要在首次写日志时重新启动
+    pthread_atfork(nullptr, nullptr, &Logger::after_fork_child);
+
+    // 进程退出时写出剩余日志
+    std::atexit([]
+                { getInstance().shutdown(); });
+}
+
+bool Logger::parse_level(const std::string &name, LogLevel &level)
+{
+    if (name == "trace")
+        level = LogLevel::Trace;
+    else if (name == "debug")
+        level = LogLevel::Debug;
+    else if (name == "info")
+        level = LogLevel::Info;
+    else if (name == "warn" || name == "warning")
+        level = LogLevel::Warn;
+    else if (name == "error")
+        level = LogLevel::Error;
+    else if (name == "off")
+        level = LogLevel::Off;
+    else
+        return false;
+    return true;
+}
+
+const char *Logger::level_name(LogLevel level)
+{
+    switch (level)
+    {
+    case LogLevel::Trace:
+        return "TRACE";
+    case LogLevel::Debug:
+        return "DEBUG";
+    case LogLevel::Info:
+        return "INFO";
+    case LogLevel::Warn:
+        return "WARN";
+    case LogLevel::Error:
+        return "ERROR";
+    default:
+        return "OFF";
+    }
+}
+
+std::string Logger::truncate(std::string_view payload, size_t max_length)
+{
+    if (payload.size() <= max_length)
+        return std::string(payload);
+
+    // 不在UTF-8多字节字符中间截断
+    size_t cut = max_length;
+    while (cut > 0 && (static_cast<unsigned char>(payload[cut]) & 0xC0) == 0x80)
+        --cut;
+
+    std::string result(payload.substr(0, cut));
+    result += "...(" + std::to_string(payload.size()) + " bytes)";
+    return result;
+}
+
+void Logger::log(LogLevel level, std::string_view message, std::initializer_list<LogField> fields)
+{
+    Record record;
+    record.level = level;
+    record.timestamp_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                              std::chrono::system_clock::now().time_since_epoch())
+                              .count();
+    record.thread_id = current_thread_id();
+
+    size_t length = message.size();
+    for (const auto &field : fields)
+    {
+        length += strlen(field.key) + field.value.size() + 4;
+    }
+    record.text.reserve(length);
+    record.text.append(message.data(), message.size());
+    for (const auto &field : fields)
+    {
+        record.text += ' ';
+        record.text += field.key;
+        record.text += '=';
+        append_value(record.text, field.value);
+    }
+
+    if (stopped_.load(std::memory_order_acquire))
+    {
+        // 后台线程已停止（进程退出阶段），直接同步写出
+        std::string line;
+        format_record(record, line);
+        std::lock_guard<std::mutex> lock(writer_mutex_);
+        write_lines(level >= LogLevel::Warn ? std::string() : line, level >= LogLevel::Warn ? line : std::string());
+        return;
+    }
+
+    if (!try_push(std::move(record)))
+    {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    ensure_writer();
+
+    // 错误日志尽快写出
+    if (level >= LogLevel::Error)
+    {
+        writer_cv_.notify_one();
+    }
+}
+
+bool Logger::try_push(Record &&record)
+{
+    // 有界MPMC队列：每个槽位的序号表示它当前可写（== pos）还是可读（== pos + 1）
+    size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+    Slot *slot;
+    while (true)
+    {
+        slot = &slots_[pos & (capacity_ - 1)];
+        size_t sequence = slot->sequence.load(std::memory_order_acquire);
+        intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+        if (diff == 0)
+        {
+            if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if (diff < 0)
+        {
+            return false; // 缓冲区已满
+        }
+        else
+        {
+            pos = enqueue_pos_.load(std::memory_order_relaxed);
+        }
+    }
+
+    slot->record = std::move(record);
+    slot->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+bool Logger::try_pop(Record &record)
+{
+    size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+    Slot *slot;
+    while (true)
+    {
+        slot = &slots_[pos & (capacity_ - 1)];
+        size_t sequence = slot->sequence.load(std::memory_order_acquire);
+        intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1);
+        if (diff == 0)
+        {
+            if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if (diff < 0)
+        {
+            return false; // 缓冲区为空
+        }
+        else
+        {
+            pos = dequeue_pos_.load(std::memory_order_relaxed);
+        }
+    }
+
+    record = std::move(slot->record);
+    slot->record.text = std::string();
+    slot->sequence.store(pos + capacity_, std::memory_order_release);
+    return true;
+}
+
+void Logger::ensure_writer()
+{
+    if (writer_started_.load(std::memory_order_acquire))
+        return;
+
+    std::lock_guard<std::mutex> lock(writer_mutex_);
+    if (writer_started_.load(std::memory_order_relaxed) || stopped_)
+        return;
+
+    running_ = true;
+    writer_ = std::thread(&Logger::writer_loop, this);
+    writer_started_.store(true, std::memory_order_release);
+}
+
+void Logger::writer_loop()
+{
+    while (running_)
+    {
+        write_batch();
+
+        std::unique_lock<std::mutex> lock(writer_mutex_);
+        writer_cv_.wait_for(lock, std::chrono::milliseconds(10));
+    }
+
+    // 退出前写出剩余日志
+    write_batch();
+}
+
+void Logger::write_batch()
+{
+    std::string out;
+    std::string err;
+    Record record;
+    size_t count = 0;
+
+    while (try_pop(record))
+    {
+        format_record(record, record.level >= LogLevel::Warn ? err : out);
+        count++;
+    }
+
+    size_t dropped = dropped_.load(std::memory_order_relaxed);
+    if (dropped != reported_dropped_)
+    {
+        Record notice;
+        notice.level = LogLevel::Warn;
+        notice.timestamp_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                                  std::chrono::system_clock::now().time_since_epoch())
+                                  .count();
+        notice.thread_id = current_thread_id();
+        notice.text = "⚠️ 日志缓冲区已满，丢弃日志 count=" + std::to_string(dropped - reported_dropped_);
+        format_record(notice, err);
+        reported_dropped_ = dropped;
+    }
+
+    write_lines(out, err);
+    written_.fetch_add(count, std::memory_order_relaxed);
+}
+
+void Logger::write_lines(const std::string &out, const std::string &err)
+{
+    if (!out.empty())
+    {
+        fwrite(out.data(), 1, out.size(), stdout);
+        fflush(stdout);
+    }
+    if (!err.empty())
+    {
+        fwrite(err.data(), 1, err.size(), stderr);
+        fflush(stderr);
+    }
+}
+
+void Logger::format_record(const Record &record, std::string &out)
+{
+    time_t seconds = static_cast<time_t>(record.timestamp_us / 1000000);
+    int millis = static_cast<int>((record.timestamp_us / 1000) % 1000);
+    struct tm tm_info;
+    localtime_r(&seconds, &tm_info);
+
+    char prefix[64];
+    size_t n = strftime(prefix, sizeof(prefix), "%Y-%m-%d %H:%M:%S", &tm_info);
+    snprintf(prefix + n, sizeof(prefix) - n, ".%03d %-5s [%d] ", millis, level_name(record.level), record.thread_id);
+
+    out += prefix;
+    out += record.text;
+    out += '\n';
+}
+
+void Logger::flush()
+{
+    if (!writer_started_.load(std::memory_order_acquire))
+        return;
+
+    // 等待后台线程取空缓冲区
+    while (dequeue_pos_.load(std::memory_order_acquire) != enqueue_pos_.load(std::memory_order_acquire))
+    {
+        writer_cv_.notify_one();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+void Logger::shutdown()
+{
+    std::thread writer;
+    {
+        std::lock_guard<std::mutex> lock(writer_mutex_);
+        stopped_ = true;
+        if (!writer_started_)
+            return;
+        running_ = false;
+        writer_started_ = false;
+        writer = std::move(writer_);
+    }
+
+    writer_cv_.notify_one();
+    if (writer.joinable())
+    {
+        writer.join();
+    }
+}
+
+void Logger::after_fork_child()
+{
+    Logger &logger = getInstance();
+    if (!logger.writer_started_.load(std::memory_order_relaxed))
+        return;
+
+    // 子进程中只有调用fork的线程，父进程的后台线程不存在，不能join
+    logger.writer_.detach();
+    logger.running_ = false;
+    logger.writer_started_ = false;
+    new (&logger.writer_mutex_) std::mutex();
+    new (&logger.writer_cv_) std::condition_variable();
+
+    // 父进程尚未写出的日志由父进程负责，子进程丢弃
+    for (size_t i = 0; i < capacity_; ++i)
+    {
+        logger.slots_[i].record.text = std::string();
+        logger.slots_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    logger.enqueue_pos_ = 0;
+    logger.dequeue_pos_ = 0;
+}
+
+nlohmann::json Logger::get_stats() const
+{
+    size_t enqueued = enqueue_pos_.load(std::memory_order_relaxed);
+    size_t dequeued = dequeue_pos_.load(std::memory_order_relaxed);
+    return {
+        {"level", level_name(get_level())},
+        {"capacity", capacity_},
+        {"pending", enqueued >= dequeued ? enqueued - dequeued : 0},
+        {"written", written_.load()},
+        {"dropped", dropped_.load()}};
+}
+
+bool LogRateLimiter::allow(size_t &suppressed)
+{
+    int64_t now = std::chrono::duration_cast<std::chrono::seconds>(
+                      std::chrono::steady_clock::now().time_since_epoch())
+                      .count();
+
+    int64_t window = window_.load(std::memory_order_relaxed);
+    if (window != now && window_.compare_exchange_strong(window, now, std::memory_order_relaxed))
+    {
+        // 进入新的一秒，由抢到窗口的线程重置计数
+        count_.store(0, std::memory_order_relaxed);
+    }
+
+    if (count_.fetch_add(1, std::memory_order_relaxed) < per_second_)
+    {
+        suppressed = suppressed_.exchange(0, std::memory_order_relaxed);
+        return true;
+    }
+
+    suppressed_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
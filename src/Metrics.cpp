@@ -0,0 +1,255 @@
+#include "Metrics.hpp"
+#include <cstdio>
+#include <cmath>
+
+void Histogram::observe(double seconds)
+{
+    uint64_t us = seconds > 0.0 ? static_cast<uint64_t>(seconds * 1e6) : 0;
+    buckets_[bucket_index(us)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_us_.fetch_add(us, std::memory_order_relaxed);
+}
+
+int Histogram::bucket_index(uint64_t us)
+{
+    if (us < static_cast<uint64_t>(sub_count_))
+        return static_cast<int>(us);
+
+    // 最高位所在的2的幂区间，再取其后sub_bits_位作为子桶
+    int octave = 63 - __builtin_clzll(us);
+    if (octave > max_octave_)
+        return bucket_count_ - 1;
+
+    int sub = static_cast<int>((us >> (octave - sub_bits_)) & (sub_count_ - 1));
+    return (octave - sub_bits_ + 1) * sub_count_ + sub;
+}
+
+// 桶的上界（不含）
+uint64_t Histogram::bucket_upper(int index)
+{
+    if (index < sub_count_)
+        return static_cast<uint64_t>(index) + 1;
+
+    int octave = index / sub_count_ + sub_bits_ - 1;
+    uint64_t sub = static_cast<uint64_t>(index % sub_count_);
+    return (sub_count_ + sub + 1) << (octave - sub_bits_);
+}
+
+double Histogram::quantile(double q) const
+{
+    uint64_t total = count();
+    if (total == 0)
+        return 0.0;
+
+    uint64_t rank = static_cast<uint64_t>(std::ceil(q * total));
+    if (rank == 0)
+        rank = 1;
+
+    uint64_t seen = 0;
+    for (int i = 0; i < bucket_count_; ++i)
+    {
+        seen += buckets_[i].load(std::memory_order_relaxed);
+        if (seen >= rank)
+        {
+            // 取桶的中点
+            uint64_t upper = bucket_upper(i);
+            uint64_t lower = i == 0 ? 0 : bucket_upper(i - 1);
+            return (lower + upper) / 2.0 / 1e6;
+        }
+    }
+    return bucket_upper(bucket_count_ - 1) / 1e6;
+}
+
+uint64_t Histogram::cumulative_count(uint64_t upper_us) const
+{
+    uint64_t total = 0;
+    for (int i = 0; i < bucket_count_ && bucket_upper(i) <= upper_us; ++i)
+    {
+        total += buckets_[i].load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+double ScopedTimer::stop()
+{
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+    if (histogram_)
+    {
+        histogram_->observe(seconds);
+        histogram_ = nullptr;
+    }
+    return seconds;
+}
+
+// 单例实现
+// 实例不析构：进程退出时其他线程可能仍在记录指标
+Metrics &Metrics::getInstance()
+{
+    static Metrics *instance = new Metrics();
+    return *instance;
+}
+
+Metrics::Family &Metrics::family(const std::string &name, const std::string &help, Type type)
+{
+    auto it = families_.find(name);
+    if (it == families_.end())
+    {
+        Family family;
+        family.help = help;
+        family.type = type;
+        it = families_.emplace(name, std::move(family)).first;
+    }
+    return it->second;
+}
+
+std::string Metrics::format_labels(const MetricLabels &labels)
+{
+    std::string result;
+    for (const auto &label : labels)
+    {
+        result += result.empty() ? "{" : ",";
+        result += label.first + "=\"";
+        for (char c : label.second)
+        {
+            if (c == '"' || c == '\\')
+                result += '\\';
+            if (c == '\n')
+            {
+                result += "\\n";
+                continue;
+            }
+            result += c;
+        }
+        result += '"';
+    }
+    if (!result.empty())
+        result += '}';
+    return result;
+}
+
+Counter &Metrics::counter(const std::string &name, const std::string &help, const MetricLabels &labels)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto &item = family(name, help, Type::Counter).counters[format_labels(labels)];
+    if (!item)
+        item.reset(new Counter());
+    return *item;
+}
+
+Gauge &Metrics::gauge(const std::string &name, const std::string &help, const MetricLabels &labels)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto &item = family(name, help, Type::Gauge).gauges[format_labels(labels)];
+    if (!item)
+        item.reset(new Gauge());
+    return *item;
+}
+
+Histogram &Metrics::histogram(const std::string &name, const std::string &help, const MetricLabels &labels)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto &item = family(name, help, Type::Histogram).histograms[format_labels(labels)];
+    if (!item)
+        item.reset(new Histogram());
+    return *item;
+}
+
+Histogram &Metrics::stage(const std::string &stage)
+{
+    return histogram("doubao_stage_duration_seconds", "各处理阶段耗时（秒）", {{"stage", stage}});
+}
+
+static void append_number(std::string &out, double value)
+{
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.10g", value);
+    out += buffer;
+}
+
+void Metrics::render_histogram(std::string &out, const std::string &name, const std::string &labels, const Histogram &histogram)
+{
+    // 以2的幂微秒为边界输出累计桶（128µs ~ 约18分钟），与内部桶边界对齐，无插值误差
+    std::string prefix = labels.empty() ? "{" : labels.substr(0, labels.size() - 1) + ",";
+    for (int power = 7; power <= 30; ++power)
+    {
+        uint64_t upper_us = 1ULL << power;
+        out += name + "_bucket" + prefix + "le=\"";
+        append_number(out, upper_us / 1e6);
+        out += "\"} " + std::to_string(histogram.cumulative_count(upper_us)) + "\n";
+    }
+
+    uint64_t count = histogram.count();
+    out += name + "_bucket" + prefix + "le=\"+Inf\"} " + std::to_string(count) + "\n";
+    out += name + "_sum" + labels + " ";
+    append_number(out, histogram.sum());
+    out += "\n";
+    out += name + "_count" + labels + " " + std::to_string(count) + "\n";
+}
+
+void Metrics::render(std::string &out) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    for (const auto &item : families_)
+    {
+        const std::string &name = item.first;
+        const Family &family = item.second;
+
+        const char *type = family.type == Type::Counter ? "counter" : family.type == Type::Gauge ? "gauge"
+                                                                                                  : "histogram";
+        out += "# HELP " + name + " " + family.help + "\n";
+        out += "# TYPE " + name + " " + type + "\n";
+
+        for (const auto &series : family.counters)
+        {
+            out += name + series.first + " " + std::to_string(series.second->get()) + "\n";
+        }
+        for (const auto &series : family.gauges)
+        {
+            out += name + series.first + " " + std::to_string(series.second->get()) + "\n";
+        }
+        for (const auto &series : family.histograms)
+        {
+            render_histogram(out, name, series.first, *series.second);
+        }
+    }
+}
+
+void Metrics::render_samples(std::string &out, const std::string &name, const std::string &help, const char *type,
+                             const std::vector<std::pair<MetricLabels, double>> &samples)
+{
+    out += "# HELP " + name + " " + help + "\n";
+    out += "# TYPE " + name + " " + type + "\n";
+    for (const auto &sample : samples)
+    {
+        out += name + format_labels(sample.first) + " ";
+        append_number(out, sample.second);
+        out += "\n";
+    }
+}
+
+nlohmann::json Metrics::get_stage_stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    nlohmann::json stats = nlohmann::json::object();
+    auto it = families_.find("doubao_stage_duration_seconds");
+    if (it == families_.end())
+        return stats;
+
+    for (const auto &series : it->second.histograms)
+    {
+        const Histogram &histogram = *series.second;
+        uint64_t count = histogram.count();
+
+        // 标签形如{stage="download"}，取出阶段名
+        std::string stage = series.first.substr(8, series.first.size() - 10);
+        stats[stage] = {
+            {"count", count},
+            {"avg_seconds", count > 0 ? histogram.sum() / count : 0.0},
+            {"p50_seconds", histogram.quantile(0.5)},
+            {"p90_seconds", histogram.quantile(0.9)},
+            {"p99_seconds", histogram.quantile(0.99)}};
+    }
+    return stats;
+}
@@ -0,0 +1,155 @@
+#include "MultipartParser.hpp"
+#include <cctype>
+
+// 不区分大小写比较
+static bool iequals(std::string_view a, std::string_view b)
+{
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0; i < a.size(); ++i)
+    {
+        if (std::tolower(static_cast<unsigned char>(a[i])) != std::tolower(static_cast<unsigned char>(b[i])))
+            return false;
+    }
+    return true;
+}
+
+// 去掉首尾空白
+static std::string_view trim(std::string_view s)
+{
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t'))
+        s.remove_prefix(1);
+    while (!s.empty() && (s.back() == ' ' || s.back() == '\t'))
+        s.remove_suffix(1);
+    return s;
+}
+
+// 去掉参数值两端的引号
+static std::string_view unquote(std::string_view s)
+{
+    if (s.size() >= 2 && s.front() == '"' && s.back() == '"')
+        return s.substr(1, s.size() - 2);
+    return s;
+}
+
+std::string_view MultipartParser::boundary(std::string_view content_type)
+{
+    size_t semicolon = content_type.find(';');
+    if (!iequals(trim(content_type.substr(0, semicolon)), "multipart/form-data") || semicolon == std::string_view::npos)
+        return std::string_view();
+
+    std::string_view params = content_type.substr(semicolon + 1);
+    while (!params.empty())
+    {
+        size_t next = params.find(';');
+        std::string_view param = trim(params.substr(0, next));
+        size_t eq = param.find('=');
+        if (eq != std::string_view::npos && iequals(trim(param.substr(0, eq)), "boundary"))
+        {
+            // RFC 2046：boundary为1~70个字符
+            std::string_view value = unquote(trim(param.substr(eq + 1)));
+            return value.size() <= 70 ? value : std::string_view();
+        }
+        if (next == std::string_view::npos)
+            break;
+        params.remove_prefix(next + 1);
+    }
+    return std::string_view();
+}
+
+std::string_view MultipartParser::disposition_param(std::string_view disposition, std::string_view name)
+{
+    while (!disposition.empty())
+    {
+        size_t next = disposition.find(';');
+        std::string_view param = trim(disposition.substr(0, next));
+        size_t eq = param.find('=');
+        if (eq != std::string_view::npos && iequals(trim(param.substr(0, eq)), name))
+            return unquote(trim(param.substr(eq + 1)));
+        if (next == std::string_view::npos)
+            break;
+        disposition.remove_prefix(next + 1);
+    }
+    return std::string_view();
+}
+
+bool MultipartParser::parse(std::string_view body, std::string_view boundary, std::vector<MultipartPart> &parts, std::string &error)
+{
+    if (boundary.empty())
+    {
+        error = "缺少multipart boundary";
+        return false;
+    }
+
+    std::string delimiter = "--" + std::string(boundary);
+
+    // 第一个分隔符之前的内容（preamble）忽略
+    size_t pos = body.find(delimiter);
+    if (pos == std::string_view::npos)
+    {
+        error = "请求体中没有找到multipart分隔符";
+        return false;
+    }
+
+    // 后续分隔符前面都有CRLF，查找时一并匹配，避免内容中恰好出现"--boundary"
+    std::string separator = "\r\n" + delimiter;
+
+    while (true)
+    {
+        pos += delimiter.size();
+        if (body.compare(pos, 2, "--") == 0)
+            return true; // 结束分隔符
+        if (body.compare(pos, 2, "\r\n") != 0)
+        {
+            error = "multipart分隔符格式错误";
+            return false;
+        }
+        pos += 2;
+
+        // 从分隔符行的CRLF开始查找，没有头部的部分同样可以识别
+        size_t headers_end = body.find("\r\n\r\n", pos - 2);
+        if (headers_end == std::string_view::npos)
+        {
+            error = "multipart头部不完整";
+            return false;
+        }
+
+        MultipartPart part;
+        std::string_view headers = body.substr(pos, headers_end + 2 - pos);
+        while (!headers.empty())
+        {
+            size_t eol = headers.find("\r\n");
+            std::string_view line = headers.substr(0, eol);
+            size_t colon = line.find(':');
+            if (colon != std::string_view::npos)
+            {
+                std::string_view name = trim(line.substr(0, colon));
+                std::string_view value = trim(line.substr(colon + 1));
+                if (iequals(name, "Content-Disposition"))
+                {
+                    part.name = disposition_param(value, "name");
+                    part.filename = disposition_param(value, "filename");
+                }
+                else if (iequals(name, "Content-Type"))
+                {
+                    part.content_type = value;
+                }
+            }
+            if (eol == std::string_view::npos)
+                break;
+            headers.remove_prefix(eol + 2);
+        }
+
+        size_t data_start = headers_end + 4;
+        size_t data_end = body.find(separator, data_start);
+        if (data_end == std::string_view::npos)
+        {
+            error = "multipart内容不完整（缺少结束分隔符）";
+            return false;
+        }
+
+        part.data = body.substr(data_start, data_end - data_start);
+        parts.push_back(part);
+        pos = data_end + 2;
+    }
+}
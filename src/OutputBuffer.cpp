@@ -0,0 +1,92 @@
+#include "OutputBuffer.hpp"
+
+void OutputBuffer::append(std::string data)
+{
+    if (data.empty())
+        return;
+
+    size_ += data.size();
+    segments_.push_back(std::move(data));
+}
+
+void OutputBuffer::append(OutputBuffer &&other)
+{
+    if (other.empty())
+        return;
+
+    if (empty())
+    {
+        *this = std::move(other);
+        other.clear();
+        return;
+    }
+
+    // 另一缓冲区第一个片段可能已部分发送（只有发送缓冲区会出现这种情况），去掉已发送的部分
+    if (other.offset_ > 0)
+    {
+        other.segments_.front().erase(0, other.offset_);
+        other.offset_ = 0;
+    }
+
+    for (auto &segment : other.segments_)
+    {
+        segments_.push_back(std::move(segment));
+    }
+    size_ += other.size_;
+    other.clear();
+}
+
+int OutputBuffer::fill_iovec(struct iovec *iov, int max_count) const
+{
+    int count = 0;
+    for (auto it = segments_.begin(); it != segments_.end() && count < max_count; ++it, ++count)
+    {
+        size_t skip = count == 0 ? offset_ : 0;
+        iov[count].iov_base = const_cast<char *>(it->data() + skip);
+        iov[count].iov_len = it->size() - skip;
+    }
+    return count;
+}
+
+void OutputBuffer::consume(size_t n)
+{
+    size_ -= n;
+    while (n > 0 && !segments_.empty())
+    {
+        size_t remaining = segments_.front().size() - offset_;
+        if (n < remaining)
+        {
+            offset_ += n;
+            return;
+        }
+
+        n -= remaining;
+        segments_.pop_front();
+        offset_ = 0;
+    }
+}
+
+void OutputBuffer::clear()
+{
+    segments_.clear();
+    offset_ = 0;
+    size_ = 0;
+}
+
+std::string OutputBuffer::to_string() const
+{
+    std::string result;
+    result.reserve(size_);
+    for (size_t i = 0; i < segments_.size(); ++i)
+    {
+        result.append(segments_[i], i == 0 ? offset_ : 0, std::string::npos);
+    }
+    return result;
+}
+
+void OutputBuffer::append_json(std::string &out, const nlohmann::json &value)
+{
+    // 与json::dump()相同的序列化器，但直接写入调用方的缓冲区
+    nlohmann::detail::serializer<nlohmann::json> serializer(nlohmann::detail::output_adapter<char, std::string>(out), ' ');
+    serializer.dump(value, false, false, 0);
+}
@@ -0,0 +1,143 @@
+#include "PayloadWriter.hpp"
+#include "utils.hpp"
+#include <cstring>
+#include <nlohmann/json.hpp>
+
+// JSON转义，返回不含引号的字符串内容
+static std::string escape_json(std::string_view text)
+{
+    std::string quoted = nlohmann::json(std::string(text)).dump();
+    return quoted.substr(1, quoted.size() - 2);
+}
+
+// 只统计长度的输出
+struct SizeCounter
+{
+    size_t size = 0;
+
+    void append(std::string_view text) { size += text.size(); }
+    void append_base64(const unsigned char *, size_t size) { this->size += utils::base64_encoded_size(size); }
+};
+
+// 写入预先分配好的缓冲区
+struct BufferWriter
+{
+    char *out;
+
+    void append(std::string_view text)
+    {
+        memcpy(out, text.data(), text.size());
+        out += text.size();
+    }
+    void append_base64(const unsigned char *data, size_t size) { out = utils::base64_encode_to(data, size, out); }
+};
+
+PayloadWriter::PayloadWriter(Format format, const std::string &model, int max_tokens, double temperature)
+    : format_(format), model_(nlohmann::json(model).dump()), max_tokens_(std::to_string(max_tokens)),
+      temperature_(nlohmann::json(temperature).dump()), stream_(false)
+{
+}
+
+void PayloadWriter::add_text(std::string_view text)
+{
+    parts_.push_back(Part{false, escape_json(text), nullptr, 0, nullptr, nullptr});
+}
+
+void PayloadWriter::add_image(const unsigned char *data, size_t size, const char *detail, const char *mime_type)
+{
+    parts_.push_back(Part{true, std::string(), data, size, detail, mime_type});
+}
+
+template <typename Output>
+void PayloadWriter::write(Output &out) const
+{
+    out.append("{\"model\":");
+    out.append(model_);
+
+    if (format_ == Format::Doubao || format_ == Format::VLLM)
+    {
+        out.append(",\"messages\":[{\"role\":\"user\",\"content\":[");
+        bool first = true;
+        for (const auto &part : parts_)
+        {
+            if (!first)
+                out.append(",");
+            first = false;
+
+            if (part.is_image)
+            {
+                out.append("{\"type\":\"image_url\",\"image_url\":{\"url\":\"data:");
+                out.append(part.mime_type);
+                out.append(";base64,");
+                out.append_base64(part.data, part.size);
+                out.append("\"");
+                if (part.detail)
+                {
+                    out.append(",\"detail\":\"");
+                    out.append(part.detail);
+                    out.append("\"");
+                }
+                out.append("}}");
+            }
+            else
+            {
+                out.append("{\"type\":\"text\",\"text\":\"");
+                out.append(part.text);
+                out.append("\"}");
+            }
+        }
+        out.append("]}],\"max_tokens\":");
+        out.append(max_tokens_);
+        out.append(",\"temperature\":");
+        out.append(temperature_);
+        // 流式响应在最后一个事件中附带usage；vLLM的非流式请求不带stream参数
+        if (stream_)
+            out.append(",\"stream\":true,\"stream_options\":{\"include_usage\":true}");
+        else if (format_ == Format::Doubao)
+            out.append(",\"stream\":false");
+        out.append("}");
+        return;
+    }
+
+    // Ollama：文本拼接为一个字符串，图片单独放在images数组中
+    out.append(format_ == Format::OllamaChat ? ",\"messages\":[{\"role\":\"user\",\"content\":\"" : ",\"prompt\":\"");
+    for (const auto &part : parts_)
+    {
+        if (!part.is_image)
+            out.append(part.text);
+    }
+    out.append("\"");
+
+    bool first = true;
+    for (const auto &part : parts_)
+    {
+        if (!part.is_image)
+            continue;
+        out.append(first ? ",\"images\":[\"" : ",\"");
+        out.append_base64(part.data, part.size);
+        out.append("\"");
+        first = false;
+    }
+    if (!first)
+        out.append("]");
+
+    if (format_ == Format::OllamaChat)
+        out.append("}]");
+    out.append(stream_ ? ",\"stream\":true" : ",\"stream\":false");
+    out.append(",\"options\":{\"num_predict\":");
+    out.append(max_tokens_);
+    out.append(",\"temperature\":");
+    out.append(temperature_);
+    out.append("}}");
+}
+
+std::string PayloadWriter::finish() const
+{
+    SizeCounter counter;
+    write(counter);
+
+    std::string payload(counter.size, '\0');
+    BufferWriter writer{&payload[0]};
+    write(writer);
+    return payload;
+}
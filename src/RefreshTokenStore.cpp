@@ -1,11 +1,18 @@
 #include "RefreshTokenStore.hpp"
-#include "ConfigManager.hpp"
 #include "DatabaseManager.hpp"
+#include "Logger.hpp"
 #include "utils.hpp"
 #include <openssl/sha.h>
+#include <algorithm>
+#include <fstream>
 #include <random>
 #include <ctime>
 
+// 未接入数据库时使用的本地文件（便于测试 refresh 流程）
+// 请求线程和后台线程都会读写该文件，读改写需持有local_store_mutex
+static const char *LOCAL_STORE_PATH = "./refresh_tokens_local.json";
+static std::mutex local_store_mutex;
+
 static std::string sha256_hex(const std::string &input)
 {
     unsigned char hash[SHA256_DIGEST_LENGTH];
@@ -22,6 +29,37 @@ static std::string sha256_hex(const std::string &input)
     return out;
 }
 
+// 读取本地文件中的token记录
+static nlohmann::json load_local_store()
+{
+    nlohmann::json arr = nlohmann::json::array();
+    if (utils::file_exists(LOCAL_STORE_PATH))
+    {
+        std::ifstream in(LOCAL_STORE_PATH);
+        in >> arr;
+    }
+    return arr;
+}
+
+static void save_local_store(const nlohmann::json &arr)
+{
+    std::ofstream out(LOCAL_STORE_PATH);
+    out << arr.dump(2);
+}
+
+// 单例实现
+// 实例不析构：进程退出时请求线程可能仍在使用
+RefreshTokenStore &RefreshTokenStore::getInstance()
+{
+    static RefreshTokenStore *instance = new RefreshTokenStore();
+    return *instance;
+}
+
+RefreshTokenStore::RefreshTokenStore()
+    : db_(nullptr), writer_started_(false), stopped_(false), cache_hits_(0), cache_misses_(0), revocations_written_(0)
+{
+}
+
 std::string RefreshTokenStore::random_hex(size_t len)
 {
     static const char *hex = "0123456789abcdef";
@@ -34,8 +72,31 @@ std::string RefreshTokenStore::random_hex(size_t len)
     return out;
 }
 
-RefreshTokenStore::RefreshTokenStore() {}
-RefreshTokenStore::~RefreshTokenStore() {}
+void RefreshTokenStore::attach_database(DatabaseManager *db)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    db_ = db;
+}
+
+void RefreshTokenStore::cache_token(const std::string &token_hash, const std::string &sub, std::time_t expires_at)
+{
+    std::time_t now = std::time(nullptr);
+    if (cache_.size() >= cache_capacity_)
+    {
+        // 先清理已过期的记录，仍然已满时丢弃任意一条（只是下次需要重新查询存储）
+        for (auto it = cache_.begin(); it != cache_.end();)
+        {
+            if (it->second.cached_until < now || it->second.expires_at < now)
+                it = cache_.erase(it);
+            else
+                ++it;
+        }
+        if (cache_.size() >= cache_capacity_)
+            cache_.erase(cache_.begin());
+    }
+
+    cache_[token_hash] = CachedToken{sub, expires_at, std::min(expires_at, now + cache_ttl_seconds_)};
+}
 
 std::string RefreshTokenStore::CreateRefreshToken(const std::string &sub, int expiry_seconds)
 {
@@ -46,111 +107,222 @@ std::string RefreshTokenStore::CreateRefreshToken(const std::string &sub, int ex
     long created_at = static_cast<long>(now);
     long expires_at = static_cast<long>(now + expiry_seconds);
 
-    ConfigManager cfg;
-    cfg.load_config();
-    DatabaseManager db(cfg.get_database_config());
-    if (!db.initialize())
+    DatabaseManager *db;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        db = db_;
+    }
+
+    // 新token同步写入存储，其他worker进程立即可以验证
+    if (db)
+    {
+        if (!db->create_refresh_token_record(token_hash, sub, created_at, expires_at))
+        {
+            LOG_WARN("⚠️ 保存refresh token失败", {{"user", sub}});
+        }
+    }
+    else
     {
-        // DB unavailable: fallback to a local file store so refresh can be tested
         try
         {
-            std::string path = "./refresh_tokens_local.json";
-            nlohmann::json arr = nlohmann::json::array();
-            if (utils::file_exists(path))
-            {
-                std::ifstream in(path);
-                in >> arr;
-            }
+            std::lock_guard<std::mutex> file_lock(local_store_mutex);
+            nlohmann::json arr = load_local_store();
             nlohmann::json rec;
             rec["token_hash"] = token_hash;
             rec["user_id"] = sub;
             rec["created_at"] = created_at;
             rec["expires_at"] = expires_at;
             arr.push_back(rec);
-            std::ofstream out(path);
-            out << arr.dump(2);
+            save_local_store(arr);
         }
         catch (...)
         {
         }
-        return token;
     }
 
-    db.create_refresh_token_record(token_hash, sub, created_at, expires_at);
+    std::lock_guard<std::mutex> lock(mutex_);
+    cache_token(token_hash, sub, static_cast<std::time_t>(expires_at));
     return token;
 }
 
 bool RefreshTokenStore::VerifyRefreshToken(const std::string &token, std::string &out_sub)
 {
     std::string token_hash = sha256_hex(token);
-    ConfigManager cfg;
-    cfg.load_config();
-    DatabaseManager db(cfg.get_database_config());
-    if (!db.initialize())
+    std::time_t now = std::time(nullptr);
+
+    DatabaseManager *db;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (pending_revocations_.count(token_hash))
+            return false;
+
+        auto it = cache_.find(token_hash);
+        if (it != cache_.end())
+        {
+            if (now <= it->second.cached_until && now <= it->second.expires_at)
+            {
+                out_sub = it->second.sub;
+                cache_hits_++;
+                return true;
+            }
+            cache_.erase(it);
+        }
+        cache_misses_++;
+        db = db_;
+    }
+
+    // 缓存未命中：查询存储
+    std::string sub;
+    long expires_at = 0;
+    if (db)
+    {
+        if (!db->verify_refresh_token_record(token_hash, sub, &expires_at))
+            return false;
+    }
+    else
     {
-        // fallback to local file store
         try
         {
-            std::string path = "./refresh_tokens_local.json";
-            if (!utils::file_exists(path))
-                return false;
-            nlohmann::json arr;
-            std::ifstream in(path);
-            in >> arr;
-            std::time_t now = std::time(nullptr);
-            for (auto &rec : arr)
+            std::lock_guard<std::mutex> file_lock(local_store_mutex);
+            bool found = false;
+            for (auto &rec : load_local_store())
             {
                 if (rec.contains("token_hash") && rec["token_hash"].get<std::string>() == token_hash)
                 {
-                    long expires_at = rec.value("expires_at", 0l);
-                    if (expires_at < static_cast<long>(now))
-                        return false;
-                    out_sub = rec.value("user_id", "");
-                    return true;
+                    expires_at = rec.value("expires_at", 0l);
+                    sub = rec.value("user_id", "");
+                    found = true;
+                    break;
                 }
             }
+            if (!found || expires_at < static_cast<long>(now))
+                return false;
         }
         catch (...)
         {
             return false;
         }
-        return false;
     }
-    return db.verify_refresh_token_record(token_hash, out_sub);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    // 查询期间可能已被撤销
+    if (pending_revocations_.count(token_hash))
+        return false;
+    cache_token(token_hash, sub, static_cast<std::time_t>(expires_at));
+    out_sub = sub;
+    return true;
 }
 
 void RefreshTokenStore::RevokeToken(const std::string &token)
 {
     std::string token_hash = sha256_hex(token);
-    ConfigManager cfg;
-    cfg.load_config();
-    DatabaseManager db(cfg.get_database_config());
-    if (!db.initialize())
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    cache_.erase(token_hash);
+    pending_revocations_.insert(token_hash);
+    revocation_queue_.push_back(token_hash);
+
+    if (stopped_)
     {
-        // fallback: remove from local file store
-        try
+        // 后台线程已停止，直接在当前线程写出
+        lock.unlock();
+        writer_loop();
+        return;
+    }
+
+    if (!writer_started_)
+    {
+        writer_started_ = true;
+        writer_ = std::thread(&RefreshTokenStore::writer_loop, this);
+    }
+    lock.unlock();
+    writer_cv_.notify_one();
+}
+
+void RefreshTokenStore::writer_loop()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true)
+    {
+        writer_cv_.wait(lock, [this]
+                        { return stopped_ || !revocation_queue_.empty(); });
+        if (revocation_queue_.empty())
+            break;
+
+        std::string token_hash = std::move(revocation_queue_.front());
+        revocation_queue_.pop_front();
+        DatabaseManager *db = db_;
+        lock.unlock();
+
+        bool ok = true;
+        if (db)
+        {
+            ok = db->revoke_refresh_token_record(token_hash);
+        }
+        else
         {
-            std::string path = "./refresh_tokens_local.json";
-            if (!utils::file_exists(path))
-                return;
-            nlohmann::json arr;
-            std::ifstream in(path);
-            in >> arr;
-            nlohmann::json newarr = nlohmann::json::array();
-            for (auto &rec : arr)
+            try
             {
-                if (!(rec.contains("token_hash") && rec["token_hash"].get<std::string>() == token_hash))
+                std::lock_guard<std::mutex> file_lock(local_store_mutex);
+                nlohmann::json arr = load_local_store();
+                nlohmann::json newarr = nlohmann::json::array();
+                for (auto &rec : arr)
                 {
-                    newarr.push_back(rec);
+                    if (!(rec.contains("token_hash") && rec["token_hash"].get<std::string>() == token_hash))
+                    {
+                        newarr.push_back(rec);
+                    }
                 }
+                save_local_store(newarr);
+            }
+            catch (...)
+            {
+                ok = false;
             }
-            std::ofstream out(path);
-            out << newarr.dump(2);
         }
-        catch (...)
+
+        lock.lock();
+        if (ok)
         {
+            // 存储中的记录已删除，不再需要单独记住
+            pending_revocations_.erase(token_hash);
+            revocations_written_++;
+        }
+        else
+        {
+            // 删除失败时保留撤销标记，本进程内该token仍然无效
+            LOG_WARN("⚠️ 撤销refresh token写入存储失败");
         }
-        return;
     }
-    db.revoke_refresh_token_record(token_hash);
+}
+
+void RefreshTokenStore::shutdown()
+{
+    std::thread writer;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopped_ = true;
+        if (!writer_started_)
+            return;
+        writer_started_ = false;
+        writer = std::move(writer_);
+    }
+
+    writer_cv_.notify_one();
+    if (writer.joinable())
+    {
+        writer.join();
+    }
+}
+
+nlohmann::json RefreshTokenStore::get_stats()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return {
+        {"storage", db_ ? "database" : "local_file"},
+        {"cached_tokens", cache_.size()},
+        {"cache_hits", cache_hits_},
+        {"cache_misses", cache_misses_},
+        {"pending_revocations", revocation_queue_.size()},
+        {"revocations_written", revocations_written_}};
 }
@@ -0,0 +1,244 @@
+#include "ResponseCompressor.hpp"
+#include <cctype>
+#include <cstring>
+#include <cstdlib>
+#include <stdexcept>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+// 去掉首尾空白
+static std::string_view trim(std::string_view s)
+{
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t'))
+        s.remove_prefix(1);
+    while (!s.empty() && (s.back() == ' ' || s.back() == '\t'))
+        s.remove_suffix(1);
+    return s;
+}
+
+static bool iequals(std::string_view a, std::string_view b)
+{
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0; i < a.size(); ++i)
+    {
+        if (std::tolower(static_cast<unsigned char>(a[i])) != std::tolower(static_cast<unsigned char>(b[i])))
+            return false;
+    }
+    return true;
+}
+
+ContentEncoding ResponseCompressor::negotiate(std::string_view accept_encoding)
+{
+    double gzip_q = -1.0;
+    double zstd_q = -1.0;
+    double wildcard_q = -1.0;
+
+    // 形如 "gzip, deflate, br, zstd;q=0.9"
+    while (!accept_encoding.empty())
+    {
+        size_t comma = accept_encoding.find(',');
+        std::string_view item = trim(accept_encoding.substr(0, comma));
+        accept_encoding = comma == std::string_view::npos ? std::string_view() : accept_encoding.substr(comma + 1);
+
+        double q = 1.0;
+        size_t semicolon = item.find(';');
+        std::string_view coding = trim(item.substr(0, semicolon));
+        if (semicolon != std::string_view::npos)
+        {
+            std::string_view param = trim(item.substr(semicolon + 1));
+            if (param.size() > 2 && (param[0] == 'q' || param[0] == 'Q') && param[1] == '=')
+                q = std::atof(std::string(param.substr(2)).c_str());
+        }
+
+        if (iequals(coding, "gzip") || iequals(coding, "x-gzip"))
+            gzip_q = q;
+        else if (iequals(coding, "zstd"))
+            zstd_q = q;
+        else if (coding == "*")
+            wildcard_q = q;
+    }
+
+    if (gzip_q < 0.0)
+        gzip_q = wildcard_q;
+    if (zstd_q < 0.0)
+        zstd_q = wildcard_q;
+
+#ifdef HAVE_ZSTD
+    if (zstd_q > 0.0 && zstd_q >= gzip_q)
+        return ContentEncoding::Zstd;
+#endif
+    if (gzip_q > 0.0)
+        return ContentEncoding::Gzip;
+    return ContentEncoding::Identity;
+}
+
+const char *ResponseCompressor::encoding_name(ContentEncoding encoding)
+{
+    switch (encoding)
+    {
+    case ContentEncoding::Gzip:
+        return "gzip";
+    case ContentEncoding::Zstd:
+        return "zstd";
+    default:
+        return "identity";
+    }
+}
+
+bool ResponseCompressor::compress(ContentEncoding encoding, std::string_view input, std::string &output)
+{
+    if (encoding == ContentEncoding::Gzip)
+    {
+        z_stream stream;
+        memset(&stream, 0, sizeof(stream));
+        // windowBits加16输出gzip格式
+        if (deflateInit2(&stream, gzip_level_, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+            return false;
+
+        output.resize(deflateBound(&stream, input.size()));
+        stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(input.data()));
+        stream.avail_in = static_cast<uInt>(input.size());
+        stream.next_out = reinterpret_cast<Bytef *>(&output[0]);
+        stream.avail_out = static_cast<uInt>(output.size());
+
+        int ret = deflate(&stream, Z_FINISH);
+        output.resize(stream.total_out);
+        deflateEnd(&stream);
+        return ret == Z_STREAM_END;
+    }
+
+#ifdef HAVE_ZSTD
+    if (encoding == ContentEncoding::Zstd)
+    {
+        output.resize(ZSTD_compressBound(input.size()));
+        size_t n = ZSTD_compress(&output[0], output.size(), input.data(), input.size(), zstd_level_);
+        if (ZSTD_isError(n))
+            return false;
+        output.resize(n);
+        return true;
+    }
+#endif
+
+    return false;
+}
+
+ResponseCompressor::ResponseCompressor(ContentEncoding encoding)
+    : encoding_(encoding), gzip_initialized_(false), zstd_ctx_(nullptr), finished_(false)
+{
+    memset(&gzip_stream_, 0, sizeof(gzip_stream_));
+
+    if (encoding_ == ContentEncoding::Gzip)
+    {
+        if (deflateInit2(&gzip_stream_, gzip_level_, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+            throw std::runtime_error("初始化gzip压缩失败");
+        gzip_initialized_ = true;
+    }
+#ifdef HAVE_ZSTD
+    else if (encoding_ == ContentEncoding::Zstd)
+    {
+        zstd_ctx_ = ZSTD_createCCtx();
+        if (!zstd_ctx_)
+            throw std::runtime_error("初始化zstd压缩失败");
+        ZSTD_CCtx_setParameter(zstd_ctx_, ZSTD_c_compressionLevel, zstd_level_);
+    }
+#endif
+}
+
+ResponseCompressor::~ResponseCompressor()
+{
+    if (gzip_initialized_)
+        deflateEnd(&gzip_stream_);
+#ifdef HAVE_ZSTD
+    if (zstd_ctx_)
+        ZSTD_freeCCtx(zstd_ctx_);
+#endif
+}
+
+std::string ResponseCompressor::write(std::string_view data)
+{
+    std::string output;
+    if (finished_)
+        return output;
+
+    if (gzip_initialized_)
+    {
+        // Z_SYNC_FLUSH让已写入的数据立即可解压，代价是少量压缩率
+        gzip_stream_.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.data()));
+        gzip_stream_.avail_in = static_cast<uInt>(data.size());
+
+        char buffer[16384];
+        do
+        {
+            gzip_stream_.next_out = reinterpret_cast<Bytef *>(buffer);
+            gzip_stream_.avail_out = sizeof(buffer);
+            deflate(&gzip_stream_, Z_SYNC_FLUSH);
+            output.append(buffer, sizeof(buffer) - gzip_stream_.avail_out);
+        } while (gzip_stream_.avail_out == 0);
+    }
+#ifdef HAVE_ZSTD
+    else if (zstd_ctx_)
+    {
+        ZSTD_inBuffer input = {data.data(), data.size(), 0};
+        char buffer[16384];
+        size_t remaining;
+        do
+        {
+            ZSTD_outBuffer out = {buffer, sizeof(buffer), 0};
+            remaining = ZSTD_compressStream2(zstd_ctx_, &out, &input, ZSTD_e_flush);
+            if (ZSTD_isError(remaining))
+                throw std::runtime_error(std::string("zstd压缩失败: ") + ZSTD_getErrorName(remaining));
+            output.append(buffer, out.pos);
+        } while (remaining != 0);
+    }
+#endif
+    else
+    {
+        output.assign(data.data(), data.size());
+    }
+
+    return output;
+}
+
+std::string ResponseCompressor::finish()
+{
+    std::string output;
+    if (finished_)
+        return output;
+    finished_ = true;
+
+    if (gzip_initialized_)
+    {
+        gzip_stream_.next_in = nullptr;
+        gzip_stream_.avail_in = 0;
+
+        char buffer[1024];
+        int ret;
+        do
+        {
+            gzip_stream_.next_out = reinterpret_cast<Bytef *>(buffer);
+            gzip_stream_.avail_out = sizeof(buffer);
+            ret = deflate(&gzip_stream_, Z_FINISH);
+            output.append(buffer, sizeof(buffer) - gzip_stream_.avail_out);
+        } while (ret == Z_OK);
+    }
+#ifdef HAVE_ZSTD
+    else if (zstd_ctx_)
+    {
+        ZSTD_inBuffer input = {nullptr, 0, 0};
+        char buffer[1024];
+        size_t remaining;
+        do
+        {
+            ZSTD_outBuffer out = {buffer, sizeof(buffer), 0};
+            remaining = ZSTD_compressStream2(zstd_ctx_, &out, &input, ZSTD_e_end);
+            if (ZSTD_isError(remaining))
+                break;
+            output.append(buffer, out.pos);
+        } while (remaining != 0);
+    }
+#endif
+
+    return output;
+}
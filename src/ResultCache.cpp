@@ -0,0 +1,412 @@
+#include "ResultCache.hpp"
+#include "Logger.hpp"
+#include "Metrics.hpp"
+#include "config.hpp"
+#include <openssl/evp.h>
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+static const double DISK_PRUNE_RATIO = 0.9; // 超过上限时删除到上限的该比例，避免每次写入都触发清理
+
+// 增量计算SHA-256
+class Sha256
+{
+public:
+    Sha256() : ctx_(EVP_MD_CTX_new()) { EVP_DigestInit_ex(ctx_, EVP_sha256(), nullptr); }
+    ~Sha256() { EVP_MD_CTX_free(ctx_); }
+
+    Sha256(const Sha256 &) = delete;
+    Sha256 &operator=(const Sha256 &) = delete;
+
+    void update(const void *data, size_t size) { EVP_DigestUpdate(ctx_, data, size); }
+    void update(const std::string &data) { update(data.data(), data.size()); }
+
+    std::string hex()
+    {
+        unsigned char digest[EVP_MAX_MD_SIZE];
+        unsigned int length = 0;
+        EVP_DigestFinal_ex(ctx_, digest, &length);
+
+        static const char *hex = "0123456789abcdef";
+        std::string out;
+        out.reserve(length * 2);
+        for (unsigned int i = 0; i < length; ++i)
+        {
+            out.push_back(hex[(digest[i] >> 4) & 0xF]);
+            out.push_back(hex[digest[i] & 0xF]);
+        }
+        return out;
+    }
+
+private:
+    EVP_MD_CTX *ctx_;
+};
+
+// 单例实现
+// 实例不析构：进程退出时请求线程可能仍在使用
+ResultCache &ResultCache::getInstance()
+{
+    static ResultCache *instance = new ResultCache();
+    return *instance;
+}
+
+ResultCache::ResultCache()
+    : writer_started_(false), stopped_(false), disk_entries_(0),
+      memory_hits_(0), disk_hits_(0), misses_(0), disk_writes_(0), disk_errors_(0)
+{
+    Metrics &metrics = Metrics::getInstance();
+    const char *help = "分析结果缓存的查询次数（按命中的缓存层）";
+    memory_hit_counter_ = &metrics.counter("doubao_result_cache_requests_total", help, {{"result", "memory"}});
+    disk_hit_counter_ = &metrics.counter("doubao_result_cache_requests_total", help, {{"result", "disk"}});
+    miss_counter_ = &metrics.counter("doubao_result_cache_requests_total", help, {{"result", "miss"}});
+
+    // 进程退出时写出尚未完成的磁盘写入（命令行批量分析没有显式的关闭流程）
+    std::atexit([]
+                { getInstance().shutdown(); });
+}
+
+std::string ResultCache::media_hash(const std::vector<unsigned char> &data)
+{
+    Sha256 sha;
+    sha.update(data.data(), data.size());
+    return sha.hex();
+}
+
+std::string ResultCache::file_hash(const std::string &path)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+    {
+        return "";
+    }
+
+    Sha256 sha;
+    std::vector<char> buffer(1 << 20);
+    while (in)
+    {
+        in.read(buffer.data(), buffer.size());
+        sha.update(buffer.data(), static_cast<size_t>(in.gcount()));
+    }
+    if (in.bad())
+    {
+        return "";
+    }
+    return sha.hex();
+}
+
+std::string ResultCache::make_key(const std::string &media_hash, const std::string &prompt,
+                                  const std::string &model, int max_tokens, int frame_count)
+{
+    Sha256 prompt_sha;
+    prompt_sha.update(prompt);
+
+    Sha256 sha;
+    sha.update(media_hash + "\n" + prompt_sha.hex() + "\n" + model + "\n" +
+               std::to_string(max_tokens) + "\n" + std::to_string(frame_count));
+    return sha.hex();
+}
+
+const char *ResultCache::tier_name(Tier tier)
+{
+    switch (tier)
+    {
+    case Tier::Memory:
+        return "memory";
+    case Tier::Disk:
+        return "disk";
+    default:
+        return "miss";
+    }
+}
+
+std::string ResultCache::disk_path(const std::string &key) const
+{
+    // 按键的前两位分子目录，避免单个目录下文件过多
+    return config::RESULT_CACHE_DIR + "/" + key.substr(0, 2) + "/" + key + ".json";
+}
+
+bool ResultCache::expired(const Entry &entry, std::time_t now) const
+{
+    return now - entry.created_at > config::RESULT_CACHE_TTL_SECONDS;
+}
+
+ResultCache::Tier ResultCache::get(const std::string &key, Entry &entry)
+{
+    std::time_t now = std::time(nullptr);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = index_.find(key);
+        if (it != index_.end())
+        {
+            if (!expired(it->second->entry, now))
+            {
+                lru_.splice(lru_.begin(), lru_, it->second);
+                entry = it->second->entry;
+                memory_hits_++;
+                memory_hit_counter_->inc();
+                return Tier::Memory;
+            }
+            lru_.erase(it->second);
+            index_.erase(it);
+        }
+    }
+
+    if (!config::RESULT_CACHE_DIR.empty())
+    {
+        std::string path = disk_path(key);
+        std::ifstream in(path);
+        if (in)
+        {
+            nlohmann::json stored = nlohmann::json::parse(in, nullptr, false);
+            if (stored.is_object() && stored.contains("content") && stored["content"].is_string())
+            {
+                Entry loaded;
+                loaded.content = stored["content"].get<std::string>();
+                loaded.usage = stored.value("usage", nlohmann::json::object());
+                loaded.raw_response = stored.value("raw_response", nlohmann::json::object());
+                loaded.created_at = stored.value("created_at", static_cast<std::time_t>(0));
+                if (!expired(loaded, now))
+                {
+                    // 更新修改时间，磁盘清理时按最近使用的顺序保留
+                    std::error_code ec;
+                    fs::last_write_time(path, fs::file_time_type::clock::now(), ec);
+
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    entry = loaded;
+                    put_memory(key, std::move(loaded));
+                    disk_hits_++;
+                    disk_hit_counter_->inc();
+                    return Tier::Disk;
+                }
+            }
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    misses_++;
+    miss_counter_->inc();
+    return Tier::Miss;
+}
+
+void ResultCache::put(const std::string &key, Entry entry)
+{
+    if (entry.created_at == 0)
+    {
+        entry.created_at = std::time(nullptr);
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (config::RESULT_CACHE_DIR.empty() || stopped_)
+    {
+        put_memory(key, std::move(entry));
+        return;
+    }
+
+    put_memory(key, entry);
+    write_queue_.emplace_back(key, std::move(entry));
+    if (!writer_started_)
+    {
+        writer_started_ = true;
+        writer_ = std::thread(&ResultCache::writer_loop, this);
+    }
+    lock.unlock();
+    writer_cv_.notify_one();
+}
+
+void ResultCache::put_memory(const std::string &key, Entry entry)
+{
+    if (config::RESULT_CACHE_MEMORY_ENTRIES == 0)
+    {
+        return;
+    }
+
+    auto it = index_.find(key);
+    if (it != index_.end())
+    {
+        it->second->entry = std::move(entry);
+        lru_.splice(lru_.begin(), lru_, it->second);
+        return;
+    }
+
+    lru_.push_front(MemoryItem{key, std::move(entry)});
+    index_[key] = lru_.begin();
+    if (lru_.size() > config::RESULT_CACHE_MEMORY_ENTRIES)
+    {
+        index_.erase(lru_.back().key);
+        lru_.pop_back();
+    }
+}
+
+void ResultCache::writer_loop()
+{
+    scan_disk();
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true)
+    {
+        writer_cv_.wait(lock, [this]
+                        { return stopped_ || !write_queue_.empty(); });
+        if (write_queue_.empty())
+            break;
+
+        std::pair<std::string, Entry> item = std::move(write_queue_.front());
+        write_queue_.pop_front();
+        lock.unlock();
+
+        std::string path = disk_path(item.first);
+        bool existed = fs::exists(path);
+        bool ok = true;
+        try
+        {
+            fs::create_directories(fs::path(path).parent_path());
+
+            // 先写临时文件再改名，读取方（包括其他worker进程）不会看到写了一半的文件
+            nlohmann::json stored = {
+                {"content", item.second.content},
+                {"usage", item.second.usage},
+                {"raw_response", item.second.raw_response},
+                {"created_at", item.second.created_at}};
+            std::string temp_path = path + ".tmp." + std::to_string(getpid());
+            {
+                std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+                out << stored.dump();
+                if (!out)
+                {
+                    throw std::runtime_error("写入失败: " + temp_path);
+                }
+            }
+            fs::rename(temp_path, path);
+        }
+        catch (const std::exception &e)
+        {
+            ok = false;
+            LOG_WARN("⚠️ [结果缓存] 写入磁盘缓存失败", {{"path", path}, {"error", e.what()}});
+        }
+
+        lock.lock();
+        if (!ok)
+        {
+            disk_errors_++;
+            continue;
+        }
+
+        disk_writes_++;
+        if (!existed)
+        {
+            disk_entries_++;
+        }
+        if (disk_entries_ > config::RESULT_CACHE_DISK_MAX_ENTRIES)
+        {
+            lock.unlock();
+            prune_disk();
+            lock.lock();
+        }
+    }
+}
+
+void ResultCache::scan_disk()
+{
+    // 统计已有的缓存文件并删除过期的文件（按修改时间判断，读取时还会按写入时间再检查），
+    // 过期的临时文件是写入中途退出的进程留下的
+    size_t count = 0;
+    size_t removed = 0;
+    std::error_code ec;
+    auto deadline = fs::file_time_type::clock::now() - std::chrono::seconds(config::RESULT_CACHE_TTL_SECONDS);
+    for (fs::recursive_directory_iterator it(config::RESULT_CACHE_DIR, ec), end; !ec && it != end; it.increment(ec))
+    {
+        if (!it->is_regular_file(ec))
+            continue;
+
+        if (it->last_write_time(ec) < deadline)
+        {
+            fs::remove(it->path(), ec);
+            removed++;
+        }
+        else if (it->path().extension() == ".json")
+        {
+            count++;
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        disk_entries_ = count;
+    }
+    LOG_INFO("🗄️ [结果缓存] 磁盘缓存已加载", {{"dir", config::RESULT_CACHE_DIR}, {"entries", count}, {"removed", removed}});
+
+    if (count > config::RESULT_CACHE_DISK_MAX_ENTRIES)
+    {
+        prune_disk();
+    }
+}
+
+void ResultCache::prune_disk()
+{
+    // 按修改时间（写入或最近一次命中）删除最旧的文件
+    std::vector<std::pair<fs::file_time_type, fs::path>> files;
+    std::error_code ec;
+    for (fs::recursive_directory_iterator it(config::RESULT_CACHE_DIR, ec), end; !ec && it != end; it.increment(ec))
+    {
+        if (it->is_regular_file(ec) && it->path().extension() == ".json")
+        {
+            files.emplace_back(it->last_write_time(ec), it->path());
+        }
+    }
+
+    size_t target = static_cast<size_t>(config::RESULT_CACHE_DISK_MAX_ENTRIES * DISK_PRUNE_RATIO);
+    size_t removed = 0;
+    if (files.size() > target)
+    {
+        size_t excess = files.size() - target;
+        std::nth_element(files.begin(), files.begin() + excess, files.end());
+        for (size_t i = 0; i < excess; ++i)
+        {
+            if (fs::remove(files[i].second, ec))
+            {
+                removed++;
+            }
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    disk_entries_ = files.size() - removed;
+    LOG_INFO("🗄️ [结果缓存] 磁盘缓存超过上限，已删除最旧的结果", {{"removed", removed}, {"entries", disk_entries_}});
+}
+
+void ResultCache::shutdown()
+{
+    std::thread writer;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopped_ = true;
+        if (!writer_started_)
+            return;
+        writer_started_ = false;
+        writer = std::move(writer_);
+    }
+
+    writer_cv_.notify_one();
+    if (writer.joinable())
+    {
+        writer.join();
+    }
+}
+
+nlohmann::json ResultCache::get_stats()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return {
+        {"memory_entries", lru_.size()},
+        {"disk_entries", disk_entries_},
+        {"memory_hits", memory_hits_},
+        {"disk_hits", disk_hits_},
+        {"misses", misses_},
+        {"pending_writes", write_queue_.size()},
+        {"disk_writes", disk_writes_},
+        {"disk_errors", disk_errors_}};
+}
@@ -0,0 +1,145 @@
+#include "RouteExecutor.hpp"
+#include <iostream>
+#include <algorithm>
+
+RouteExecutor::RouteExecutor(const std::string &name, size_t thread_count, size_t max_queue_size)
+    : name_(name), thread_count_(thread_count), max_queue_size_(max_queue_size),
+      queue_wait_ewma_(0.0), service_time_ewma_(0.0),
+      stop_(false), active_(0), completed_(0), rejected_(0)
+{
+    for (size_t i = 0; i < thread_count_; ++i)
+    {
+        workers_.emplace_back(&RouteExecutor::worker_thread, this);
+    }
+
+    std::cout << "✅ 路由执行器 [" << name_ << "] 已启动，线程数: " << thread_count_
+              << "，队列上限: " << max_queue_size_ << std::endl;
+}
+
+RouteExecutor::~RouteExecutor()
+{
+    shutdown();
+}
+
+bool RouteExecutor::submit(Job job)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stop_ || queue_.size() >= max_queue_size_)
+        {
+            rejected_++;
+            return false;
+        }
+        queue_.push({std::move(job), Clock::now()});
+    }
+
+    condition_.notify_one();
+    return true;
+}
+
+void RouteExecutor::shutdown()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stop_)
+            return;
+        stop_ = true;
+    }
+
+    condition_.notify_all();
+
+    for (auto &worker : workers_)
+    {
+        if (worker.joinable())
+        {
+            worker.join();
+        }
+    }
+    workers_.clear();
+}
+
+size_t RouteExecutor::get_queue_size() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return queue_.size();
+}
+
+double RouteExecutor::estimate_queue_wait() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (queue_.empty())
+        return 0.0;
+
+    // 队首任务已等待的时间能及时反映处理停滞的情况
+    double oldest_wait = std::chrono::duration<double>(Clock::now() - queue_.front().enqueue_time).count();
+    double drain_estimate = queue_.size() * service_time_ewma_ / thread_count_;
+    return std::max(oldest_wait, drain_estimate);
+}
+
+double RouteExecutor::get_drain_rate() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return service_time_ewma_ > 0.0 ? thread_count_ / service_time_ewma_ : 0.0;
+}
+
+nlohmann::json RouteExecutor::get_stats() const
+{
+    double queue_wait_ewma;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_wait_ewma = queue_wait_ewma_;
+    }
+
+    return {
+        {"threads", thread_count_},
+        {"max_queue", max_queue_size_},
+        {"queued", get_queue_size()},
+        {"active", active_.load()},
+        {"completed", completed_.load()},
+        {"rejected", rejected_.load()},
+        {"queue_wait_ms", queue_wait_ewma * 1000.0},
+        {"drain_rate", get_drain_rate()}};
+}
+
+void RouteExecutor::worker_thread()
+{
+    while (true)
+    {
+        Job job;
+
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            condition_.wait(lock, [this]
+                            { return stop_ || !queue_.empty(); });
+
+            if (stop_)
+                return;
+
+            QueuedJob &front = queue_.front();
+            double wait = std::chrono::duration<double>(Clock::now() - front.enqueue_time).count();
+            queue_wait_ewma_ = queue_wait_ewma_ * 0.8 + wait * 0.2;
+
+            job = std::move(front.job);
+            queue_.pop();
+        }
+
+        Clock::time_point start = Clock::now();
+        active_++;
+        try
+        {
+            job();
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "❌ 路由执行器 [" << name_ << "] 任务异常: " << e.what() << std::endl;
+        }
+        active_--;
+        completed_++;
+
+        {
+            double service_time = std::chrono::duration<double>(Clock::now() - start).count();
+            std::lock_guard<std::mutex> lock(mutex_);
+            service_time_ewma_ = service_time_ewma_ > 0.0 ? service_time_ewma_ * 0.8 + service_time * 0.2 : service_time;
+        }
+    }
+}
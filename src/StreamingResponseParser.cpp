@@ -0,0 +1,192 @@
+#include "StreamingResponseParser.hpp"
+
+// 无法解析的内容最多保留的字节数（只用于错误信息）
+static const size_t MAX_UNPARSED_BYTES = 4096;
+
+StreamingResponseParser::StreamingResponseParser(Format format)
+    : format_(format), delta_start_(0), usage_(nlohmann::json::object()), events_(0)
+{
+}
+
+void StreamingResponseParser::feed(const char *data, size_t size)
+{
+    std::string_view input(data, size);
+
+    // 先补全上次残留的半行，之后的完整行直接在输入数据上解析
+    size_t newline = input.find('\n');
+    if (!buffer_.empty())
+    {
+        if (newline == std::string_view::npos)
+        {
+            buffer_.append(input);
+            return;
+        }
+        buffer_.append(input.substr(0, newline));
+        handle_line(buffer_);
+        buffer_.clear();
+        input.remove_prefix(newline + 1);
+        newline = input.find('\n');
+    }
+
+    while (newline != std::string_view::npos)
+    {
+        handle_line(input.substr(0, newline));
+        input.remove_prefix(newline + 1);
+        newline = input.find('\n');
+    }
+    buffer_.append(input);
+}
+
+void StreamingResponseParser::finish()
+{
+    if (!buffer_.empty())
+    {
+        handle_line(buffer_);
+        buffer_.clear();
+    }
+
+    // 没有任何事件时，后端可能返回了普通的（可能跨多行的）JSON错误响应
+    if (events_ == 0 && !unparsed_.empty())
+    {
+        nlohmann::json body = nlohmann::json::parse(unparsed_, nullptr, false);
+        if (body.is_object())
+        {
+            handle_event(body);
+        }
+    }
+}
+
+std::string StreamingResponseParser::take_delta()
+{
+    std::string delta = content_.substr(delta_start_);
+    delta_start_ = content_.size();
+    return delta;
+}
+
+void StreamingResponseParser::handle_line(std::string_view line)
+{
+    if (!line.empty() && line.back() == '\r')
+    {
+        line.remove_suffix(1);
+    }
+    if (line.empty())
+    {
+        return;
+    }
+
+    if (format_ == Format::SSE)
+    {
+        // 注释行（心跳）以及event:/id:/retry:等字段不携带内容
+        if (line.compare(0, 5, "data:") != 0)
+        {
+            if (line.front() != ':' && line.compare(0, 6, "event:") != 0 && line.compare(0, 3, "id:") != 0 &&
+                line.compare(0, 6, "retry:") != 0)
+            {
+                keep_unparsed(line);
+            }
+            return;
+        }
+
+        line.remove_prefix(5);
+        if (!line.empty() && line.front() == ' ')
+        {
+            line.remove_prefix(1);
+        }
+        if (line == "[DONE]")
+        {
+            return;
+        }
+    }
+
+    nlohmann::json event = nlohmann::json::parse(line, nullptr, false);
+    if (!event.is_object())
+    {
+        keep_unparsed(line);
+        return;
+    }
+    handle_event(event);
+}
+
+void StreamingResponseParser::handle_event(const nlohmann::json &event)
+{
+    ++events_;
+
+    if (event.contains("error"))
+    {
+        const nlohmann::json &error = event["error"];
+        if (error.is_string())
+        {
+            error_ = error.get<std::string>();
+        }
+        else if (error.is_object() && error.contains("message") && error["message"].is_string())
+        {
+            error_ = error["message"].get<std::string>();
+        }
+        else
+        {
+            error_ = error.dump();
+        }
+        last_event_ = event;
+        return;
+    }
+
+    if (format_ == Format::SSE)
+    {
+        auto choices = event.find("choices");
+        if (choices != event.end() && choices->is_array() && !choices->empty())
+        {
+            const nlohmann::json &choice = (*choices)[0];
+            if (choice.contains("delta") && choice["delta"].contains("content") && choice["delta"]["content"].is_string())
+            {
+                content_ += choice["delta"]["content"].get<std::string>();
+            }
+        }
+
+        // 请求中设置了stream_options.include_usage时，最后一个事件携带usage
+        auto usage = event.find("usage");
+        if (usage != event.end() && usage->is_object())
+        {
+            usage_ = *usage;
+        }
+    }
+    else
+    {
+        // /api/chat返回message.content，/api/generate返回response
+        if (event.contains("message") && event["message"].contains("content") && event["message"]["content"].is_string())
+        {
+            content_ += event["message"]["content"].get<std::string>();
+        }
+        else if (event.contains("response") && event["response"].is_string())
+        {
+            content_ += event["response"].get<std::string>();
+        }
+
+        // 最后一行（done为true）带有token统计，换算为OpenAI格式的usage
+        if (event.value("done", false))
+        {
+            int prompt_tokens = event.value("prompt_eval_count", 0);
+            int completion_tokens = event.value("eval_count", 0);
+            if (prompt_tokens > 0 || completion_tokens > 0)
+            {
+                usage_ = {{"prompt_tokens", prompt_tokens},
+                          {"completion_tokens", completion_tokens},
+                          {"total_tokens", prompt_tokens + completion_tokens}};
+            }
+        }
+    }
+
+    last_event_ = event;
+}
+
+void StreamingResponseParser::keep_unparsed(std::string_view line)
+{
+    if (unparsed_.size() >= MAX_UNPARSED_BYTES)
+    {
+        return;
+    }
+    if (!unparsed_.empty())
+    {
+        unparsed_.push_back('\n');
+    }
+    unparsed_.append(line.substr(0, MAX_UNPARSED_BYTES - unparsed_.size()));
+}
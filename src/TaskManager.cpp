@@ -1,8 +1,11 @@
 
 #include "TaskManager.hpp"
 #include "utils.hpp"
+#include "Logger.hpp"
+#include "Tracer.hpp"
 #include <iostream>
 #include <chrono>
+#include <algorithm>
 
 // 单例实现
 TaskManager &TaskManager::getInstance()
@@ -45,6 +48,10 @@ std::future<TaskResult> TaskManager::addTask(const AnalysisTask &task)
 
     // 创建带回调的任务副本
     AnalysisTask task_with_callback = task;
+    if (!task_with_callback.trace.active())
+    {
+        task_with_callback.trace = Tracer::current();
+    }
     task_with_callback.callback = [promise, task](const AnalysisResult &result)
     {
         TaskResult task_result;
@@ -58,6 +65,12 @@ std::future<TaskResult> TaskManager::addTask(const AnalysisTask &task)
         task_result.result.raw_response["file_id"] = task.file_id;
 
         promise->set_value(task_result);
+
+        // 调用方自带的完成回调（例如作业管理器更新行状态）
+        if (task.callback)
+        {
+            task.callback(task_result.result);
+        }
     };
 
     {
@@ -82,6 +95,75 @@ std::vector<std::future<TaskResult>> TaskManager::addTasks(const std::vector<Ana
     return futures;
 }
 
+size_t TaskManager::runTasks(const std::vector<AnalysisTask> &tasks, size_t window,
+                             const std::function<bool(size_t index, TaskResult &&result)> &on_result)
+{
+    // 完成队列：任务的回调在工作线程中把结果放入队列，调用线程按完成顺序取出。
+    // 调用方提前停止时回调可能晚于本函数返回，队列由回调共同持有
+    struct CompletionQueue
+    {
+        std::mutex mutex;
+        std::condition_variable ready;
+        std::deque<std::pair<size_t, TaskResult>> results;
+    };
+    auto completions = std::make_shared<CompletionQueue>();
+    auto cancelled = std::make_shared<std::atomic<bool>>(false);
+    window = std::max<size_t>(1, window);
+
+    size_t next = 0;
+    size_t in_flight = 0;
+    size_t handled = 0;
+    while (next < tasks.size() || in_flight > 0)
+    {
+        for (; next < tasks.size() && in_flight < window; ++next, ++in_flight)
+        {
+            AnalysisTask task = tasks[next];
+            if (!task.cancelled)
+            {
+                task.cancelled = cancelled;
+            }
+            task.callback = [completions, index = next, id = task.id, callback = task.callback](const AnalysisResult &result)
+            {
+                if (callback)
+                {
+                    callback(result);
+                }
+
+                TaskResult task_result;
+                task_result.task_id = id;
+                task_result.success = result.success;
+                task_result.result = result;
+                task_result.error = result.error;
+                {
+                    std::lock_guard<std::mutex> lock(completions->mutex);
+                    completions->results.emplace_back(index, std::move(task_result));
+                }
+                completions->ready.notify_one();
+            };
+            addTask(task);
+        }
+
+        std::pair<size_t, TaskResult> completed;
+        {
+            std::unique_lock<std::mutex> lock(completions->mutex);
+            completions->ready.wait(lock, [&completions]
+                                    { return !completions->results.empty(); });
+            completed = std::move(completions->results.front());
+            completions->results.pop_front();
+        }
+        in_flight--;
+        handled++;
+
+        if (!on_result(completed.first, std::move(completed.second)))
+        {
+            cancelled->store(true);
+            break;
+        }
+    }
+
+    return handled;
+}
+
 void TaskManager::shutdown()
 {
     if (stop_)
@@ -120,48 +202,185 @@ size_t TaskManager::getActiveThreadCount() const
     return active_threads_;
 }
 
+size_t TaskManager::getAwaitingTaskCount() const
+{
+    return awaiting_tasks_;
+}
+
+size_t TaskManager::getCompletedTaskCount() const
+{
+    return completed_tasks_;
+}
+
+size_t TaskManager::getCoalescedTaskCount() const
+{
+    return coalesced_tasks_;
+}
+
+std::string TaskManager::coalescingKey(const AnalysisTask &task)
+{
+    // 各字段以不会出现在URL和数值中的分隔符连接；保存与否、file_id等只影响结果的去向
+    static const char separator = '\x1f';
+    return task.media_type + separator + task.media_url + separator + task.model_name + separator +
+           std::to_string(task.max_tokens) + separator + std::to_string(task.video_frames) + separator + task.prompt;
+}
+
+bool TaskManager::joinInFlight(const std::string &key, const AnalysisTask &task, double start_time)
+{
+    std::lock_guard<std::mutex> lock(in_flight_mutex_);
+    auto it = in_flight_.find(key);
+    if (it == in_flight_.end())
+    {
+        in_flight_.emplace(key, std::vector<CoalescedTask>());
+        return true;
+    }
+
+    it->second.push_back(CoalescedTask{task, start_time});
+    coalesced_tasks_++;
+    return false;
+}
+
+void TaskManager::finishInFlight(const std::string &key, const AnalysisTask &task, TaskResult result, double start_time)
+{
+    std::vector<CoalescedTask> followers;
+    {
+        std::lock_guard<std::mutex> lock(in_flight_mutex_);
+        auto it = in_flight_.find(key);
+        if (it != in_flight_.end())
+        {
+            followers = std::move(it->second);
+            in_flight_.erase(it);
+        }
+    }
+
+    if (!followers.empty())
+    {
+        LOG_DEBUG("🔗 相同的任务已合并执行", {{"task", task.id}, {"url", task.media_url}, {"coalesced", followers.size()}});
+    }
+
+    // 先完成重复任务（需要拷贝结果），最后把结果移交给执行者
+    for (const auto &follower : followers)
+    {
+        TaskResult copy = result;
+        copy.task_id = follower.task.id;
+        completeTask(follower.task, std::move(copy), follower.start_time);
+    }
+    completeTask(task, std::move(result), start_time);
+}
+
 void TaskManager::workerThread()
 {
     while (true)
     {
         AnalysisTask task;
+        std::function<void()> continuation;
 
         {
             std::unique_lock<std::mutex> lock(queue_mutex_);
 
+            // 关闭时等待已发出的异步任务全部完成后再退出
             condition_.wait(lock, [this]
-                            { return stop_ || !tasks_.empty(); });
+                            { return !continuations_.empty() || !tasks_.empty() || (stop_ && awaiting_tasks_ == 0); });
 
-            if (stop_ && tasks_.empty())
+            if (!continuations_.empty())
+            {
+                continuation = std::move(continuations_.front());
+                continuations_.pop();
+            }
+            else if (!tasks_.empty())
+            {
+                task = tasks_.front();
+                tasks_.pop();
+            }
+            else
             {
                 return;
             }
+        }
 
-            task = tasks_.front();
-            tasks_.pop();
+        if (continuation)
+        {
+            active_threads_++;
+            continuation();
+            active_threads_--;
+            continue;
+        }
+
+        // 已取消的任务不再执行，直接以失败结果回调
+        if (task.cancelled && task.cancelled->load())
+        {
+            AnalysisResult cancelled_result;
+            cancelled_result.success = false;
+            cancelled_result.error = "任务已取消";
+            if (task.callback)
+            {
+                task.callback(cancelled_result);
+            }
+            continue;
+        }
+
+        if (task.on_start)
+        {
+            task.on_start();
         }
 
         // 执行任务
         active_threads_++;
-        TaskResult result = executeTask(task);
+        executeTask(task);
         active_threads_--;
+    }
+}
 
-        // 调用回调
-        if (task.callback)
-        {
-            task.callback(result.result);
-        }
+void TaskManager::postContinuation(std::function<void()> continuation)
+{
+    {
+        std::unique_lock<std::mutex> lock(queue_mutex_);
+        continuations_.push(std::move(continuation));
+        awaiting_tasks_--;
     }
+
+    // 关闭过程中最后一个异步任务完成时，需唤醒所有等待退出的工作线程
+    if (stop_)
+        condition_.notify_all();
+    else
+        condition_.notify_one();
 }
 
-TaskResult TaskManager::executeTask(const AnalysisTask &task)
+void TaskManager::abandonAwaiting()
+{
+    {
+        std::unique_lock<std::mutex> lock(queue_mutex_);
+        awaiting_tasks_--;
+    }
+
+    if (stop_)
+        condition_.notify_all();
+}
+
+void TaskManager::executeTask(const AnalysisTask &task)
 {
     TaskResult result;
     result.task_id = task.id;
+    double start_time = utils::get_current_time();
+
+    // 接续提交请求的跟踪
+    TraceScope trace_scope(task.trace);
+    Span span("task");
+    span.set_arg("task_id", task.id);
+    span.set_arg("media_type", task.media_type);
+
+    // 相同的任务正在执行时不再重复下载和调用模型，等待其结果
+    std::string key = coalescingKey(task);
+    if (!joinInFlight(key, task, start_time))
+    {
+        span.set_arg("coalesced", "true");
+        LOG_DEBUG("🔗 相同的任务正在执行，等待其结果", {{"task", task.id}, {"url", task.media_url}});
+        return;
+    }
 
     try
     {
-        std::cout << "🔄 开始处理任务: " << task.id << " (" << task.media_type << ")" << std::endl;
+        LOG_DEBUG("🔄 开始处理任务", {{"task", task.id}, {"type", task.media_type}});
 
         // 根据媒体类型选择分析方法
         if (task.media_type == "image")
@@ -172,26 +391,55 @@ TaskResult TaskManager::executeTask(const AnalysisTask &task)
             {
                 result.result.success = false;
                 result.result.error = "图片文件不存在: " + task.media_url;
-                result.success = false;
-                result.error = result.result.error;
-                return result;
+                finishInFlight(key, task, std::move(result), start_time);
+                return;
             }
 
-            // 分析下载的图片
-            result.result = analyzer_->analyze_single_image(
-                temp_file,
-                task.prompt,
-                task.max_tokens,
-                task.model_name);
+            // 异步分析下载的图片：编码在当前线程完成后即可删除临时文件，
+            // 等待模型响应期间工作线程继续处理其他任务，响应到达后由工作线程完成后续处理。
+            // 回调与提交时抛出的异常只有一方完成任务（settled），异常时撤销等待计数并由下面的catch以错误结果完成该任务和合并的重复任务
+            auto settled = std::make_shared<std::atomic<bool>>(false);
+            {
+                std::unique_lock<std::mutex> lock(queue_mutex_);
+                awaiting_tasks_++;
+            }
+            try
+            {
+                analyzer_->analyze_single_image_async(
+                    temp_file,
+                    task.prompt,
+                    task.max_tokens,
+                    task.model_name,
+                    [this, key, task, start_time, settled](AnalysisResult &&analysis)
+                    {
+                        if (settled->exchange(true))
+                            return;
+                        postContinuation([this, key, task, start_time, analysis = std::move(analysis)]() mutable
+                                         {
+                            TaskResult result;
+                            result.task_id = task.id;
+                            result.result = std::move(analysis);
+
+                            // 如果分析成功，更新结果中的路径为原始URL
+                            if (result.result.success)
+                            {
+                                result.result.raw_response["path"] = task.media_url;
+                            }
+                            finishInFlight(key, task, std::move(result), start_time); });
+                    });
+            }
+            catch (const std::exception &)
+            {
+                std::filesystem::remove(temp_file);
+                if (settled->exchange(true))
+                    return;
+                abandonAwaiting();
+                throw;
+            }
 
             // 清理临时文件
             std::filesystem::remove(temp_file);
-
-            // 如果分析成功，更新结果中的路径为原始URL
-            if (result.result.success)
-            {
-                result.result.raw_response["path"] = task.media_url;
-            }
+            return;
         }
         else if (task.media_type == "video")
         {
@@ -214,36 +462,52 @@ TaskResult TaskManager::executeTask(const AnalysisTask &task)
             result.result.success = false;
             result.result.error = "不支持的媒体类型: " + task.media_type;
         }
+    }
+    catch (const std::exception &e)
+    {
+        result.result.success = false;
+        result.result.error = "任务执行异常: " + std::string(e.what());
+        LOG_ERROR("❌ 任务执行异常", {{"task", task.id}, {"error", result.result.error}});
+    }
 
-        // 异步保存到数据库
-        if (task.save_to_db && result.result.success)
-        {
-            // 使用线程池中的线程异步保存，避免阻塞
-            std::thread([this, result]()
-                        {
-                try {
-                    analyzer_->save_result_to_database(result.result);
-                    std::cout << "✅ 任务结果已保存到数据库: " << result.task_id << std::endl;
-                } catch (const std::exception& e) {
-                    std::cerr << "❌ 保存到数据库失败: " << e.what() << std::endl;
-                } })
-                .detach();
-        }
+    finishInFlight(key, task, std::move(result), start_time);
+}
 
-        result.success = result.result.success;
-        if (!result.success)
-        {
-            result.error = result.result.error;
-        }
+void TaskManager::completeTask(const AnalysisTask &task, TaskResult result, double start_time)
+{
+    TraceScope trace_scope(task.trace);
 
-        std::cout << "✅ 任务完成: " << task.id << " (成功: " << (result.success ? "是" : "否") << ")" << std::endl;
+    // 异步保存到数据库
+    if (task.save_to_db && result.result.success)
+    {
+        // 使用线程池中的线程异步保存，避免阻塞
+        std::thread([this, result, trace = Tracer::current()]()
+                    {
+            TraceScope trace_scope(trace);
+            try {
+                analyzer_->save_result_to_database(result.result);
+                LOG_DEBUG("✅ 任务结果已保存到数据库", {{"task", result.task_id}});
+            } catch (const std::exception& e) {
+                LOG_ERROR("❌ 保存到数据库失败", {{"task", result.task_id}, {"error", e.what()}});
+            } })
+            .detach();
     }
-    catch (const std::exception &e)
+
+    result.success = result.result.success;
+    if (!result.success)
     {
-        result.success = false;
-        result.error = "任务执行异常: " + std::string(e.what());
-        std::cerr << "❌ 任务执行异常: " << result.error << std::endl;
+        result.error = result.result.error;
     }
 
-    return result;
+    LOG_INFO("✅ 任务完成",
+             {{"task", task.id}, {"type", task.media_type}, {"success", result.success},
+              {"seconds", utils::get_current_time() - start_time}});
+
+    completed_tasks_++;
+
+    // 调用回调
+    if (task.callback)
+    {
+        task.callback(result.result);
+    }
 }
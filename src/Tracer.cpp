@@ -0,0 +1,252 @@
+#include "Tracer.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+// 当前线程的跟踪上下文
+static thread_local TraceContext t_current;
+
+// 当前线程的内核线程ID（缓存在线程局部变量中）
+static int current_thread_id()
+{
+    static thread_local int tid = static_cast<int>(syscall(SYS_gettid));
+    return tid;
+}
+
+int64_t Tracer::now_us()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+}
+
+// 单例实现
+// 实例不析构：进程退出时其他线程可能仍在记录span
+Tracer &Tracer::getInstance()
+{
+    static Tracer *instance = new Tracer();
+    return *instance;
+}
+
+Tracer::Tracer()
+    : sample_rate_(0.0), next_slot_(0), traces_started_(0), spans_recorded_(0)
+{
+    const char *env_rate = std::getenv("TRACE_SAMPLE_RATE");
+    if (env_rate)
+    {
+        double rate = std::atof(env_rate);
+        sample_rate_ = rate < 0.0 ? 0.0 : (rate > 1.0 ? 1.0 : rate);
+    }
+    spans_.reserve(capacity_);
+}
+
+uint64_t Tracer::next_id()
+{
+    // 每个线程独立的随机数生成器，worker进程中的请求线程在fork之后创建，各自重新播种
+    static thread_local std::mt19937_64 generator(
+        (static_cast<uint64_t>(std::random_device{}()) << 32) ^ std::random_device{}() ^
+        (static_cast<uint64_t>(getpid()) << 16) ^ static_cast<uint64_t>(current_thread_id()));
+
+    uint64_t id = 0;
+    while (id == 0)
+    {
+        id = generator();
+    }
+    return id;
+}
+
+TraceContext Tracer::start_trace(int force_sample)
+{
+    TraceContext ctx;
+    double rate = get_sample_rate();
+    if (force_sample == 1)
+        ctx.sampled = true;
+    else if (force_sample == -1 && rate > 0.0)
+    {
+        static thread_local std::mt19937 generator(std::random_device{}());
+        ctx.sampled = rate >= 1.0 || std::uniform_real_distribution<double>(0.0, 1.0)(generator) < rate;
+    }
+
+    // 未采样的请求不生成ID，避免无谓的开销
+    if (ctx.sampled)
+    {
+        ctx.trace_id = next_id();
+        traces_started_.fetch_add(1, std::memory_order_relaxed);
+    }
+    return ctx;
+}
+
+TraceContext Tracer::current()
+{
+    return t_current;
+}
+
+void Tracer::record(SpanRecord &&span)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (spans_.size() < capacity_)
+    {
+        spans_.push_back(std::move(span));
+    }
+    else
+    {
+        spans_[next_slot_] = std::move(span);
+    }
+    next_slot_ = (next_slot_ + 1) % capacity_;
+    spans_recorded_.fetch_add(1, std::memory_order_relaxed);
+}
+
+std::string Tracer::format_id(uint64_t id)
+{
+    char buffer[17];
+    snprintf(buffer, sizeof(buffer), "%016llx", static_cast<unsigned long long>(id));
+    return buffer;
+}
+
+uint64_t Tracer::parse_id(const std::string &text)
+{
+    if (text.empty() || text.size() > 16)
+        return 0;
+
+    uint64_t id = 0;
+    for (char c : text)
+    {
+        int digit;
+        if (c >= '0' && c <= '9')
+            digit = c - '0';
+        else if (c >= 'a' && c <= 'f')
+            digit = c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F')
+            digit = c - 'A' + 10;
+        else
+            return 0;
+        id = (id << 4) | static_cast<uint64_t>(digit);
+    }
+    return id;
+}
+
+std::string Tracer::export_chrome_trace(const std::string &trace_id, size_t limit) const
+{
+    uint64_t filter = trace_id.empty() ? 0 : parse_id(trace_id);
+    if (!trace_id.empty() && filter == 0)
+    {
+        return nlohmann::json{{"traceEvents", nlohmann::json::array()}, {"displayTimeUnit", "ms"}}.dump();
+    }
+
+    nlohmann::json events = nlohmann::json::array();
+    int pid = static_cast<int>(getpid());
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        // 从最新的span往前取，最多limit个
+        size_t total = spans_.size();
+        std::vector<const SpanRecord *> selected;
+        for (size_t i = 0; i < total && selected.size() < limit; ++i)
+        {
+            size_t index = (next_slot_ + capacity_ - 1 - i) % capacity_;
+            if (index >= total)
+                continue;
+            const SpanRecord &span = spans_[index];
+            if (filter == 0 || span.trace_id == filter)
+                selected.push_back(&span);
+        }
+
+        for (auto it = selected.rbegin(); it != selected.rend(); ++it)
+        {
+            const SpanRecord &span = **it;
+            nlohmann::json args = {
+                {"trace_id", format_id(span.trace_id)},
+                {"span_id", format_id(span.span_id)},
+                {"parent_id", span.parent_id ? format_id(span.parent_id) : ""}};
+            for (const auto &arg : span.args)
+            {
+                args[arg.first] = arg.second;
+            }
+
+            events.push_back({{"name", span.name},
+                              {"cat", "doubao"},
+                              {"ph", "X"},
+                              {"ts", span.start_us},
+                              {"dur", span.duration_us},
+                              {"pid", pid},
+                              {"tid", span.thread_id},
+                              {"args", std::move(args)}});
+        }
+    }
+
+    nlohmann::json result = {{"traceEvents", std::move(events)}, {"displayTimeUnit", "ms"}};
+    return result.dump(-1, ' ', false, nlohmann::json::error_handler_t::replace);
+}
+
+nlohmann::json Tracer::get_stats() const
+{
+    size_t buffered;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        buffered = spans_.size();
+    }
+    return {
+        {"sample_rate", get_sample_rate()},
+        {"capacity", capacity_},
+        {"buffered_spans", buffered},
+        {"traces_started", traces_started_.load()},
+        {"spans_recorded", spans_recorded_.load()}};
+}
+
+TraceScope::TraceScope(const TraceContext &ctx)
+    : previous_(t_current)
+{
+    t_current = ctx;
+}
+
+TraceScope::~TraceScope()
+{
+    t_current = previous_;
+}
+
+Span::Span(const char *name)
+{
+    record_.span_id = 0;
+    if (!t_current.active())
+        return;
+
+    record_.trace_id = t_current.trace_id;
+    record_.parent_id = t_current.span_id;
+    record_.span_id = Tracer::getInstance().next_id();
+    record_.name = name;
+    record_.start_us = Tracer::now_us();
+    record_.duration_us = 0;
+    record_.thread_id = current_thread_id();
+
+    t_current.span_id = record_.span_id;
+}
+
+Span::Span(const char *name, int64_t start_us)
+    : Span(name)
+{
+    if (active())
+        record_.start_us = start_us;
+}
+
+Span::~Span()
+{
+    if (!active())
+        return;
+
+    record_.duration_us = Tracer::now_us() - record_.start_us;
+    if (t_current.trace_id == record_.trace_id)
+    {
+        t_current.span_id = record_.parent_id;
+    }
+    Tracer::getInstance().record(std::move(record_));
+}
+
+void Span::set_arg(const char *key, std::string_view value)
+{
+    if (!active())
+        return;
+    record_.args.emplace_back(key, std::string(value));
+}
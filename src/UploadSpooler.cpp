@@ -0,0 +1,222 @@
+#include "UploadSpooler.hpp"
+#include "Logger.hpp"
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+
+// 单例实现
+// 实例不析构：进程退出时I/O线程可能仍在交付数据
+UploadSpooler &UploadSpooler::getInstance()
+{
+    static UploadSpooler *instance = new UploadSpooler();
+    return *instance;
+}
+
+UploadSpooler::UploadSpooler()
+    : queued_bytes_(0), written_bytes_(0), files_(0), throttled_(0), errors_(0)
+{
+    writer_ = std::thread(&UploadSpooler::writer_loop, this);
+}
+
+UploadSpooler::FilePtr UploadSpooler::open(const std::string &dir, size_t window, std::function<void()> notify)
+{
+    auto file = std::make_shared<File>();
+    file->dir = dir;
+    file->window = window;
+    file->notify = std::move(notify);
+    return file;
+}
+
+void UploadSpooler::write(const FilePtr &file, std::string data)
+{
+    if (data.empty())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(file->mutex);
+        file->queued += data.size();
+    }
+    queued_bytes_ += data.size();
+    enqueue(Item{file, Op::Write, std::move(data)});
+}
+
+bool UploadSpooler::backlogged(const FilePtr &file)
+{
+    std::lock_guard<std::mutex> lock(file->mutex);
+    if (file->queued < file->window)
+        return false;
+
+    if (!file->throttled)
+    {
+        file->throttled = true;
+        throttled_++;
+    }
+    return true;
+}
+
+void UploadSpooler::finish(const FilePtr &file)
+{
+    enqueue(Item{file, Op::Finish, std::string()});
+}
+
+void UploadSpooler::discard(const FilePtr &file)
+{
+    {
+        std::lock_guard<std::mutex> lock(file->mutex);
+        file->discarded = true;
+    }
+    enqueue(Item{file, Op::Discard, std::string()});
+}
+
+void UploadSpooler::enqueue(Item item)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_.push_back(std::move(item));
+    }
+    condition_.notify_one();
+}
+
+void UploadSpooler::writer_loop()
+{
+    while (true)
+    {
+        Item item;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            condition_.wait(lock, [this]
+                            { return !queue_.empty(); });
+            item = std::move(queue_.front());
+            queue_.pop_front();
+        }
+        process(item);
+    }
+}
+
+void UploadSpooler::process(Item &item)
+{
+    File &file = *item.file;
+
+    if (item.op == Op::Discard)
+    {
+        if (file.fd >= 0)
+        {
+            close(file.fd);
+            file.fd = -1;
+        }
+        // 写完的文件交给请求对象后不会再被放弃，这里的文件都仍归上传方所有
+        std::lock_guard<std::mutex> lock(file.mutex);
+        if (!file.path.empty())
+        {
+            unlink(file.path.c_str());
+        }
+        return;
+    }
+
+    if (item.op == Op::Finish)
+    {
+        bool ok;
+        {
+            std::lock_guard<std::mutex> lock(file.mutex);
+            ok = file.error.empty() && !file.discarded;
+        }
+        if (!ok)
+            return;
+
+        if (file.fd >= 0)
+        {
+            close(file.fd);
+            file.fd = -1;
+        }
+        {
+            std::lock_guard<std::mutex> lock(file.mutex);
+            file.finished = true;
+        }
+        files_++;
+        file.notify();
+        return;
+    }
+
+    // 写入一段请求体；放弃或出错后的数据直接丢弃
+    std::string error;
+    bool skip;
+    {
+        std::lock_guard<std::mutex> lock(file.mutex);
+        skip = file.discarded || !file.error.empty();
+    }
+
+    if (!skip && file.fd < 0)
+    {
+        std::string path = file.dir + "/upload_XXXXXX";
+        file.fd = mkstemp(&path[0]);
+        if (file.fd < 0)
+        {
+            error = "无法创建上传临时文件: " + std::string(strerror(errno));
+        }
+        else
+        {
+            std::lock_guard<std::mutex> lock(file.mutex);
+            file.path = path;
+        }
+    }
+
+    size_t written = 0;
+    while (!skip && error.empty() && written < item.data.size())
+    {
+        ssize_t n = ::write(file.fd, item.data.data() + written, item.data.size() - written);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            error = "写入上传临时文件失败: " + std::string(strerror(errno));
+            break;
+        }
+        written += static_cast<size_t>(n);
+    }
+    written_bytes_ += written;
+    queued_bytes_ -= item.data.size();
+
+    bool notify = false;
+    {
+        std::lock_guard<std::mutex> lock(file.mutex);
+        file.queued -= item.data.size();
+        if (!error.empty() && file.error.empty())
+        {
+            file.error = error;
+            notify = !file.discarded;
+        }
+        else if (file.throttled && file.queued <= file.window / 2)
+        {
+            // 积压降到一半后恢复读取，避免在上限附近频繁暂停和恢复
+            file.throttled = false;
+            notify = !file.discarded;
+        }
+    }
+
+    if (!error.empty())
+    {
+        errors_++;
+        LOG_WARN("⚠️ 上传请求体写入失败", {{"error", error}});
+    }
+    if (notify)
+    {
+        file.notify();
+    }
+}
+
+nlohmann::json UploadSpooler::get_stats()
+{
+    size_t pending;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending = queue_.size();
+    }
+    return {
+        {"pending_writes", pending},
+        {"queued_bytes", queued_bytes_.load()},
+        {"written_bytes", written_bytes_.load()},
+        {"files", files_.load()},
+        {"throttled", throttled_.load()},
+        {"errors", errors_.load()}};
+}
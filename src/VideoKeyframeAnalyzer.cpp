@@ -1,5 +1,8 @@
 #include "VideoKeyframeAnalyzer.hpp"
 #include "utils.hpp"
+#include "Logger.hpp"
+#include "Metrics.hpp"
+#include "Tracer.hpp"
 #include <filesystem>
 #include <fstream>
 #include <iostream>
@@ -121,10 +124,22 @@ std::string VideoKeyframeAnalyzer::execute_command(const std::string &cmd)
     std::array<char, 128> buffer;
     std::string result;
 
-    std::cout << "执行命令: " << cmd << std::endl;
-    std::cout << "命令长度: " << cmd.length() << std::endl;
+    // ffprobe（元数据、编码检查）和ffmpeg（抽帧）分别统计耗时
+    static Histogram &ffprobe_seconds = Metrics::getInstance().stage("ffprobe");
+    static Histogram &ffmpeg_seconds = Metrics::getInstance().stage("ffmpeg_extract");
+    static Histogram &command_seconds = Metrics::getInstance().stage("command");
+    ScopedTimer timer(cmd.compare(0, 7, "ffprobe") == 0 ? ffprobe_seconds : cmd.compare(0, 6, "ffmpeg") == 0 ? ffmpeg_seconds
+                                                                                                             : command_seconds);
+    Span span(cmd.compare(0, 7, "ffprobe") == 0 ? "ffprobe" : cmd.compare(0, 6, "ffmpeg") == 0 ? "ffmpeg" : "command");
+    if (span.active())
+    {
+        span.set_arg("cmd", Logger::truncate(cmd, 512));
+    }
+
+    LOG_DEBUG("执行命令", {{"length", cmd.length()}});
+    LOG_TRACE("执行命令", {{"cmd", Logger::truncate(cmd, 1024)}});
     if (!cmd.empty() && cmd[0] == '|') {
-        std::cerr << "错误：命令开头包含非法字符 '|'" << std::endl;
+        LOG_ERROR("错误：命令开头包含非法字符 '|'");
     }
 
     FILE *pipe = popen(cmd.c_str(), "r");
@@ -240,43 +255,42 @@ VideoMetadata VideoKeyframeAnalyzer::get_video_metadata(const std::string &video
         }
 
         // 输出视频元数据，包括总帧数
-        std::cout << "视频元数据: " << metadata.width << "x" << metadata.height
-                  << ", " << metadata.duration << "秒, " << metadata.fps
-                  << " FPS, 编解码器: " << metadata.codec;
-        if (metadata.total_frames > 0)
-        {
-            std::cout << ", 总帧数: " << metadata.total_frames;
-        }
-        std::cout << std::endl;
+        LOG_DEBUG("视频元数据",
+                  {{"width", metadata.width},
+                   {"height", metadata.height},
+                   {"duration", metadata.duration},
+                   {"fps", metadata.fps},
+                   {"codec", metadata.codec},
+                   {"total_frames", metadata.total_frames}});
     }
     catch (const std::exception &e)
     {
-        std::cerr << "获取视频元数据失败: " << e.what() << std::endl;
+        LOG_WARN("获取视频元数据失败", {{"error", e.what()}});
     }
 
     return metadata;
 }
 
 // 并发处理帧
-std::vector<std::string> VideoKeyframeAnalyzer::process_frames_concurrently(
+std::vector<std::vector<unsigned char>> VideoKeyframeAnalyzer::process_frames_concurrently(
     const std::vector<std::string> &frame_paths,
     int max_concurrency)
 {
 
-    std::vector<std::future<std::string>> futures;
-    std::vector<std::string> results;
+    std::vector<std::future<std::vector<unsigned char>>> futures;
+    std::vector<std::vector<unsigned char>> results;
 
     // 提交所有帧处理任务
     for (const auto &frame_path : frame_paths)
     {
         // 使用lambda函数捕获this指针，以便调用成员函数
-        std::function<std::string()> task = [this, frame_path]()
+        std::function<std::vector<unsigned char>()> task = [this, frame_path]()
         {
             return process_single_frame(frame_path);
         };
 
         // 创建packaged_task并获取future
-        auto packaged_task = std::make_shared<std::packaged_task<std::string()>>(task);
+        auto packaged_task = std::make_shared<std::packaged_task<std::vector<unsigned char>()>>(task);
         futures.push_back(packaged_task->get_future());
 
         // 将任务添加到队列
@@ -297,7 +311,7 @@ std::vector<std::string> VideoKeyframeAnalyzer::process_frames_concurrently(
         }
         catch (const std::exception &e)
         {
-            std::cerr << "处理帧时出错: " << e.what() << std::endl;
+            LOG_WARN("处理帧时出错", {{"error", e.what()}});
         }
     }
 
@@ -305,11 +319,11 @@ std::vector<std::string> VideoKeyframeAnalyzer::process_frames_concurrently(
 }
 
 // 处理单个帧
-std::string VideoKeyframeAnalyzer::process_single_frame(const std::string &frame_path)
+std::vector<unsigned char> VideoKeyframeAnalyzer::process_single_frame(const std::string &frame_path)
 {
     if (!std::filesystem::exists(frame_path))
     {
-        return "";
+        return {};
     }
 
     try
@@ -318,22 +332,19 @@ std::string VideoKeyframeAnalyzer::process_single_frame(const std::string &frame
         cv::Mat frame = cv::imread(frame_path);
         if (frame.empty())
         {
-            return "";
+            return {};
         }
 
         // 调整图像大小
         cv::Mat resized_frame = utils::resize_image(frame, 800);
 
-        // 编码为JPEG并转换为base64
-        auto jpeg_data = utils::encode_image_to_jpeg(resized_frame, 85);
-        std::string frame_base64 = utils::base64_encode(jpeg_data);
-
-        return frame_base64;
+        // 编码为JPEG（Base64编码在写入请求体时完成）
+        return utils::encode_image_to_jpeg(resized_frame, 85);
     }
     catch (const std::exception &e)
     {
-        std::cerr << "处理帧 " << frame_path << " 时出错: " << e.what() << std::endl;
-        return "";
+        LOG_WARN("处理帧时出错", {{"path", frame_path}, {"error", e.what()}});
+        return {};
     }
 }
 // 20251204 add  根据视频编码格式和时长生成优化的提取命令
@@ -417,16 +428,18 @@ std::string get_optimized_extract_cmd(
     // 返回一个包含两种命令的字符串，用特殊分隔符分隔
     // 主程序将首先尝试CUDA命令，如果失败则使用回退命令
     std::string full_cmd = cmd.str() + "|||FALLBACK|||" + fallback_cmd;
-    std::cout << "完整命令长度: " << full_cmd.length() << std::endl;
+    LOG_TRACE("完整命令长度", {{"length", full_cmd.length()}});
     return full_cmd;
 }
 
-std::vector<std::string> VideoKeyframeAnalyzer::extract_keyframes(
+std::vector<std::vector<unsigned char>> VideoKeyframeAnalyzer::extract_keyframes(
     const std::string &video_url,
     int max_frames,
     const std::string &output_format)
 {
-    std::vector<std::string> frames_base64;
+    std::vector<std::vector<unsigned char>> frames;
+    Span span("extract_keyframes");
+    span.set_arg("max_frames", max_frames);
 
     try
     {
@@ -485,10 +498,9 @@ std::vector<std::string> VideoKeyframeAnalyzer::extract_keyframes(
                 size_t fallback_pos = cmd.find("|||FALLBACK|||");
                 if (fallback_pos != std::string::npos) {
                     std::string fallback_cmd = cmd.substr(fallback_pos + 13); // 13是"|||FALLBACK|||"的长度
-                    std::cout << "CUDA资源不可用，使用CPU处理..." << std::endl;
-                    std::cout << "回退命令长度: " << fallback_cmd.length() << std::endl;
+                    LOG_DEBUG("CUDA资源不可用，使用CPU处理", {{"length", fallback_cmd.length()}});
                     if (!fallback_cmd.empty() && fallback_cmd[0] == '|') {
-                        std::cerr << "错误：回退命令开头包含非法字符 '|'，正在移除..." << std::endl;
+                        LOG_WARN("回退命令开头包含非法字符 '|'，正在移除");
                         fallback_cmd = fallback_cmd.substr(1);
                     }
                     execute_command(fallback_cmd);
@@ -500,25 +512,24 @@ std::vector<std::string> VideoKeyframeAnalyzer::extract_keyframes(
                 }
             }
         } catch (const std::exception& e) {
-            std::cerr << "视频处理命令执行失败: " << e.what() << std::endl;
+            LOG_WARN("视频处理命令执行失败", {{"error", e.what()}});
             
             // 如果使用CUDA失败，尝试使用CPU回退命令
             if (use_cuda) {
                 size_t fallback_pos = cmd.find("|||FALLBACK|||");
                 if (fallback_pos != std::string::npos) {
                     std::string fallback_cmd = cmd.substr(fallback_pos + 13);
-                    std::cout << "CUDA处理失败，尝试使用CPU回退命令..." << std::endl;
-                    std::cout << "回退命令长度: " << fallback_cmd.length() << std::endl;
+                    LOG_DEBUG("CUDA处理失败，尝试使用CPU回退命令", {{"length", fallback_cmd.length()}});
                     if (!fallback_cmd.empty() && fallback_cmd[0] == '|') {
-                        std::cerr << "错误：回退命令开头包含非法字符 '|'，正在移除..." << std::endl;
+                        LOG_WARN("回退命令开头包含非法字符 '|'，正在移除");
                         fallback_cmd = fallback_cmd.substr(1);
                     }
                     try {
                         execute_command(fallback_cmd);
                         cmd_success = true;
-                        std::cout << "CPU回退命令执行成功" << std::endl;
+                        LOG_DEBUG("CPU回退命令执行成功");
                     } catch (const std::exception& fallback_e) {
-                        std::cerr << "CPU回退命令也失败: " << fallback_e.what() << std::endl;
+                        LOG_WARN("CPU回退命令也失败", {{"error", fallback_e.what()}});
                     }
                 }
             }
@@ -536,7 +547,7 @@ std::vector<std::string> VideoKeyframeAnalyzer::extract_keyframes(
         auto end_time = std::chrono::high_resolution_clock::now();
         auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count();
 
-        std::cout << "⏱️ [耗时] 帧提取耗时: " << duration / 1000.0 << " 秒" << std::endl;
+        LOG_DEBUG("⏱️ [耗时] 帧提取完成", {{"seconds", duration / 1000.0}});
 
         // 收集所有提取的帧文件路径
         std::vector<std::string> frame_paths;
@@ -553,21 +564,21 @@ std::vector<std::string> VideoKeyframeAnalyzer::extract_keyframes(
 
         // 使用并发处理这些帧
         auto concurrent_start = std::chrono::high_resolution_clock::now();
-        frames_base64 = process_frames_concurrently(frame_paths);
+        frames = process_frames_concurrently(frame_paths);
         auto concurrent_end = std::chrono::high_resolution_clock::now();
         auto concurrent_duration = std::chrono::duration_cast<std::chrono::milliseconds>(concurrent_end - concurrent_start).count();
 
-        std::cout << "并发帧处理耗时: " << concurrent_duration / 1000.0 << " 秒" << std::endl;
+        LOG_DEBUG("并发帧处理完成", {{"frames", frames.size()}, {"seconds", concurrent_duration / 1000.0}});
 
         // 如果关键帧数量不足，使用采样方法补充
-        if (frames_base64.size() < 3)
+        if (frames.size() < 3)
         {
-            std::cout << "关键帧数量不足(" << frames_base64.size() << ")，使用采样方法补充到3帧" << std::endl;
+            LOG_DEBUG("关键帧数量不足，使用采样方法补充到3帧", {{"frames", frames.size()}});
 
             if (metadata.duration > 0)
             {
                 // 计算需要补充的帧数
-                int remaining_frames = 3 - frames_base64.size();
+                int remaining_frames = 3 - frames.size();
 
                 // 优化采样策略：使用固定时间点而不是等分
                 std::vector<double> timestamps;
@@ -620,32 +631,30 @@ std::vector<std::string> VideoKeyframeAnalyzer::extract_keyframes(
                         execute_command(sample_cmd_cuda);
                         cmd_success = true;
                     } else {
-                        std::cout << "CUDA资源不可用，使用CPU处理..." << std::endl;
-                        std::cout << "CPU命令长度: " << sample_cmd_cpu.length() << std::endl;
+                        LOG_DEBUG("CUDA资源不可用，使用CPU处理", {{"length", sample_cmd_cpu.length()}});
                         if (!sample_cmd_cpu.empty() && sample_cmd_cpu[0] == '|') {
-                            std::cerr << "错误：CPU命令开头包含非法字符 '|'，正在移除..." << std::endl;
+                            LOG_WARN("CPU命令开头包含非法字符 '|'，正在移除");
                             sample_cmd_cpu = sample_cmd_cpu.substr(1);
                         }
                         execute_command(sample_cmd_cpu);
                         cmd_success = true;
                     }
                 } catch (const std::exception& e) {
-                    std::cerr << "采样命令执行失败: " << e.what() << std::endl;
+                    LOG_WARN("采样命令执行失败", {{"error", e.what()}});
                     
                     // 如果使用CUDA失败，尝试使用CPU命令
                     if (use_cuda) {
                         try {
-                            std::cout << "CUDA处理失败，尝试使用CPU回退命令..." << std::endl;
-                            std::cout << "CPU回退命令长度: " << sample_cmd_cpu.length() << std::endl;
+                            LOG_DEBUG("CUDA处理失败，尝试使用CPU回退命令", {{"length", sample_cmd_cpu.length()}});
                             if (!sample_cmd_cpu.empty() && sample_cmd_cpu[0] == '|') {
-                                std::cerr << "错误：CPU回退命令开头包含非法字符 '|'，正在移除..." << std::endl;
+                                LOG_WARN("CPU回退命令开头包含非法字符 '|'，正在移除");
                                 sample_cmd_cpu = sample_cmd_cpu.substr(1);
                             }
                             execute_command(sample_cmd_cpu);
                             cmd_success = true;
-                            std::cout << "CPU回退命令执行成功" << std::endl;
+                            LOG_DEBUG("CPU回退命令执行成功");
                         } catch (const std::exception& fallback_e) {
-                            std::cerr << "CPU回退命令也失败: " << fallback_e.what() << std::endl;
+                            LOG_WARN("CPU回退命令也失败", {{"error", fallback_e.what()}});
                         }
                     }
                 }
@@ -660,38 +669,30 @@ std::vector<std::string> VideoKeyframeAnalyzer::extract_keyframes(
                 }
 
                 // 使用并发处理这些采样帧
-                std::vector<std::string> sample_frames = process_frames_concurrently(sample_paths);
+                std::vector<std::vector<unsigned char>> sample_frames = process_frames_concurrently(sample_paths);
 
                 // 将处理好的采样帧添加到结果中
-                for (const auto &frame : sample_frames)
+                for (auto &frame : sample_frames)
                 {
                     if (!frame.empty())
                     {
-                        frames_base64.push_back(frame);
+                        frames.push_back(std::move(frame));
                     }
                 }
             }
         }
 
-        std::cout << "成功提取 " << frames_base64.size() << " 个关键帧" << std::endl;
-
         // 输出统计信息
-        if (metadata.total_frames > 0)
-        {
-            double keyframe_ratio = (static_cast<double>(frames_base64.size()) / metadata.total_frames) * 100;
-
-            std::cout << "📊 [统计] 视频总帧数: " << metadata.total_frames << std::endl;
-            std::cout << "📊 [统计] 抽取关键帧数: " << frames_base64.size() << std::endl;
-            std::cout << "📊 [统计] 抽取帧占总帧数比例: " << std::fixed << std::setprecision(2)
-                      << keyframe_ratio << "%" << std::endl;
-        }
+        double keyframe_ratio = metadata.total_frames > 0 ? (static_cast<double>(frames.size()) / metadata.total_frames) * 100 : 0.0;
+        LOG_DEBUG("📊 [统计] 关键帧提取完成",
+                  {{"frames", frames.size()}, {"total_frames", metadata.total_frames}, {"ratio_percent", keyframe_ratio}});
     }
     catch (const std::exception &e)
     {
-        std::cerr << "提取关键帧失败: " << e.what() << std::endl;
+        LOG_ERROR("提取关键帧失败", {{"error", e.what()}});
     }
 
-    return frames_base64;
+    return frames;
 }
 
 // CUDA资源管理方法实现
@@ -700,14 +701,13 @@ bool VideoKeyframeAnalyzer::acquire_cuda_resource() {
     
     // 如果已经达到最大并发CUDA任务数，返回false
     if (active_cuda_tasks_.load() >= MAX_CONCURRENT_CUDA_TASKS) {
-        std::cout << "CUDA资源已满，当前活动任务数: " << active_cuda_tasks_.load() 
-                  << "，最大允许: " << MAX_CONCURRENT_CUDA_TASKS << std::endl;
+        LOG_DEBUG("CUDA资源已满", {{"active", active_cuda_tasks_.load()}, {"max", MAX_CONCURRENT_CUDA_TASKS}});
         return false;
     }
     
     // 增加活动CUDA任务计数
     active_cuda_tasks_++;
-    std::cout << "获取CUDA资源成功，当前活动任务数: " << active_cuda_tasks_.load() << std::endl;
+    LOG_DEBUG("获取CUDA资源成功", {{"active", active_cuda_tasks_.load()}});
     return true;
 }
 
@@ -717,7 +717,7 @@ void VideoKeyframeAnalyzer::release_cuda_resource() {
     // 确保计数不会变为负数
     if (active_cuda_tasks_.load() > 0) {
         active_cuda_tasks_--;
-        std::cout << "释放CUDA资源，当前活动任务数: " << active_cuda_tasks_.load() << std::endl;
+        LOG_DEBUG("释放CUDA资源", {{"active", active_cuda_tasks_.load()}});
     }
 }
 
@@ -943,10 +943,12 @@ void VideoKeyframeAnalyzer::release_cuda_resource() {
 // }
 
 // 增加默认值 num_samples = 5
-std::vector<std::string> VideoKeyframeAnalyzer::extract_sample_frames(const std::string &video_url,
+std::vector<std::vector<unsigned char>> VideoKeyframeAnalyzer::extract_sample_frames(const std::string &video_url,
                                                                       int num_samples)
 {
-    std::vector<std::string> frames_base64;
+    std::vector<std::vector<unsigned char>> frames;
+    Span span("extract_sample_frames");
+    span.set_arg("num_samples", num_samples);
 
     try
     {
@@ -968,7 +970,7 @@ std::vector<std::string> VideoKeyframeAnalyzer::extract_sample_frames(const std:
 
         if (metadata.duration <= 0)
         {
-            std::cerr << "无法获取视频时长，使用关键帧方法" << std::endl;
+            LOG_DEBUG("无法获取视频时长，使用关键帧方法");
             return extract_keyframes(video_url, num_samples);
         }
 
@@ -1002,20 +1004,18 @@ std::vector<std::string> VideoKeyframeAnalyzer::extract_sample_frames(const std:
 
         // 使用并发处理这些采样帧
         auto concurrent_start = std::chrono::high_resolution_clock::now();
-        frames_base64 = process_frames_concurrently(frame_paths);
+        frames = process_frames_concurrently(frame_paths);
         auto concurrent_end = std::chrono::high_resolution_clock::now();
         auto concurrent_duration = std::chrono::duration_cast<std::chrono::milliseconds>(concurrent_end - concurrent_start).count();
 
-        std::cout << "并发采样帧处理耗时: " << concurrent_duration / 1000.0 << " 秒" << std::endl;
-
-        std::cout << "成功提取 " << frames_base64.size() << " 个采样帧" << std::endl;
+        LOG_DEBUG("采样帧提取完成", {{"frames", frames.size()}, {"seconds", concurrent_duration / 1000.0}});
     }
     catch (const std::exception &e)
     {
-        std::cerr << "采样帧提取失败: " << e.what() << std::endl;
+        LOG_ERROR("采样帧提取失败", {{"error", e.what()}});
     }
 
-    return frames_base64;
+    return frames;
 }
 
 FrameAnalysis VideoKeyframeAnalyzer::analyze_frame(const cv::Mat &frame, double timestamp)
@@ -1086,28 +1086,26 @@ VideoAnalysisResult VideoKeyframeAnalyzer::analyze_video_content(const std::stri
         }
 
         // 提取帧
-        std::vector<std::string> frames_base64;
+        std::vector<std::vector<unsigned char>> frames;
         if (method == "keyframes")
         {
-            frames_base64 = extract_keyframes(video_url, num_frames);
+            frames = extract_keyframes(video_url, num_frames);
         }
         else
         {
-            frames_base64 = extract_sample_frames(video_url, num_frames);
+            frames = extract_sample_frames(video_url, num_frames);
         }
 
-        if (frames_base64.empty())
+        if (frames.empty())
         {
             result.error = "无法提取视频帧";
             return result;
         }
 
         // 分析帧内容
-        for (size_t i = 0; i < frames_base64.size(); ++i)
+        for (size_t i = 0; i < frames.size(); ++i)
         {
-            // 从base64解码图像
-            std::vector<unsigned char> jpeg_data = utils::base64_decode(frames_base64[i]);
-            cv::Mat frame = cv::imdecode(jpeg_data, cv::IMREAD_COLOR);
+            cv::Mat frame = cv::imdecode(frames[i], cv::IMREAD_COLOR);
 
             if (!frame.empty())
             {
@@ -1115,7 +1113,7 @@ VideoAnalysisResult VideoKeyframeAnalyzer::analyze_video_content(const std::stri
                 double timestamp = 0.0;
                 if (result.metadata.duration > 0)
                 {
-                    timestamp = (static_cast<double>(i) / frames_base64.size()) * result.metadata.duration;
+                    timestamp = (static_cast<double>(i) / frames.size()) * result.metadata.duration;
                 }
 
                 // 分析帧
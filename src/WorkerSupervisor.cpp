@@ -0,0 +1,300 @@
+#include "WorkerSupervisor.hpp"
+#include <iostream>
+#include <new>
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <ctime>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <sys/prctl.h>
+
+// supervisor收到的停止信号
+static volatile sig_atomic_t g_supervisor_stop = 0;
+
+static void supervisor_signal_handler(int)
+{
+    g_supervisor_stop = 1;
+}
+
+WorkerSupervisor::WorkerSupervisor(size_t worker_count)
+    : worker_count_(worker_count), slots_(nullptr), supervisor_pid_(getpid()), current_index_(0), is_worker_(false),
+      restart_at_(worker_count), backoff_seconds_(worker_count, 1),
+      heartbeat_timeout_seconds_(30), min_uptime_seconds_(10), max_backoff_seconds_(30), shutdown_timeout_seconds_(15)
+{
+    // 槽位必须在fork之前分配，worker继承同一块共享内存
+    void *memory = mmap(nullptr, sizeof(WorkerSlot) * worker_count_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED)
+    {
+        throw std::runtime_error(std::string("分配worker共享内存失败: ") + strerror(errno));
+    }
+
+    slots_ = static_cast<WorkerSlot *>(memory);
+    for (size_t i = 0; i < worker_count_; ++i)
+    {
+        new (&slots_[i]) WorkerSlot();
+    }
+}
+
+WorkerSupervisor::~WorkerSupervisor()
+{
+    if (slots_)
+    {
+        munmap(slots_, sizeof(WorkerSlot) * worker_count_);
+        slots_ = nullptr;
+    }
+}
+
+WorkerSlot *WorkerSupervisor::current_slot() const
+{
+    return is_worker_ ? &slots_[current_index_] : nullptr;
+}
+
+int WorkerSupervisor::run(WorkerMain worker_main)
+{
+    worker_main_ = std::move(worker_main);
+
+    // 不使用SA_RESTART，使等待被信号打断后立即检查停止标志
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = supervisor_signal_handler;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+
+    std::cout << "👥 [supervisor] 进程 " << supervisor_pid_ << " 启动 " << worker_count_ << " 个worker" << std::endl;
+
+    for (size_t i = 0; i < worker_count_; ++i)
+    {
+        spawn(i);
+    }
+
+    while (!g_supervisor_stop)
+    {
+        reap_workers();
+        check_heartbeats();
+
+        // 到达重启时间的worker重新fork
+        Clock::time_point now = Clock::now();
+        for (size_t i = 0; i < worker_count_; ++i)
+        {
+            if (slots_[i].pid.load() == 0 && now >= restart_at_[i])
+            {
+                slots_[i].restarts++;
+                spawn(i);
+            }
+        }
+
+        poll(nullptr, 0, 500);
+    }
+
+    std::cout << "🛑 [supervisor] 收到停止信号，正在停止所有worker..." << std::endl;
+    stop_workers();
+    std::cout << "✅ [supervisor] 所有worker已退出" << std::endl;
+    return 0;
+}
+
+bool WorkerSupervisor::spawn(size_t index)
+{
+    // 统计在fork之前清零，避免覆盖新worker已经上报的数据
+    WorkerSlot &slot = slots_[index];
+    slot.heartbeat = 0;
+    slot.requests = 0;
+    slot.open_connections = 0;
+    slot.queued = 0;
+    slot.active = 0;
+    slot.rejected = 0;
+    slot.started_at = static_cast<int64_t>(time(nullptr));
+
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        std::cerr << "❌ [supervisor] fork worker " << index << " 失败: " << strerror(errno) << std::endl;
+        restart_at_[index] = Clock::now() + std::chrono::seconds(backoff_seconds_[index]);
+        return false;
+    }
+
+    if (pid == 0)
+    {
+        // worker进程：恢复默认信号处理，supervisor退出时随之退出
+        is_worker_ = true;
+        current_index_ = index;
+
+        signal(SIGINT, SIG_DFL);
+        signal(SIGTERM, SIG_DFL);
+        prctl(PR_SET_PDEATHSIG, SIGTERM);
+        if (getppid() != supervisor_pid_)
+        {
+            _exit(0);
+        }
+
+        int code = worker_main_(index);
+        std::cout.flush();
+        exit(code);
+    }
+
+    slot.pid = pid;
+
+    std::cout << "🚀 [supervisor] worker " << index << " 已启动，PID: " << pid << std::endl;
+    return true;
+}
+
+void WorkerSupervisor::reap_workers()
+{
+    int status = 0;
+    pid_t pid;
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0)
+    {
+        for (size_t i = 0; i < worker_count_; ++i)
+        {
+            WorkerSlot &slot = slots_[i];
+            if (slot.pid.load() != pid)
+                continue;
+
+            int64_t uptime = static_cast<int64_t>(time(nullptr)) - slot.started_at.load();
+            if (WIFSIGNALED(status))
+            {
+                std::cerr << "💥 [supervisor] worker " << i << " (PID " << pid << ") 被信号 " << WTERMSIG(status)
+                          << " 终止，运行 " << uptime << " 秒" << std::endl;
+            }
+            else
+            {
+                std::cerr << "⚠️ [supervisor] worker " << i << " (PID " << pid << ") 退出，退出码 " << WEXITSTATUS(status)
+                          << "，运行 " << uptime << " 秒" << std::endl;
+            }
+
+            // 启动后很快退出（如端口绑定失败）时指数退避，避免频繁重启
+            if (uptime < min_uptime_seconds_)
+                backoff_seconds_[i] = std::min(backoff_seconds_[i] * 2, max_backoff_seconds_);
+            else
+                backoff_seconds_[i] = 1;
+
+            slot.pid = 0;
+            restart_at_[i] = Clock::now() + std::chrono::seconds(backoff_seconds_[i]);
+            std::cout << "🔄 [supervisor] " << backoff_seconds_[i] << " 秒后重启 worker " << i << std::endl;
+            break;
+        }
+    }
+}
+
+void WorkerSupervisor::check_heartbeats()
+{
+    int64_t now = static_cast<int64_t>(time(nullptr));
+    for (size_t i = 0; i < worker_count_; ++i)
+    {
+        WorkerSlot &slot = slots_[i];
+        int32_t pid = slot.pid.load();
+        int64_t heartbeat = slot.heartbeat.load();
+
+        // 只检查已经开始上报心跳的worker（初始化数据库等步骤可能较慢）
+        if (pid > 0 && heartbeat > 0 && now - heartbeat > heartbeat_timeout_seconds_)
+        {
+            std::cerr << "💀 [supervisor] worker " << i << " (PID " << pid << ") " << (now - heartbeat)
+                      << " 秒无心跳，强制终止" << std::endl;
+            slot.heartbeat = 0;
+            kill(pid, SIGKILL);
+        }
+    }
+}
+
+void WorkerSupervisor::stop_workers()
+{
+    for (size_t i = 0; i < worker_count_; ++i)
+    {
+        int32_t pid = slots_[i].pid.load();
+        if (pid > 0)
+            kill(pid, SIGTERM);
+    }
+
+    Clock::time_point deadline = Clock::now() + std::chrono::seconds(shutdown_timeout_seconds_);
+    while (true)
+    {
+        int status = 0;
+        pid_t pid;
+        while ((pid = waitpid(-1, &status, WNOHANG)) > 0)
+        {
+            for (size_t i = 0; i < worker_count_; ++i)
+            {
+                if (slots_[i].pid.load() == pid)
+                    slots_[i].pid = 0;
+            }
+        }
+
+        size_t running = 0;
+        for (size_t i = 0; i < worker_count_; ++i)
+        {
+            if (slots_[i].pid.load() > 0)
+                running++;
+        }
+        if (running == 0)
+            return;
+
+        if (Clock::now() >= deadline)
+        {
+            std::cerr << "⚠️ [supervisor] " << running << " 个worker未在 " << shutdown_timeout_seconds_ << " 秒内退出，强制终止" << std::endl;
+            for (size_t i = 0; i < worker_count_; ++i)
+            {
+                int32_t worker_pid = slots_[i].pid.load();
+                if (worker_pid > 0)
+                {
+                    kill(worker_pid, SIGKILL);
+                    waitpid(worker_pid, &status, 0);
+                    slots_[i].pid = 0;
+                }
+            }
+            return;
+        }
+
+        poll(nullptr, 0, 100);
+    }
+}
+
+nlohmann::json WorkerSupervisor::get_status() const
+{
+    int64_t now = static_cast<int64_t>(time(nullptr));
+
+    nlohmann::json list = nlohmann::json::array();
+    uint64_t requests = 0, open_connections = 0, queued = 0, active = 0, rejected = 0;
+    size_t alive = 0;
+
+    for (size_t i = 0; i < worker_count_; ++i)
+    {
+        const WorkerSlot &slot = slots_[i];
+        int32_t pid = slot.pid.load();
+        int64_t heartbeat = slot.heartbeat.load();
+        bool healthy = pid > 0 && heartbeat > 0 && now - heartbeat <= heartbeat_timeout_seconds_;
+
+        nlohmann::json worker;
+        worker["index"] = i;
+        worker["pid"] = pid;
+        worker["healthy"] = healthy;
+        worker["restarts"] = slot.restarts.load();
+        worker["uptime_seconds"] = pid > 0 ? now - slot.started_at.load() : 0;
+        worker["heartbeat_age_seconds"] = heartbeat > 0 ? now - heartbeat : -1;
+        worker["requests"] = slot.requests.load();
+        worker["open_connections"] = slot.open_connections.load();
+        worker["queued"] = slot.queued.load();
+        worker["active"] = slot.active.load();
+        worker["rejected"] = slot.rejected.load();
+        list.push_back(std::move(worker));
+
+        if (healthy)
+            alive++;
+        requests += slot.requests.load();
+        open_connections += slot.open_connections.load();
+        queued += slot.queued.load();
+        active += slot.active.load();
+        rejected += slot.rejected.load();
+    }
+
+    return {
+        {"supervisor_pid", supervisor_pid_},
+        {"count", worker_count_},
+        {"healthy", alive},
+        {"totals", {{"requests", requests}, {"open_connections", open_connections}, {"queued", queued}, {"active", active}, {"rejected", rejected}}},
+        {"list", list}};
+}
@@ -1,6 +1,8 @@
 #include "ApiServer.hpp"
 #include "utils.hpp"
 #include "GPUManager.hpp"
+#include "WorkerSupervisor.hpp"
+#include "Logger.hpp"
 #include <iostream>
 #include <string>
 #include <signal.h>
@@ -27,10 +29,40 @@ void print_usage()
     std::cout << "  --api-key KEY        豆包API密钥 (必需)" << std::endl;
     std::cout << "  --port PORT          服务器监听端口 (默认: 8080)" << std::endl;
     std::cout << "  --host HOST          服务器绑定地址 (默认: 0.0.0.0)" << std::endl;
+    std::cout << "  --workers N          以N个worker进程共同监听同一端口，异常退出的worker自动重启 (默认: 1)" << std::endl;
+    std::cout << "  --log-level LEVEL    日志级别: trace/debug/info/warn/error/off (默认: info，也可用LOG_LEVEL环境变量设置)" << std::endl;
     std::cout << "  --help               显示此帮助信息" << std::endl;
     std::cout << std::endl;
     std::cout << "示例:" << std::endl;
     std::cout << "  doubao_api_server --api-key YOUR_KEY --port 8080" << std::endl;
+    std::cout << "  doubao_api_server --api-key YOUR_KEY --port 8080 --workers 4" << std::endl;
+}
+
+// 创建并运行API服务器，supervisor不为空时以worker身份运行
+int run_server(const std::string &api_key, int port, const std::string &host, WorkerSupervisor *supervisor)
+{
+    // 设置信号处理
+    signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
+
+    // 初始化GPU管理器
+    gpu::GPUManager::initialize();
+
+    // 创建并初始化API服务器
+    g_server = std::make_unique<ApiServer>(api_key, port, host);
+    g_server->set_supervisor(supervisor);
+
+    if (!g_server->initialize())
+    {
+        std::cout << "❌ API服务器初始化失败" << std::endl;
+        return 1;
+    }
+
+    // 启动服务器
+    std::cout << "🚀 启动豆包媒体分析API服务器..." << std::endl;
+    g_server->start();
+
+    return 0;
 }
 
 int main(int argc, char *argv[])
@@ -55,6 +87,7 @@ int main(int argc, char *argv[])
     std::string api_key;
     int port = 8080;
     std::string host = "0.0.0.0";
+    int workers = 1;
 
     // 解析命令行参数
 
@@ -111,31 +144,34 @@ int main(int argc, char *argv[])
         {
             host = argv[++i];
         }
+        else if (arg == "--workers" && i + 1 < argc)
+        {
+            workers = std::stoi(argv[++i]);
+        }
+        else if (arg == "--log-level" && i + 1 < argc)
+        {
+            LogLevel level;
+            if (!Logger::parse_level(argv[++i], level))
+            {
+                std::cout << "❌ 无效的日志级别: " << argv[i] << std::endl;
+                print_usage();
+                return 1;
+            }
+            Logger::getInstance().set_level(level);
+        }
         else if (arg == "--db-stats")
         {
             show_db_stats = true;
         }
     }
 
-    // 设置信号处理
-    signal(SIGINT, signal_handler);
-    signal(SIGTERM, signal_handler);
-
-    // 初始化GPU管理器
-    gpu::GPUManager::initialize();
-
-    // 创建并初始化API服务器
-    g_server = std::make_unique<ApiServer>(api_key, port, host);
-
-    if (!g_server->initialize())
+    if (workers > 1)
     {
-        std::cout << "❌ API服务器初始化失败" << std::endl;
-        return 1;
+        // 多进程模式：必须在创建任何线程（GPU、任务管理器、执行器）之前fork
+        WorkerSupervisor supervisor(static_cast<size_t>(workers));
+        return supervisor.run([&](size_t)
+                              { return run_server(api_key, port, host, &supervisor); });
     }
 
-    // 启动服务器
-    std::cout << "🚀 启动豆包媒体分析API服务器..." << std::endl;
-    g_server->start();
-
-    return 0;
+    return run_server(api_key, port, host, nullptr);
 }
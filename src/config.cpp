@@ -13,7 +13,7 @@ namespace config
     // const std::string MODEL_NAME = "qwen3-vl:8b-instruct-q4_K_M";          // qwen3-vl:235b-cloud
     // const std::string API_KEY = "";                                        // 默认空值，Ollama通常不需要API密钥
 
-    // 默认使用本地Vllm API
+    // 默认使用本地Vllm API（多个副本用逗号分隔，如 "http://10.0.0.1:8000/v1/chat/completions,http://10.0.0.2:8000/v1/chat/completions"）
     const std::string BASE_URL = "http://172.22.5.101:8000/v1/chat/completions"; // "http://127.0.0.1:11434/api/generate";
     const std::string MODEL_NAME = "../huggingface_models/Qwen3-VL-4B-Instruct"; // qwen3-vl:235b-cloud
     const std::string API_KEY = "";
@@ -31,6 +31,36 @@ namespace config
     const int TEXT_ANALYSIS_TIMEOUT = 60;
     const int FILE_ANALYSIS_TIMEOUT = 120;
 
+    // 上游并发（初始值与任务管理器的工作线程数一致，之后按观测到的延迟调整）
+    const int UPSTREAM_INITIAL_CONCURRENCY = 16;
+    const int UPSTREAM_MIN_CONCURRENCY = 1;
+    const int UPSTREAM_MAX_CONCURRENCY = 256;
+    const int UPSTREAM_MAX_QUEUE = 1024;
+
+    // 上游连接：每个后端主机最多256个连接（与并发上限一致），空闲时每个主机保留16个连接供复用
+    const int UPSTREAM_MAX_HOST_CONNECTIONS = 256;
+    const int UPSTREAM_IDLE_CONNECTIONS_PER_HOST = 16;
+
+    // 模型后端池：每5秒探测一次各副本，连续3次请求失败后摘除10秒，再次摘除时加倍（最长5分钟）
+    const int BACKEND_HEALTH_CHECK_INTERVAL_MS = 5000;
+    const int BACKEND_HEALTH_CHECK_TIMEOUT = 2;
+    const int BACKEND_EJECT_AFTER_FAILURES = 3;
+    const int BACKEND_BASE_EJECTION_SECONDS = 10;
+    const int BACKEND_MAX_EJECTION_SECONDS = 300;
+    // 启动时（非阻塞）预热到每个副本的连接数（HTTP/2后端只需一个连接），0为不预热
+    const int BACKEND_WARMUP_CONNECTIONS = 4;
+
+    // 请求对冲：超过近期延迟的p95（至少500毫秒）仍未返回时重发，对冲请求不超过请求数的5%（设为0关闭）
+    const double UPSTREAM_HEDGE_PERCENTILE = 0.95;
+    const double UPSTREAM_HEDGE_BUDGET = 0.05;
+    const int UPSTREAM_HEDGE_MIN_DELAY_MS = 500;
+
+    // 分析结果缓存：内存中保留最近使用的2048条，磁盘上最多10万条，保存7天（条数为0或目录为空时关闭对应层）
+    const size_t RESULT_CACHE_MEMORY_ENTRIES = 2048;
+    const std::string RESULT_CACHE_DIR = "./cache/analysis_results";
+    const size_t RESULT_CACHE_DISK_MAX_ENTRIES = 100000;
+    const int RESULT_CACHE_TTL_SECONDS = 7 * 24 * 3600;
+
     // 文件扩展名
     const std::vector<std::string> IMAGE_EXTENSIONS = {
         ".jpg", ".jpeg", ".png", ".bmp", ".tiff", ".webp",
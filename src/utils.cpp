@@ -1,6 +1,10 @@
 #include "utils.hpp"
 #include "config.hpp"
 #include "GPUManager.hpp"
+#include "Metrics.hpp"
+#include "Tracer.hpp"
+#include "Logger.hpp"
+#include "CurlShare.hpp"
 #include <fstream>
 #include <sstream>
 #include <algorithm>
@@ -140,132 +144,124 @@ namespace utils
         return files;
     }
 
-    // Base64编码
-    std::string base64_encode(const std::vector<unsigned char> &data)
-    {
-        static const std::string base64_chars =
-            "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
-            "abcdefghijklmnopqrstuvwxyz"
-            "0123456789+/";
+    static const char BASE64_CHARS[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+        "abcdefghijklmnopqrstuvwxyz"
+        "0123456789+/";
 
-        std::string encoded;
-        int i = 0;
-        int j = 0;
-        unsigned char char_array_3[3];
-        unsigned char char_array_4[4];
+    size_t base64_encoded_size(size_t size)
+    {
+        return (size + 2) / 3 * 4;
+    }
 
-        for (const auto &byte : data)
+    char *base64_encode_to(const unsigned char *data, size_t size, char *out)
+    {
+        size_t i = 0;
+        for (; i + 3 <= size; i += 3)
         {
-            char_array_3[i++] = byte;
-            if (i == 3)
-            {
-                char_array_4[0] = (char_array_3[0] & 0xfc) >> 2;
-                char_array_4[1] = ((char_array_3[0] & 0x03) << 4) + ((char_array_3[1] & 0xf0) >> 4);
-                char_array_4[2] = ((char_array_3[1] & 0x0f) << 2) + ((char_array_3[2] & 0xc0) >> 6);
-                char_array_4[3] = char_array_3[2] & 0x3f;
-
-                for (i = 0; i < 4; i++)
-                {
-                    encoded += base64_chars[char_array_4[i]];
-                }
-                i = 0;
-            }
+            uint32_t triple = (static_cast<uint32_t>(data[i]) << 16) | (static_cast<uint32_t>(data[i + 1]) << 8) | data[i + 2];
+            out[0] = BASE64_CHARS[(triple >> 18) & 0x3f];
+            out[1] = BASE64_CHARS[(triple >> 12) & 0x3f];
+            out[2] = BASE64_CHARS[(triple >> 6) & 0x3f];
+            out[3] = BASE64_CHARS[triple & 0x3f];
+            out += 4;
         }
 
-        if (i > 0)
+        size_t remaining = size - i;
+        if (remaining > 0)
         {
-            for (j = i; j < 3; j++)
-            {
-                char_array_3[j] = '\0';
-            }
+            uint32_t triple = static_cast<uint32_t>(data[i]) << 16;
+            if (remaining == 2)
+                triple |= static_cast<uint32_t>(data[i + 1]) << 8;
+            out[0] = BASE64_CHARS[(triple >> 18) & 0x3f];
+            out[1] = BASE64_CHARS[(triple >> 12) & 0x3f];
+            out[2] = remaining == 2 ? BASE64_CHARS[(triple >> 6) & 0x3f] : '=';
+            out[3] = '=';
+            out += 4;
+        }
 
-            char_array_4[0] = (char_array_3[0] & 0xfc) >> 2;
-            char_array_4[1] = ((char_array_3[0] & 0x03) << 4) + ((char_array_3[1] & 0xf0) >> 4);
-            char_array_4[2] = ((char_array_3[1] & 0x0f) << 2) + ((char_array_3[2] & 0xc0) >> 6);
-            char_array_4[3] = char_array_3[2] & 0x3f;
+        return out;
+    }
 
-            for (j = 0; j < i + 1; j++)
-            {
-                encoded += base64_chars[char_array_4[j]];
-            }
+    // Base64编码
+    std::string base64_encode(const std::vector<unsigned char> &data)
+    {
+        static Histogram &base64_seconds = Metrics::getInstance().stage("base64");
+        ScopedTimer timer(base64_seconds);
 
-            while (i++ < 3)
-            {
-                encoded += '=';
-            }
-        }
+        return base64_encode_chunked(data.data(), data.size());
+    }
 
+    // 一次分配好结果的内存后直接写入
+    std::string base64_encode_chunked(const unsigned char *data, size_t size)
+    {
+        std::string encoded(base64_encoded_size(size), '\0');
+        base64_encode_to(data, size, &encoded[0]);
         return encoded;
     }
 
-    // 分块Base64编码，减少内存占用
     std::string base64_encode_chunked(const std::vector<unsigned char> &data)
     {
-        static const std::string base64_chars =
-            "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
-            "abcdefghijklmnopqrstuvwxyz"
-            "0123456789+/";
-
-        std::string encoded;
-        encoded.reserve((data.size() * 4 + 2) / 3); // 预分配内存，减少重新分配次数
-
-        const size_t chunk_size = 3 * 4096; // 12KB的块，确保是3的倍数
-        size_t pos = 0;
-
-        while (pos < data.size())
-        {
-            size_t end = std::min(pos + chunk_size, data.size());
-
-            // 处理当前块
-            for (size_t i = pos; i < end; i += 3)
-            {
-                unsigned char char_array_3[3];
-                unsigned char char_array_4[4];
-                int j = 0;
-
-                // 填充char_array_3
-                for (j = 0; j < 3 && (i + j) < end; ++j)
-                {
-                    char_array_3[j] = data[i + j];
-                }
+        return base64_encode_chunked(data.data(), data.size());
+    }
 
-                // 填充剩余的0
-                for (; j < 3; ++j)
-                {
-                    char_array_3[j] = (char)0;
-                }
+    // 大图片缩小并重新编码为JPEG，减少上传到模型的数据量
+    static std::vector<unsigned char> compress_image_to_jpeg(cv::Mat img, double start_time)
+    {
+        int original_width = img.cols;
+        int original_height = img.rows;
 
-                char_array_4[0] = (char_array_3[0] & 0xfc) >> 2;
-                char_array_4[1] = ((char_array_3[0] & 0x03) << 4) + ((char_array_3[1] & 0xf0) >> 4);
-                char_array_4[2] = ((char_array_3[1] & 0x0f) << 2) + ((char_array_3[2] & 0xc0) >> 6);
-                char_array_4[3] = char_array_3[2] & 0x3f;
+        // 进一步减小图片尺寸，提高处理速度
+        int max_size = 256; // 降低到256像素，大幅提高处理速度
 
-                // 计算实际有效的字符数
-                int valid_chars = 4;
-                if (i + 2 >= data.size())
-                    valid_chars = 3;
-                if (i + 1 >= data.size())
-                    valid_chars = 2;
+        // 缩放和编码的耗时分别计入image_resize和image_encode阶段（每次编码各记录一次）
+        static Histogram &resize_seconds = Metrics::getInstance().stage("image_resize");
+        static Histogram &encode_seconds = Metrics::getInstance().stage("image_encode");
 
-                for (j = 0; j < valid_chars; j++)
-                {
-                    encoded += base64_chars[char_array_4[j]];
-                }
+        // 直接调整到目标尺寸，减少中间步骤
+        if (img.cols > max_size || img.rows > max_size)
+        {
+            ScopedTimer timer(resize_seconds);
+            double scale = max_size / (double)std::max(img.cols, img.rows);
+            cv::Mat resized;
+            // 使用INTER_NEAREST插值，比INTER_LINEAR更快
+            cv::resize(img, resized, cv::Size(), scale, scale, cv::INTER_NEAREST);
+            img = resized;
+        }
 
-                // 添加填充的'='
-                while (valid_chars++ < 4)
-                {
-                    encoded += '=';
-                }
-            }
+        // 降低图片质量，减小文件大小
+        std::vector<uchar> jpeg_data;
+        // 进一步降低JPEG质量至55，平衡质量和速度
+        std::vector<int> params = {cv::IMWRITE_JPEG_QUALITY, 55, cv::IMWRITE_JPEG_OPTIMIZE, 1};
+        {
+            ScopedTimer timer(encode_seconds);
+            cv::imencode(".jpg", img, jpeg_data, params);
+        }
+        size_t first_size = jpeg_data.size();
 
-            pos = end;
+        // 如果压缩后仍然较大，进一步降低质量
+        bool reencoded = false;
+        if (jpeg_data.size() > 100 * 1024) // 降低阈值到100KB
+        {
+            ScopedTimer timer(encode_seconds);
+            params = {cv::IMWRITE_JPEG_QUALITY, 40, cv::IMWRITE_JPEG_OPTIMIZE, 1};
+            jpeg_data.clear();
+            cv::imencode(".jpg", img, jpeg_data, params);
+            reencoded = true;
         }
 
-        return encoded;
+        LOG_DEBUG("⏰ [性能] 图片压缩完成",
+                  {{"width", original_width},
+                   {"height", original_height},
+                   {"first_bytes", first_size},
+                   {"reencoded", reencoded},
+                   {"bytes", jpeg_data.size()},
+                   {"total_seconds", get_current_time() - start_time}});
+
+        return jpeg_data;
     }
 
-    std::string base64_encode_file(const std::string &file_path)
+    std::vector<unsigned char> load_image_for_request(const std::string &file_path)
     {
         double start_time = get_current_time();
         std::ifstream file(file_path, std::ios::binary);
@@ -279,109 +275,53 @@ namespace utils
         size_t file_size = file.tellg();
         file.seekg(0, std::ios::beg);
 
-        double file_info_time = get_current_time();
-        std::cout << "⏰ [性能] 文件信息获取完成，耗时: " << (file_info_time - start_time) << " 秒" << std::endl;
-        std::cout << "⏰ [性能] 原始文件大小: " << file_size << " 字节" << std::endl;
-
         // 降低压缩阈值到256KB，减少处理时间
         if (file_size > 256 * 1024)
         {
-            std::cout << "⏰ [性能] 文件过大，开始压缩处理..." << std::endl;
-            double compress_start = get_current_time();
-
             // 使用OpenCV读取并压缩图片
+            double load_start = get_current_time();
             cv::Mat img = cv::imread(file_path);
             if (!img.empty())
             {
-                double load_time = get_current_time();
-                std::cout << "⏰ [性能] 图片加载完成，耗时: " << (load_time - compress_start) << " 秒" << std::endl;
-                std::cout << "⏰ [性能] 图片尺寸: " << img.cols << "x" << img.rows << std::endl;
-
-                // 进一步减小图片尺寸，提高处理速度
-                int max_size = 256; // 降低到256像素，大幅提高处理速度
-
-                // 直接调整到目标尺寸，减少中间步骤
-                if (img.cols > max_size || img.rows > max_size)
-                {
-                    double resize_start = get_current_time();
-                    double scale = max_size / (double)std::max(img.cols, img.rows);
-                    cv::Mat resized;
-                    // 使用INTER_NEAREST插值，比INTER_LINEAR更快
-                    cv::resize(img, resized, cv::Size(), scale, scale, cv::INTER_NEAREST);
-                    img = resized;
-                    double resize_end = get_current_time();
-                    std::cout << "⏰ [性能] 图片缩放完成，耗时: " << (resize_end - resize_start) << " 秒" << std::endl;
-                }
-
-                // 降低图片质量，减小文件大小
-                double encode_start = get_current_time();
-                std::vector<uchar> jpeg_data;
-                // 进一步降低JPEG质量至55，平衡质量和速度
-                std::vector<int> params = {cv::IMWRITE_JPEG_QUALITY, 55, cv::IMWRITE_JPEG_OPTIMIZE, 1};
-                cv::imencode(".jpg", img, jpeg_data, params);
-                double encode_end = get_current_time();
-                std::cout << "⏰ [性能] 图片编码完成，耗时: " << (encode_end - encode_start) << " 秒" << std::endl;
-                std::cout << "⏰ [性能] 压缩后大小: " << jpeg_data.size() << " 字节" << std::endl;
-
-                // 如果压缩后仍然较大，进一步降低质量
-                if (jpeg_data.size() > 100 * 1024) // 降低阈值到100KB
-                {
-                    std::cout << "⏰ [性能] 文件仍然过大，进行二次压缩..." << std::endl;
-                    double reencode_start = get_current_time();
-                    params = {cv::IMWRITE_JPEG_QUALITY, 40, cv::IMWRITE_JPEG_OPTIMIZE, 1};
-                    jpeg_data.clear();
-                    cv::imencode(".jpg", img, jpeg_data, params);
-                    double reencode_end = get_current_time();
-                    std::cout << "⏰ [性能] 二次压缩完成，耗时: " << (reencode_end - reencode_start) << " 秒" << std::endl;
-                    std::cout << "⏰ [性能] 二次压缩后大小: " << jpeg_data.size() << " 字节" << std::endl;
-                }
-
-                double b64_start = get_current_time();
-                // 使用分块编码方式处理Base64，减少内存占用
-                std::string result = base64_encode_chunked(jpeg_data);
-                double b64_end = get_current_time();
-                std::cout << "⏰ [性能] Base64编码完成，耗时: " << (b64_end - b64_start) << " 秒" << std::endl;
-
-                double total_time = get_current_time() - start_time;
-                std::cout << "⏰ [性能] 图片处理总耗时: " << total_time << " 秒" << std::endl;
-
-                return result;
+                LOG_TRACE("⏰ [性能] 图片加载完成", {{"path", file_path}, {"bytes", file_size}, {"seconds", get_current_time() - load_start}});
+                return compress_image_to_jpeg(img, start_time);
             }
         }
 
-        // 小图片直接读取和编码
-        std::cout << "⏰ [性能] 文件较小，直接处理..." << std::endl;
-        double read_start = get_current_time();
+        // 小图片直接读取，按文件大小一次分配
+        std::vector<unsigned char> buffer(file_size);
+        file.read(reinterpret_cast<char *>(buffer.data()), file_size);
+        buffer.resize(file.gcount());
 
-        // 使用分块读取方式，减少内存峰值
-        const size_t chunk_size = 64 * 1024; // 64KB块
-        std::vector<unsigned char> buffer;
-        buffer.reserve(file_size);
+        LOG_TRACE("⏰ [性能] 图片读取完成", {{"path", file_path}, {"bytes", buffer.size()}, {"seconds", get_current_time() - start_time}});
+        return buffer;
+    }
 
-        std::vector<unsigned char> chunk(chunk_size);
-        while (file.read(reinterpret_cast<char *>(chunk.data()), chunk_size))
-        {
-            buffer.insert(buffer.end(), chunk.begin(), chunk.begin() + file.gcount());
-        }
-        // 处理最后一个不完整的块
-        if (file.gcount() > 0)
+    std::vector<unsigned char> prepare_image_for_request(std::string_view data)
+    {
+        // 与load_image_for_request相同的处理，但直接使用内存中的图片数据（如上传的请求体），不经过临时文件
+        double start_time = get_current_time();
+        if (data.size() > 256 * 1024)
         {
-            buffer.insert(buffer.end(), chunk.begin(), chunk.begin() + file.gcount());
+            cv::Mat raw(1, static_cast<int>(data.size()), CV_8UC1, const_cast<char *>(data.data()));
+            cv::Mat img = cv::imdecode(raw, cv::IMREAD_COLOR);
+            if (!img.empty())
+            {
+                return compress_image_to_jpeg(img, start_time);
+            }
         }
 
-        double read_end = get_current_time();
-        std::cout << "⏰ [性能] 文件读取完成，耗时: " << (read_end - read_start) << " 秒" << std::endl;
-
-        double b64_start = get_current_time();
-        // 使用分块编码方式处理Base64
-        std::string result = base64_encode_chunked(buffer);
-        double b64_end = get_current_time();
-        std::cout << "⏰ [性能] Base64编码完成，耗时: " << (b64_end - b64_start) << " 秒" << std::endl;
+        return std::vector<unsigned char>(data.begin(), data.end());
+    }
 
-        double total_time = get_current_time() - start_time;
-        std::cout << "⏰ [性能] 图片处理总耗时: " << total_time << " 秒" << std::endl;
+    std::string base64_encode_file(const std::string &file_path)
+    {
+        return base64_encode_chunked(load_image_for_request(file_path));
+    }
 
-        return result;
+    std::string base64_encode_image_data(std::string_view data)
+    {
+        return base64_encode_chunked(prepare_image_for_request(data));
     }
 
     std::vector<unsigned char> base64_decode(const std::string &encoded_string)
@@ -463,36 +403,39 @@ namespace utils
     // 图像处理
     std::vector<unsigned char> encode_image_to_jpeg(const cv::Mat &image, int quality)
     {
+        static Histogram &encode_seconds = Metrics::getInstance().stage("image_encode");
+        ScopedTimer timer(encode_seconds);
+
         // 使用GPU加速（如果可用）
         return gpu::GPUManager::encode_image_to_jpeg(image, quality);
     }
 
     cv::Mat resize_image(const cv::Mat &image, int max_size)
     {
+        static Histogram &resize_seconds = Metrics::getInstance().stage("image_resize");
+        ScopedTimer timer(resize_seconds);
+
         // 使用GPU加速（如果可用）
         return gpu::GPUManager::resize_image(image, max_size);
     }
 
-    std::string optimize_image_for_ollama(const std::string &base64_data, const std::string &image_url)
+    bool optimize_image_for_ollama(std::vector<unsigned char> &image_data, bool keep_png)
     {
         try
         {
-            // 解码base64数据
-            std::vector<unsigned char> image_data = base64_decode(base64_data);
-
             // 从内存中加载图像
             cv::Mat image = cv::imdecode(image_data, cv::IMREAD_COLOR);
             if (image.empty())
             {
                 std::cout << "⚠️ 无法解码图片数据，返回原始数据" << std::endl;
-                return base64_data;
+                return false;
             }
 
             // 确保图片格式是Ollama支持的格式（JPEG或PNG）
             std::string output_format = ".jpg"; // 默认使用JPEG格式
 
             // 如果原始格式是PNG，可以考虑保留PNG格式（对于透明度重要的图像）
-            if (image_url.find("data:image/png") == 0)
+            if (keep_png)
             {
                 output_format = ".png";
             }
@@ -537,14 +480,26 @@ namespace utils
                 }
             }
 
-            // 重新编码为base64
-            return base64_encode(optimized_data);
+            image_data.swap(optimized_data);
+            return true;
         }
         catch (const std::exception &e)
         {
             std::cout << "⚠️ 图片优化失败: " << e.what() << "，返回原始数据" << std::endl;
+            return false;
+        }
+    }
+
+    std::string optimize_image_for_ollama(const std::string &base64_data, const std::string &image_url)
+    {
+        std::vector<unsigned char> image_data = base64_decode(base64_data);
+        if (!optimize_image_for_ollama(image_data, image_url.find("data:image/png") == 0))
+        {
             return base64_data;
         }
+
+        // 重新编码为base64
+        return base64_encode(image_data);
     }
 
     // JSON工具
@@ -653,8 +608,30 @@ namespace utils
 
     // 文件下载工具
 
+    // 当前线程用于下载的easy句柄（线程退出时释放）
+    static CURL *thread_download_handle()
+    {
+        struct Handle
+        {
+            CURL *curl = curl_easy_init();
+            ~Handle()
+            {
+                if (curl)
+                    curl_easy_cleanup(curl);
+            }
+        };
+        static thread_local Handle handle;
+        return handle.curl;
+    }
+
     bool download_file(const std::string &url, const std::string &output_path)
     {
+        // 命中缓存时只是本地复制，同样计入下载耗时
+        static Histogram &download_seconds = Metrics::getInstance().stage("download");
+        ScopedTimer timer(download_seconds);
+        Span span("download");
+        span.set_arg("url", url);
+
         // 检查缓存
         {
             std::lock_guard<std::mutex> lock(cache_mutex);
@@ -695,35 +672,38 @@ namespace utils
 
         std::string temp_path = "/tmp/download_cache_" + unique_id + ".jpg";
 
-        CURL *curl = curl_easy_init();
-        if (!curl)
+        FILE *fp = fopen(temp_path.c_str(), "wb");
+        if (!fp)
         {
-            std::cerr << "❌ 初始化CURL失败" << std::endl;
+            std::cerr << "❌ 无法打开输出文件: " << temp_path << std::endl;
             return false;
         }
 
-        FILE *fp = fopen(temp_path.c_str(), "wb");
-        if (!fp)
+        // 下载在当前工作线程中完成（文件写入不占用模型请求的事件线程）。每个线程复用自己的easy句柄：
+        // 句柄保留的连接缓存使同一CDN的后续下载直接复用keep-alive连接；DNS缓存和TLS会话按主机在线程间共享（CurlShare）
+        CURL *curl = thread_download_handle();
+        if (!curl)
         {
-            std::cerr << "❌ 无法打开输出文件: " << temp_path << std::endl;
-            curl_easy_cleanup(curl);
+            std::cerr << "❌ 初始化CURL失败" << std::endl;
+            fclose(fp);
+            std::filesystem::remove(temp_path);
             return false;
         }
 
+        curl_easy_reset(curl);
         curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+        curl_easy_setopt(curl, CURLOPT_SHARE, CurlShare::for_url(url));
         curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, NULL);
         curl_easy_setopt(curl, CURLOPT_WRITEDATA, fp);
         curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
         curl_easy_setopt(curl, CURLOPT_TIMEOUT, 60L); // 1分钟超时
-        curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+        curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
         curl_easy_setopt(curl, CURLOPT_USERAGENT, "Mozilla/5.0");
 
         // 启用TCP Fast Open
         curl_easy_setopt(curl, CURLOPT_TCP_FASTOPEN, 1L);
 
         CURLcode res = curl_easy_perform(curl);
-
-        curl_easy_cleanup(curl);
         fclose(fp);
 
         if (res != CURLE_OK)
@@ -3,8 +3,11 @@
 # 设置API服务可执行文件路径
 API_EXECUTABLE="./build/doubao_api_server"
 
-# 设置端口列表
-PORTS=("8080" "8081" "8082" "8083")
+# 监听端口和worker进程数
+# 所有worker以SO_REUSEPORT共同监听同一端口，由内核在worker之间分配连接，
+# supervisor进程负责重启异常退出的worker
+PORT="8080"
+WORKERS="4"
 
 # 设置日志目录
 LOG_DIR="./logs"
@@ -13,10 +16,8 @@ LOG_DIR="./logs"
 mkdir -p $LOG_DIR
 
 # 启动API服务
-for port in "${PORTS[@]}"; do
-    echo "Starting API service on port $port..."
-    nohup $API_EXECUTABLE --port $port > "$LOG_DIR/api_$port.log" 2>&1 &
-    echo $! > "$LOG_DIR/api_$port.pid"
-done
+echo "Starting API service on port $PORT with $WORKERS workers..."
+nohup $API_EXECUTABLE --port $PORT --workers $WORKERS > "$LOG_DIR/api_$PORT.log" 2>&1 &
+echo $! > "$LOG_DIR/api_$PORT.pid"
 
 echo "All API services started."
@@ -1,21 +1,19 @@
 #!/bin/bash
 
-# 设置端口列表
-PORTS=("8080" "8081" "8082" "8083")
+# 监听端口（与start_api_services.sh一致）
+PORT="8080"
 
 # 设置日志目录
 LOG_DIR="./logs"
 
-# 停止API服务
-for port in "${PORTS[@]}"; do
-    if [ -f "$LOG_DIR/api_$port.pid" ]; then
-        PID=$(cat "$LOG_DIR/api_$port.pid")
-        echo "Stopping API service on port $port (PID: $PID)..."
-        kill $PID
-        rm "$LOG_DIR/api_$port.pid"
-    else
-        echo "No PID file found for API service on port $port"
-    fi
-done
+# 停止API服务：向supervisor发送SIGTERM，由它停止所有worker
+if [ -f "$LOG_DIR/api_$PORT.pid" ]; then
+    PID=$(cat "$LOG_DIR/api_$PORT.pid")
+    echo "Stopping API service on port $PORT (PID: $PID)..."
+    kill $PID
+    rm "$LOG_DIR/api_$PORT.pid"
+else
+    echo "No PID file found for API service on port $PORT"
+fi
 
 echo "All API services stopped."